@@ -142,6 +142,28 @@ module cmi_fortran_library
     subroutine cmi_destroy() bind(C, name = "cmi_destroy")
     end subroutine cmi_destroy
 
+    !-
+    !> @brief Fortran interface for CMILibrary::cmi_set_incremental_mapping().
+    !>
+    !> @param tolerance Change in position or smoothing length (in units of
+    !> the smoothing length) below which the mapping for a particle is reused.
+    !-
+    subroutine cmi_set_incremental_mapping(tolerance) &
+      bind(C, name = "cmi_set_incremental_mapping")
+
+      use iso_c_binding
+      implicit none
+
+      real (kind = c_double), intent(in), value :: tolerance
+
+    end subroutine cmi_set_incremental_mapping
+
+    !-
+    !> @brief Fortran interface for CMILibrary::cmi_set_warm_start().
+    !-
+    subroutine cmi_set_warm_start() bind(C, name = "cmi_set_warm_start")
+    end subroutine cmi_set_warm_start
+
     !-
     !> @brief Fortran interface for
     !> CMILibrary::cmi_compute_neutral_fraction_dp().
@@ -0,0 +1,155 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file AliasTable.hpp
+ *
+ * @brief Alias table that samples an index from a discrete probability
+ * distribution in constant time.
+ *
+ * The table is constructed using Vose's variant of Walker's alias method, which
+ * takes O(N) time for N elements. Every element i of the table has an
+ * acceptance probability p_i and an alias a_i. To sample an index, we pick a
+ * uniform random element i, and return i with probability p_i and a_i
+ * otherwise. Both choices are made using a single uniform random number: the
+ * integer part of N x selects the element, the fractional part is compared
+ * with the acceptance probability.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef ALIASTABLE_HPP
+#define ALIASTABLE_HPP
+
+#include "Error.hpp"
+
+#include <cinttypes>
+#include <vector>
+
+/**
+ * @brief Alias table that samples an index from a discrete probability
+ * distribution in constant time.
+ */
+class AliasTable {
+private:
+  /*! @brief Acceptance probability for every element. */
+  std::vector< double > _probabilities;
+
+  /*! @brief Alias for every element. */
+  std::vector< uint_fast32_t > _aliases;
+
+  /*! @brief Work list of elements with a scaled probability smaller than 1
+   *  (kept to avoid reallocating memory when the table is rebuilt). */
+  std::vector< uint_fast32_t > _small;
+
+  /*! @brief Work list of elements with a scaled probability of at least 1
+   *  (kept to avoid reallocating memory when the table is rebuilt). */
+  std::vector< uint_fast32_t > _large;
+
+public:
+  /**
+   * @brief (Re)build the table for the given weights.
+   *
+   * The weights do not need to be normalised. Memory is only reallocated if
+   * the number of weights grows beyond the largest number used before, so
+   * rebuilding the table when sources are added or removed is cheap.
+   *
+   * @param weights Weights of all elements (should be non-negative, with a
+   * non-zero sum).
+   */
+  inline void initialize(const std::vector< double > &weights) {
+
+    const size_t size = weights.size();
+    _probabilities.resize(size);
+    _aliases.resize(size);
+    _small.clear();
+    _large.clear();
+    if (size == 0) {
+      return;
+    }
+
+    double total_weight = 0.;
+    for (size_t i = 0; i < size; ++i) {
+      cmac_assert_message(weights[i] >= 0., "Negative weight!");
+      total_weight += weights[i];
+    }
+    if (!(total_weight > 0.)) {
+      cmac_error("Alias table weights have a zero sum!");
+    }
+
+    // scale the probabilities so that their average is 1
+    const double norm = size / total_weight;
+    for (size_t i = 0; i < size; ++i) {
+      _probabilities[i] = weights[i] * norm;
+      _aliases[i] = i;
+      if (_probabilities[i] < 1.) {
+        _small.push_back(i);
+      } else {
+        _large.push_back(i);
+      }
+    }
+
+    // pair every small element with a large element that fills up the
+    // remainder of its slot
+    while (!_small.empty() && !_large.empty()) {
+      const uint_fast32_t small = _small.back();
+      _small.pop_back();
+      const uint_fast32_t large = _large.back();
+      _aliases[small] = large;
+      _probabilities[large] -= 1. - _probabilities[small];
+      if (_probabilities[large] < 1.) {
+        _large.pop_back();
+        _small.push_back(large);
+      }
+    }
+
+    // the remaining elements have a probability of 1 up to round off
+    for (size_t i = 0; i < _large.size(); ++i) {
+      _probabilities[_large[i]] = 1.;
+    }
+    for (size_t i = 0; i < _small.size(); ++i) {
+      _probabilities[_small[i]] = 1.;
+    }
+  }
+
+  /**
+   * @brief Get the number of elements in the table.
+   *
+   * @return Number of elements.
+   */
+  inline size_t size() const { return _probabilities.size(); }
+
+  /**
+   * @brief Sample an index using the given uniform random number.
+   *
+   * @param x Uniform random number in the range [0, 1[.
+   * @return Index, distributed according to the weights of the table.
+   */
+  inline uint_fast32_t get_index(const double x) const {
+    cmac_assert(_probabilities.size() > 0);
+    const double scaled_x = x * _probabilities.size();
+    uint_fast32_t index = scaled_x;
+    // guard against round off for x very close to 1
+    if (index >= _probabilities.size()) {
+      index = _probabilities.size() - 1;
+    }
+    const double fraction = scaled_x - index;
+    return (fraction < _probabilities[index]) ? index : _aliases[index];
+  }
+};
+
+#endif // ALIASTABLE_HPP
@@ -132,6 +132,32 @@ void cmi_destroy() {
   delete global_log;
 }
 
+/**
+ * @brief Reuse the density mapping of the previous call for SPH particles that
+ * did not change significantly.
+ *
+ * Only has an effect for the centroid and Petkova mapping types. Should be
+ * called after the library was initialized.
+ *
+ * @param tolerance Change in position or smoothing length (in units of the
+ * smoothing length) below which the mapping for a particle is reused.
+ */
+void cmi_set_incremental_mapping(const double tolerance) {
+  global_interface->set_incremental_mapping(tolerance);
+}
+
+/**
+ * @brief Start every computation from the ionization and temperature state at
+ * the end of the previous computation.
+ *
+ * Subsequent computations use the full number of photons from the first
+ * iteration and continue the iteration count of the previous computation.
+ * Should be called after the library was initialized.
+ */
+void cmi_set_warm_start() {
+  global_ionization_simulation->set_warm_start(true);
+}
+
 /**
  * @brief Compute the neutral fractions for the given SPH density field and
  * store them in the given array.
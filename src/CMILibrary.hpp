@@ -59,6 +59,9 @@ void cmi_init_periodic_sp(const char *parameter_file, const int num_thread,
                           const int talk);
 void cmi_destroy();
 
+void cmi_set_incremental_mapping(const double tolerance);
+void cmi_set_warm_start();
+
 void cmi_compute_neutral_fraction_dp(const double *x, const double *y,
                                      const double *z, const double *h,
                                      const double *m, double *nH,
@@ -303,15 +303,11 @@ int main(int argc, char **argv) {
 
   } else if (parser.get_value< bool >("task-based")) {
 
-    if (comm.get_size() > 1) {
-      cmac_error("MPI task based algorithm does not exist yet.");
-    }
-
     TaskBasedIonizationSimulation simulation(
         parser.get_value< int_fast32_t >("threads"),
         parser.get_value< std::string >("params"),
         parser.get_value< bool >("task-plot"),
-        !parser.get_value< bool >("no-initial-output"), log);
+        !parser.get_value< bool >("no-initial-output"), &comm, log);
 
     if (parser.get_value< bool >("dry-run")) {
       if (log) {
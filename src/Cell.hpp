@@ -29,6 +29,12 @@
 #include "CoordinateVector.hpp"
 #include "Face.hpp"
 
+#include <cstdint>
+
+/*! @brief Index returned by Cell::get_cell_index() for cells that are not part
+ *  of a grid. */
+#define CELL_NO_INDEX SIZE_MAX
+
 /**
  * @brief General interface for geometrical cell information.
  */
@@ -54,6 +60,17 @@ public:
    * @return Faces of the cell.
    */
   virtual std::vector< Face > get_faces() const = 0;
+
+  /**
+   * @brief Get the index of the cell within the grid it belongs to.
+   *
+   * The index can be used to store information about the cell in between
+   * calls that receive the same cell.
+   *
+   * @return Index of the cell, or CELL_NO_INDEX if the cell is not part of a
+   * grid that provides indices.
+   */
+  virtual size_t get_cell_index() const { return CELL_NO_INDEX; }
 };
 
 /**
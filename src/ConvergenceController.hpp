@@ -0,0 +1,440 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file ConvergenceController.hpp
+ *
+ * @brief Convergence driven control of the number of iterations and the number
+ * of photon packets of the photoionization algorithm.
+ *
+ * After every iteration, the simulation measures the mean absolute change in
+ * the hydrogen neutral fraction and the mean relative change in the
+ * temperature of all cells (using ConvergenceController::Changes). The
+ * temperature change is weighted with the ionized fraction, since the
+ * temperature of neutral cells is not relevant and very noisy. The run is
+ * converged as soon as both changes are below the tolerance.
+ *
+ * As long as the state is still evolving systematically, the changes decrease
+ * from one iteration to the next. Monte Carlo noise on the other hand causes
+ * changes that do not depend on the iteration, but only on the number of
+ * photon packets. If the changes no longer decrease significantly, we hence
+ * assume that noise dominates, and increase the number of photon packets by
+ * a fixed factor (up to a maximum).
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef CONVERGENCECONTROLLER_HPP
+#define CONVERGENCECONTROLLER_HPP
+
+#include "Error.hpp"
+#include "Log.hpp"
+#include "ParameterFile.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <sstream>
+#include <string>
+
+/*! @brief Number of sums stored in a ConvergenceController::Changes object. */
+#define CONVERGENCECONTROLLER_NUMBER_OF_SUMS 4
+
+/**
+ * @brief Convergence driven control of the number of iterations and the number
+ * of photon packets of the photoionization algorithm.
+ */
+class ConvergenceController {
+public:
+  /**
+   * @brief Sums of the changes in the hydrogen neutral fraction and the
+   * temperature of a set of cells during an iteration.
+   *
+   * Every thread accumulates the changes of its cells in its own object. The
+   * sums of different threads (or processes) can then simply be added.
+   */
+  class Changes {
+  private:
+    /*! @brief Sums: absolute change in the hydrogen neutral fraction,
+     *  relative change in the temperature weighted with the ionized fraction,
+     *  ionized fraction and number of cells. */
+    double _sums[CONVERGENCECONTROLLER_NUMBER_OF_SUMS];
+
+  public:
+    /**
+     * @brief Constructor.
+     */
+    inline Changes() { reset(); }
+
+    /**
+     * @brief Reset all sums to zero.
+     */
+    inline void reset() {
+      for (uint_fast8_t i = 0; i < CONVERGENCECONTROLLER_NUMBER_OF_SUMS; ++i) {
+        _sums[i] = 0.;
+      }
+    }
+
+    /**
+     * @brief Add the changes of a single cell.
+     *
+     * @param xH_old Hydrogen neutral fraction before the iteration.
+     * @param xH Hydrogen neutral fraction after the iteration.
+     * @param T_old Temperature before the iteration (in K).
+     * @param T Temperature after the iteration (in K).
+     */
+    inline void accumulate(const double xH_old, const double xH,
+                           const double T_old, const double T) {
+      _sums[0] += std::abs(xH - xH_old);
+      if (T > 0.) {
+        _sums[1] += (1. - xH) * std::abs(T - T_old) / T;
+        _sums[2] += 1. - xH;
+      }
+      _sums[3] += 1.;
+    }
+
+    /**
+     * @brief Add the sums of the given object.
+     *
+     * @param changes Changes to add.
+     * @return Reference to this object.
+     */
+    inline Changes &operator+=(const Changes &changes) {
+      for (uint_fast8_t i = 0; i < CONVERGENCECONTROLLER_NUMBER_OF_SUMS; ++i) {
+        _sums[i] += changes._sums[i];
+      }
+      return *this;
+    }
+
+    /**
+     * @brief Access the sums, e.g. to reduce them across MPI processes.
+     *
+     * @return Array of CONVERGENCECONTROLLER_NUMBER_OF_SUMS sums.
+     */
+    inline double *get_sums() { return _sums; }
+
+    /**
+     * @brief Get the mean absolute change in the hydrogen neutral fraction.
+     *
+     * @return Mean absolute neutral fraction change.
+     */
+    inline double get_neutral_fraction_change() const {
+      return (_sums[3] > 0.) ? _sums[0] / _sums[3] : 0.;
+    }
+
+    /**
+     * @brief Get the mean relative change in the temperature, weighted with
+     * the ionized fraction.
+     *
+     * @return Mean relative temperature change.
+     */
+    inline double get_temperature_change() const {
+      return (_sums[2] > 0.) ? _sums[1] / _sums[2] : 0.;
+    }
+  };
+
+private:
+  /*! @brief Tolerance on the mean changes (a value of zero disables the
+   *  controller). */
+  double _tolerance;
+
+  /*! @brief Maximum number of photon packets. */
+  const uint_fast64_t _maximum_number_of_photons;
+
+  /*! @brief Factor by which the number of photon packets is increased. */
+  const uint_fast32_t _photon_growth_factor;
+
+  /*! @brief Minimum ratio of the changes of two consecutive iterations for
+   *  which the changes are considered to be dominated by noise. */
+  const double _noise_ratio;
+
+  /*! @brief Current number of photon packets. */
+  uint_fast64_t _number_of_photons;
+
+  /*! @brief Number of iterations since the last call to start_run(). */
+  uint_fast32_t _number_of_iterations;
+
+  /*! @brief Mean absolute change in the hydrogen neutral fraction during the
+   *  last iteration. */
+  double _neutral_fraction_change;
+
+  /*! @brief Mean relative change in the temperature during the last
+   *  iteration. */
+  double _temperature_change;
+
+  /*! @brief Largest of both changes during the previous iteration (negative if
+   *  not available). */
+  double _previous_change;
+
+  /*! @brief Did the run converge? */
+  bool _converged;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param number_of_photons Initial number of photon packets.
+   * @param tolerance Tolerance on the mean changes (a value of zero disables
+   * the controller).
+   * @param maximum_number_of_photons Maximum number of photon packets.
+   * @param photon_growth_factor Factor by which the number of photon packets
+   * is increased.
+   * @param noise_ratio Minimum ratio of the changes of two consecutive
+   * iterations for which the changes are considered to be dominated by noise.
+   */
+  inline ConvergenceController(const uint_fast64_t number_of_photons,
+                               const double tolerance,
+                               const uint_fast64_t maximum_number_of_photons,
+                               const uint_fast32_t photon_growth_factor,
+                               const double noise_ratio)
+      : _tolerance(tolerance),
+        _maximum_number_of_photons(maximum_number_of_photons),
+        _photon_growth_factor(photon_growth_factor), _noise_ratio(noise_ratio),
+        _number_of_photons(number_of_photons), _number_of_iterations(0),
+        _neutral_fraction_change(0.), _temperature_change(0.),
+        _previous_change(-1.), _converged(false) {
+
+    if (_tolerance < 0.) {
+      cmac_error("Convergence tolerance should be positive!");
+    }
+    if (_photon_growth_factor < 1) {
+      cmac_error("Photon number growth factor should be at least 1!");
+    }
+    if (_noise_ratio <= 0. || _noise_ratio > 1.) {
+      cmac_error("Noise ratio should be in the range (0, 1]!");
+    }
+  }
+
+  /**
+   * @brief ParameterFile constructor.
+   *
+   * Parameters are:
+   *  - tolerance: Tolerance on the mean absolute change in the hydrogen
+   *    neutral fraction and the mean relative change in the temperature
+   *    during an iteration (default: 0, which disables the controller)
+   *  - maximum number of photons: Maximum number of photon packets (default:
+   *    the initial number of photon packets)
+   *  - photon number growth factor: Factor by which the number of photon
+   *    packets is increased if noise dominates (default: 2)
+   *  - noise ratio: Minimum ratio of the changes of two consecutive iterations
+   *    for which the changes are considered to be dominated by noise
+   *    (default: 0.8)
+   *
+   * @param number_of_photons Initial number of photon packets.
+   * @param params ParameterFile to read from.
+   */
+  inline ConvergenceController(const uint_fast64_t number_of_photons,
+                               ParameterFile &params)
+      : ConvergenceController(
+            number_of_photons,
+            params.get_value< double >("ConvergenceController:tolerance", 0.),
+            params.get_value< uint_fast64_t >(
+                "ConvergenceController:maximum number of photons",
+                number_of_photons),
+            params.get_value< uint_fast32_t >(
+                "ConvergenceController:photon number growth factor", 2),
+            params.get_value< double >("ConvergenceController:noise ratio",
+                                       0.8)) {}
+
+  /**
+   * @brief Is the controller enabled?
+   *
+   * @return True if a non-zero tolerance was set.
+   */
+  inline bool is_enabled() const { return _tolerance > 0.; }
+
+  /**
+   * @brief Should a run with the given properties check for convergence?
+   *
+   * Runs with trackers never stop early: trackers are only added in the final
+   * iteration, which then needs to be known in advance.
+   *
+   * @param has_trackers Does the run use trackers?
+   * @return True if the controller is enabled and the run can stop early.
+   */
+  inline bool is_active(const bool has_trackers) const {
+    return is_enabled() && !has_trackers;
+  }
+
+  /**
+   * @brief Set the tolerance.
+   *
+   * @param tolerance Tolerance on the mean changes (a value of zero disables
+   * the controller).
+   */
+  inline void set_tolerance(const double tolerance) {
+    if (tolerance < 0.) {
+      cmac_error("Convergence tolerance should be positive!");
+    }
+    _tolerance = tolerance;
+  }
+
+  /**
+   * @brief Get the number of photon packets to use for the next iteration.
+   *
+   * @return Number of photon packets.
+   */
+  inline uint_fast64_t get_number_of_photons() const {
+    return _number_of_photons;
+  }
+
+  /**
+   * @brief Prepare for a new run.
+   *
+   * The number of photon packets is kept, so that consecutive runs reuse the
+   * number of photon packets that was needed before.
+   */
+  inline void start_run() {
+    _number_of_iterations = 0;
+    _neutral_fraction_change = 0.;
+    _temperature_change = 0.;
+    _previous_change = -1.;
+    _converged = false;
+  }
+
+  /**
+   * @brief Process the changes during the last iteration.
+   *
+   * @param neutral_fraction_change Mean absolute change in the hydrogen neutral
+   * fraction.
+   * @param temperature_change Mean relative change in the temperature.
+   * @param allows_convergence Can the state after this iteration be considered
+   * to be converged? If not, the changes are only recorded.
+   * @return True if the number of photon packets was increased.
+   */
+  inline bool update(const double neutral_fraction_change,
+                     const double temperature_change,
+                     const bool allows_convergence) {
+
+    ++_number_of_iterations;
+    _neutral_fraction_change = neutral_fraction_change;
+    _temperature_change = temperature_change;
+
+    if (!allows_convergence) {
+      _previous_change = -1.;
+      return false;
+    }
+
+    const double change = std::max(neutral_fraction_change, temperature_change);
+    _converged = change < _tolerance;
+    if (_converged) {
+      return false;
+    }
+
+    if (_previous_change > 0. && change > _noise_ratio * _previous_change &&
+        _number_of_photons * _photon_growth_factor <=
+            _maximum_number_of_photons &&
+        _photon_growth_factor > 1) {
+      _number_of_photons *= _photon_growth_factor;
+      // the next change is still partly due to the old number of photons
+      _previous_change = -1.;
+      return true;
+    }
+
+    _previous_change = change;
+    return false;
+  }
+
+  /**
+   * @brief Process the changes during the last iteration, and log the result.
+   *
+   * @param changes Changes of all cells.
+   * @param allows_convergence Can the state after this iteration be considered
+   * to be converged? If not, the changes are only recorded.
+   * @param log Log to write logging info to.
+   * @return True if the number of photon packets was increased.
+   */
+  inline bool update(const Changes &changes, const bool allows_convergence,
+                     Log *log = nullptr) {
+
+    const bool more_photons =
+        update(changes.get_neutral_fraction_change(),
+               changes.get_temperature_change(), allows_convergence);
+    if (log) {
+      log->write_status("Mean neutral fraction change: ",
+                        _neutral_fraction_change,
+                        ", mean relative temperature change: ",
+                        _temperature_change, ".");
+      if (more_photons) {
+        log->write_status("Changes are dominated by Monte Carlo noise, "
+                          "increasing the number of photons to ",
+                          _number_of_photons, ".");
+      }
+    }
+    return more_photons;
+  }
+
+  /**
+   * @brief Did the run converge?
+   *
+   * @return True if the changes during the last iteration were below the
+   * tolerance.
+   */
+  inline bool has_converged() const { return _converged; }
+
+  /**
+   * @brief Get the factor by which the number of photon packets is increased.
+   *
+   * @return Photon number growth factor.
+   */
+  inline uint_fast32_t get_photon_growth_factor() const {
+    return _photon_growth_factor;
+  }
+
+  /**
+   * @brief Get the mean absolute change in the hydrogen neutral fraction during
+   * the last iteration.
+   *
+   * @return Mean absolute neutral fraction change.
+   */
+  inline double get_neutral_fraction_change() const {
+    return _neutral_fraction_change;
+  }
+
+  /**
+   * @brief Get the mean relative change in the temperature during the last
+   * iteration.
+   *
+   * @return Mean relative temperature change.
+   */
+  inline double get_temperature_change() const { return _temperature_change; }
+
+  /**
+   * @brief Add the achieved convergence metrics to the given ParameterFile, so
+   * that they are written to snapshots.
+   *
+   * @param params ParameterFile to add to.
+   */
+  inline void add_metrics(ParameterFile &params) const {
+    std::stringstream neutral_fraction_change, temperature_change,
+        number_of_iterations, number_of_photons;
+    neutral_fraction_change << _neutral_fraction_change;
+    temperature_change << _temperature_change;
+    number_of_iterations << _number_of_iterations;
+    number_of_photons << _number_of_photons;
+    params.add_value("ConvergenceController:achieved neutral fraction change",
+                     neutral_fraction_change.str());
+    params.add_value("ConvergenceController:achieved temperature change",
+                     temperature_change.str());
+    params.add_value("ConvergenceController:number of iterations done",
+                     number_of_iterations.str());
+    params.add_value("ConvergenceController:final number of photons",
+                     number_of_photons.str());
+  }
+};
+
+#endif // CONVERGENCECONTROLLER_HPP
@@ -48,6 +48,37 @@ public:
    */
   virtual double get_cross_section(const int_fast32_t ion,
                                    const double energy) const = 0;
+
+  /**
+   * @brief Get the photoionization cross sections for all ions at the given
+   * photon energy.
+   *
+   * The default implementation calls get_cross_section() for every ion.
+   * Implementations that can compute all cross sections at once more
+   * efficiently should override this function.
+   *
+   * @param energy Photon frequency (in Hz).
+   * @param cross_sections Output array for the photoionization cross sections
+   * of all ions (in m^2, should have size NUMBER_OF_IONNAMES).
+   */
+  virtual void get_cross_sections(const double energy,
+                                  double *cross_sections) const {
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      cross_sections[ion] = get_cross_section(ion, energy);
+    }
+  }
+
+  /**
+   * @brief Notify the cross sections that many photons will have the given
+   * frequency, e.g. because it is the frequency of a monochromatic spectrum.
+   *
+   * Implementations that approximate the cross sections can use this to
+   * return exact values for this frequency. The default implementation does
+   * nothing.
+   *
+   * @param frequency Frequency (in Hz).
+   */
+  virtual void add_discrete_frequency(const double frequency) {}
 };
 
 #endif // CROSSSECTIONS_HPP
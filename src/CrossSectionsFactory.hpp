@@ -28,16 +28,51 @@
 #include "Error.hpp"
 #include "Log.hpp"
 #include "ParameterFile.hpp"
+#include "PhotonSourceSpectrum.hpp"
+
+#include <vector>
 
 // implementations
 #include "BimodalCrossSections.hpp"
 #include "FixedValueCrossSections.hpp"
+#include "TabulatedCrossSections.hpp"
 #include "VernerCrossSections.hpp"
 
 /**
  * @brief Factory for CrossSections instances.
  */
 class CrossSectionsFactory {
+private:
+  /**
+   * @brief Generate an untabulated CrossSections instance based on the type
+   * chosen in the parameter file.
+   *
+   * @param params ParameterFile to read from.
+   * @param log Log to write logging info to.
+   * @return Pointer to a newly created CrossSections implementation.
+   */
+  static CrossSections *generate_implementation(ParameterFile &params,
+                                                Log *log) {
+
+    std::string type =
+        params.get_value< std::string >("CrossSections:type", "Verner");
+
+    if (log) {
+      log->write_info("Requested CrossSections type: ", type);
+    }
+
+    if (type == "Bimodal") {
+      return new BiModalCrossSections(params);
+    } else if (type == "FixedValue") {
+      return new FixedValueCrossSections(params);
+    } else if (type == "Verner") {
+      return new VernerCrossSections();
+    } else {
+      cmac_error("Unknown CrossSections type: \"%s\"!", type.c_str());
+      return nullptr;
+    }
+  }
+
 public:
   /**
    * @brief Generate a CrossSections instance based on the type chosen in the
@@ -52,6 +87,10 @@ public:
    *  - Verner: Implementation that uses the Verner & Yakovlev (1995) and Verner
    *    et al. (1996) cross sections.
    *
+   * The Verner cross sections are expensive to evaluate. If "CrossSections:
+   * tabulate" is set to true (default: false), the cross sections are
+   * tabulated (see generate_tabulated()).
+   *
    * @param params ParameterFile to read from.
    * @param log Log to write logging info to.
    * @return Pointer to a newly created CrossSections implementation. Memory
@@ -59,22 +98,67 @@ public:
    */
   static CrossSections *generate(ParameterFile &params, Log *log = nullptr) {
 
-    std::string type =
-        params.get_value< std::string >("CrossSections:type", "Verner");
+    if (params.get_value< bool >("CrossSections:tabulate", false)) {
+      return generate_tabulated(params, log);
+    }
+    return generate_implementation(params, log);
+  }
+
+  /**
+   * @brief Generate a TabulatedCrossSections instance that tabulates the
+   * CrossSections type chosen in the parameter file.
+   *
+   * The cross sections are tabulated at startup on a regular frequency grid
+   * with "CrossSections:tabulation bins" bins (default: 4096) and are
+   * interpolated from the table afterwards, except in the bins that contain
+   * an ionization threshold. Compact photon packets always use tabulated cross
+   * sections.
+   *
+   * @param params ParameterFile to read from.
+   * @param log Log to write logging info to.
+   * @return Pointer to a newly created TabulatedCrossSections instance. Memory
+   * management for the pointer needs to be done by the calling routine.
+   */
+  static TabulatedCrossSections *generate_tabulated(ParameterFile &params,
+                                                    Log *log = nullptr) {
 
+    const uint_fast32_t number_of_bins = params.get_value< uint_fast32_t >(
+        "CrossSections:tabulation bins", TABULATEDCROSSSECTIONS_DEFAULT_SIZE);
+    TabulatedCrossSections *cross_sections = new TabulatedCrossSections(
+        generate_implementation(params, log), number_of_bins);
     if (log) {
-      log->write_info("Requested CrossSections type: ", type);
+      log->write_info("Tabulated cross sections using ", number_of_bins,
+                      " bins, ", cross_sections->get_number_of_exact_bins(),
+                      " bins contain an ionization threshold and are "
+                      "evaluated exactly.");
     }
+    return cross_sections;
+  }
 
-    if (type == "Bimodal") {
-      return new BiModalCrossSections(params);
-    } else if (type == "FixedValue") {
-      return new FixedValueCrossSections(params);
-    } else if (type == "Verner") {
-      return new VernerCrossSections();
-    } else {
-      cmac_error("Unknown CrossSections type: \"%s\"!", type.c_str());
-      return nullptr;
+  /**
+   * @brief Tell the given CrossSections about the discrete frequencies of the
+   * given spectra, so that exact cross sections can be precomputed for them.
+   *
+   * @param cross_sections CrossSections to update.
+   * @param spectrum Spectrum of the discrete photon sources (can be a null
+   * pointer).
+   * @param continuous_spectrum Spectrum of the continuous photon sources (can
+   * be a null pointer).
+   */
+  static void
+  add_discrete_frequencies(CrossSections &cross_sections,
+                           const PhotonSourceSpectrum *spectrum,
+                           const PhotonSourceSpectrum *continuous_spectrum) {
+
+    std::vector< double > discrete_frequencies;
+    if (spectrum != nullptr) {
+      spectrum->get_discrete_frequencies(discrete_frequencies);
+    }
+    if (continuous_spectrum != nullptr) {
+      continuous_spectrum->get_discrete_frequencies(discrete_frequencies);
+    }
+    for (size_t i = 0; i < discrete_frequencies.size(); ++i) {
+      cross_sections.add_discrete_frequency(discrete_frequencies[i]);
     }
   }
 };
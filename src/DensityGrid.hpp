@@ -493,6 +493,13 @@ public:
       return _grid->get_faces(_index);
     }
 
+    /**
+     * @brief Get the index of the cell within the grid.
+     *
+     * @return Index of the cell.
+     */
+    virtual size_t get_cell_index() const { return _index; }
+
     /**
      * @brief Reset the mean intensity counters for the cell the iterator is
      * currently pointing to.
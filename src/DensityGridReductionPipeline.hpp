@@ -0,0 +1,310 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file DensityGridReductionPipeline.hpp
+ *
+ * @brief Fused MPI communication of the DensityGrid variables that change
+ * during a single iteration of the photoionization algorithm.
+ *
+ * All per cell quantities that are accumulated during the photon propagation
+ * (mean intensity integrals and heating terms) are reduced in chunks of cells,
+ * using a small ring of chunk buffers, so that the memory used for the
+ * reduction does not depend on the size of the grid. The temperature and
+ * ionization state of the local cells in a chunk are computed as soon as that
+ * chunk has been reduced, while the next chunks are still being communicated.
+ * Afterwards, the resulting temperatures and ionic fractions are gathered in
+ * chunks of the same size.
+ *
+ * The time spent updating cells and the time spent in the communication
+ * (including packing and unpacking of the buffers) are recorded separately.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef DENSITYGRIDREDUCTIONPIPELINE_HPP
+#define DENSITYGRIDREDUCTIONPIPELINE_HPP
+
+#include "DensityGrid.hpp"
+#include "MPICommunicator.hpp"
+#include "TemperatureCalculator.hpp"
+#include "Timer.hpp"
+
+#include <algorithm>
+
+/*! @brief Number of cells that are reduced or gathered in a single MPI
+ *  communication. */
+#define DENSITYGRIDREDUCTIONPIPELINE_CHUNK_SIZE 32768
+
+/*! @brief Number of chunk buffers used for the reduction. */
+#define DENSITYGRIDREDUCTIONPIPELINE_NUMBER_OF_BUFFERS 4
+
+/*! @brief Number of cells that are updated in between two checks for progress
+ *  of the outstanding reductions. */
+#define DENSITYGRIDREDUCTIONPIPELINE_PROGRESS_SIZE 1024
+
+/**
+ * @brief Fused MPI communication of the DensityGrid variables that change
+ * during a single iteration of the photoionization algorithm.
+ */
+class DensityGridReductionPipeline {
+private:
+  /*! @brief Number of reduced values per cell. */
+  static const size_t REDUCTION_SIZE =
+      NUMBER_OF_IONNAMES + NUMBER_OF_HEATINGTERMS;
+
+  /*! @brief Number of gathered values per cell. */
+  static const size_t GATHER_SIZE = NUMBER_OF_IONNAMES + 1;
+
+  /*! @brief DensityGrid to operate on. */
+  DensityGrid &_grid;
+
+  /*! @brief TemperatureCalculator used to update the reduced cells. */
+  const TemperatureCalculator &_temperature_calculator;
+
+  /*! @brief Current iteration number of the photoionization algorithm. */
+  const uint_fast32_t _loop;
+
+  /*! @brief Total weight of all photons that were used. */
+  const double _totweight;
+
+  /*! @brief Block of cells that is updated by the local MPI process. */
+  const std::pair< cellsize_t, cellsize_t > _block;
+
+  /*! @brief WorkDistributor used to update the temperature of the cells. */
+  const TemperatureCalculator::TemperatureCalculatorWorkDistributor
+      _temperature_workers;
+
+  /*! @brief WorkDistributor used to update the ionization state of the cells.
+   */
+  const IonizationStateCalculator::IonizationStateCalculatorWorkDistributor
+      _ionization_workers;
+
+  /*! @brief Timer for the time spent updating cells. */
+  Timer &_update_timer;
+
+  /*! @brief Timer for the time spent in communication. */
+  Timer &_communication_timer;
+
+  /**
+   * @brief Functor used to pack and unpack the temperatures and ionic
+   * fractions of the cells for the gather.
+   */
+  class GatherFunction {
+  private:
+    /*! @brief DensityGrid to operate on. */
+    DensityGrid &_grid;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param grid DensityGrid to operate on.
+     */
+    inline GatherFunction(DensityGrid &grid) : _grid(grid) {}
+
+    /**
+     * @brief Pack the temperatures and ionic fractions of the cells in the
+     * given chunk into the given buffer.
+     *
+     * @param chunk_begin Index of the first cell in the chunk.
+     * @param chunk_end Index of the first cell not in the chunk.
+     * @param buffer Chunk buffer to fill.
+     */
+    inline void pack(const size_t chunk_begin, const size_t chunk_end,
+                     double *buffer) {
+
+      size_t index = 0;
+      std::pair< DensityGrid::iterator, DensityGrid::iterator > chunk =
+          _grid.get_chunk(chunk_begin, chunk_end);
+      for (auto it = chunk.first; it != chunk.second; ++it) {
+        const IonizationVariables &ionization_variables =
+            it.get_ionization_variables();
+        buffer[index] = ionization_variables.get_temperature();
+        ++index;
+        for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+          buffer[index] = ionization_variables.get_ionic_fraction(ion);
+          ++index;
+        }
+      }
+    }
+
+    /**
+     * @brief Store the temperatures and ionic fractions in the given buffer in
+     * the cells of the given chunk.
+     *
+     * @param chunk_begin Index of the first cell in the chunk.
+     * @param chunk_end Index of the first cell not in the chunk.
+     * @param buffer Gathered chunk buffer.
+     */
+    inline void unpack(const size_t chunk_begin, const size_t chunk_end,
+                       const double *buffer) {
+
+      size_t index = 0;
+      std::pair< DensityGrid::iterator, DensityGrid::iterator > chunk =
+          _grid.get_chunk(chunk_begin, chunk_end);
+      for (auto it = chunk.first; it != chunk.second; ++it) {
+        IonizationVariables &ionization_variables =
+            it.get_ionization_variables();
+        ionization_variables.set_temperature(buffer[index]);
+        ++index;
+        for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+          ionization_variables.set_ionic_fraction(ion, buffer[index]);
+          ++index;
+        }
+      }
+    }
+  };
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param grid DensityGrid to operate on.
+   * @param temperature_calculator TemperatureCalculator used to update the
+   * reduced cells.
+   * @param loop Current iteration number of the photoionization algorithm.
+   * @param totweight Total weight of all photons that were used.
+   * @param block Block of cells that is updated by the local MPI process.
+   * @param update_timer Timer for the time spent updating cells.
+   * @param communication_timer Timer for the time spent in communication.
+   */
+  inline DensityGridReductionPipeline(
+      DensityGrid &grid, const TemperatureCalculator &temperature_calculator,
+      const uint_fast32_t loop, const double totweight,
+      const std::pair< cellsize_t, cellsize_t > &block, Timer &update_timer,
+      Timer &communication_timer)
+      : _grid(grid), _temperature_calculator(temperature_calculator),
+        _loop(loop), _totweight(totweight), _block(block),
+        _update_timer(update_timer),
+        _communication_timer(communication_timer) {}
+
+  /**
+   * @brief Reduce the accumulated cell variables across all processes and
+   * update the temperature and ionization state of the local cells.
+   *
+   * @param mpi_communicator MPICommunicator to use.
+   */
+  inline void reduce_and_update(const MPICommunicator &mpi_communicator) {
+
+    _communication_timer.start();
+    mpi_communicator.reduce_pipelined< MPI_SUM_OF_ALL_PROCESSES, double >(
+        _grid.get_number_of_cells() * REDUCTION_SIZE,
+        DENSITYGRIDREDUCTIONPIPELINE_CHUNK_SIZE * REDUCTION_SIZE,
+        DENSITYGRIDREDUCTIONPIPELINE_NUMBER_OF_BUFFERS, *this);
+    _communication_timer.stop();
+  }
+
+  /**
+   * @brief Pack the accumulated variables of the cells in the given chunk into
+   * the given buffer.
+   *
+   * @param chunk_begin Index of the first value in the chunk.
+   * @param chunk_end Index of the first value not in the chunk.
+   * @param buffer Chunk buffer to fill.
+   */
+  inline void pack(const size_t chunk_begin, const size_t chunk_end,
+                   double *buffer) {
+
+    size_t index = 0;
+    std::pair< DensityGrid::iterator, DensityGrid::iterator > chunk =
+        _grid.get_chunk(chunk_begin / REDUCTION_SIZE,
+                        chunk_end / REDUCTION_SIZE);
+    for (auto it = chunk.first; it != chunk.second; ++it) {
+      const IonizationVariables &ionization_variables =
+          it.get_ionization_variables();
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        buffer[index] = ionization_variables.get_mean_intensity(ion);
+        ++index;
+      }
+      for (int_fast32_t term = 0; term < NUMBER_OF_HEATINGTERMS; ++term) {
+        buffer[index] = ionization_variables.get_heating(term);
+        ++index;
+      }
+    }
+  }
+
+  /**
+   * @brief Unpack the given reduced chunk and update the local cells in it.
+   *
+   * The local cells are updated in small blocks, and the outstanding
+   * reductions are progressed in between blocks.
+   *
+   * @param chunk_begin Index of the first value in the chunk.
+   * @param chunk_end Index of the first value not in the chunk.
+   * @param buffer Reduced chunk buffer.
+   * @param progress Functor that progresses the outstanding reductions.
+   */
+  inline void update(const size_t chunk_begin, const size_t chunk_end,
+                     const double *buffer,
+                     const MPICommunicator::PipelineProgress &progress) {
+
+    const cellsize_t cell_begin = chunk_begin / REDUCTION_SIZE;
+    const cellsize_t cell_end = chunk_end / REDUCTION_SIZE;
+    size_t index = 0;
+    std::pair< DensityGrid::iterator, DensityGrid::iterator > chunk =
+        _grid.get_chunk(cell_begin, cell_end);
+    for (auto it = chunk.first; it != chunk.second; ++it) {
+      IonizationVariables &ionization_variables = it.get_ionization_variables();
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        ionization_variables.set_mean_intensity(ion, buffer[index]);
+        ++index;
+      }
+      for (int_fast32_t term = 0; term < NUMBER_OF_HEATINGTERMS; ++term) {
+        ionization_variables.set_heating(term, buffer[index]);
+        ++index;
+      }
+    }
+    progress();
+
+    const cellsize_t local_end = std::min(cell_end, _block.second);
+    for (cellsize_t local_begin = std::max(cell_begin, _block.first);
+         local_begin < local_end;
+         local_begin += DENSITYGRIDREDUCTIONPIPELINE_PROGRESS_SIZE) {
+      std::pair< cellsize_t, cellsize_t > local_block = std::make_pair(
+          local_begin,
+          std::min(local_begin + DENSITYGRIDREDUCTIONPIPELINE_PROGRESS_SIZE,
+                   local_end));
+      _communication_timer.stop();
+      _update_timer.start();
+      _temperature_calculator.calculate_temperature(
+          _loop, _totweight, _grid, local_block, _temperature_workers,
+          _ionization_workers);
+      _update_timer.stop();
+      _communication_timer.start();
+      progress();
+    }
+  }
+
+  /**
+   * @brief Gather the temperatures and ionic fractions of all cells across all
+   * processes.
+   *
+   * @param mpi_communicator MPICommunicator to use.
+   */
+  inline void gather(const MPICommunicator &mpi_communicator) {
+
+    _communication_timer.start();
+    GatherFunction function(_grid);
+    mpi_communicator.gather_chunked< double >(
+        _grid.get_number_of_cells(), GATHER_SIZE,
+        DENSITYGRIDREDUCTIONPIPELINE_CHUNK_SIZE, function);
+    _communication_timer.stop();
+  }
+};
+
+#endif // DENSITYGRIDREDUCTIONPIPELINE_HPP
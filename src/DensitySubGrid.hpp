@@ -123,8 +123,56 @@ class DensityValues;
  *  time. */
 #define DENSITYSUBGRID_FIXED_SIZE sizeof(DensitySubGrid)
 
+/*! @brief Enable this to store the cell variables used during photon
+ *  traversal in separate contiguous arrays (structure-of-arrays layout). */
+#if defined(HAVE_SUBGRID_SOA) && !defined(SUBGRID_SOA)
+#define SUBGRID_SOA
+#endif
+
+/*! @brief Number of photon packets that are traversed in lock step by
+ *  DensitySubGrid::interact_batch(): the number of double precision values
+ *  that fit in a vector register of the target architecture. */
+#ifndef DENSITYSUBGRID_BATCH_WIDTH
+#if defined(__AVX512F__)
+#define DENSITYSUBGRID_BATCH_WIDTH 8
+#elif defined(__AVX__)
+#define DENSITYSUBGRID_BATCH_WIDTH 4
+#else
+#define DENSITYSUBGRID_BATCH_WIDTH 1
+#endif
+#endif
+
+/*! @brief Number of accumulated traversal counters per cell: one mean
+ *  intensity integral per ion and one value per heating term. */
+#define DENSITYSUBGRID_COUNTER_SIZE                                            \
+  (NUMBER_OF_IONNAMES + NUMBER_OF_HEATINGTERMS)
+
+#ifdef SUBGRID_SOA
+#ifdef HAS_HELIUM
+#ifdef VARIABLE_ABUNDANCES
+/*! @brief Number of traversal input variables per cell: number density,
+ *  hydrogen and helium neutral fraction, and helium abundance. */
+#define DENSITYSUBGRID_TRAVERSAL_SIZE 4
+#else
+/*! @brief Number of traversal input variables per cell: number density and
+ *  hydrogen and helium neutral fraction. */
+#define DENSITYSUBGRID_TRAVERSAL_SIZE 3
+#endif
+#else
+/*! @brief Number of traversal input variables per cell: number density and
+ *  hydrogen neutral fraction. */
+#define DENSITYSUBGRID_TRAVERSAL_SIZE 2
+#endif
+
+/*! @brief Size of a single cell of the subgrid. */
+#define DENSITYSUBGRID_ELEMENT_SIZE                                            \
+  (sizeof(IonizationVariables) +                                               \
+   (DENSITYSUBGRID_TRAVERSAL_SIZE + DENSITYSUBGRID_COUNTER_SIZE) *             \
+       sizeof(double))
+#else
 /*! @brief Size of a single cell of the subgrid. */
 #define DENSITYSUBGRID_ELEMENT_SIZE sizeof(IonizationVariables)
+#endif
 
 /**
  * @brief Small fraction of a density grid that acts as an individual density
@@ -194,6 +242,85 @@ protected:
   /*! @brief Cell locks (if active). */
   subgrid_cell_lock_variables();
 
+  /*! @brief Private intensity counters per thread (if active; stored as
+   *  _private_counters[(thread * ncell + index) * DENSITYSUBGRID_COUNTER_SIZE
+   *  + counter]). */
+  double *_private_counters;
+
+  /*! @brief Number of threads that have a private block of intensity
+   *  counters (0 if private counters are not active). */
+  int_fast32_t _number_of_private_counters;
+
+#ifdef SUBGRID_SOA
+  /// TRAVERSAL VARIABLES (STRUCTURE-OF-ARRAYS LAYOUT)
+
+  /*! @brief Number density used during photon traversal (in m^-3). */
+  double *_traversal_number_density;
+
+  /*! @brief Hydrogen neutral fraction used during photon traversal. */
+  double *_traversal_neutral_fraction_H;
+
+#ifdef HAS_HELIUM
+  /*! @brief Helium neutral fraction used during photon traversal. */
+  double *_traversal_neutral_fraction_He;
+
+#ifdef VARIABLE_ABUNDANCES
+  /*! @brief Helium abundance used during photon traversal. */
+  double *_traversal_abundance_He;
+#endif
+#endif
+
+  /**
+   * @brief Mean intensity and heating counters accumulated during photon
+   * traversal.
+   *
+   * The counters for a single cell are stored contiguously, so that a photon
+   * crossing that cell only touches a single block of memory:
+   * ```
+   *  _traversal_counters[index * DENSITYSUBGRID_COUNTER_SIZE + ion]
+   * ```
+   * contains the mean intensity integral for the given ion, while the heating
+   * terms are stored at offset `NUMBER_OF_IONNAMES + name`.
+   */
+  double *_traversal_counters;
+
+  /*! @brief Does any of the cells in this subgrid have a tracker? */
+  bool _traversal_has_trackers;
+
+  /**
+   * @brief Allocate the traversal arrays for the given number of cells.
+   *
+   * @param ncell Number of cells.
+   */
+  inline void allocate_traversal_variables(const int_fast32_t ncell) {
+    _traversal_number_density = new double[ncell];
+    _traversal_neutral_fraction_H = new double[ncell];
+#ifdef HAS_HELIUM
+    _traversal_neutral_fraction_He = new double[ncell];
+#ifdef VARIABLE_ABUNDANCES
+    _traversal_abundance_He = new double[ncell];
+#endif
+#endif
+    _traversal_counters = new double[ncell * DENSITYSUBGRID_COUNTER_SIZE];
+    _traversal_has_trackers = false;
+  }
+
+  /**
+   * @brief Free the memory used by the traversal arrays.
+   */
+  inline void free_traversal_variables() {
+    delete[] _traversal_number_density;
+    delete[] _traversal_neutral_fraction_H;
+#ifdef HAS_HELIUM
+    delete[] _traversal_neutral_fraction_He;
+#ifdef VARIABLE_ABUNDANCES
+    delete[] _traversal_abundance_He;
+#endif
+#endif
+    delete[] _traversal_counters;
+  }
+#endif
+
   /**
    * @brief Convert the given 3 indices to a single index.
    *
@@ -557,6 +684,28 @@ protected:
   inline double get_optical_depth(const int_fast32_t active_cell,
                                   const double distance,
                                   const PhotonPacket &photon) const {
+#ifdef SUBGRID_SOA
+#ifdef HAS_HELIUM
+#ifdef VARIABLE_ABUNDANCES
+    return distance * _traversal_number_density[active_cell] *
+           (photon.get_photoionization_cross_section(ION_H_n) *
+                _traversal_neutral_fraction_H[active_cell] +
+            _traversal_abundance_He[active_cell] *
+                photon.get_photoionization_cross_section(ION_He_n) *
+                _traversal_neutral_fraction_He[active_cell]);
+#else
+    return distance * _traversal_number_density[active_cell] *
+           (photon.get_photoionization_cross_section(ION_H_n) *
+                _traversal_neutral_fraction_H[active_cell] +
+            photon.get_photoionization_cross_section(ION_He_n) *
+                _traversal_neutral_fraction_He[active_cell]);
+#endif
+#else
+    return distance * _traversal_number_density[active_cell] *
+           photon.get_photoionization_cross_section(ION_H_n) *
+           _traversal_neutral_fraction_H[active_cell];
+#endif
+#else
 #ifdef HAS_HELIUM
 #ifdef VARIABLE_ABUNDANCES
     return distance * _ionization_variables[active_cell].get_number_density() *
@@ -579,6 +728,35 @@ protected:
     return distance * _ionization_variables[active_cell].get_number_density() *
            photon.get_photoionization_cross_section(ION_H_n) *
            _ionization_variables[active_cell].get_ionic_fraction(ION_H_n);
+#endif
+#endif
+  }
+
+  /**
+   * @brief Add the contribution of the given photon packet travelling the
+   * given distance to the given packed block of cell counters.
+   *
+   * @param counters Counters for a single cell (DENSITYSUBGRID_COUNTER_SIZE
+   * elements: mean intensity integrals followed by heating terms).
+   * @param distance Distance travelled through the cell (in m).
+   * @param photon Photon packet that travels through the cell.
+   * @param dmean_intensity Mean intensity contributions (output array, needed
+   * by trackers).
+   */
+  inline static void add_to_counters(double *counters, const double distance,
+                                     const PhotonPacket &photon,
+                                     double *dmean_intensity) {
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      dmean_intensity[ion] = distance *
+                             photon.get_photoionization_cross_section(ion) *
+                             photon.get_weight();
+      counters[ion] += dmean_intensity[ion];
+    }
+    counters[NUMBER_OF_IONNAMES + HEATINGTERM_H] +=
+        dmean_intensity[ION_H_n] * (photon.get_energy() - 3.288e15);
+#ifdef HAS_HELIUM
+    counters[NUMBER_OF_IONNAMES + HEATINGTERM_He] +=
+        dmean_intensity[ION_He_n] * (photon.get_energy() - 5.948e15);
 #endif
   }
 
@@ -589,12 +767,42 @@ protected:
    * @param active_cell Index of the cell.
    * @param distance Distance travelled through the cell (in m).
    * @param photon Photon packet that travels through the cell.
+   * @param thread_id ID of the thread that traverses the photon packet (only
+   * used if private counters are active).
    */
   inline void update_intensity_counters(const int_fast32_t active_cell,
                                         const double distance,
-                                        const PhotonPacket &photon) {
-    subgrid_cell_lock_lock(active_cell);
+                                        const PhotonPacket &photon,
+                                        const int_fast32_t thread_id) {
+
     double dmean_intensity[NUMBER_OF_IONNAMES];
+    if (_private_counters != nullptr) {
+      // every thread has its own counters: no locking required
+      cmac_assert_message(thread_id < _number_of_private_counters,
+                          "thread_id: %" PRIiFAST32, thread_id);
+      const size_t offset =
+          (static_cast< size_t >(thread_id) * _number_of_cells[0] *
+               _number_of_cells[3] +
+           active_cell) *
+          DENSITYSUBGRID_COUNTER_SIZE;
+      add_to_counters(_private_counters + offset, distance, photon,
+                      dmean_intensity);
+      return;
+    }
+
+    subgrid_cell_lock_lock(active_cell);
+#ifdef SUBGRID_SOA
+    add_to_counters(_traversal_counters +
+                        active_cell * DENSITYSUBGRID_COUNTER_SIZE,
+                    distance, photon, dmean_intensity);
+
+    if (_traversal_has_trackers) {
+      Tracker *tracker = _ionization_variables[active_cell].get_tracker();
+      if (tracker != nullptr) {
+        tracker->count_photon(photon, dmean_intensity);
+      }
+    }
+#else
     for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
       dmean_intensity[ion] = distance *
                              photon.get_photoionization_cross_section(ion) *
@@ -615,10 +823,51 @@ protected:
     if (tracker != nullptr) {
       tracker->count_photon(photon, dmean_intensity);
     }
+#endif
 
     subgrid_cell_lock_unlock(active_cell);
   }
 
+  /**
+   * @brief Copy the final state of the photon in the given lane of a batched
+   * traversal back into the photon.
+   *
+   * @param photon Photon that was traversed in the lane.
+   * @param position Lane positions (relative w.r.t. _anchor, in m).
+   * @param three_index Lane 3 indices.
+   * @param tau_done Lane optical depths that were traversed.
+   * @param tau_target Lane target optical depths.
+   * @param lane Lane index.
+   * @param output_direction TravelDirection of the photon after it has
+   * traversed this grid (output variable).
+   */
+  template < uint_fast32_t LANE_WIDTH >
+  inline void
+  finish_batch_lane(PhotonPacket &photon,
+                    const double (&position)[3][LANE_WIDTH],
+                    const int_fast32_t (&three_index)[3][LANE_WIDTH],
+                    const double (&tau_done)[LANE_WIDTH],
+                    const double (&tau_target)[LANE_WIDTH],
+                    const uint_fast32_t lane,
+                    int_fast32_t &output_direction) const {
+
+    photon.set_target_optical_depth(tau_target[lane] - tau_done[lane]);
+    photon.set_position(CoordinateVector<>(position[0][lane],
+                                           position[1][lane],
+                                           position[2][lane]) +
+                        _anchor);
+    if (tau_done[lane] >= tau_target[lane]) {
+      output_direction = TRAVELDIRECTION_INSIDE;
+    } else {
+      output_direction = get_output_direction(CoordinateVector< int_fast32_t >(
+          three_index[0][lane], three_index[1][lane], three_index[2][lane]));
+    }
+
+    cmac_assert_message(TravelDirections::is_compatible_output_direction(
+                            photon.get_direction(), output_direction),
+                        "wrong output direction!");
+  }
+
 public:
   /**
    * @brief Get the index (and 3 index) of the cell containing the given
@@ -741,7 +990,8 @@ public:
         _inv_cell_size{ncell[0] / box[3], ncell[1] / box[4], ncell[2] / box[5]},
         _number_of_cells{ncell[0], ncell[1], ncell[2], ncell[1] * ncell[2]},
         _owning_thread(0), _largest_buffer_index(TRAVELDIRECTION_NUMBER),
-        _largest_buffer_size(0) {
+        _largest_buffer_size(0), _private_counters(nullptr),
+        _number_of_private_counters(0) {
 
 #ifdef DENSITYGRID_EDGECOST
     // initialize edge communication costs
@@ -754,6 +1004,10 @@ public:
     const int_fast32_t tot_ncell = _number_of_cells[3] * ncell[0];
     _ionization_variables = new IonizationVariables[tot_ncell];
     subgrid_cell_lock_init(tot_ncell);
+#ifdef SUBGRID_SOA
+    allocate_traversal_variables(tot_ncell);
+    update_traversal_variables();
+#endif
   }
 
   /**
@@ -769,7 +1023,8 @@ public:
             original._number_of_cells[0], original._number_of_cells[1],
             original._number_of_cells[2], original._number_of_cells[3]},
         _owning_thread(original._owning_thread),
-        _largest_buffer_index(TRAVELDIRECTION_NUMBER), _largest_buffer_size(0) {
+        _largest_buffer_index(TRAVELDIRECTION_NUMBER), _largest_buffer_size(0),
+        _private_counters(nullptr), _number_of_private_counters(0) {
 
 #ifdef DENSITYGRID_EDGECOST
     // initialize edge communication costs
@@ -786,6 +1041,10 @@ public:
     for (int_fast32_t i = 0; i < tot_ncell; ++i) {
       _ionization_variables[i].copy_all(original._ionization_variables[i]);
     }
+#ifdef SUBGRID_SOA
+    allocate_traversal_variables(tot_ncell);
+    update_traversal_variables();
+#endif
   }
 
   /**
@@ -795,6 +1054,12 @@ public:
     // deallocate data arrays
     delete[] _ionization_variables;
     subgrid_cell_lock_destroy();
+    if (_private_counters != nullptr) {
+      delete[] _private_counters;
+    }
+#ifdef SUBGRID_SOA
+    free_traversal_variables();
+#endif
   }
 
   /**
@@ -950,9 +1215,11 @@ public:
    * @return Size of a DensitySubGrid that is stored in memory (in bytes).
    */
   inline size_t get_memory_size() const {
-    return DENSITYSUBGRID_FIXED_SIZE + DENSITYSUBGRID_ELEMENT_SIZE *
-                                           _number_of_cells[0] *
-                                           _number_of_cells[3];
+    return DENSITYSUBGRID_FIXED_SIZE +
+           (DENSITYSUBGRID_ELEMENT_SIZE + _number_of_private_counters *
+                                              DENSITYSUBGRID_COUNTER_SIZE *
+                                              sizeof(double)) *
+               _number_of_cells[0] * _number_of_cells[3];
   }
 
 #ifdef HAVE_MPI
@@ -1039,6 +1306,10 @@ public:
       _number_of_cells[3] = new_number_of_cells[3];
       delete[] _ionization_variables;
       _ionization_variables = new IonizationVariables[tot_num_cells];
+#ifdef SUBGRID_SOA
+      free_traversal_variables();
+      allocate_traversal_variables(tot_num_cells);
+#endif
     }
     for (int_fast32_t i = 0; i < tot_num_cells; ++i) {
       double vals[3];
@@ -1048,6 +1319,9 @@ public:
       _ionization_variables[i].set_ionic_fraction(ION_H_n, vals[1]);
       _ionization_variables[i].set_mean_intensity(ION_H_n, vals[2]);
     }
+#ifdef SUBGRID_SOA
+    update_traversal_variables();
+#endif
   }
 #endif
 
@@ -1065,6 +1339,7 @@ public:
           original._ionization_variables[i].get_number_density());
       _ionization_variables[i].reset_mean_intensities();
     }
+    update_traversal_variables();
   }
 
   /**
@@ -1089,12 +1364,143 @@ public:
 
   /**
    * @brief Reset the intensity counters for all cells in the subgrid.
+   *
+   * This also refreshes the traversal variables (if the structure-of-arrays
+   * layout is active), so this should be called after the density or ionic
+   * fractions were changed and before photons are traversed.
    */
   inline void reset_intensities() {
     const int_fast32_t tot_ncell = _number_of_cells[3] * _number_of_cells[0];
     for (int_fast32_t i = 0; i < tot_ncell; ++i) {
       _ionization_variables[i].reset_mean_intensities();
     }
+    update_traversal_variables();
+    if (_private_counters != nullptr) {
+      const size_t tot_ncounter = static_cast< size_t >(tot_ncell) *
+                                  _number_of_private_counters *
+                                  DENSITYSUBGRID_COUNTER_SIZE;
+      for (size_t i = 0; i < tot_ncounter; ++i) {
+        _private_counters[i] = 0.;
+      }
+    }
+  }
+
+  /**
+   * @brief Give every thread its own private block of intensity counters.
+   *
+   * After this call, multiple threads can traverse photon packets through
+   * this subgrid simultaneously, as long as they all use a different thread
+   * ID. The subgrid dependency then only needs to protect the photon buffer
+   * bookkeeping, and traversal tasks should use get_traversal_dependency()
+   * rather than get_dependency(). The private counters are added to the
+   * intensity integrals by flush_traversal_counters().
+   *
+   * Trackers are not updated for photon packets that are counted in private
+   * counters.
+   *
+   * @param number_of_threads Number of threads that can traverse photon
+   * packets through this subgrid.
+   */
+  inline void activate_private_counters(const int_fast32_t number_of_threads) {
+    if (_private_counters != nullptr) {
+      delete[] _private_counters;
+    }
+    const size_t tot_ncounter =
+        static_cast< size_t >(_number_of_cells[3]) * _number_of_cells[0] *
+        number_of_threads * DENSITYSUBGRID_COUNTER_SIZE;
+    _private_counters = new double[tot_ncounter];
+    for (size_t i = 0; i < tot_ncounter; ++i) {
+      _private_counters[i] = 0.;
+    }
+    _number_of_private_counters = number_of_threads;
+  }
+
+  /**
+   * @brief Check if this subgrid has private intensity counters per thread.
+   *
+   * @return True if activate_private_counters() was called.
+   */
+  inline bool has_private_counters() const {
+    return _private_counters != nullptr;
+  }
+
+  /**
+   * @brief Copy the variables needed during photon traversal from the
+   * ionization variables into the traversal arrays, and reset the traversal
+   * counters.
+   *
+   * Does nothing if the structure-of-arrays layout is not active.
+   */
+  inline void update_traversal_variables() {
+#ifdef SUBGRID_SOA
+    const int_fast32_t tot_ncell = _number_of_cells[3] * _number_of_cells[0];
+    _traversal_has_trackers = false;
+    for (int_fast32_t i = 0; i < tot_ncell; ++i) {
+      IonizationVariables &vars = _ionization_variables[i];
+      _traversal_number_density[i] = vars.get_number_density();
+      _traversal_neutral_fraction_H[i] = vars.get_ionic_fraction(ION_H_n);
+#ifdef HAS_HELIUM
+      _traversal_neutral_fraction_He[i] = vars.get_ionic_fraction(ION_He_n);
+#ifdef VARIABLE_ABUNDANCES
+      _traversal_abundance_He[i] =
+          vars.get_abundances().get_abundance(ELEMENT_He);
+#endif
+#endif
+      _traversal_has_trackers |= (vars.get_tracker() != nullptr);
+    }
+    const int_fast32_t tot_ncounter = tot_ncell * DENSITYSUBGRID_COUNTER_SIZE;
+    for (int_fast32_t i = 0; i < tot_ncounter; ++i) {
+      _traversal_counters[i] = 0.;
+    }
+#endif
+  }
+
+  /**
+   * @brief Add the counters accumulated during photon traversal to the
+   * intensity integrals of the ionization variables, and reset them.
+   *
+   * Needs to be called after all photons have been traversed and before the
+   * intensity integrals are used. This also reduces the private per-thread
+   * counters (if active). Does nothing if the structure-of-arrays layout and
+   * private counters are both not active.
+   */
+  inline void flush_traversal_counters() {
+    if (_private_counters != nullptr) {
+      const int_fast32_t tot_ncell = _number_of_cells[3] * _number_of_cells[0];
+      for (int_fast32_t ithread = 0; ithread < _number_of_private_counters;
+           ++ithread) {
+        double *counters = _private_counters + static_cast< size_t >(ithread) *
+                                                   tot_ncell *
+                                                   DENSITYSUBGRID_COUNTER_SIZE;
+        for (int_fast32_t i = 0; i < tot_ncell; ++i) {
+          IonizationVariables &vars = _ionization_variables[i];
+          for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+            vars.increase_mean_intensity(ion, counters[ion]);
+            counters[ion] = 0.;
+          }
+          for (int_fast32_t j = 0; j < NUMBER_OF_HEATINGTERMS; ++j) {
+            vars.increase_heating(j, counters[NUMBER_OF_IONNAMES + j]);
+            counters[NUMBER_OF_IONNAMES + j] = 0.;
+          }
+          counters += DENSITYSUBGRID_COUNTER_SIZE;
+        }
+      }
+    }
+#ifdef SUBGRID_SOA
+    const int_fast32_t tot_ncell = _number_of_cells[3] * _number_of_cells[0];
+    for (int_fast32_t i = 0; i < tot_ncell; ++i) {
+      IonizationVariables &vars = _ionization_variables[i];
+      double *counters = _traversal_counters + i * DENSITYSUBGRID_COUNTER_SIZE;
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        vars.increase_mean_intensity(ion, counters[ion]);
+        counters[ion] = 0.;
+      }
+      for (int_fast32_t j = 0; j < NUMBER_OF_HEATINGTERMS; ++j) {
+        vars.increase_heating(j, counters[NUMBER_OF_IONNAMES + j]);
+        counters[NUMBER_OF_IONNAMES + j] = 0.;
+      }
+    }
+#endif
   }
 
   /**
@@ -1132,10 +1538,13 @@ public:
    *
    * @param photon Photon.
    * @param input_direction Direction from which the photon enters the grid.
+   * @param thread_id ID of the thread that traverses the photon (only used if
+   * private counters are active).
    * @return TravelDirection of the photon after it has traversed this grid.
    */
   inline int_fast32_t interact(PhotonPacket &photon,
-                               const int_fast32_t input_direction) {
+                               const int_fast32_t input_direction,
+                               const int_fast32_t thread_id = 0) {
 
     cmac_assert_message(input_direction >= 0 &&
                             input_direction < TRAVELDIRECTION_NUMBER,
@@ -1239,7 +1648,7 @@ public:
         }
       }
       // add the pathlength to the intensity counter
-      update_intensity_counters(active_cell, lmin, photon);
+      update_intensity_counters(active_cell, lmin, photon, thread_id);
       // update the photon position
       // we use the complicated syntax below to make sure the positions we
       // know are 100% accurate (only important for our assertions)
@@ -1273,6 +1682,213 @@ public:
     return output_direction;
   }
 
+  /**
+   * @brief Let a batch of photons that all enter the grid from the same
+   * direction travel through the density grid.
+   *
+   * The photons are traversed in LANE_WIDTH lanes that advance one cell
+   * crossing at a time in lock step. The cell distance computation and
+   * position updates for all lanes are written as branch free loops over the
+   * lanes, so that they can be mapped onto vector instructions. Lanes whose
+   * photon reached its target optical depth or left the subgrid are masked
+   * out and refilled with the next photon in the batch.
+   *
+   * Every photon undergoes exactly the same floating point operations as in
+   * interact(), so that the resulting photons are bitwise identical. The
+   * intensity counters are updated in a different order if LANE_WIDTH > 1 and
+   * can therefore differ on the level of round off.
+   *
+   * @param photons Photons.
+   * @param number_of_photons Number of photons in the batch.
+   * @param input_direction Direction from which the photons enter the grid.
+   * @param output_directions TravelDirection of each photon after it has
+   * traversed this grid (output array, should have at least number_of_photons
+   * elements).
+   * @param thread_id ID of the thread that traverses the photons (only used if
+   * private counters are active).
+   */
+  template < uint_fast32_t LANE_WIDTH >
+  inline void interact_batch(PhotonPacket *photons,
+                             const uint_fast32_t number_of_photons,
+                             const int_fast32_t input_direction,
+                             int_fast32_t *output_directions,
+                             const int_fast32_t thread_id = 0) {
+
+    cmac_assert_message(input_direction >= 0 &&
+                            input_direction < TRAVELDIRECTION_NUMBER,
+                        "input_direction: %" PRIiFAST32, input_direction);
+
+    // lane variables (positions are relative w.r.t. _anchor)
+    double position[3][LANE_WIDTH];
+    double direction[3][LANE_WIDTH];
+    double inverse_direction[3][LANE_WIDTH];
+    int_fast32_t three_index[3][LANE_WIDTH];
+    double l[3][LANE_WIDTH];
+    double wall[3][LANE_WIDTH];
+    double lmin[LANE_WIDTH];
+    double tau_done[LANE_WIDTH];
+    double tau_target[LANE_WIDTH];
+    int_fast32_t active_cell[LANE_WIDTH];
+    uint_fast32_t photon_index[LANE_WIDTH];
+    int_fast32_t active[LANE_WIDTH];
+
+    // initialise all lanes with harmless values, so that masked out lanes do
+    // not produce floating point exceptions
+    for (uint_fast32_t lane = 0; lane < LANE_WIDTH; ++lane) {
+      for (uint_fast8_t idim = 0; idim < 3; ++idim) {
+        position[idim][lane] = 0.;
+        direction[idim][lane] = 1.;
+        inverse_direction[idim][lane] = 1.;
+        three_index[idim][lane] = 0;
+      }
+      tau_done[lane] = 0.;
+      tau_target[lane] = 0.;
+      active_cell[lane] = 0;
+      photon_index[lane] = 0;
+      active[lane] = 0;
+    }
+
+    uint_fast32_t next_photon = 0;
+    uint_fast32_t number_active = 0;
+    while (true) {
+
+      // (re)fill empty lanes
+      for (uint_fast32_t lane = 0; lane < LANE_WIDTH; ++lane) {
+        while (!active[lane] && next_photon < number_of_photons) {
+          PhotonPacket &photon = photons[next_photon];
+          photon_index[lane] = next_photon;
+          ++next_photon;
+
+          const CoordinateVector<> photon_direction = photon.get_direction();
+
+          cmac_assert_message(
+              TravelDirections::is_compatible_input_direction(photon_direction,
+                                                              input_direction),
+              "direction: %g %g %g, input_direction: %" PRIiFAST32,
+              photon_direction[0], photon_direction[1], photon_direction[2],
+              input_direction);
+
+          const CoordinateVector<> photon_inverse_direction =
+              1. / photon_direction;
+          CoordinateVector<> photon_position = photon.get_position() - _anchor;
+          update_photon_position(input_direction, photon_position);
+          CoordinateVector< int_fast32_t > photon_three_index;
+          active_cell[lane] = get_start_index(photon_position, input_direction,
+                                              photon_three_index);
+          for (uint_fast8_t idim = 0; idim < 3; ++idim) {
+            position[idim][lane] = photon_position[idim];
+            direction[idim][lane] = photon_direction[idim];
+            inverse_direction[idim][lane] = photon_inverse_direction[idim];
+            three_index[idim][lane] = photon_three_index[idim];
+          }
+          tau_done[lane] = 0.;
+          tau_target[lane] = photon.get_target_optical_depth();
+
+          cmac_assert_message(tau_done[lane] < tau_target[lane],
+                              "tau_done: %g, target: %g", tau_done[lane],
+                              tau_target[lane]);
+
+          if (tau_done[lane] < tau_target[lane]) {
+            active[lane] = 1;
+            ++number_active;
+          } else {
+            finish_batch_lane(photon, position, three_index, tau_done,
+                              tau_target, lane,
+                              output_directions[photon_index[lane]]);
+          }
+        }
+      }
+
+      if (number_active == 0) {
+        break;
+      }
+
+      // compute the cell distances for all lanes
+      for (uint_fast8_t idim = 0; idim < 3; ++idim) {
+        for (uint_fast32_t lane = 0; lane < LANE_WIDTH; ++lane) {
+          const double cell_low = three_index[idim][lane] * _cell_size[idim];
+          const double cell_high =
+              (three_index[idim][lane] + 1.) * _cell_size[idim];
+          wall[idim][lane] =
+              (direction[idim][lane] > 0.) ? cell_high : cell_low;
+          l[idim][lane] = (direction[idim][lane] != 0.)
+                              ? (wall[idim][lane] - position[idim][lane]) *
+                                    inverse_direction[idim][lane]
+                              : DBL_MAX;
+        }
+      }
+      for (uint_fast32_t lane = 0; lane < LANE_WIDTH; ++lane) {
+        lmin[lane] = std::min(l[0][lane], std::min(l[1][lane], l[2][lane]));
+      }
+
+      // compute the optical depths and update the intensity counters for the
+      // active lanes (these require gathers and scatters, so we do them one
+      // lane at a time)
+      for (uint_fast32_t lane = 0; lane < LANE_WIDTH; ++lane) {
+        if (!active[lane]) {
+          continue;
+        }
+
+        cmac_assert_message(lmin[lane] >= 0., "lmin: %g", lmin[lane]);
+
+        const PhotonPacket &photon = photons[photon_index[lane]];
+        const double tau =
+            get_optical_depth(active_cell[lane], lmin[lane], photon);
+        tau_done[lane] += tau;
+        // check if the target optical depth was reached
+        if (tau_done[lane] >= tau_target[lane]) {
+          // if so: subtract the surplus from the path
+          const double correction = (tau_done[lane] - tau_target[lane]) / tau;
+          lmin[lane] *= (1. - correction);
+        }
+        update_intensity_counters(active_cell[lane], lmin[lane], photon,
+                                  thread_id);
+      }
+
+      // update the positions and cell indices of the active lanes
+      for (uint_fast8_t idim = 0; idim < 3; ++idim) {
+        for (uint_fast32_t lane = 0; lane < LANE_WIDTH; ++lane) {
+          const bool on_wall = (l[idim][lane] == lmin[lane]);
+          const double new_position =
+              on_wall ? wall[idim][lane]
+                      : position[idim][lane] +
+                            lmin[lane] * direction[idim][lane];
+          position[idim][lane] =
+              active[lane] ? new_position : position[idim][lane];
+          const bool leaves_cell = active[lane] && on_wall &&
+                                   (tau_done[lane] < tau_target[lane]);
+          three_index[idim][lane] +=
+              leaves_cell ? ((direction[idim][lane] > 0.) ? 1 : -1) : 0;
+        }
+      }
+      for (uint_fast32_t lane = 0; lane < LANE_WIDTH; ++lane) {
+        active_cell[lane] = three_index[0][lane] * _number_of_cells[3] +
+                            three_index[1][lane] * _number_of_cells[2] +
+                            three_index[2][lane];
+      }
+
+      // mask out lanes whose photon is done
+      for (uint_fast32_t lane = 0; lane < LANE_WIDTH; ++lane) {
+        if (!active[lane]) {
+          continue;
+        }
+        const bool inside = three_index[0][lane] < _number_of_cells[0] &&
+                            three_index[0][lane] >= 0 &&
+                            three_index[1][lane] < _number_of_cells[1] &&
+                            three_index[1][lane] >= 0 &&
+                            three_index[2][lane] < _number_of_cells[2] &&
+                            three_index[2][lane] >= 0;
+        if (!(tau_done[lane] < tau_target[lane] && inside)) {
+          finish_batch_lane(photons[photon_index[lane]], position, three_index,
+                            tau_done, tau_target, lane,
+                            output_directions[photon_index[lane]]);
+          active[lane] = 0;
+          --number_active;
+        }
+      }
+    }
+  }
+
   /**
    * @brief Let the given Photon travel through the density grid without
    * interacting with the grid.
@@ -1638,6 +2254,17 @@ public:
    */
   inline ThreadLock *get_dependency() { return &_dependency; }
 
+  /**
+   * @brief Get the dependency for photon traversal tasks on this subgrid.
+   *
+   * @return Pointer to the dependency lock, or nullptr if the subgrid has
+   * private counters per thread and can be traversed by multiple threads
+   * simultaneously.
+   */
+  inline ThreadLock *get_traversal_dependency() {
+    return (_private_counters != nullptr) ? nullptr : &_dependency;
+  }
+
   /**
    * @brief Get the id of the thread that owns this subgrid.
    *
@@ -1964,12 +2591,18 @@ public:
     _owning_thread = restart_reader.read< int_least32_t >();
     _largest_buffer_index = TRAVELDIRECTION_NUMBER;
     _largest_buffer_size = 0;
+    _private_counters = nullptr;
+    _number_of_private_counters = 0;
     const int_fast32_t number_of_cells =
         _number_of_cells[0] * _number_of_cells[1] * _number_of_cells[2];
     _ionization_variables = new IonizationVariables[number_of_cells];
     for (int_fast32_t i = 0; i < number_of_cells; ++i) {
       _ionization_variables[i] = IonizationVariables(restart_reader);
     }
+#ifdef SUBGRID_SOA
+    allocate_traversal_variables(number_of_cells);
+    update_traversal_variables();
+#endif
   }
 };
 
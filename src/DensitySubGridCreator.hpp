@@ -31,9 +31,13 @@
 #include "DensityFunction.hpp"
 #include "DensitySubGrid.hpp"
 #include "Error.hpp"
+#include "MPICommunicator.hpp"
+#include "MortonKeyGenerator.hpp"
+#include "NUMATopology.hpp"
 #include "OpenMP.hpp"
 #include "ParameterFile.hpp"
 
+#include <algorithm>
 #include <cinttypes>
 #include <vector>
 
@@ -68,6 +72,16 @@ private:
   /*! @brief Periodicity flags. */
   const CoordinateVector< bool > _periodicity;
 
+  /*! @brief Rank of the local MPI process. */
+  int_fast32_t _rank;
+
+  /*! @brief Rank of the MPI process that owns each original subgrid. */
+  std::vector< int_fast32_t > _subgrid_ranks;
+
+  /*! @brief Number of original subgrids that are owned by the local MPI
+   *  process. */
+  uint_fast32_t _number_of_local_subgrids;
+
 public:
   /**
    * @brief Constructor.
@@ -89,7 +103,7 @@ public:
         _subgrid_number_of_cells(number_of_cells[0] / number_of_subgrids[0],
                                  number_of_cells[1] / number_of_subgrids[1],
                                  number_of_cells[2] / number_of_subgrids[2]),
-        _periodicity(periodicity) {
+        _periodicity(periodicity), _rank(0) {
 
     for (uint_fast8_t i = 0; i < 3; ++i) {
       if (number_of_cells[i] % number_of_subgrids[i] != 0) {
@@ -101,6 +115,8 @@ public:
                          _number_of_subgrids[2],
                      nullptr);
     _copies.resize(_subgrids.size(), 0xffffffff);
+    _subgrid_ranks.resize(_subgrids.size(), 0);
+    _number_of_local_subgrids = _subgrids.size();
   }
 
   /**
@@ -157,15 +173,82 @@ public:
   }
 
   /**
-   * @brief Total number of cells in the grid.
+   * @brief Total number of cells in the grid that are owned by the local MPI
+   * process.
    *
-   * @return Total number of cells.
+   * @return Total number of local cells.
    */
   inline uint_fast64_t number_of_cells() const {
-    return number_of_original_subgrids() * _subgrid_number_of_cells.x() *
+    return _number_of_local_subgrids * _subgrid_number_of_cells.x() *
            _subgrid_number_of_cells.y() * _subgrid_number_of_cells.z();
   }
 
+  /**
+   * @brief Distribute the original subgrids across the given number of MPI
+   * processes.
+   *
+   * Every process gets a contiguous block of subgrid indices, which
+   * corresponds to a slab of subgrids along the x axis. Only the subgrids
+   * owned by the local process are allocated by initialize(); all other
+   * subgrids remain empty and cannot be dereferenced.
+   *
+   * This method needs to be called before initialize().
+   *
+   * @param rank Rank of the local MPI process.
+   * @param size Total number of MPI processes.
+   */
+  inline void set_domain_decomposition(const int_fast32_t rank,
+                                       const int_fast32_t size) {
+
+    const size_t number_of_subgrids = number_of_original_subgrids();
+    if (static_cast< size_t >(size) > number_of_subgrids) {
+      cmac_error("Cannot distribute %zu subgrids over %" PRIiFAST32
+                 " processes!",
+                 number_of_subgrids, size);
+    }
+
+    _rank = rank;
+    for (int_fast32_t irank = 0; irank < size; ++irank) {
+      const std::pair< size_t, size_t > block =
+          MPICommunicator::distribute_block(irank, size, 0,
+                                            number_of_subgrids);
+      for (size_t igrid = block.first; igrid < block.second; ++igrid) {
+        _subgrid_ranks[igrid] = irank;
+      }
+      if (irank == rank) {
+        _number_of_local_subgrids = block.second - block.first;
+      }
+    }
+  }
+
+  /**
+   * @brief Get the rank of the MPI process that owns the subgrid with the
+   * given index.
+   *
+   * Copies are always owned by the process that owns the original.
+   *
+   * @param index Subgrid index.
+   * @return Rank of the owning MPI process.
+   */
+  inline int_fast32_t get_subgrid_rank(const size_t index) const {
+    if (index < _subgrid_ranks.size()) {
+      return _subgrid_ranks[index];
+    } else {
+      return _subgrid_ranks[_originals[index - _subgrid_ranks.size()]];
+    }
+  }
+
+  /**
+   * @brief Is the subgrid with the given index owned by the local MPI
+   * process?
+   *
+   * @param index Subgrid index.
+   * @return True if the subgrid is stored on this process.
+   */
+  inline bool is_local(const size_t index) const {
+    return get_subgrid_rank(index) == _rank;
+  }
+
   /**
    * @brief Get the number of subgrids in each coordinate direction.
    *
@@ -395,6 +478,33 @@ public:
     return this_grid;
   }
 
+  /**
+   * @brief Allocate and initialize the subgrid with the given index.
+   *
+   * @param index Index of an original subgrid owned by the local process.
+   * @param density_function DensityFunction to use to initialize the cell
+   * variables.
+   * @param owning_thread Thread that owns the subgrid.
+   */
+  inline void initialize_subgrid(const size_t index,
+                                 DensityFunction &density_function,
+                                 const int_fast32_t owning_thread) {
+    _subgrids[index] = create_subgrid(index);
+    _subgrids[index]->set_owning_thread(owning_thread);
+    for (auto it = _subgrids[index]->begin(); it != _subgrids[index]->end();
+         ++it) {
+      DensityValues values = density_function(it);
+      it.get_ionization_variables().set_number_density(
+          values.get_number_density());
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        it.get_ionization_variables().set_ionic_fraction(
+            ion, values.get_ionic_fraction(ion));
+      }
+      it.get_ionization_variables().set_temperature(values.get_temperature());
+      _subgrids[index]->initialize_hydro(it.get_index(), values);
+    }
+  }
+
   /**
    * @brief Initialize the subgrids that make up the grid.
    *
@@ -408,24 +518,67 @@ public:
 #endif
     while (igrid.value() < _subgrids.size()) {
       const size_t this_igrid = igrid.post_increment();
-      if (this_igrid < _subgrids.size()) {
-        _subgrids[this_igrid] = create_subgrid(this_igrid);
-        _subgrids[this_igrid]->set_owning_thread(get_thread_index());
-        for (auto it = _subgrids[this_igrid]->begin();
-             it != _subgrids[this_igrid]->end(); ++it) {
-          DensityValues values = density_function(it);
-          it.get_ionization_variables().set_number_density(
-              values.get_number_density());
-          for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-            it.get_ionization_variables().set_ionic_fraction(
-                ion, values.get_ionic_fraction(ion));
-          }
-          it.get_ionization_variables().set_temperature(
-              values.get_temperature());
-          _subgrids[this_igrid]->initialize_hydro(it.get_index(), values);
+      if (this_igrid < _subgrids.size() && is_local(this_igrid)) {
+        initialize_subgrid(this_igrid, density_function, get_thread_index());
+      }
+    }
+  }
+
+  /**
+   * @brief Initialize the subgrids that make up the grid, using NUMA aware
+   * placement.
+   *
+   * The local subgrids are sorted in Morton order and split into contiguous
+   * blocks, first per NUMA node and then per thread on that node. Every
+   * subgrid is allocated and initialized by the thread that owns it, so that
+   * its memory ends up on the NUMA node of that thread (first touch).
+   *
+   * @param density_function DensityFunction to use to initialize the cell
+   * variables.
+   * @param topology Mapping of threads onto NUMA nodes. The number of threads
+   * in the topology should match the number of threads in a parallel region.
+   */
+  inline void initialize(DensityFunction &density_function,
+                         const NUMATopology &topology) {
+
+    const MortonKeyGenerator key_generator(_box);
+    std::vector< std::pair< morton_key_t, size_t > > keys;
+    for (size_t igrid = 0; igrid < _subgrids.size(); ++igrid) {
+      if (is_local(igrid)) {
+        const CoordinateVector< int_fast32_t > p = get_grid_position(igrid);
+        const CoordinateVector<> midpoint(
+            _box.get_anchor()[0] + (p.x() + 0.5) * _subgrid_sides[0],
+            _box.get_anchor()[1] + (p.y() + 0.5) * _subgrid_sides[1],
+            _box.get_anchor()[2] + (p.z() + 0.5) * _subgrid_sides[2]);
+        keys.push_back(std::make_pair(key_generator.get_key(midpoint), igrid));
+      }
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector< int_fast32_t > owners(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      owners[i] = topology.get_block_thread(i, keys.size());
+    }
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel num_threads(topology.get_number_of_threads())
+#endif
+    {
+      const int_fast32_t thread_id = get_thread_index();
+      for (size_t i = 0; i < keys.size(); ++i) {
+        if (owners[i] == thread_id) {
+          initialize_subgrid(keys[i].second, density_function, thread_id);
         }
       }
     }
+
+    // if we got less threads than expected, the calling thread initializes
+    // the remaining subgrids
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (_subgrids[keys[i].second] == nullptr) {
+        initialize_subgrid(keys[i].second, density_function, owners[i]);
+      }
+    }
   }
 
   /**
@@ -454,6 +607,8 @@ public:
     for (int_fast32_t i = 0; i < number_of_unique_subgrids; ++i) {
       const uint_fast8_t level = copy_levels[i];
       const uint_fast32_t number_of_copies = 1 << level;
+      cmac_assert_message(number_of_copies == 1 || is_local(i),
+                          "Cannot create copies of a remote subgrid!");
       // create the copies
       if (number_of_copies > 1) {
         _copies[i] = _subgrids.size();
@@ -466,6 +621,10 @@ public:
 
     // neighbour setting
     for (int_fast32_t i = 0; i < number_of_unique_subgrids; ++i) {
+      // remote subgrids have no copies
+      if (!is_local(i)) {
+        continue;
+      }
       const uint_fast8_t level = copy_levels[i];
       const uint_fast32_t number_of_copies = 1 << level;
       // first do the self-reference for each copy (if there are copies)
@@ -552,6 +711,9 @@ public:
   /**
    * @brief Update the counters of all original subgrids with the contributions
    * from their copies.
+   *
+   * The traversal counters of all subgrids (originals and copies) are flushed
+   * into the intensity integrals first.
    */
   inline void update_original_counters() {
     AtomicValue< size_t > ioriginal(0);
@@ -561,13 +723,17 @@ public:
     while (ioriginal.value() < _copies.size()) {
       const size_t this_ioriginal = ioriginal.post_increment();
       if (this_ioriginal < _copies.size() &&
-          _copies[this_ioriginal] != 0xffffffff) {
-        size_t copy_index = _copies[this_ioriginal] - _copies.size();
-        while (copy_index < _originals.size() &&
-               _originals[copy_index] == this_ioriginal) {
-          _subgrids[this_ioriginal]->update_intensities(
-              *_subgrids[copy_index + _copies.size()]);
-          ++copy_index;
+          is_local(this_ioriginal)) {
+        _subgrids[this_ioriginal]->flush_traversal_counters();
+        if (_copies[this_ioriginal] != 0xffffffff) {
+          size_t copy_index = _copies[this_ioriginal] - _copies.size();
+          while (copy_index < _originals.size() &&
+                 _originals[copy_index] == this_ioriginal) {
+            _subgrids[copy_index + _copies.size()]->flush_traversal_counters();
+            _subgrids[this_ioriginal]->update_intensities(
+                *_subgrids[copy_index + _copies.size()]);
+            ++copy_index;
+          }
         }
       }
     }
@@ -658,16 +824,32 @@ public:
 
     // Iterator functionality
 
+    /**
+     * @brief Move the iterator past original subgrids that are not stored on
+     * the local MPI process.
+     */
+    inline void skip_remote_subgrids() {
+      const size_t number_of_originals =
+          _grid_creator->number_of_original_subgrids();
+      while (_index < number_of_originals &&
+             !_grid_creator->is_local(_index)) {
+        ++_index;
+      }
+    }
+
     /**
      * @brief Increment operator.
      *
      * We only implemented the pre-increment version, since the post-increment
      * version creates a new object and is computationally more expensive.
      *
+     * Original subgrids that are owned by another MPI process are skipped.
+     *
      * @return Reference to the incremented iterator.
      */
     inline iterator &operator++() {
       ++_index;
+      skip_remote_subgrids();
       return *this;
     }
 
@@ -725,9 +907,14 @@ public:
   /**
    * @brief Get an iterator to the beginning of the grid.
    *
-   * @return Iterator to the first subgrid.
+   * @return Iterator to the first subgrid that is stored on the local MPI
+   * process.
    */
-  inline iterator begin() { return iterator(0, *this); }
+  inline iterator begin() {
+    iterator it(0, *this);
+    it.skip_remote_subgrids();
+    return it;
+  }
 
   /**
    * @brief Get an iterator to the end of the original subgrids.
@@ -812,7 +999,8 @@ public:
   inline DensitySubGridCreator(RestartReader &restart_reader)
       : _box(restart_reader), _subgrid_sides(restart_reader),
         _number_of_subgrids(restart_reader),
-        _subgrid_number_of_cells(restart_reader), _periodicity(restart_reader) {
+        _subgrid_number_of_cells(restart_reader), _periodicity(restart_reader),
+        _rank(0) {
 
     const size_t number_of_subgrids = restart_reader.read< size_t >();
     _subgrids.resize(number_of_subgrids, nullptr);
@@ -829,6 +1017,8 @@ public:
     for (size_t i = 0; i < number_of_originals; ++i) {
       _copies[i] = restart_reader.read< size_t >();
     }
+    _subgrid_ranks.resize(number_of_originals, 0);
+    _number_of_local_subgrids = number_of_originals;
   }
 };
 
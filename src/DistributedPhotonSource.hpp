@@ -188,6 +188,18 @@ public:
     return _positions[source_index];
   }
 
+  /**
+   * @brief Multiply the number of photons emitted by every source with the
+   * given factor.
+   *
+   * @param factor Multiplication factor.
+   */
+  inline void scale_number_of_photons(const size_t factor) {
+    for (size_t i = 0; i < _subgrids.size(); ++i) {
+      _total_number_of_photons[i] *= factor;
+    }
+  }
+
   /**
    * @brief Reset the internal counters to start a new photon propagation step.
    */
@@ -1099,6 +1099,41 @@ public:
       Eflux = 0.;
     }
   }
+
+  /**
+   * @brief Solve the Riemann problem for a batch of static interfaces with the
+   * same coordinate axis as surface normal.
+   *
+   * The exact solver is iterative and cannot be vectorised, so this simply
+   * calls solve_for_flux() for every interface. The method exists so that
+   * both Riemann solvers can be used for pencil flux calculations.
+   *
+   * @param number_of_interfaces Number of interfaces.
+   * @param i Surface normal direction: x (0), y (1) or z (2).
+   * @param WL Left state primitive variables (density, velocity components,
+   * pressure).
+   * @param WR Right state primitive variables.
+   * @param fluxes Output flux arrays (mass, momentum components, energy).
+   */
+  inline void solve_for_flux_batch(const uint_fast32_t number_of_interfaces,
+                                   const uint_fast8_t i,
+                                   const double *const WL[5],
+                                   const double *const WR[5],
+                                   double *const fluxes[5]) const {
+
+    CoordinateVector<> normal;
+    normal[i] = 1.;
+    for (uint_fast32_t j = 0; j < number_of_interfaces; ++j) {
+      CoordinateVector<> pflux;
+      ExactRiemannSolver::solve_for_flux(
+          WL[0][j], CoordinateVector<>(WL[1][j], WL[2][j], WL[3][j]), WL[4][j],
+          WR[0][j], CoordinateVector<>(WR[1][j], WR[2][j], WR[3][j]), WR[4][j],
+          fluxes[0][j], pflux, fluxes[4][j], normal);
+      fluxes[1][j] = pflux.x();
+      fluxes[2][j] = pflux.y();
+      fluxes[3][j] = pflux.z();
+    }
+  }
 };
 
 #endif // EXACTRIEMANNSOLVER_HPP
@@ -0,0 +1,643 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file FlatOctree.hpp
+ *
+ * @brief Linear octree stored in a single contiguous array, used to speed up
+ * neighbour searches.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef FLATOCTREE_HPP
+#define FLATOCTREE_HPP
+
+#include "Box.hpp"
+#include "CoordinateVector.hpp"
+#include "MortonKeyGenerator.hpp"
+#include "OpenMP.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cinttypes>
+#include <utility>
+#include <vector>
+
+/*! @brief Maximum number of positions in a single leaf of the tree. */
+#ifndef FLATOCTREE_LEAF_SIZE
+#define FLATOCTREE_LEAF_SIZE 8
+#endif
+
+/*! @brief Level of the tree at which the construction is split into
+ *  independent subtrees that are built in parallel. */
+#ifndef FLATOCTREE_PARALLEL_LEVEL
+#define FLATOCTREE_PARALLEL_LEVEL 2
+#endif
+
+/*! @brief Number of levels in a Morton key. */
+#define FLATOCTREE_NUMBER_OF_LEVELS 21
+
+/**
+ * @brief Linear octree stored in a single contiguous array, used to speed up
+ * neighbour searches.
+ *
+ * The positions are sorted on their Morton key (as computed by
+ * MortonKeyGenerator) and the tree is constructed top-down on the sorted keys.
+ * The nodes are stored in depth-first order, so that the first child of a node
+ * is always the next node in the array. Every node stores the index of the
+ * next node on the same or a higher level (the node that needs to be checked
+ * next if the node is not opened), so that the tree can be traversed without
+ * recursion and without a stack. Leaves contain up to FLATOCTREE_LEAF_SIZE
+ * consecutive positions in the sorted position array.
+ *
+ * Nodes store the tight bounding box of the positions they contain, which
+ * guarantees that the opening criteria are correct, independent of round off
+ * in the key computation.
+ *
+ * The neighbour queries exist in two versions: a version that calls a given
+ * function for every neighbour, and does no heap allocation, and a version
+ * that returns the neighbours in a std::vector (like Octree).
+ */
+class FlatOctree {
+private:
+  /**
+   * @brief Single node of the tree.
+   */
+  struct Node {
+    /*! @brief Bounding box of all positions in the node. */
+    Box<> _box;
+
+    /*! @brief Accumulated auxiliary variable. */
+    double _variable;
+
+    /*! @brief Index of the first position of the node in the sorted position
+     *  array. */
+    uint32_t _begin;
+
+    /*! @brief Index beyond the last position of the node in the sorted position
+     *  array. */
+    uint32_t _end;
+
+    /*! @brief Index of the next node on the same or a higher level. */
+    uint32_t _skip;
+
+    /*! @brief Is this node a leaf? */
+    bool _is_leaf;
+  };
+
+  /*! @brief Box containing the tree structure. */
+  const Box<> _box;
+
+  /*! @brief Periodicity flag. */
+  const bool _is_periodic;
+
+  /*! @brief Nodes, in depth-first order. */
+  std::vector< Node > _nodes;
+
+  /*! @brief Positions, sorted on Morton key. */
+  std::vector< CoordinateVector<> > _positions;
+
+  /*! @brief Auxiliary variables, in the same order as the sorted positions. */
+  std::vector< double > _variables;
+
+  /*! @brief Original index of each position in the sorted position array. */
+  std::vector< uint32_t > _indices;
+
+  /*! @brief Morton keys of the sorted positions. */
+  std::vector< morton_key_t > _keys;
+
+  /**
+   * @brief Get the end of the range of positions in the given sorted range
+   * that belong to the given child on the given level.
+   *
+   * @param begin Start of the range.
+   * @param end End of the range.
+   * @param level Level of the parent node (0 for the root node).
+   * @param child Index of the child (0-7).
+   * @return Index beyond the last position that belongs to the child.
+   */
+  inline uint32_t get_child_end(const uint32_t begin, const uint32_t end,
+                                const uint_fast8_t level,
+                                const uint_fast8_t child) const {
+
+    const uint_fast8_t shift = 3 * (FLATOCTREE_NUMBER_OF_LEVELS - 1 - level);
+    uint32_t low = begin;
+    uint32_t high = end;
+    while (low < high) {
+      const uint32_t mid = low + (high - low) / 2;
+      if (((_keys[mid] >> shift) & 7) <= child) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    return low;
+  }
+
+  /**
+   * @brief Check if a node containing the given range of positions on the
+   * given level should be a leaf.
+   *
+   * @param begin Start of the range.
+   * @param end End of the range.
+   * @param level Level of the node.
+   * @return True if the node is a leaf.
+   */
+  inline static bool is_leaf(const uint32_t begin, const uint32_t end,
+                             const uint_fast8_t level) {
+    return end - begin <= FLATOCTREE_LEAF_SIZE ||
+           level == FLATOCTREE_NUMBER_OF_LEVELS;
+  }
+
+  /**
+   * @brief Set the bounding box of the node with the given index, based on
+   * its positions or children.
+   *
+   * @param nodes Node array.
+   * @param inode Index of the node.
+   */
+  inline void set_bounding_box(std::vector< Node > &nodes,
+                               const uint32_t inode) const {
+
+    Node &node = nodes[inode];
+    CoordinateVector<> min_corner(DBL_MAX);
+    CoordinateVector<> max_corner(-DBL_MAX);
+    if (node._is_leaf) {
+      for (uint32_t i = node._begin; i < node._end; ++i) {
+        min_corner = CoordinateVector<>::min(min_corner, _positions[i]);
+        max_corner = CoordinateVector<>::max(max_corner, _positions[i]);
+      }
+    } else {
+      uint32_t ichild = inode + 1;
+      while (ichild != node._skip) {
+        const Box<> &child_box = nodes[ichild]._box;
+        min_corner =
+            CoordinateVector<>::min(min_corner, child_box.get_anchor());
+        max_corner =
+            CoordinateVector<>::max(max_corner, child_box.get_top_anchor());
+        ichild = nodes[ichild]._skip;
+      }
+    }
+    node._box = Box<>(min_corner, max_corner - min_corner);
+  }
+
+  /**
+   * @brief Recursively add the node for the given range of positions and all
+   * its children to the given node array.
+   *
+   * @param begin Start of the range of positions.
+   * @param end End of the range of positions.
+   * @param level Level of the node.
+   * @param nodes Node array to add to. Skip indices are relative to the start
+   * of this array.
+   */
+  inline void build_node(const uint32_t begin, const uint32_t end,
+                         const uint_fast8_t level,
+                         std::vector< Node > &nodes) const {
+
+    const uint32_t inode = nodes.size();
+    nodes.push_back(Node());
+    nodes[inode]._begin = begin;
+    nodes[inode]._end = end;
+    nodes[inode]._variable = 0.;
+    nodes[inode]._is_leaf = is_leaf(begin, end, level);
+    if (!nodes[inode]._is_leaf) {
+      uint32_t child_begin = begin;
+      for (uint_fast8_t ichild = 0; ichild < 8; ++ichild) {
+        const uint32_t child_end =
+            get_child_end(child_begin, end, level, ichild);
+        if (child_end > child_begin) {
+          build_node(child_begin, child_end, level + 1, nodes);
+        }
+        child_begin = child_end;
+      }
+    }
+    nodes[inode]._skip = nodes.size();
+    set_bounding_box(nodes, inode);
+  }
+
+  /**
+   * @brief Recursively find the ranges of positions of the subtrees that are
+   * built in parallel.
+   *
+   * @param begin Start of the range of positions.
+   * @param end End of the range of positions.
+   * @param level Level of the node.
+   * @param subtrees List of subtrees to add to: start and end of the range of
+   * positions and level of the subtree root.
+   */
+  inline void find_subtrees(
+      const uint32_t begin, const uint32_t end, const uint_fast8_t level,
+      std::vector< std::pair< std::pair< uint32_t, uint32_t >, uint_fast8_t > >
+          &subtrees) const {
+
+    if (level == FLATOCTREE_PARALLEL_LEVEL || is_leaf(begin, end, level)) {
+      subtrees.push_back(std::make_pair(std::make_pair(begin, end), level));
+    } else {
+      uint32_t child_begin = begin;
+      for (uint_fast8_t ichild = 0; ichild < 8; ++ichild) {
+        const uint32_t child_end =
+            get_child_end(child_begin, end, level, ichild);
+        if (child_end > child_begin) {
+          find_subtrees(child_begin, child_end, level + 1, subtrees);
+        }
+        child_begin = child_end;
+      }
+    }
+  }
+
+  /**
+   * @brief Recursively add the top level nodes of the tree to the node array,
+   * and insert the subtrees that were built in parallel.
+   *
+   * Traverses the tree in the same order as find_subtrees().
+   *
+   * @param begin Start of the range of positions.
+   * @param end End of the range of positions.
+   * @param level Level of the node.
+   * @param subtrees Subtrees that were built in parallel.
+   * @param isubtree Index of the next subtree that will be inserted.
+   */
+  inline void assemble_node(const uint32_t begin, const uint32_t end,
+                            const uint_fast8_t level,
+                            const std::vector< std::vector< Node > > &subtrees,
+                            size_t &isubtree) {
+
+    if (level == FLATOCTREE_PARALLEL_LEVEL || is_leaf(begin, end, level)) {
+      const std::vector< Node > &subtree = subtrees[isubtree];
+      const uint32_t offset = _nodes.size();
+      for (size_t i = 0; i < subtree.size(); ++i) {
+        _nodes.push_back(subtree[i]);
+        _nodes.back()._skip += offset;
+      }
+      ++isubtree;
+    } else {
+      const uint32_t inode = _nodes.size();
+      _nodes.push_back(Node());
+      _nodes[inode]._begin = begin;
+      _nodes[inode]._end = end;
+      _nodes[inode]._variable = 0.;
+      _nodes[inode]._is_leaf = false;
+      uint32_t child_begin = begin;
+      for (uint_fast8_t ichild = 0; ichild < 8; ++ichild) {
+        const uint32_t child_end =
+            get_child_end(child_begin, end, level, ichild);
+        if (child_end > child_begin) {
+          assemble_node(child_begin, child_end, level + 1, subtrees, isubtree);
+        }
+        child_begin = child_end;
+      }
+      _nodes[inode]._skip = _nodes.size();
+      set_bounding_box(_nodes, inode);
+    }
+  }
+
+  /**
+   * @brief Get the distance between the given position and the position with
+   * the given index in the sorted position array.
+   *
+   * @param i Index in the sorted position array.
+   * @param centre Position.
+   * @return Distance between both positions, taking into account periodic
+   * boundaries if necessary.
+   */
+  inline double get_distance(const uint32_t i,
+                             const CoordinateVector<> &centre) const {
+    if (_is_periodic) {
+      return _box.periodic_distance(_positions[i], centre).norm();
+    } else {
+      return (_positions[i] - centre).norm();
+    }
+  }
+
+  /**
+   * @brief Get the distance between the given position and the bounding box of
+   * the given node.
+   *
+   * @param node Node.
+   * @param centre Position.
+   * @return Shortest distance between the node and the position, taking into
+   * account periodic boundaries if necessary.
+   */
+  inline double get_distance(const Node &node,
+                             const CoordinateVector<> &centre) const {
+    if (_is_periodic) {
+      return _box.periodic_distance(node._box, centre);
+    } else {
+      return node._box.get_distance(centre);
+    }
+  }
+
+  /**
+   * @brief Functor that stores neighbours in a std::vector.
+   */
+  class NeighbourList {
+  private:
+    /*! @brief Neighbour list. */
+    std::vector< uint_fast32_t > &_ngbs;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param ngbs Neighbour list to fill.
+     */
+    inline NeighbourList(std::vector< uint_fast32_t > &ngbs) : _ngbs(ngbs) {}
+
+    /**
+     * @brief Add the given neighbour to the list.
+     *
+     * @param index Index of the neighbour.
+     */
+    inline void operator()(const uint_fast32_t index) {
+      _ngbs.push_back(index);
+    }
+  };
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param positions Positions. A sorted copy of the positions is stored
+   * internally.
+   * @param box Box containing the tree structure.
+   * @param periodic Periodicity flag.
+   */
+  inline FlatOctree(const std::vector< CoordinateVector<> > &positions,
+                    const Box<> box, const bool periodic = false)
+      : _box(box), _is_periodic(periodic) {
+
+    const int_fast64_t number_of_positions = positions.size();
+    if (number_of_positions == 0) {
+      return;
+    }
+
+    // compute the keys
+    const MortonKeyGenerator key_generator(_box);
+    std::vector< std::pair< morton_key_t, uint32_t > > keys(
+        number_of_positions);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for default(shared)
+#endif
+    for (int_fast64_t i = 0; i < number_of_positions; ++i) {
+      keys[i].first = key_generator.get_key(positions[i]);
+      keys[i].second = i;
+    }
+
+    // sort them: every thread sorts a chunk, after which we merge the chunks
+    // pairwise. Since the key-index pairs are unique, the result does not
+    // depend on the number of threads.
+    int_fast64_t number_of_chunks = 1;
+#ifdef HAVE_OPENMP
+    number_of_chunks =
+        std::min< int_fast64_t >(omp_get_max_threads(), number_of_positions);
+#endif
+    std::vector< int_fast64_t > chunk_limits(number_of_chunks + 1);
+    for (int_fast64_t i = 0; i < number_of_chunks + 1; ++i) {
+      chunk_limits[i] = i * number_of_positions / number_of_chunks;
+    }
+#ifdef HAVE_OPENMP
+#pragma omp parallel for default(shared)
+#endif
+    for (int_fast64_t i = 0; i < number_of_chunks; ++i) {
+      std::sort(keys.begin() + chunk_limits[i],
+                keys.begin() + chunk_limits[i + 1]);
+    }
+    for (int_fast64_t width = 1; width < number_of_chunks; width *= 2) {
+#ifdef HAVE_OPENMP
+#pragma omp parallel for default(shared)
+#endif
+      for (int_fast64_t i = 0; i < number_of_chunks - width; i += 2 * width) {
+        std::inplace_merge(
+            keys.begin() + chunk_limits[i],
+            keys.begin() + chunk_limits[i + width],
+            keys.begin() +
+                chunk_limits[std::min(i + 2 * width, number_of_chunks)]);
+      }
+    }
+
+    // store the sorted positions
+    _positions.resize(number_of_positions);
+    _indices.resize(number_of_positions);
+    _keys.resize(number_of_positions);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for default(shared)
+#endif
+    for (int_fast64_t i = 0; i < number_of_positions; ++i) {
+      _keys[i] = keys[i].first;
+      _indices[i] = keys[i].second;
+      _positions[i] = positions[keys[i].second];
+    }
+
+    // build the subtrees in parallel and then assemble the full tree
+    std::vector< std::pair< std::pair< uint32_t, uint32_t >, uint_fast8_t > >
+        subtree_ranges;
+    find_subtrees(0, number_of_positions, 0, subtree_ranges);
+    const int_fast64_t number_of_subtrees = subtree_ranges.size();
+    std::vector< std::vector< Node > > subtrees(number_of_subtrees);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for default(shared) schedule(dynamic)
+#endif
+    for (int_fast64_t i = 0; i < number_of_subtrees; ++i) {
+      build_node(subtree_ranges[i].first.first, subtree_ranges[i].first.second,
+                 subtree_ranges[i].second, subtrees[i]);
+    }
+    size_t isubtree = 0;
+    assemble_node(0, number_of_positions, 0, subtrees, isubtree);
+
+    _variables.resize(number_of_positions, 0.);
+  }
+
+  /**
+   * @brief Custom version of std::max that can be used as a template operation.
+   *
+   * @param a Variable a.
+   * @param b Variable b.
+   * @return std::max(a,b).
+   */
+  template < typename _datatype_ >
+  inline static const _datatype_ &max(const _datatype_ &a,
+                                      const _datatype_ &b) {
+    return std::max(a, b);
+  }
+
+  /**
+   * @brief Set the auxiliary variables and accumulate the variables in the
+   * nodes using the given operation.
+   *
+   * @param v std::vector containing the values of the auxiliary variables (for
+   * each position, there is exactly one corresponding variable).
+   * @param op Operation used to accumulate variables within nodes.
+   */
+  template < typename _operation_ >
+  inline void set_auxiliaries(const std::vector< double > &v, _operation_ op) {
+
+    const int_fast64_t number_of_positions = _positions.size();
+#ifdef HAVE_OPENMP
+#pragma omp parallel for default(shared)
+#endif
+    for (int_fast64_t i = 0; i < number_of_positions; ++i) {
+      _variables[i] = v[_indices[i]];
+    }
+
+    // children are always stored after their parent, so a reverse traversal
+    // guarantees children are done before their parent
+    for (size_t inode = _nodes.size(); inode > 0; --inode) {
+      Node &node = _nodes[inode - 1];
+      if (node._is_leaf) {
+        node._variable = _variables[node._begin];
+        for (uint32_t i = node._begin + 1; i < node._end; ++i) {
+          node._variable = op(node._variable, _variables[i]);
+        }
+      } else {
+        uint32_t ichild = inode;
+        node._variable = _nodes[ichild]._variable;
+        ichild = _nodes[ichild]._skip;
+        while (ichild != node._skip) {
+          node._variable = op(node._variable, _nodes[ichild]._variable);
+          ichild = _nodes[ichild]._skip;
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Call the given function for every neighbour of the sphere with the
+   * given centre and radius.
+   *
+   * A neighbour is a position in the internal list for which the input sphere
+   * overlaps with the sphere with the list position as centre and the
+   * corresponding auxiliary variable as radius.
+   *
+   * @param centre Centre of the sphere.
+   * @param radius Radius of the sphere.
+   * @param function Function that is called with the (original) index of every
+   * neighbour. The order in which neighbours are found is not specified.
+   */
+  template < typename _function_ >
+  inline void for_each_ngb_sphere(const CoordinateVector<> centre,
+                                  const double radius,
+                                  _function_ &function) const {
+
+    const uint32_t number_of_nodes = _nodes.size();
+    uint32_t inode = 0;
+    while (inode < number_of_nodes) {
+      const Node &node = _nodes[inode];
+      if (get_distance(node, centre) > node._variable + radius) {
+        inode = node._skip;
+      } else if (node._is_leaf) {
+        for (uint32_t i = node._begin; i < node._end; ++i) {
+          if (get_distance(i, centre) <= _variables[i] + radius) {
+            function(static_cast< uint_fast32_t >(_indices[i]));
+          }
+        }
+        inode = node._skip;
+      } else {
+        ++inode;
+      }
+    }
+  }
+
+  /**
+   * @brief Call the given function for every neighbour of the given position.
+   *
+   * A neighbour is a position in the internal list for which the given position
+   * lies inside the sphere with the list position as centre and the
+   * corresponding auxiliary variable as radius.
+   *
+   * @param centre Position for which we search neighbours.
+   * @param function Function that is called with the (original) index of every
+   * neighbour. The order in which neighbours are found is not specified.
+   */
+  template < typename _function_ >
+  inline void for_each_ngb(const CoordinateVector<> centre,
+                           _function_ &function) const {
+    for_each_ngb_sphere(centre, 0., function);
+  }
+
+  /**
+   * @brief Get the indices of the neighbours of the given position.
+   *
+   * @param centre Position for which we search neighbours.
+   * @return Indices of the positions that are neighbours of the given centre.
+   */
+  inline std::vector< uint_fast32_t >
+  get_ngbs(const CoordinateVector<> centre) const {
+    std::vector< uint_fast32_t > ngbs;
+    NeighbourList list(ngbs);
+    for_each_ngb(centre, list);
+    return ngbs;
+  }
+
+  /**
+   * @brief Get the indices of the neighbours of the sphere of given position
+   * and radius.
+   *
+   * @param centre Centre of the sphere.
+   * @param radius Radius of the sphere.
+   * @return Indices of the positions that are neighbours of the given sphere.
+   */
+  inline std::vector< uint_fast32_t >
+  get_ngbs_sphere(const CoordinateVector<> centre, const double radius) const {
+    std::vector< uint_fast32_t > ngbs;
+    NeighbourList list(ngbs);
+    for_each_ngb_sphere(centre, radius, list);
+    return ngbs;
+  }
+
+  /**
+   * @brief Get the index of the closest position to the given position.
+   *
+   * @param centre Position.
+   * @return Index of the closest position.
+   */
+  inline uint_fast32_t get_closest_ngb(const CoordinateVector<> centre) const {
+
+    double rmin = DBL_MAX;
+    uint32_t imin = 0;
+    const uint32_t number_of_nodes = _nodes.size();
+    uint32_t inode = 0;
+    while (inode < number_of_nodes) {
+      const Node &node = _nodes[inode];
+      if (get_distance(node, centre) > rmin) {
+        inode = node._skip;
+      } else if (node._is_leaf) {
+        for (uint32_t i = node._begin; i < node._end; ++i) {
+          const double r = get_distance(i, centre);
+          if (r <= rmin) {
+            rmin = r;
+            imin = i;
+          }
+        }
+        inode = node._skip;
+      } else {
+        ++inode;
+      }
+    }
+    return _indices.empty() ? 0 : _indices[imin];
+  }
+
+  /**
+   * @brief Get the number of nodes in the tree.
+   *
+   * @return Number of nodes.
+   */
+  inline size_t get_number_of_nodes() const { return _nodes.size(); }
+};
+
+#endif // FLATOCTREE_HPP
@@ -123,7 +123,7 @@ public:
         //  - subgrid
         // (the output buffers belong to the subgrid and do not count
         // as a dependency)
-        new_task.set_dependency(subgrid.get_dependency());
+        new_task.set_dependency(subgrid.get_traversal_dependency());
 
         _queues[subgrid.get_owning_thread()]->add_task(task_index);
       }
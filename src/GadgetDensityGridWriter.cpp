@@ -37,11 +37,20 @@
 #include "ParameterFile.hpp"
 #include "Utilities.hpp"
 
+#include <algorithm>
+#include <cinttypes>
 #include <vector>
 
 /**
  * @brief Constructor.
  *
+ * If asynchronous output is enabled, snapshot data are copied into one of two
+ * staging buffers and written to disk by a background thread, so that the
+ * simulation can continue while the previous snapshot is written. All HDF5
+ * calls for snapshots are then made from the background thread, which is only
+ * safe if the HDF5 library was built to be thread safe. If it was not,
+ * snapshots are written synchronously instead.
+ *
  * @param prefix Prefix for the name of the file to write.
  * @param output_folder Name of the folder where output files should be placed.
  * @param hydro Flag specifying whether or not hydro is active.
@@ -50,13 +59,66 @@
  * @param log Log to write logging information to.
  * @param padding Number of digits used for the counter in the filenames.
  * @param compression Compress the HDF5 output?
+ * @param compression_level Deflate compression level (0-9) used if compression
+ * is enabled.
+ * @param chunk_size Maximum number of elements in a single dataset chunk.
+ * @param shuffle Apply the shuffle filter if compression is enabled?
+ * @param asynchronous Write snapshots asynchronously from a background thread?
  */
 GadgetDensityGridWriter::GadgetDensityGridWriter(
     std::string prefix, std::string output_folder, const bool hydro,
     const DensityGridWriterFields fields, Log *log, uint_fast8_t padding,
-    const bool compression)
+    const bool compression, const int_fast32_t compression_level,
+    const uint_fast32_t chunk_size, const bool shuffle,
+    const bool asynchronous)
     : DensityGridWriter(output_folder, hydro, fields, log), _prefix(prefix),
-      _padding(padding), _compression(compression) {
+      _padding(padding), _compression(compression),
+      _compression_level(compression_level), _chunk_size(chunk_size),
+      _shuffle(shuffle),
+      _asynchronous(asynchronous && HDF5Tools::is_library_threadsafe()),
+      _active_buffer(nullptr), _file(0), _group(0), _stop_writer(false) {
+
+  if (_compression_level < 0 || _compression_level > 9) {
+    cmac_error("Invalid compression level: %" PRIiFAST32
+               " (should be in the range [0, 9])!",
+               _compression_level);
+  }
+  if (_chunk_size == 0) {
+    cmac_error("Dataset chunk size should be larger than 0!");
+  }
+
+  // store the names of the datasets in the order in which they are filled
+  for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
+       ++property) {
+    if (_fields.field_present(property)) {
+      const std::string name = DensityGridWriterFields::get_name(property);
+      if (DensityGridWriterFields::get_type(property) ==
+          DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE) {
+        _vector_dataset_names.push_back(name);
+      } else {
+        if (DensityGridWriterFields::is_ion_property(property)) {
+          for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+            if (_fields.ion_present(property, ion)) {
+              _scalar_dataset_names.push_back(name + get_ion_name(ion));
+            }
+          }
+        } else if (DensityGridWriterFields::is_heating_property(property)) {
+          for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
+               ++heating) {
+            if (_fields.heatingterm_present(property, heating)) {
+              _scalar_dataset_names.push_back(name + get_ion_name(heating));
+            }
+          }
+        } else {
+          _scalar_dataset_names.push_back(name);
+        }
+      }
+    }
+  }
+
+  for (uint_fast8_t i = 0; i < 2; ++i) {
+    _buffers[i]._in_use = false;
+  }
 
   // turn off default HDF5 error handling: we catch errors ourselves
   HDF5Tools::initialize();
@@ -64,10 +126,22 @@ GadgetDensityGridWriter::GadgetDensityGridWriter(
     _log->write_status("Set up GadgetDensityGridWriter with prefix \"", _prefix,
                        "\".");
     if (_compression) {
-      _log->write_status("Compression enabled.");
+      _log->write_status("Compression enabled (level ", _compression_level,
+                         ", shuffle: ", _shuffle, ").");
     } else {
       _log->write_status("Compression disabled.");
     }
+    _log->write_status("Using a dataset chunk size of ", _chunk_size, ".");
+    if (_asynchronous) {
+      _log->write_status("Snapshots are written asynchronously.");
+    } else if (asynchronous) {
+      _log->write_warning("The HDF5 library is not thread safe, snapshots are "
+                          "written synchronously.");
+    }
+  }
+
+  if (_asynchronous) {
+    _writer_thread = std::thread(&GadgetDensityGridWriter::run_writer, this);
   }
 }
 
@@ -78,6 +152,14 @@ GadgetDensityGridWriter::GadgetDensityGridWriter(
  *  - prefix: Prefix to prepend to all snapshot file names (default: snapshot)
  *  - padding: Number of digits to use in the output file names (default: 3)
  *  - compression: Compress HDF5 datasets? (default: false)
+ *  - compression level: Deflate compression level (0-9) used if compression is
+ *    enabled (default: 9)
+ *  - chunk size: Maximum number of elements in a single dataset chunk
+ *    (default: 1024)
+ *  - shuffle: Apply the shuffle filter if compression is enabled?
+ *    (default: true)
+ *  - asynchronous: Write snapshots asynchronously from a background thread?
+ *    This is ignored if the HDF5 library is not thread safe (default: false)
  *
  * @param output_folder Name of the folder where output files should be placed.
  * @param params ParameterFile to read.
@@ -92,36 +174,43 @@ GadgetDensityGridWriter::GadgetDensityGridWriter(std::string output_folder,
                                           "snapshot"),
           output_folder, hydro, DensityGridWriterFields(params, hydro), log,
           params.get_value< uint_fast8_t >("DensityGridWriter:padding", 3),
-          params.get_value< bool >("DensityGridWriter:compression", false)) {}
+          params.get_value< bool >("DensityGridWriter:compression", false),
+          params.get_value< int_fast32_t >(
+              "DensityGridWriter:compression level",
+              HDF5TOOLS_DEFAULT_COMPRESSION_LEVEL),
+          params.get_value< uint_fast32_t >("DensityGridWriter:chunk size",
+                                            HDF5TOOLS_DEFAULT_CHUNK_SIZE),
+          params.get_value< bool >("DensityGridWriter:shuffle", true),
+          params.get_value< bool >("DensityGridWriter:asynchronous", false)) {}
 
 /**
- * @brief Write the file.
+ * @brief Destructor.
  *
- * @param grid DensityGrid to write out.
- * @param iteration Value of the counter to append to the filename.
- * @param params ParameterFile containing the run parameters that should be
- * written to the file.
- * @param time Simulation time (in s).
- * @param hydro_units Internal unit system for the hydro.
+ * Waits for all pending asynchronous snapshots to be written to disk.
  */
-void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
-                                    ParameterFile &params, double time,
-                                    const InternalHydroUnits *hydro_units) {
-
-  std::string filename = Utilities::compose_filename(
-      _output_folder, _prefix, "hdf5", iteration, _padding);
-
-  if (_log) {
-    _log->write_status("Writing file \"", filename, "\".");
+GadgetDensityGridWriter::~GadgetDensityGridWriter() {
+  if (_asynchronous) {
+    {
+      std::unique_lock< std::mutex > lock(_queue_lock);
+      _stop_writer = true;
+    }
+    _queue_condition.notify_all();
+    _writer_thread.join();
   }
+}
 
-  HDF5Tools::HDF5File file =
-      HDF5Tools::open_file(filename, HDF5Tools::HDF5FILEMODE_WRITE);
+/**
+ * @brief Write the snapshot header groups to the given file.
+ *
+ * @param file HDF5File handle to an open file.
+ * @param snapshot SnapshotBuffer containing the header information.
+ */
+void GadgetDensityGridWriter::write_header(
+    HDF5Tools::HDF5File file, const SnapshotBuffer &snapshot) const {
 
   // write header
   HDF5Tools::HDF5Group group = HDF5Tools::create_group(file, "Header");
-  Box<> box = grid.get_box();
-  CoordinateVector<> boxsize = box.get_sides();
+  CoordinateVector<> boxsize = snapshot._box_sides;
   HDF5Tools::write_attribute< CoordinateVector<> >(group, "BoxSize", boxsize);
   int32_t dimension = 3;
   HDF5Tools::write_attribute< int32_t >(group, "Dimension", dimension);
@@ -134,14 +223,16 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
   int32_t numfiles = 1;
   HDF5Tools::write_attribute< int32_t >(group, "NumFilesPerSnapshot", numfiles);
   std::vector< uint32_t > numpart(6, 0);
-  numpart[0] = grid.get_number_of_cells();
+  numpart[0] = static_cast< uint32_t >(snapshot._number_of_cells);
   std::vector< uint32_t > numpart_high(6, 0);
+  numpart_high[0] = static_cast< uint32_t >(snapshot._number_of_cells >> 32);
   HDF5Tools::write_attribute< std::vector< uint32_t > >(
       group, "NumPart_ThisFile", numpart);
   HDF5Tools::write_attribute< std::vector< uint32_t > >(group, "NumPart_Total",
                                                         numpart);
   HDF5Tools::write_attribute< std::vector< uint32_t > >(
       group, "NumPart_Total_HighWord", numpart_high);
+  double time = snapshot._time;
   HDF5Tools::write_attribute< double >(group, "Time", time);
   HDF5Tools::close_group(group);
 
@@ -166,20 +257,20 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
 
   // write parameters
   group = HDF5Tools::create_group(file, "Parameters");
-  for (auto it = params.begin(); it != params.end(); ++it) {
-    std::string key = it.get_key();
-    std::string value = it.get_value();
-    HDF5Tools::write_attribute< std::string >(group, key, value);
+  for (auto it = snapshot._parameters.begin();
+       it != snapshot._parameters.end(); ++it) {
+    std::string value = it->second;
+    HDF5Tools::write_attribute< std::string >(group, it->first, value);
   }
   HDF5Tools::close_group(group);
 
   // write runtime parameters
   group = HDF5Tools::create_group(file, "RuntimePars");
-  std::string timestamp = Utilities::get_timestamp();
+  std::string timestamp = snapshot._timestamp;
   HDF5Tools::write_attribute< std::string >(group, "Creation time", timestamp);
   // an uint_fast32_t does not necessarily have the expected 32-bit size, while
   // we really need a 32-bit variable to write to the file
-  uint32_t uint32_iteration = iteration;
+  uint32_t uint32_iteration = snapshot._iteration;
   HDF5Tools::write_attribute< uint32_t >(group, "Iteration", uint32_iteration);
   HDF5Tools::close_group(group);
 
@@ -201,52 +292,236 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
   HDF5Tools::write_attribute< double >(group, "Unit time in cgs (U_t)",
                                        unit_time_in_cgs);
   HDF5Tools::close_group(group);
+}
 
-  // write particles
-  // to limit memory usage, we first create all datasets, and then add the data
-  // in small blocks
-  group = HDF5Tools::create_group(file, "PartType0");
-  for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
-       ++property) {
-    if (_fields.field_present(property)) {
-      const std::string name = DensityGridWriterFields::get_name(property);
-      if (DensityGridWriterFields::get_type(property) ==
-          DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE) {
-        HDF5Tools::create_dataset< CoordinateVector<> >(group, name, numpart[0],
-                                                        _compression);
-      } else {
-        if (DensityGridWriterFields::is_ion_property(property)) {
-          for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-            if (_fields.ion_present(property, ion)) {
-              const std::string prop_name = name + get_ion_name(ion);
-              HDF5Tools::create_dataset< double >(group, prop_name, numpart[0],
-                                                  _compression);
-            }
-          }
-        } else if (DensityGridWriterFields::is_heating_property(property)) {
-          for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
-               ++heating) {
-            if (_fields.heatingterm_present(property, heating)) {
-              const std::string prop_name = name + get_ion_name(heating);
-              HDF5Tools::create_dataset< double >(group, prop_name, numpart[0],
-                                                  _compression);
-            }
-          }
-        } else {
-          HDF5Tools::create_dataset< double >(group, name, numpart[0],
-                                              _compression);
-        }
+/**
+ * @brief Create empty datasets for all output fields in the given group.
+ *
+ * @param group HDF5Group handle to an open group.
+ * @param number_of_cells Number of cells in the snapshot.
+ */
+void GadgetDensityGridWriter::create_datasets(
+    HDF5Tools::HDF5Group group, const uint64_t number_of_cells) const {
+
+  for (uint_fast32_t i = 0; i < _vector_dataset_names.size(); ++i) {
+    HDF5Tools::create_dataset< CoordinateVector<> >(
+        group, _vector_dataset_names[i], number_of_cells, _compression,
+        _compression_level, _chunk_size, _shuffle);
+  }
+  for (uint_fast32_t i = 0; i < _scalar_dataset_names.size(); ++i) {
+    HDF5Tools::create_dataset< double >(
+        group, _scalar_dataset_names[i], number_of_cells, _compression,
+        _compression_level, _chunk_size, _shuffle);
+  }
+}
+
+/**
+ * @brief Start writing a new snapshot.
+ *
+ * In synchronous mode, this opens the snapshot file, writes the header and
+ * creates empty datasets. In asynchronous mode, this waits for a free staging
+ * buffer and stores the header information in it.
+ *
+ * @param filename Name of the snapshot file.
+ * @param box_sides Side lengths of the simulation box (in m).
+ * @param number_of_cells Number of cells in the snapshot.
+ * @param time Simulation time (in s).
+ * @param iteration Snapshot counter value.
+ * @param params ParameterFile containing the run parameters that should be
+ * written to the file.
+ */
+void GadgetDensityGridWriter::begin_snapshot(
+    const std::string filename, const CoordinateVector<> box_sides,
+    const uint64_t number_of_cells, const double time,
+    const uint_fast32_t iteration, ParameterFile &params) {
+
+  if (_asynchronous) {
+    std::unique_lock< std::mutex > lock(_queue_lock);
+    _queue_condition.wait(lock, [this] {
+      return !_buffers[0]._in_use || !_buffers[1]._in_use;
+    });
+    _active_buffer = _buffers[0]._in_use ? &_buffers[1] : &_buffers[0];
+    _active_buffer->_in_use = true;
+  } else {
+    _active_buffer = &_buffers[0];
+  }
+
+  SnapshotBuffer &snapshot = *_active_buffer;
+  snapshot._filename = filename;
+  snapshot._box_sides = box_sides;
+  snapshot._number_of_cells = number_of_cells;
+  snapshot._time = time;
+  snapshot._iteration = iteration;
+  snapshot._timestamp = Utilities::get_timestamp();
+  snapshot._parameters.clear();
+  for (auto it = params.begin(); it != params.end(); ++it) {
+    snapshot._parameters.push_back(
+        std::make_pair(it.get_key(), it.get_value()));
+  }
+
+  if (_asynchronous) {
+    snapshot._vector_data.resize(_vector_dataset_names.size());
+    for (uint_fast32_t i = 0; i < snapshot._vector_data.size(); ++i) {
+      snapshot._vector_data[i].resize(number_of_cells);
+    }
+    snapshot._scalar_data.resize(_scalar_dataset_names.size());
+    for (uint_fast32_t i = 0; i < snapshot._scalar_data.size(); ++i) {
+      snapshot._scalar_data[i].resize(number_of_cells);
+    }
+  } else {
+    _file = HDF5Tools::open_file(filename, HDF5Tools::HDF5FILEMODE_WRITE);
+    write_header(_file, snapshot);
+    // to limit memory usage, we first create all datasets, and then add the
+    // data in small blocks
+    _group = HDF5Tools::create_group(_file, "PartType0");
+    create_datasets(_group, number_of_cells);
+  }
+}
+
+/**
+ * @brief Add a block of cell data to the current snapshot.
+ *
+ * @param offset Offset of the first cell in the block.
+ * @param vector_props Vector field values for the cells in the block.
+ * @param scalar_props Scalar field values for the cells in the block.
+ */
+void GadgetDensityGridWriter::write_block(
+    const uint_fast32_t offset,
+    std::vector< std::vector< CoordinateVector<> > > &vector_props,
+    std::vector< std::vector< double > > &scalar_props) {
+
+  if (_asynchronous) {
+    SnapshotBuffer &snapshot = *_active_buffer;
+    for (uint_fast32_t i = 0; i < vector_props.size(); ++i) {
+      std::copy(vector_props[i].begin(), vector_props[i].end(),
+                snapshot._vector_data[i].begin() + offset);
+    }
+    for (uint_fast32_t i = 0; i < scalar_props.size(); ++i) {
+      std::copy(scalar_props[i].begin(), scalar_props[i].end(),
+                snapshot._scalar_data[i].begin() + offset);
+    }
+  } else {
+    for (uint_fast32_t i = 0; i < vector_props.size(); ++i) {
+      HDF5Tools::append_dataset< CoordinateVector<> >(
+          _group, _vector_dataset_names[i], offset, vector_props[i]);
+    }
+    for (uint_fast32_t i = 0; i < scalar_props.size(); ++i) {
+      HDF5Tools::append_dataset< double >(_group, _scalar_dataset_names[i],
+                                          offset, scalar_props[i]);
+    }
+  }
+}
+
+/**
+ * @brief Finish writing the current snapshot.
+ *
+ * In synchronous mode, this closes the snapshot file. In asynchronous mode,
+ * this hands the staging buffer over to the background writer thread.
+ */
+void GadgetDensityGridWriter::end_snapshot() {
+
+  if (_asynchronous) {
+    {
+      std::unique_lock< std::mutex > lock(_queue_lock);
+      _write_queue.push_back(_active_buffer);
+    }
+    _queue_condition.notify_all();
+  } else {
+    HDF5Tools::close_group(_group);
+    HDF5Tools::close_file(_file);
+  }
+  _active_buffer = nullptr;
+}
+
+/**
+ * @brief Write the given staged snapshot to disk.
+ *
+ * @param snapshot SnapshotBuffer containing a complete snapshot.
+ */
+void GadgetDensityGridWriter::write_snapshot(SnapshotBuffer &snapshot) const {
+
+  HDF5Tools::HDF5File file =
+      HDF5Tools::open_file(snapshot._filename, HDF5Tools::HDF5FILEMODE_WRITE);
+  write_header(file, snapshot);
+  HDF5Tools::HDF5Group group = HDF5Tools::create_group(file, "PartType0");
+  for (uint_fast32_t i = 0; i < _vector_dataset_names.size(); ++i) {
+    HDF5Tools::write_dataset< CoordinateVector<> >(
+        group, _vector_dataset_names[i], snapshot._vector_data[i],
+        _compression, _compression_level, _chunk_size, _shuffle);
+  }
+  for (uint_fast32_t i = 0; i < _scalar_dataset_names.size(); ++i) {
+    HDF5Tools::write_dataset< double >(
+        group, _scalar_dataset_names[i], snapshot._scalar_data[i],
+        _compression, _compression_level, _chunk_size, _shuffle);
+  }
+  HDF5Tools::close_group(group);
+  HDF5Tools::close_file(file);
+}
+
+/**
+ * @brief Main loop of the background writer thread.
+ *
+ * Writes queued snapshots in the order in which they were completed, until
+ * the writer is told to stop and the queue is empty.
+ */
+void GadgetDensityGridWriter::run_writer() {
+
+  while (true) {
+    SnapshotBuffer *snapshot;
+    {
+      std::unique_lock< std::mutex > lock(_queue_lock);
+      _queue_condition.wait(
+          lock, [this] { return _stop_writer || !_write_queue.empty(); });
+      if (_write_queue.empty()) {
+        return;
       }
+      snapshot = _write_queue.front();
+      _write_queue.pop_front();
     }
+
+    write_snapshot(*snapshot);
+
+    {
+      std::unique_lock< std::mutex > lock(_queue_lock);
+      snapshot->_in_use = false;
+    }
+    _queue_condition.notify_all();
   }
+}
+
+/**
+ * @brief Write the file.
+ *
+ * @param grid DensityGrid to write out.
+ * @param iteration Value of the counter to append to the filename.
+ * @param params ParameterFile containing the run parameters that should be
+ * written to the file.
+ * @param time Simulation time (in s).
+ * @param hydro_units Internal unit system for the hydro.
+ */
+void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
+                                    ParameterFile &params, double time,
+                                    const InternalHydroUnits *hydro_units) {
+
+  std::string filename = Utilities::compose_filename(
+      _output_folder, _prefix, "hdf5", iteration, _padding);
+
+  if (_log) {
+    _log->write_status("Writing file \"", filename, "\".");
+  }
+
+  const Box<> box = grid.get_box();
+  const uint_fast32_t number_of_cells = grid.get_number_of_cells();
+  begin_snapshot(filename, box.get_sides(), number_of_cells, time, iteration,
+                 params);
 
   const uint_fast32_t blocksize = 10000;
   const uint_fast32_t numblock =
-      numpart[0] / blocksize + (numpart[0] % blocksize > 0);
+      number_of_cells / blocksize + (number_of_cells % blocksize > 0);
   for (uint_fast32_t iblock = 0; iblock < numblock; ++iblock) {
     const uint_fast32_t offset = iblock * blocksize;
     const uint_fast32_t upper_limit =
-        std::min(offset + blocksize, uint_fast32_t(numpart[0]));
+        std::min(offset + blocksize, number_of_cells);
     const uint_fast32_t thisblocksize = upper_limit - offset;
 
     std::vector< std::vector< CoordinateVector<> > > vector_props(
@@ -302,50 +577,9 @@ void GadgetDensityGridWriter::write(DensityGrid &grid, uint_fast32_t iteration,
       ++index;
     }
 
-    uint_fast8_t vector_index = 0;
-    uint_fast8_t scalar_index = 0;
-    for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
-         ++property) {
-      if (_fields.field_present(property)) {
-        const std::string name = DensityGridWriterFields::get_name(property);
-        if (DensityGridWriterFields::get_type(property) ==
-            DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE) {
-          HDF5Tools::append_dataset< CoordinateVector<> >(
-              group, name, offset, vector_props[vector_index]);
-          ++vector_index;
-        } else {
-          if (DensityGridWriterFields::is_ion_property(property)) {
-            for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-              if (_fields.ion_present(property, ion)) {
-                const std::string prop_name = name + get_ion_name(ion);
-                HDF5Tools::append_dataset< double >(group, prop_name, offset,
-                                                    scalar_props[scalar_index]);
-                ++scalar_index;
-              }
-            }
-          } else if (DensityGridWriterFields::is_heating_property(property)) {
-            for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
-                 ++heating) {
-              if (_fields.heatingterm_present(property, heating)) {
-                const std::string prop_name = name + get_ion_name(heating);
-                HDF5Tools::append_dataset< double >(group, prop_name, offset,
-                                                    scalar_props[scalar_index]);
-                ++scalar_index;
-              }
-            }
-          } else {
-            HDF5Tools::append_dataset< double >(group, name, offset,
-                                                scalar_props[scalar_index]);
-            ++scalar_index;
-          }
-        }
-      }
-    }
+    write_block(offset, vector_props, scalar_props);
   }
-  HDF5Tools::close_group(group);
-
-  // close file
-  HDF5Tools::close_file(file);
+  end_snapshot();
 }
 
 /**
@@ -382,131 +616,8 @@ void GadgetDensityGridWriter::write(
   // this line is what we actually want...
   const DensityGridWriterFields &fields = _fields;
 
-  HDF5Tools::HDF5File file =
-      HDF5Tools::open_file(filename, HDF5Tools::HDF5FILEMODE_WRITE);
-
-  // write header
-  HDF5Tools::HDF5Group group = HDF5Tools::create_group(file, "Header");
-  CoordinateVector<> boxsize = box.get_sides();
-  HDF5Tools::write_attribute< CoordinateVector<> >(group, "BoxSize", boxsize);
-  int32_t dimension = 3;
-  HDF5Tools::write_attribute< int32_t >(group, "Dimension", dimension);
-  std::vector< uint32_t > flag_entropy(6, 0);
-  HDF5Tools::write_attribute< std::vector< uint32_t > >(
-      group, "Flag_Entropy_ICs", flag_entropy);
-  std::vector< double > masstable(6, 0.);
-  HDF5Tools::write_attribute< std::vector< double > >(group, "MassTable",
-                                                      masstable);
-  int32_t numfiles = 1;
-  HDF5Tools::write_attribute< int32_t >(group, "NumFilesPerSnapshot", numfiles);
-  const uint64_t number_of_cells = grid_creator.number_of_cells();
-  std::vector< uint32_t > numpart(6, 0);
-  numpart[0] = static_cast< uint32_t >(number_of_cells);
-  std::vector< uint32_t > numpart_high(6, 0);
-  numpart_high[0] = static_cast< uint32_t >(number_of_cells >> 32);
-  HDF5Tools::write_attribute< std::vector< uint32_t > >(
-      group, "NumPart_ThisFile", numpart);
-  HDF5Tools::write_attribute< std::vector< uint32_t > >(group, "NumPart_Total",
-                                                        numpart);
-  HDF5Tools::write_attribute< std::vector< uint32_t > >(
-      group, "NumPart_Total_HighWord", numpart_high);
-  HDF5Tools::write_attribute< double >(group, "Time", time);
-  HDF5Tools::close_group(group);
-
-  // write code info
-  group = HDF5Tools::create_group(file, "Code");
-  for (auto it = CompilerInfo::begin(); it != CompilerInfo::end(); ++it) {
-    std::string key = it.get_key();
-    std::string value = it.get_value();
-    HDF5Tools::write_attribute< std::string >(group, key, value);
-  }
-  HDF5Tools::close_group(group);
-
-  // write configuration info
-  group = HDF5Tools::create_group(file, "Configuration");
-  for (auto it = ConfigurationInfo::begin(); it != ConfigurationInfo::end();
-       ++it) {
-    std::string key = it.get_key();
-    std::string value = it.get_value();
-    HDF5Tools::write_attribute< std::string >(group, key, value);
-  }
-  HDF5Tools::close_group(group);
-
-  // write parameters
-  group = HDF5Tools::create_group(file, "Parameters");
-  for (auto it = params.begin(); it != params.end(); ++it) {
-    std::string key = it.get_key();
-    std::string value = it.get_value();
-    HDF5Tools::write_attribute< std::string >(group, key, value);
-  }
-  HDF5Tools::close_group(group);
-
-  // write runtime parameters
-  group = HDF5Tools::create_group(file, "RuntimePars");
-  std::string timestamp = Utilities::get_timestamp();
-  HDF5Tools::write_attribute< std::string >(group, "Creation time", timestamp);
-  // an uint_fast32_t does not necessarily have the expected 32-bit size, while
-  // we really need a 32-bit variable to write to the file
-  uint32_t uint32_iteration = counter;
-  HDF5Tools::write_attribute< uint32_t >(group, "Iteration", uint32_iteration);
-  HDF5Tools::close_group(group);
-
-  // write units, we use SI units everywhere
-  group = HDF5Tools::create_group(file, "Units");
-  double unit_current_in_cgs = 1.;
-  double unit_length_in_cgs = 100.;
-  double unit_mass_in_cgs = 1000.;
-  double unit_temperature_in_cgs = 1.;
-  double unit_time_in_cgs = 1.;
-  HDF5Tools::write_attribute< double >(group, "Unit current in cgs (U_I)",
-                                       unit_current_in_cgs);
-  HDF5Tools::write_attribute< double >(group, "Unit length in cgs (U_L)",
-                                       unit_length_in_cgs);
-  HDF5Tools::write_attribute< double >(group, "Unit mass in cgs (U_M)",
-                                       unit_mass_in_cgs);
-  HDF5Tools::write_attribute< double >(group, "Unit temperature in cgs (U_T)",
-                                       unit_temperature_in_cgs);
-  HDF5Tools::write_attribute< double >(group, "Unit time in cgs (U_t)",
-                                       unit_time_in_cgs);
-  HDF5Tools::close_group(group);
-
-  // write particles
-  // to limit memory usage, we first create all datasets, and then add the data
-  // in small blocks
-  group = HDF5Tools::create_group(file, "PartType0");
-  for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
-       ++property) {
-    if (fields.field_present(property)) {
-      const std::string name = DensityGridWriterFields::get_name(property);
-      if (DensityGridWriterFields::get_type(property) ==
-          DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE) {
-        HDF5Tools::create_dataset< CoordinateVector<> >(group, name, numpart[0],
-                                                        _compression);
-      } else {
-        if (DensityGridWriterFields::is_ion_property(property)) {
-          for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-            if (fields.ion_present(property, ion)) {
-              const std::string prop_name = name + get_ion_name(ion);
-              HDF5Tools::create_dataset< double >(group, prop_name, numpart[0],
-                                                  _compression);
-            }
-          }
-        } else if (DensityGridWriterFields::is_heating_property(property)) {
-          for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
-               ++heating) {
-            if (fields.heatingterm_present(property, heating)) {
-              const std::string prop_name = name + get_ion_name(heating);
-              HDF5Tools::create_dataset< double >(group, prop_name, numpart[0],
-                                                  _compression);
-            }
-          }
-        } else {
-          HDF5Tools::create_dataset< double >(group, name, numpart[0],
-                                              _compression);
-        }
-      }
-    }
-  }
+  begin_snapshot(filename, box.get_sides(), grid_creator.number_of_cells(),
+                 time, counter, params);
 
   const uint_fast32_t blocksize = 10000;
   uint_fast32_t block_offset = 0;
@@ -577,55 +688,11 @@ void GadgetDensityGridWriter::write(
         ++index;
       }
 
-      uint_fast8_t vector_index = 0;
-      uint_fast8_t scalar_index = 0;
-      for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
-           ++property) {
-        if (fields.field_present(property)) {
-          const std::string name = DensityGridWriterFields::get_name(property);
-          if (DensityGridWriterFields::get_type(property) ==
-              DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE) {
-            HDF5Tools::append_dataset< CoordinateVector<> >(
-                group, name, block_offset + offset, vector_props[vector_index]);
-            ++vector_index;
-          } else {
-            if (DensityGridWriterFields::is_ion_property(property)) {
-              for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-                if (fields.ion_present(property, ion)) {
-                  const std::string prop_name = name + get_ion_name(ion);
-                  HDF5Tools::append_dataset< double >(
-                      group, prop_name, block_offset + offset,
-                      scalar_props[scalar_index]);
-                  ++scalar_index;
-                }
-              }
-            } else if (DensityGridWriterFields::is_heating_property(property)) {
-              for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
-                   ++heating) {
-                if (fields.heatingterm_present(property, heating)) {
-                  const std::string prop_name = name + get_ion_name(heating);
-                  HDF5Tools::append_dataset< double >(
-                      group, prop_name, block_offset + offset,
-                      scalar_props[scalar_index]);
-                  ++scalar_index;
-                }
-              }
-            } else {
-              HDF5Tools::append_dataset< double >(group, name,
-                                                  block_offset + offset,
-                                                  scalar_props[scalar_index]);
-              ++scalar_index;
-            }
-          }
-        }
-      }
+      write_block(block_offset + offset, vector_props, scalar_props);
     }
     block_offset += (*gridit).get_number_of_cells();
   }
-  HDF5Tools::close_group(group);
-
-  // close file
-  HDF5Tools::close_file(file);
+  end_snapshot();
 }
 
 /**
@@ -662,131 +729,8 @@ void GadgetDensityGridWriter::write(
   // this line is what we actually want...
   const DensityGridWriterFields &fields = _fields;
 
-  HDF5Tools::HDF5File file =
-      HDF5Tools::open_file(filename, HDF5Tools::HDF5FILEMODE_WRITE);
-
-  // write header
-  HDF5Tools::HDF5Group group = HDF5Tools::create_group(file, "Header");
-  CoordinateVector<> boxsize = box.get_sides();
-  HDF5Tools::write_attribute< CoordinateVector<> >(group, "BoxSize", boxsize);
-  int32_t dimension = 3;
-  HDF5Tools::write_attribute< int32_t >(group, "Dimension", dimension);
-  std::vector< uint32_t > flag_entropy(6, 0);
-  HDF5Tools::write_attribute< std::vector< uint32_t > >(
-      group, "Flag_Entropy_ICs", flag_entropy);
-  std::vector< double > masstable(6, 0.);
-  HDF5Tools::write_attribute< std::vector< double > >(group, "MassTable",
-                                                      masstable);
-  int32_t numfiles = 1;
-  HDF5Tools::write_attribute< int32_t >(group, "NumFilesPerSnapshot", numfiles);
-  const uint64_t number_of_cells = grid_creator.number_of_cells();
-  std::vector< uint32_t > numpart(6, 0);
-  numpart[0] = static_cast< uint32_t >(number_of_cells);
-  std::vector< uint32_t > numpart_high(6, 0);
-  numpart_high[0] = static_cast< uint32_t >(number_of_cells >> 32);
-  HDF5Tools::write_attribute< std::vector< uint32_t > >(
-      group, "NumPart_ThisFile", numpart);
-  HDF5Tools::write_attribute< std::vector< uint32_t > >(group, "NumPart_Total",
-                                                        numpart);
-  HDF5Tools::write_attribute< std::vector< uint32_t > >(
-      group, "NumPart_Total_HighWord", numpart_high);
-  HDF5Tools::write_attribute< double >(group, "Time", time);
-  HDF5Tools::close_group(group);
-
-  // write code info
-  group = HDF5Tools::create_group(file, "Code");
-  for (auto it = CompilerInfo::begin(); it != CompilerInfo::end(); ++it) {
-    std::string key = it.get_key();
-    std::string value = it.get_value();
-    HDF5Tools::write_attribute< std::string >(group, key, value);
-  }
-  HDF5Tools::close_group(group);
-
-  // write configuration info
-  group = HDF5Tools::create_group(file, "Configuration");
-  for (auto it = ConfigurationInfo::begin(); it != ConfigurationInfo::end();
-       ++it) {
-    std::string key = it.get_key();
-    std::string value = it.get_value();
-    HDF5Tools::write_attribute< std::string >(group, key, value);
-  }
-  HDF5Tools::close_group(group);
-
-  // write parameters
-  group = HDF5Tools::create_group(file, "Parameters");
-  for (auto it = params.begin(); it != params.end(); ++it) {
-    std::string key = it.get_key();
-    std::string value = it.get_value();
-    HDF5Tools::write_attribute< std::string >(group, key, value);
-  }
-  HDF5Tools::close_group(group);
-
-  // write runtime parameters
-  group = HDF5Tools::create_group(file, "RuntimePars");
-  std::string timestamp = Utilities::get_timestamp();
-  HDF5Tools::write_attribute< std::string >(group, "Creation time", timestamp);
-  // an uint_fast32_t does not necessarily have the expected 32-bit size, while
-  // we really need a 32-bit variable to write to the file
-  uint32_t uint32_iteration = counter;
-  HDF5Tools::write_attribute< uint32_t >(group, "Iteration", uint32_iteration);
-  HDF5Tools::close_group(group);
-
-  // write units, we use SI units everywhere
-  group = HDF5Tools::create_group(file, "Units");
-  double unit_current_in_cgs = 1.;
-  double unit_length_in_cgs = 100.;
-  double unit_mass_in_cgs = 1000.;
-  double unit_temperature_in_cgs = 1.;
-  double unit_time_in_cgs = 1.;
-  HDF5Tools::write_attribute< double >(group, "Unit current in cgs (U_I)",
-                                       unit_current_in_cgs);
-  HDF5Tools::write_attribute< double >(group, "Unit length in cgs (U_L)",
-                                       unit_length_in_cgs);
-  HDF5Tools::write_attribute< double >(group, "Unit mass in cgs (U_M)",
-                                       unit_mass_in_cgs);
-  HDF5Tools::write_attribute< double >(group, "Unit temperature in cgs (U_T)",
-                                       unit_temperature_in_cgs);
-  HDF5Tools::write_attribute< double >(group, "Unit time in cgs (U_t)",
-                                       unit_time_in_cgs);
-  HDF5Tools::close_group(group);
-
-  // write particles
-  // to limit memory usage, we first create all datasets, and then add the data
-  // in small blocks
-  group = HDF5Tools::create_group(file, "PartType0");
-  for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
-       ++property) {
-    if (fields.field_present(property)) {
-      const std::string name = DensityGridWriterFields::get_name(property);
-      if (DensityGridWriterFields::get_type(property) ==
-          DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE) {
-        HDF5Tools::create_dataset< CoordinateVector<> >(group, name, numpart[0],
-                                                        _compression);
-      } else {
-        if (DensityGridWriterFields::is_ion_property(property)) {
-          for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-            if (fields.ion_present(property, ion)) {
-              const std::string prop_name = name + get_ion_name(ion);
-              HDF5Tools::create_dataset< double >(group, prop_name, numpart[0],
-                                                  _compression);
-            }
-          }
-        } else if (DensityGridWriterFields::is_heating_property(property)) {
-          for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
-               ++heating) {
-            if (fields.heatingterm_present(property, heating)) {
-              const std::string prop_name = name + get_ion_name(heating);
-              HDF5Tools::create_dataset< double >(group, prop_name, numpart[0],
-                                                  _compression);
-            }
-          }
-        } else {
-          HDF5Tools::create_dataset< double >(group, name, numpart[0],
-                                              _compression);
-        }
-      }
-    }
-  }
+  begin_snapshot(filename, box.get_sides(), grid_creator.number_of_cells(),
+                 time, counter, params);
 
   const uint_fast32_t blocksize = 10000;
   uint_fast32_t block_offset = 0;
@@ -857,53 +801,9 @@ void GadgetDensityGridWriter::write(
         ++index;
       }
 
-      uint_fast8_t vector_index = 0;
-      uint_fast8_t scalar_index = 0;
-      for (int_fast32_t property = 0; property < DENSITYGRIDFIELD_NUMBER;
-           ++property) {
-        if (fields.field_present(property)) {
-          const std::string name = DensityGridWriterFields::get_name(property);
-          if (DensityGridWriterFields::get_type(property) ==
-              DENSITYGRIDFIELDTYPE_VECTOR_DOUBLE) {
-            HDF5Tools::append_dataset< CoordinateVector<> >(
-                group, name, block_offset + offset, vector_props[vector_index]);
-            ++vector_index;
-          } else {
-            if (DensityGridWriterFields::is_ion_property(property)) {
-              for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-                if (fields.ion_present(property, ion)) {
-                  const std::string prop_name = name + get_ion_name(ion);
-                  HDF5Tools::append_dataset< double >(
-                      group, prop_name, block_offset + offset,
-                      scalar_props[scalar_index]);
-                  ++scalar_index;
-                }
-              }
-            } else if (DensityGridWriterFields::is_heating_property(property)) {
-              for (int_fast32_t heating = 0; heating < NUMBER_OF_HEATINGTERMS;
-                   ++heating) {
-                if (fields.heatingterm_present(property, heating)) {
-                  const std::string prop_name = name + get_ion_name(heating);
-                  HDF5Tools::append_dataset< double >(
-                      group, prop_name, block_offset + offset,
-                      scalar_props[scalar_index]);
-                  ++scalar_index;
-                }
-              }
-            } else {
-              HDF5Tools::append_dataset< double >(group, name,
-                                                  block_offset + offset,
-                                                  scalar_props[scalar_index]);
-              ++scalar_index;
-            }
-          }
-        }
-      }
+      write_block(block_offset + offset, vector_props, scalar_props);
     }
     block_offset += (*gridit).get_number_of_cells();
   }
-  HDF5Tools::close_group(group);
-
-  // close file
-  HDF5Tools::close_file(file);
+  end_snapshot();
 }
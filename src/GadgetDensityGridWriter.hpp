@@ -27,8 +27,15 @@
 #define GADGETDENSITYGRIDWRITER_HPP
 
 #include "DensityGridWriter.hpp"
+#include "HDF5Tools.hpp"
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 class ParameterFile;
 
@@ -46,16 +53,131 @@ private:
   /*! @brief Compress the HDF5 output? */
   const bool _compression;
 
+  /*! @brief Deflate compression level (0-9) used if compression is enabled. */
+  const int_fast32_t _compression_level;
+
+  /*! @brief Maximum number of elements in a single dataset chunk. */
+  const uint_fast32_t _chunk_size;
+
+  /*! @brief Apply the shuffle filter if compression is enabled? */
+  const bool _shuffle;
+
+  /*! @brief Write snapshots asynchronously from a background thread? */
+  const bool _asynchronous;
+
+  /*! @brief Names of the vector datasets, in the order in which they are
+   *  filled. */
+  std::vector< std::string > _vector_dataset_names;
+
+  /*! @brief Names of the scalar datasets, in the order in which they are
+   *  filled. */
+  std::vector< std::string > _scalar_dataset_names;
+
+  /**
+   * @brief Staging buffer containing all the information needed to write a
+   * snapshot file.
+   *
+   * In synchronous mode, only the header information is used.
+   */
+  struct SnapshotBuffer {
+    /*! @brief Name of the snapshot file. */
+    std::string _filename;
+
+    /*! @brief Side lengths of the simulation box (in m). */
+    CoordinateVector<> _box_sides;
+
+    /*! @brief Number of cells in the snapshot. */
+    uint64_t _number_of_cells;
+
+    /*! @brief Simulation time (in s). */
+    double _time;
+
+    /*! @brief Snapshot counter value. */
+    uint32_t _iteration;
+
+    /*! @brief Creation time stamp. */
+    std::string _timestamp;
+
+    /*! @brief Run parameters (key-value pairs). */
+    std::vector< std::pair< std::string, std::string > > _parameters;
+
+    /*! @brief Vector dataset values. */
+    std::vector< std::vector< CoordinateVector<> > > _vector_data;
+
+    /*! @brief Scalar dataset values. */
+    std::vector< std::vector< double > > _scalar_data;
+
+    /*! @brief Is the buffer currently being filled or written? */
+    bool _in_use;
+  };
+
+  /*! @brief Snapshot buffers. In asynchronous mode, one buffer can be filled
+   *  while the other one is written to disk. */
+  SnapshotBuffer _buffers[2];
+
+  /*! @brief Buffer for the snapshot that is currently being written out by
+   *  the simulation. */
+  SnapshotBuffer *_active_buffer;
+
+  /*! @brief HDF5 file handle for the snapshot that is currently being written
+   *  (synchronous mode only). */
+  HDF5Tools::HDF5File _file;
+
+  /*! @brief HDF5 group handle for the cell data of the snapshot that is
+   *  currently being written (synchronous mode only). */
+  HDF5Tools::HDF5Group _group;
+
+  /*! @brief Snapshot buffers that are waiting to be written to disk by the
+   *  background writer thread. */
+  std::deque< SnapshotBuffer * > _write_queue;
+
+  /*! @brief Lock that protects the write queue and the buffer flags. */
+  std::mutex _queue_lock;
+
+  /*! @brief Condition variable used to signal changes to the write queue and
+   *  the buffer flags. */
+  std::condition_variable _queue_condition;
+
+  /*! @brief Flag signalling the background writer thread to stop. */
+  bool _stop_writer;
+
+  /*! @brief Background writer thread (asynchronous mode only). */
+  std::thread _writer_thread;
+
+  void write_header(HDF5Tools::HDF5File file,
+                    const SnapshotBuffer &snapshot) const;
+  void create_datasets(HDF5Tools::HDF5Group group,
+                       const uint64_t number_of_cells) const;
+
+  void begin_snapshot(const std::string filename,
+                      const CoordinateVector<> box_sides,
+                      const uint64_t number_of_cells, const double time,
+                      const uint_fast32_t iteration, ParameterFile &params);
+  void write_block(
+      const uint_fast32_t offset,
+      std::vector< std::vector< CoordinateVector<> > > &vector_props,
+      std::vector< std::vector< double > > &scalar_props);
+  void end_snapshot();
+
+  void write_snapshot(SnapshotBuffer &snapshot) const;
+  void run_writer();
+
 public:
   GadgetDensityGridWriter(
       std::string prefix, std::string output_folder = std::string("."),
       const bool hydro = false,
       const DensityGridWriterFields fields = DensityGridWriterFields(false),
       Log *log = nullptr, uint_fast8_t padding = 3,
-      const bool compression = false);
+      const bool compression = false,
+      const int_fast32_t compression_level =
+          HDF5TOOLS_DEFAULT_COMPRESSION_LEVEL,
+      const uint_fast32_t chunk_size = HDF5TOOLS_DEFAULT_CHUNK_SIZE,
+      const bool shuffle = true, const bool asynchronous = false);
   GadgetDensityGridWriter(std::string output_folder, ParameterFile &params,
                           const bool hydro, Log *log = nullptr);
 
+  virtual ~GadgetDensityGridWriter();
+
   virtual void write(DensityGrid &grid, uint_fast32_t iteration,
                      ParameterFile &params, double time = 0.,
                      const InternalHydroUnits *hydro_units = nullptr);
@@ -0,0 +1,237 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file GuideTable.hpp
+ *
+ * @brief Guide table that speeds up the inversion of a tabulated cumulative
+ * distribution.
+ *
+ * The range of the cumulative distribution is divided into a number of equal
+ * guide cells (Chen & Asau, 1974). For every guide cell, we store the index of
+ * the bin in the cumulative distribution that contains the lower limit of the
+ * cell. To locate a value, we look up its guide cell and walk the cumulative
+ * distribution linearly from the stored index. If the number of guide cells is
+ * similar to the number of bins, the expected number of steps is of order 1,
+ * compared to the logarithmic cost of a binary search.
+ *
+ * The located index is identical to the index returned by Utilities::locate(),
+ * so that switching to a guide table does not change the sampled values.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef GUIDETABLE_HPP
+#define GUIDETABLE_HPP
+
+#include "Error.hpp"
+#include "RandomGenerator.hpp"
+
+#include <cinttypes>
+#include <vector>
+
+/*! @brief Number of values that is processed at once by the bulk sampling
+ *  function. */
+#define GUIDETABLE_BLOCK_SIZE 64
+
+/**
+ * @brief Guide table that speeds up the inversion of a tabulated cumulative
+ * distribution.
+ */
+class GuideTable {
+private:
+  /*! @brief Index of the bin that contains the lower limit of every guide
+   *  cell. */
+  std::vector< uint_fast32_t > _guides;
+
+  /*! @brief Lower limit of the cumulative distribution. */
+  double _minimum;
+
+  /*! @brief Inverse width of a single guide cell. */
+  double _inverse_width;
+
+  /*! @brief Number of elements in the cumulative distribution. */
+  uint_fast32_t _length;
+
+public:
+  /**
+   * @brief Empty constructor.
+   */
+  inline GuideTable() : _minimum(0.), _inverse_width(0.), _length(0) {}
+
+  /**
+   * @brief (Re)build the guide table for the given cumulative distribution.
+   *
+   * The guide table does not store a copy of the cumulative distribution; the
+   * same array needs to be passed on to the other member functions.
+   *
+   * @param cumulative_distribution Cumulative distribution (should be
+   * monotonically increasing).
+   * @param length Number of elements in the cumulative distribution (at least
+   * 2).
+   * @param number_of_guides Number of guide cells (default: same as the
+   * number of elements).
+   */
+  inline void initialize(const double *cumulative_distribution,
+                         const uint_fast32_t length,
+                         uint_fast32_t number_of_guides = 0) {
+
+    cmac_assert_message(length > 1,
+                        "Cumulative distribution needs at least 2 elements!");
+
+    if (number_of_guides == 0) {
+      number_of_guides = length;
+    }
+    _length = length;
+    _minimum = cumulative_distribution[0];
+    const double range = cumulative_distribution[length - 1] - _minimum;
+    _inverse_width = (range > 0.) ? number_of_guides / range : 0.;
+
+    _guides.resize(number_of_guides);
+    uint_fast32_t index = 0;
+    for (uint_fast32_t i = 0; i < number_of_guides; ++i) {
+      const double lower_limit = _minimum + i * range / number_of_guides;
+      while (index < _length - 2 &&
+             lower_limit > cumulative_distribution[index + 1]) {
+        ++index;
+      }
+      _guides[i] = index;
+    }
+  }
+
+  /**
+   * @brief Locate the given value in the cumulative distribution.
+   *
+   * @param x Value to locate.
+   * @param cumulative_distribution Cumulative distribution that was used to
+   * build the table.
+   * @return Index of the last element in the cumulative distribution that is
+   * smaller than the given value, limited to the range [0, length - 2], i.e.
+   * the value is in between element index and index + 1.
+   */
+  inline uint_fast32_t locate(const double x,
+                              const double *cumulative_distribution) const {
+
+    cmac_assert_message(_length > 1, "Guide table was not initialized!");
+
+    const double guide_position = (x - _minimum) * _inverse_width;
+    uint_fast32_t guide = 0;
+    if (guide_position > 0.) {
+      guide = (guide_position < _guides.size()) ? guide_position
+                                                : _guides.size() - 1;
+    }
+    uint_fast32_t index = _guides[guide];
+    // guard against round off in the guide cell index: make sure we did not
+    // start beyond the correct element
+    while (index > 0 && !(x > cumulative_distribution[index])) {
+      --index;
+    }
+    while (index < _length - 2 && x > cumulative_distribution[index + 1]) {
+      ++index;
+    }
+    return index;
+  }
+
+  /**
+   * @brief Invert the cumulative distribution for the given value, using
+   * linear interpolation on the given tabulated values.
+   *
+   * @param x Value of the cumulative distribution.
+   * @param cumulative_distribution Cumulative distribution that was used to
+   * build the table.
+   * @param values Values corresponding to the elements of the cumulative
+   * distribution.
+   * @return Linearly interpolated value.
+   */
+  inline double sample_linear(const double x,
+                              const double *cumulative_distribution,
+                              const double *values) const {
+
+    const uint_fast32_t i = locate(x, cumulative_distribution);
+    return values[i] + (values[i + 1] - values[i]) *
+                           (x - cumulative_distribution[i]) /
+                           (cumulative_distribution[i + 1] -
+                            cumulative_distribution[i]);
+  }
+
+  /**
+   * @brief Invert the cumulative distribution for all given values, using
+   * linear interpolation on the given tabulated values.
+   *
+   * The values are processed in blocks. For every block, we first locate all
+   * values and then interpolate, so that the interpolation loop can be
+   * vectorised.
+   *
+   * @param number_of_values Number of values.
+   * @param x Values of the cumulative distribution. On return, these are
+   * replaced by the corresponding interpolated values.
+   * @param cumulative_distribution Cumulative distribution that was used to
+   * build the table.
+   * @param values Values corresponding to the elements of the cumulative
+   * distribution.
+   */
+  inline void sample_linear(const uint_fast32_t number_of_values, double *x,
+                            const double *cumulative_distribution,
+                            const double *values) const {
+
+    int32_t indices[GUIDETABLE_BLOCK_SIZE];
+    for (uint_fast32_t offset = 0; offset < number_of_values;
+         offset += GUIDETABLE_BLOCK_SIZE) {
+      const uint_fast32_t block_size =
+          (number_of_values - offset < GUIDETABLE_BLOCK_SIZE)
+              ? number_of_values - offset
+              : GUIDETABLE_BLOCK_SIZE;
+      double *block = x + offset;
+      for (uint_fast32_t j = 0; j < block_size; ++j) {
+        indices[j] = locate(block[j], cumulative_distribution);
+      }
+      for (uint_fast32_t j = 0; j < block_size; ++j) {
+        const int32_t i = indices[j];
+        block[j] = values[i] + (values[i + 1] - values[i]) *
+                                   (block[j] - cumulative_distribution[i]) /
+                                   (cumulative_distribution[i + 1] -
+                                    cumulative_distribution[i]);
+      }
+    }
+  }
+
+  /**
+   * @brief Fill the given array with random values drawn from the tabulated
+   * distribution, using linear interpolation on the given tabulated values.
+   *
+   * The uniform random numbers are generated in bulk first; they are then
+   * converted in bulk using sample_linear().
+   *
+   * @param random_generator RandomGenerator to use.
+   * @param number_of_values Number of values to generate.
+   * @param x Array to store the random values in.
+   * @param cumulative_distribution Cumulative distribution that was used to
+   * build the table.
+   * @param values Values corresponding to the elements of the cumulative
+   * distribution.
+   */
+  inline void fill_linear(RandomGenerator &random_generator,
+                          const uint_fast32_t number_of_values, double *x,
+                          const double *cumulative_distribution,
+                          const double *values) const {
+
+    random_generator.get_uniform_random_doubles(x, number_of_values);
+    sample_linear(number_of_values, x, cumulative_distribution, values);
+  }
+};
+
+#endif // GUIDETABLE_HPP
@@ -37,6 +37,12 @@
 #include <string>
 #include <vector>
 
+/*! @brief Default deflate compression level for compressed datasets. */
+#define HDF5TOOLS_DEFAULT_COMPRESSION_LEVEL 9
+
+/*! @brief Default maximum number of elements in a single dataset chunk. */
+#define HDF5TOOLS_DEFAULT_CHUNK_SIZE (1 << 10)
+
 /**
  * @brief Custom wrappers around some HDF5 library functions that feel more like
  * C++.
@@ -73,6 +79,31 @@ inline void initialize() {
   }
 }
 
+/**
+ * @brief Check if the HDF5 library was built to be thread safe.
+ *
+ * Libraries that are too old to report this are assumed not to be thread
+ * safe.
+ *
+ * @return True if HDF5 calls can safely be made from multiple threads.
+ */
+inline bool is_library_threadsafe() {
+#ifdef H5_VERSION_GE
+#if H5_VERSION_GE(1, 8, 16)
+  hbool_t is_threadsafe;
+  const herr_t hdf5status = H5is_library_threadsafe(&is_threadsafe);
+  if (hdf5status < 0) {
+    cmac_error("Unable to check if the HDF5 library is thread safe!");
+  }
+  return is_threadsafe;
+#else
+  return false;
+#endif
+#else
+  return false;
+#endif
+}
+
 /**
  * @brief Open the file with the given name for reading and/or writing.
  *
@@ -1340,17 +1371,26 @@ inline HDF5Dictionary< _datatype_ > read_dictionary(hid_t group,
  * @param name Name of the dataset to write.
  * @param values std::vector containing the contents of the dataset.
  * @param compress Apply compression to the dataset?
+ * @param compression_level Deflate compression level (0-9) used if compression
+ * is enabled.
+ * @param chunk_size Maximum number of elements in a single chunk.
+ * @param shuffle Apply the shuffle filter if compression is enabled?
  */
 template < typename _datatype_ >
 inline void write_dataset(hid_t group, std::string name,
                           std::vector< _datatype_ > &values,
-                          const bool compress = false) {
+                          const bool compress = false,
+                          const int_fast32_t compression_level =
+                              HDF5TOOLS_DEFAULT_COMPRESSION_LEVEL,
+                          const hsize_t chunk_size =
+                              HDF5TOOLS_DEFAULT_CHUNK_SIZE,
+                          const bool shuffle = true) {
 
   const hid_t datatype = get_datatype_name< _datatype_ >();
 
   // create dataspace
   const uint_fast32_t vsize = values.size();
-  const uint_fast32_t limit = 1 << 10;
+  const uint_fast32_t limit = chunk_size;
   const hsize_t dims[1] = {vsize};
   const hsize_t chunk[1] = {std::min(vsize, limit)};
   const hid_t filespace = H5Screate_simple(1, dims, nullptr);
@@ -1371,12 +1411,14 @@ inline void write_dataset(hid_t group, std::string name,
       cmac_error("Failed to set Fletcher32 filter for dataset \"%s\"",
                  name.c_str());
     }
-    hdf5status = H5Pset_shuffle(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set shuffle filter for dataset \"%s\"",
-                 name.c_str());
+    if (shuffle) {
+      hdf5status = H5Pset_shuffle(prop);
+      if (hdf5status < 0) {
+        cmac_error("Failed to set shuffle filter for dataset \"%s\"",
+                   name.c_str());
+      }
     }
-    hdf5status = H5Pset_deflate(prop, 9);
+    hdf5status = H5Pset_deflate(prop, compression_level);
     if (hdf5status < 0) {
       cmac_error("Failed to set compression for dataset \"%s\"", name.c_str());
     }
@@ -1434,17 +1476,23 @@ inline void write_dataset(hid_t group, std::string name,
  * @param name Name of the dataset to write.
  * @param values std::vector containing the contents of the dataset.
  * @param compress Apply compression to the dataset?
+ * @param compression_level Deflate compression level (0-9) used if compression
+ * is enabled.
+ * @param chunk_size Maximum number of elements in a single chunk.
+ * @param shuffle Apply the shuffle filter if compression is enabled?
  */
 template <>
 inline void write_dataset(hid_t group, std::string name,
                           std::vector< CoordinateVector<> > &values,
-                          const bool compress) {
+                          const bool compress,
+                          const int_fast32_t compression_level,
+                          const hsize_t chunk_size, const bool shuffle) {
 
   const hid_t datatype = get_datatype_name< double >();
 
   // create dataspace
   const uint_fast32_t vsize = values.size();
-  const uint_fast32_t limit = 1 << 10;
+  const uint_fast32_t limit = chunk_size;
   const hsize_t dims[2] = {vsize, 3};
   const hsize_t chunk[2] = {std::min(vsize, limit), 3};
   const hid_t filespace = H5Screate_simple(2, dims, nullptr);
@@ -1465,12 +1513,14 @@ inline void write_dataset(hid_t group, std::string name,
       cmac_error("Failed to set Fletcher32 filter for dataset \"%s\"",
                  name.c_str());
     }
-    hdf5status = H5Pset_shuffle(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set shuffle filter for dataset \"%s\"",
-                 name.c_str());
+    if (shuffle) {
+      hdf5status = H5Pset_shuffle(prop);
+      if (hdf5status < 0) {
+        cmac_error("Failed to set shuffle filter for dataset \"%s\"",
+                   name.c_str());
+      }
     }
-    hdf5status = H5Pset_deflate(prop, 9);
+    hdf5status = H5Pset_deflate(prop, compression_level);
     if (hdf5status < 0) {
       cmac_error("Failed to set compression for dataset \"%s\"", name.c_str());
     }
@@ -1530,11 +1580,17 @@ inline void write_dataset(hid_t group, std::string name,
  * @param name Name of the dataset to write.
  * @param values std::vector containing the contents of the dataset.
  * @param compress Apply compression to the dataset?
+ * @param compression_level Deflate compression level (0-9) used if compression
+ * is enabled.
+ * @param chunk_size Maximum number of elements in a single chunk.
+ * @param shuffle Apply the shuffle filter if compression is enabled?
  */
 template <>
 inline void write_dataset(hid_t group, std::string name,
                           std::vector< std::string > &values,
-                          const bool compress) {
+                          const bool compress,
+                          const int_fast32_t compression_level,
+                          const hsize_t chunk_size, const bool shuffle) {
 
   const hid_t datatype = H5Tcopy(H5T_C_S1);
   if (datatype < 0) {
@@ -1557,7 +1613,7 @@ inline void write_dataset(hid_t group, std::string name,
   }
 
   // create dataspace
-  const uint_fast32_t limit = 1 << 10;
+  const uint_fast32_t limit = chunk_size;
   const hsize_t dims[1] = {vsize};
   const hsize_t chunk[1] = {std::min(vsize, limit)};
   const hid_t filespace = H5Screate_simple(1, dims, nullptr);
@@ -1578,12 +1634,14 @@ inline void write_dataset(hid_t group, std::string name,
       cmac_error("Failed to set Fletcher32 filter for dataset \"%s\"",
                  name.c_str());
     }
-    hdf5status = H5Pset_shuffle(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set shuffle filter for dataset \"%s\"",
-                 name.c_str());
+    if (shuffle) {
+      hdf5status = H5Pset_shuffle(prop);
+      if (hdf5status < 0) {
+        cmac_error("Failed to set shuffle filter for dataset \"%s\"",
+                   name.c_str());
+      }
     }
-    hdf5status = H5Pset_deflate(prop, 9);
+    hdf5status = H5Pset_deflate(prop, compression_level);
     if (hdf5status < 0) {
       cmac_error("Failed to set compression for dataset \"%s\"", name.c_str());
     }
@@ -1647,15 +1705,24 @@ inline void write_dataset(hid_t group, std::string name,
  * @param name Name of the dataset to create.
  * @param size Size of the dataset.
  * @param compress Apply compression to the dataset?
+ * @param compression_level Deflate compression level (0-9) used if compression
+ * is enabled.
+ * @param chunk_size Maximum number of elements in a single chunk.
+ * @param shuffle Apply the shuffle filter if compression is enabled?
  */
 template < typename _datatype_ >
 inline void create_dataset(hid_t group, std::string name, hsize_t size,
-                           const bool compress = false) {
+                           const bool compress = false,
+                           const int_fast32_t compression_level =
+                               HDF5TOOLS_DEFAULT_COMPRESSION_LEVEL,
+                           const hsize_t chunk_size =
+                               HDF5TOOLS_DEFAULT_CHUNK_SIZE,
+                           const bool shuffle = true) {
 
   const hid_t datatype = get_datatype_name< _datatype_ >();
 
   // create dataspace
-  const hsize_t limit = 1 << 10;
+  const hsize_t limit = chunk_size;
   const hsize_t dims[1] = {size};
   const hsize_t chunk[1] = {std::min(size, limit)};
   const hid_t filespace = H5Screate_simple(1, dims, nullptr);
@@ -1676,12 +1743,14 @@ inline void create_dataset(hid_t group, std::string name, hsize_t size,
       cmac_error("Failed to set Fletcher32 filter for dataset \"%s\"",
                  name.c_str());
     }
-    hdf5status = H5Pset_shuffle(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set shuffle filter for dataset \"%s\"",
-                 name.c_str());
+    if (shuffle) {
+      hdf5status = H5Pset_shuffle(prop);
+      if (hdf5status < 0) {
+        cmac_error("Failed to set shuffle filter for dataset \"%s\"",
+                   name.c_str());
+      }
     }
-    hdf5status = H5Pset_deflate(prop, 9);
+    hdf5status = H5Pset_deflate(prop, compression_level);
     if (hdf5status < 0) {
       cmac_error("Failed to set compression for dataset \"%s\"", name.c_str());
     }
@@ -1728,16 +1797,21 @@ inline void create_dataset(hid_t group, std::string name, hsize_t size,
  * @param name Name of the dataset to create.
  * @param size Size of the dataset.
  * @param compress Apply compression to the dataset?
+ * @param compression_level Deflate compression level (0-9) used if compression
+ * is enabled.
+ * @param chunk_size Maximum number of elements in a single chunk.
+ * @param shuffle Apply the shuffle filter if compression is enabled?
  */
 template <>
-inline void create_dataset< CoordinateVector<> >(hid_t group, std::string name,
-                                                 hsize_t size,
-                                                 const bool compress) {
+inline void create_dataset< CoordinateVector<> >(
+    hid_t group, std::string name, hsize_t size, const bool compress,
+    const int_fast32_t compression_level, const hsize_t chunk_size,
+    const bool shuffle) {
 
   const hid_t datatype = get_datatype_name< double >();
 
   // create dataspace
-  const hsize_t limit = 1 << 10;
+  const hsize_t limit = chunk_size;
   const hsize_t dims[2] = {size, 3};
   const hsize_t chunk[2] = {std::min(size, limit), 3};
   const hid_t filespace = H5Screate_simple(2, dims, nullptr);
@@ -1758,12 +1832,14 @@ inline void create_dataset< CoordinateVector<> >(hid_t group, std::string name,
       cmac_error("Failed to set Fletcher32 filter for dataset \"%s\"",
                  name.c_str());
     }
-    hdf5status = H5Pset_shuffle(prop);
-    if (hdf5status < 0) {
-      cmac_error("Failed to set shuffle filter for dataset \"%s\"",
-                 name.c_str());
+    if (shuffle) {
+      hdf5status = H5Pset_shuffle(prop);
+      if (hdf5status < 0) {
+        cmac_error("Failed to set shuffle filter for dataset \"%s\"",
+                   name.c_str());
+      }
     }
-    hdf5status = H5Pset_deflate(prop, 9);
+    hdf5status = H5Pset_deflate(prop, compression_level);
     if (hdf5status < 0) {
       cmac_error("Failed to set compression for dataset \"%s\"", name.c_str());
     }
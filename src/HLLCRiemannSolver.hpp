@@ -38,6 +38,10 @@
 #include <cinttypes>
 #include <cmath>
 
+/*! @brief Number of interfaces that are processed together by
+ *  HLLCRiemannSolver::solve_for_flux_batch(). */
+#define HLLCRIEMANNSOLVER_BATCH_SIZE 32
+
 /**
  * @brief HLLC Riemann solver.
  */
@@ -512,6 +516,186 @@ public:
         Utilities::as_bytes(uR[0]), Utilities::as_bytes(uR[1]),
         Utilities::as_bytes(uR[2]), PR, Utilities::as_bytes(PR));
   }
+
+  /**
+   * @brief Solve the Riemann problem for a batch of static interfaces with the
+   * same coordinate axis as surface normal.
+   *
+   * The left and right states and the fluxes are stored as separate arrays for
+   * every variable: density, the three velocity (momentum) components, and
+   * pressure (energy). The result is the same as calling solve_for_flux() for
+   * every interface, but the common HLLC case is written without branches, so
+   * that the compiler can vectorise it. Interfaces that involve vacuum are
+   * passed on to solve_for_flux().
+   *
+   * @param number_of_interfaces Number of interfaces.
+   * @param i Surface normal direction: x (0), y (1) or z (2).
+   * @param WL Left state primitive variables.
+   * @param WR Right state primitive variables.
+   * @param fluxes Output flux arrays.
+   */
+  inline void solve_for_flux_batch(const uint_fast32_t number_of_interfaces,
+                                   const uint_fast8_t i,
+                                   const double *const WL[5],
+                                   const double *const WR[5],
+                                   double *const fluxes[5]) const {
+
+    double normal[3] = {0., 0., 0.};
+    normal[i] = 1.;
+
+    // the interfaces are processed in blocks that use local output arrays, so
+    // that the compiler knows the output cannot alias the input
+    for (uint_fast32_t ibatch = 0; ibatch < number_of_interfaces;
+         ibatch += HLLCRIEMANNSOLVER_BATCH_SIZE) {
+
+      const uint_fast32_t batch_size =
+          std::min(number_of_interfaces - ibatch,
+                   uint_fast32_t(HLLCRIEMANNSOLVER_BATCH_SIZE));
+      double mflux[HLLCRIEMANNSOLVER_BATCH_SIZE];
+      double pflux[3][HLLCRIEMANNSOLVER_BATCH_SIZE];
+      double Eflux[HLLCRIEMANNSOLVER_BATCH_SIZE];
+      // vacuum flags are stored as doubles, so that all arrays in the loop
+      // below have the same element size
+      double vacuum[HLLCRIEMANNSOLVER_BATCH_SIZE];
+
+      const double *rhoLs = WL[0] + ibatch;
+      const double *uxLs = WL[1] + ibatch;
+      const double *uyLs = WL[2] + ibatch;
+      const double *uzLs = WL[3] + ibatch;
+      const double *PLs = WL[4] + ibatch;
+      const double *rhoRs = WR[0] + ibatch;
+      const double *uxRs = WR[1] + ibatch;
+      const double *uyRs = WR[2] + ibatch;
+      const double *uzRs = WR[3] + ibatch;
+      const double *PRs = WR[4] + ibatch;
+
+      // this loop follows solve_for_flux() step by step, with the left or
+      // right state selected using conditional moves
+      for (uint_fast32_t j = 0; j < batch_size; ++j) {
+        const double rhoL = rhoLs[j];
+        const double uL[3] = {uxLs[j], uyLs[j], uzLs[j]};
+        const double PL = PLs[j];
+        const double rhoR = rhoRs[j];
+        const double uR[3] = {uxRs[j], uyRs[j], uzRs[j]};
+        const double PR = PRs[j];
+
+        const double rhoLinv = 1. / (rhoL + DBL_MIN);
+        const double rhoRinv = 1. / (rhoR + DBL_MIN);
+        const double PLinv = 1. / (PL + DBL_MIN);
+        const double PRinv = 1. / (PR + DBL_MIN);
+
+        const double vL =
+            uL[0] * normal[0] + uL[1] * normal[1] + uL[2] * normal[2];
+        const double vR =
+            uR[0] * normal[0] + uR[1] * normal[1] + uR[2] * normal[2];
+
+        const double aL = std::sqrt(_gamma * PL * rhoLinv);
+        const double aR = std::sqrt(_gamma * PR * rhoRinv);
+
+        const double vdiff = vR - vL;
+        const double abar = aL + aR;
+
+        // we use bitwise operators to avoid branches
+        vacuum[j] = ((rhoL == 0.) | std::isinf(rhoLinv) | (PL == 0.) |
+                     std::isinf(PLinv) | (rhoR == 0.) | std::isinf(rhoRinv) |
+                     (PR == 0.) | std::isinf(PRinv) | (_tdgm1 * abar <= vdiff))
+                        ? 1.
+                        : 0.;
+
+        const double rhobar = rhoL + rhoR;
+        const double Pbar = PL + PR;
+        const double pPVRS = 0.5 * (Pbar - 0.25 * vdiff * rhobar * abar);
+        const double pstar = std::max(0., pPVRS);
+
+        // the square roots are computed unconditionally, so that no branches
+        // are needed
+        const double sqrtqL = std::sqrt(1. + _gp1d2g * (pstar * PLinv - 1.));
+        const double sqrtqR = std::sqrt(1. + _gp1d2g * (pstar * PRinv - 1.));
+        const double qL = (pstar > PL) ? sqrtqL : 1.;
+        const double qR = (pstar > PR) ? sqrtqR : 1.;
+
+        const double SLmvL = -aL * qL;
+        const double SRmvR = aR * qR;
+        const double Pdiff = PR - PL;
+        const double rhovSdiff = rhoL * vL * SLmvL - rhoR * vR * SRmvR;
+        const double rhoSdiff = rhoL * SLmvL - rhoR * SRmvR;
+        const double Sstar = (Pdiff + rhovSdiff) / (rhoSdiff + DBL_MIN);
+
+        // select the upwind state
+        const bool left = (Sstar >= 0.);
+        const double rho = left ? rhoL : rhoR;
+        const double u[3] = {left ? uL[0] : uR[0], left ? uL[1] : uR[1],
+                             left ? uL[2] : uR[2]};
+        const double P = left ? PL : PR;
+        const double v = left ? vL : vR;
+        const double rhoinv = left ? rhoLinv : rhoRinv;
+        const double Smv = left ? SLmvL : SRmvR;
+
+        const double rhov = rho * v;
+        const double v2 = u[0] * u[0] + u[1] * u[1] + u[2] * u[2];
+        const double e = P * _odgm1 * rhoinv + 0.5 * v2;
+        const double S = Smv + v;
+
+        double m = rhov;
+        double p[3] = {rhov * u[0] + P * normal[0],
+                       rhov * u[1] + P * normal[1],
+                       rhov * u[2] + P * normal[2]};
+        double E = rhov * e + P * v;
+
+        const bool star = (left & (S < 0.)) | (!left & (S > 0.));
+        const double starfac = Smv / (S - Sstar) - 1.;
+        const double Srho = S * rho;
+        const double Sstarmv = Sstar - v;
+        const double Srhostarfac = Srho * starfac;
+        const double SrhoSstarmv = Srho * Sstarmv;
+        const double Smvinv = 1. / (Smv + DBL_MIN);
+
+        m = star ? m + Srhostarfac : m;
+        p[0] = star ? p[0] + (Srhostarfac * u[0] + SrhoSstarmv * normal[0])
+                    : p[0];
+        p[1] = star ? p[1] + (Srhostarfac * u[1] + SrhoSstarmv * normal[1])
+                    : p[1];
+        p[2] = star ? p[2] + (Srhostarfac * u[2] + SrhoSstarmv * normal[2])
+                    : p[2];
+        E = star ? E + (Srhostarfac * e +
+                        SrhoSstarmv * (Sstar + P * rhoinv * Smvinv))
+                 : E;
+
+        mflux[j] = m;
+        pflux[0][j] = p[0];
+        pflux[1][j] = p[1];
+        pflux[2][j] = p[2];
+        Eflux[j] = E;
+      }
+
+      // redo the interfaces that involve vacuum with the general solver
+      for (uint_fast32_t j = 0; j < batch_size; ++j) {
+        if (vacuum[j] != 0.) {
+          CoordinateVector<> p;
+          HLLCRiemannSolver::solve_for_flux(
+              WL[0][ibatch + j],
+              CoordinateVector<>(WL[1][ibatch + j], WL[2][ibatch + j],
+                                 WL[3][ibatch + j]),
+              WL[4][ibatch + j], WR[0][ibatch + j],
+              CoordinateVector<>(WR[1][ibatch + j], WR[2][ibatch + j],
+                                 WR[3][ibatch + j]),
+              WR[4][ibatch + j], mflux[j], p, Eflux[j],
+              CoordinateVector<>(normal[0], normal[1], normal[2]));
+          pflux[0][j] = p.x();
+          pflux[1][j] = p.y();
+          pflux[2][j] = p.z();
+        }
+      }
+
+      for (uint_fast32_t j = 0; j < batch_size; ++j) {
+        fluxes[0][ibatch + j] = mflux[j];
+        fluxes[1][ibatch + j] = pflux[0][j];
+        fluxes[2][ibatch + j] = pflux[1][j];
+        fluxes[3][ibatch + j] = pflux[2][j];
+        fluxes[4][ibatch + j] = Eflux[j];
+      }
+    }
+  }
 };
 
 #endif // HLLCRIEMANNSOLVER_HPP
@@ -26,6 +26,7 @@
 #ifndef HELIUMLYMANCONTINUUMSPECTRUM_HPP
 #define HELIUMLYMANCONTINUUMSPECTRUM_HPP
 
+#include "GuideTable.hpp"
 #include "PhotonSourceSpectrum.hpp"
 #include "RandomGenerator.hpp"
 
@@ -60,6 +61,14 @@ private:
   /*! @brief Cumulative distribution function. */
   std::vector< std::vector< double > > _cumulative_distribution;
 
+  /*! @brief Guide table used to locate temperatures in the temperature
+   *  bins. */
+  GuideTable _temperature_guide_table;
+
+  /*! @brief Guide tables used to invert the cumulative distribution function
+   *  for every temperature bin. */
+  std::vector< GuideTable > _guide_tables;
+
 public:
   HeliumLymanContinuumSpectrum(const CrossSections &cross_sections);
 
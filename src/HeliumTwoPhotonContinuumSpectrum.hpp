@@ -26,6 +26,7 @@
 #ifndef HELIUMTWOPHOTONCONTINUUMSPECTRUM_HPP
 #define HELIUMTWOPHOTONCONTINUUMSPECTRUM_HPP
 
+#include "GuideTable.hpp"
 #include "PhotonSourceSpectrum.hpp"
 #include "RandomGenerator.hpp"
 
@@ -51,6 +52,9 @@ private:
   /*! @brief Cumulative distribution function. */
   std::vector< double > _cumulative_distribution;
 
+  /*! @brief Guide table used to invert the cumulative distribution. */
+  GuideTable _guide_table;
+
 public:
   HeliumTwoPhotonContinuumSpectrum();
 
@@ -67,6 +71,11 @@ public:
   virtual double get_random_frequency(RandomGenerator &random_generator,
                                       double temperature = 0.) const;
 
+  virtual void fill_frequencies(RandomGenerator &random_generator,
+                                double *frequencies,
+                                const uint_fast32_t number_of_frequencies,
+                                double temperature = 0.) const;
+
   virtual double get_total_flux() const;
 };
 
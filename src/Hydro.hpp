@@ -26,6 +26,7 @@
 #ifndef HYDRO_HPP
 #define HYDRO_HPP
 
+#include "ExactRiemannSolver.hpp"
 #include "HLLCRiemannSolver.hpp"
 #include "HydroBoundary.hpp"
 #include "HydroVariables.hpp"
@@ -34,6 +35,7 @@
 #include "PhysicalConstants.hpp"
 
 #include <cfloat>
+#include <vector>
 
 /*! @brief Uncomment this to enable hard resets for unphysical hydro
  *  variables. */
@@ -42,6 +44,70 @@
 /*! @brief Uncomment this to activate the flux limiter. */
 #define FLUX_LIMITER 2.
 
+/*! @brief Riemann solver used by the hydro scheme. Since the type is fixed at
+ *  compile time, all calls to the solver are resolved statically. Set this to
+ *  ExactRiemannSolver to use the exact solver instead. */
+#ifndef HYDRO_RIEMANN_SOLVER
+#define HYDRO_RIEMANN_SOLVER HLLCRiemannSolver
+#endif
+
+/**
+ * @brief Work arrays for a flux calculation for a pencil of interfaces.
+ *
+ * The cell and interface quantities are stored as separate contiguous arrays,
+ * so that the reconstruction and limiting loops can be vectorised. Every
+ * quantity is stored twice: for the cells on the left and on the right of the
+ * interfaces.
+ */
+class HydroPencil {
+public:
+  /*! @brief Primitive variables of the cells. */
+  std::vector< double > _primitives[2][5];
+
+  /*! @brief Primitive variable gradients along the interface normal. */
+  std::vector< double > _gradients[2][5];
+
+  /*! @brief Conserved mass of the cells (in kg). */
+  std::vector< double > _mass[2];
+
+  /*! @brief Conserved total energy of the cells (in J). */
+  std::vector< double > _total_energy[2];
+
+  /*! @brief Squared norm of the conserved momentum of the cells
+   *  (in kg^2 m^2 s^-2). */
+  std::vector< double > _momentum2[2];
+
+  /*! @brief Reconstructed primitive variables at the interfaces. */
+  std::vector< double > _interface_states[2][5];
+
+  /*! @brief Fluxes through the interfaces. */
+  std::vector< double > _fluxes[5];
+
+  /**
+   * @brief Make sure the work arrays can hold the given number of interfaces.
+   *
+   * @param number_of_interfaces Number of interfaces in the pencil.
+   */
+  inline void reserve(const uint_fast32_t number_of_interfaces) {
+    if (_fluxes[0].size() >= number_of_interfaces) {
+      return;
+    }
+    for (uint_fast8_t side = 0; side < 2; ++side) {
+      for (uint_fast8_t j = 0; j < 5; ++j) {
+        _primitives[side][j].resize(number_of_interfaces);
+        _gradients[side][j].resize(number_of_interfaces);
+        _interface_states[side][j].resize(number_of_interfaces);
+      }
+      _mass[side].resize(number_of_interfaces);
+      _total_energy[side].resize(number_of_interfaces);
+      _momentum2[side].resize(number_of_interfaces);
+    }
+    for (uint_fast8_t j = 0; j < 5; ++j) {
+      _fluxes[j].resize(number_of_interfaces);
+    }
+  }
+};
+
 /**
  * @brief Hydro related functionality.
  */
@@ -89,7 +155,7 @@ private:
   const double _u_conversion_factor;
 
   /*! @brief Riemann solver used to solve the Riemann problem. */
-  const HLLCRiemannSolver _riemann_solver;
+  const HYDRO_RIEMANN_SOLVER _riemann_solver;
 
   /**
    * @brief Per face slope limiter for a single quantity.
@@ -114,39 +180,26 @@ private:
     const double delta1 = psi1 * std::abs(phiL - phiR);
     const double delta2 = psi2 * std::abs(phiL - phiR);
 
-    const double phimin = std::min(phiL, phiR);
-    const double phimax = std::max(phiL, phiR);
-
     const double phibar = phiL + dnrm_over_r * (phiR - phiL);
 
-    // if sign(phimax+delta1) == sign(phimax)
-    double phiplus;
-    if ((phimax + delta1) * phimax > 0.) {
-      phiplus = phimax + delta1;
-    } else {
-      const double absphimax = std::abs(phimax);
-      phiplus = phimax * absphimax / (absphimax + delta1 + DBL_MIN);
-    }
-
-    // if sign(phimin-delta1) == sign(phimin)
-    double phiminus;
-    if ((phimin - delta1) * phimin > 0.) {
-      phiminus = phimin - delta1;
-    } else {
-      const double absphimin = std::abs(phimin);
-      phiminus = phimin * absphimin / (absphimin + delta1 + DBL_MIN);
-    }
-
-    double phimid;
-    if (phiL == phiR) {
-      phimid = phiL;
-    } else {
-      if (phiL < phiR) {
-        phimid = std::max(phiminus, std::min(phibar + delta2, phimid0));
-      } else {
-        phimid = std::min(phiplus, std::max(phibar - delta2, phimid0));
-      }
-    }
+    // the limiter uses phimin - delta1 if phiL < phiR and phimax + delta1 if
+    // phiL > phiR. In both cases, the relevant extreme value is phiL.
+    // All alternatives are computed unconditionally, so that loops containing
+    // this function can be vectorised
+    const bool increasing = (phiL < phiR);
+    const double phiLshifted = phiL + (increasing ? -delta1 : delta1);
+    const double absphiL = std::abs(phiL);
+    const double phiLscaled = phiL * absphiL / (absphiL + delta1 + DBL_MIN);
+    // if sign(phiLshifted) == sign(phiL)
+    const double phiext =
+        (phiLshifted * phiL > 0.) ? phiLshifted : phiLscaled;
+
+    const double phimidup =
+        std::max(phiext, std::min(phibar + delta2, phimid0));
+    const double phimiddown =
+        std::min(phiext, std::max(phibar - delta2, phimid0));
+    const double phimid =
+        (phiL == phiR) ? phiL : (increasing ? phimidup : phimiddown);
     return phimid;
   }
 
@@ -372,11 +425,17 @@ public:
    * @param dx Distance between left and right state midpoint (in m).
    * @param A Surface area of the interface (in m^2).
    * @param dt Current system time step, used for flux limiter (in s).
+   * @param left_weight Weight of the flux in the left state time derivatives
+   * (ratio of the interface and left state time step).
+   * @param right_weight Weight of the flux in the right state time derivatives
+   * (ratio of the interface and right state time step).
    */
   inline void do_flux_calculation(const uint_fast8_t i,
                                   HydroVariables &left_state,
                                   HydroVariables &right_state, const double dx,
-                                  const double A, const double dt) const {
+                                  const double A, const double dt,
+                                  const double left_weight = 1.,
+                                  const double right_weight = 1.) const {
 
     const double halfdx = 0.5 * dx;
     double rhoL = left_state.get_primitives_density() +
@@ -526,17 +585,205 @@ public:
     Eflux *= fluxfac;
 #endif
 
-    left_state.delta_conserved(0) -= mflux;
-    left_state.delta_conserved(1) -= pflux.x();
-    left_state.delta_conserved(2) -= pflux.y();
-    left_state.delta_conserved(3) -= pflux.z();
-    left_state.delta_conserved(4) -= Eflux;
+    left_state.delta_conserved(0) -= left_weight * mflux;
+    left_state.delta_conserved(1) -= left_weight * pflux.x();
+    left_state.delta_conserved(2) -= left_weight * pflux.y();
+    left_state.delta_conserved(3) -= left_weight * pflux.z();
+    left_state.delta_conserved(4) -= left_weight * Eflux;
+
+    right_state.delta_conserved(0) += right_weight * mflux;
+    right_state.delta_conserved(1) += right_weight * pflux.x();
+    right_state.delta_conserved(2) += right_weight * pflux.y();
+    right_state.delta_conserved(3) += right_weight * pflux.z();
+    right_state.delta_conserved(4) += right_weight * Eflux;
+  }
+
+  /**
+   * @brief Do the flux calculation for a pencil of interfaces.
+   *
+   * The left and right cells of the interfaces are consecutive elements of the
+   * given arrays, so that they can be read with unit stride. For interfaces
+   * with a normal along the pencil, the two arrays overlap.
+   *
+   * This gives the same result as calling do_flux_calculation() for every
+   * interface, in order. However, the cell variables are gathered into
+   * contiguous arrays first, so that the reconstruction, limiting and Riemann
+   * solver can be vectorised.
+   *
+   * @param i Interface normal direction: x (0), y (1) or z (2).
+   * @param left_states Hydro variables of the left cell of the first interface.
+   * @param right_states Hydro variables of the right cell of the first
+   * interface.
+   * @param number_of_interfaces Number of interfaces in the pencil.
+   * @param dx Distance between left and right state midpoint (in m).
+   * @param A Surface area of the interfaces (in m^2).
+   * @param dt Current system time step, used for flux limiter (in s).
+   * @param pencil Work arrays.
+   * @param prediction_dt If positive, the primitive variables are predicted
+   * forward in time with this time step while they are gathered, instead of
+   * using the stored values (in s).
+   */
+  inline void do_pencil_flux_calculation(
+      const uint_fast8_t i, HydroVariables *left_states,
+      HydroVariables *right_states, const uint_fast32_t number_of_interfaces,
+      const double dx, const double A, const double dt, HydroPencil &pencil,
+      const double prediction_dt = 0.) const {
+
+    if (number_of_interfaces == 0) {
+      return;
+    }
+
+    pencil.reserve(number_of_interfaces);
+
+    // gather
+    HydroVariables *states[2] = {left_states, right_states};
+    for (uint_fast8_t side = 0; side < 2; ++side) {
+      for (uint_fast32_t iface = 0; iface < number_of_interfaces; ++iface) {
+        const HydroVariables &state = states[side][iface];
+        double W[5];
+        if (prediction_dt > 0.) {
+          get_predicted_primitive_variables(state, prediction_dt, W);
+        } else {
+          for (uint_fast8_t j = 0; j < 5; ++j) {
+            W[j] = state.primitives(j);
+          }
+        }
+        for (uint_fast8_t j = 0; j < 5; ++j) {
+          pencil._primitives[side][j][iface] = W[j];
+          pencil._gradients[side][j][iface] = state.primitive_gradients(j)[i];
+        }
+        pencil._mass[side][iface] = state.get_conserved_mass();
+        pencil._total_energy[side][iface] = state.get_conserved_total_energy();
+        pencil._momentum2[side][iface] =
+            state.get_conserved_momentum().norm2();
+      }
+    }
 
-    right_state.delta_conserved(0) += mflux;
-    right_state.delta_conserved(1) += pflux.x();
-    right_state.delta_conserved(2) += pflux.y();
-    right_state.delta_conserved(3) += pflux.z();
-    right_state.delta_conserved(4) += Eflux;
+    // reconstruct and limit the interface states
+    const double halfdx = 0.5 * dx;
+    for (uint_fast8_t j = 0; j < 5; ++j) {
+      const double *WL = &pencil._primitives[0][j][0];
+      const double *WR = &pencil._primitives[1][j][0];
+      const double *GL = &pencil._gradients[0][j][0];
+      const double *GR = &pencil._gradients[1][j][0];
+      double *WLface = &pencil._interface_states[0][j][0];
+      double *WRface = &pencil._interface_states[1][j][0];
+      for (uint_fast32_t iface = 0; iface < number_of_interfaces; ++iface) {
+        WLface[iface] =
+            limit(WL[iface] + halfdx * GL[iface], WL[iface], WR[iface], 0.5);
+        WRface[iface] =
+            limit(WR[iface] - halfdx * GR[iface], WR[iface], WL[iface], 0.5);
+      }
+    }
+
+    // make sure all densities and pressures are physical
+    for (uint_fast8_t side = 0; side < 2; ++side) {
+      double *rho = &pencil._interface_states[side][0][0];
+      double *P = &pencil._interface_states[side][4][0];
+      for (uint_fast32_t iface = 0; iface < number_of_interfaces; ++iface) {
+#ifdef SAFE_HYDRO_VARIABLES
+        rho[iface] = std::max(rho[iface], 0.);
+        P[iface] = std::max(P[iface], 0.);
+#else
+        cmac_assert(rho[iface] >= 0.);
+        cmac_assert(P[iface] >= 0.);
+#endif
+      }
+    }
+
+    // solve the Riemann problems
+    const double *WL[5], *WR[5];
+    double *fluxes[5];
+    for (uint_fast8_t j = 0; j < 5; ++j) {
+      WL[j] = &pencil._interface_states[0][j][0];
+      WR[j] = &pencil._interface_states[1][j][0];
+      fluxes[j] = &pencil._fluxes[j][0];
+    }
+    _riemann_solver.solve_for_flux_batch(number_of_interfaces, i, WL, WR,
+                                         fluxes);
+
+    // apply the flux limiter
+    for (uint_fast32_t iface = 0; iface < number_of_interfaces; ++iface) {
+      double mflux = fluxes[0][iface];
+      CoordinateVector<> pflux(fluxes[1][iface], fluxes[2][iface],
+                               fluxes[3][iface]);
+      double Eflux = fluxes[4][iface];
+
+      mflux *= A;
+      pflux[0] *= A;
+      pflux[1] *= A;
+      pflux[2] *= A;
+      Eflux *= A;
+
+#ifdef FLUX_LIMITER
+      // limit the flux, see do_flux_calculation() for details
+      const double mL = pencil._mass[0][iface];
+      const double mR = pencil._mass[1][iface];
+      double fluxfac = 1.;
+      const double absmflux = mflux * dt;
+      if (absmflux > FLUX_LIMITER * mL) {
+        fluxfac = FLUX_LIMITER * mL / absmflux;
+      }
+      if (-absmflux > FLUX_LIMITER * mR) {
+        fluxfac = std::min(fluxfac, -FLUX_LIMITER * mR / absmflux);
+      }
+      if (_gamma > 1.) {
+        const double EL = pencil._total_energy[0][iface];
+        const double ER = pencil._total_energy[1][iface];
+        const double absEflux = Eflux * dt;
+        if (absEflux > FLUX_LIMITER * EL) {
+          fluxfac = std::min(fluxfac, FLUX_LIMITER * EL / absEflux);
+        }
+        if (-absEflux > FLUX_LIMITER * ER) {
+          fluxfac = std::min(fluxfac, -FLUX_LIMITER * ER / absEflux);
+        }
+      }
+      const double p2 = pencil._momentum2[0][iface];
+      const double m2 = mL * mL;
+      if (p2 * pencil._primitives[0][0][iface] >
+          _gamma * m2 * pencil._primitives[0][4][iface]) {
+        const double pflux2 = pflux.norm2() * dt * dt;
+        if (pflux2 > (FLUX_LIMITER * FLUX_LIMITER) * p2) {
+          fluxfac = std::min(
+              fluxfac, std::sqrt((FLUX_LIMITER * FLUX_LIMITER) * p2 / pflux2));
+        }
+      }
+      {
+        const double pn2 = pencil._momentum2[1][iface];
+        const double mn2 = mR * mR;
+        if (p2 * pencil._primitives[1][0][iface] >
+            _gamma * mn2 * pencil._primitives[1][4][iface]) {
+          const double pflux2 = pflux.norm2() * dt * dt;
+          if (pflux2 > (FLUX_LIMITER * FLUX_LIMITER) * pn2) {
+            fluxfac = std::min(fluxfac, std::sqrt((FLUX_LIMITER *
+                                                   FLUX_LIMITER) *
+                                                  pn2 / pflux2));
+          }
+        }
+      }
+      cmac_assert_message(fluxfac >= 0. && fluxfac <= 1., "fluxfac: %g",
+                          fluxfac);
+      mflux *= fluxfac;
+      pflux *= fluxfac;
+      Eflux *= fluxfac;
+#endif
+
+      pencil._fluxes[0][iface] = mflux;
+      pencil._fluxes[1][iface] = pflux.x();
+      pencil._fluxes[2][iface] = pflux.y();
+      pencil._fluxes[3][iface] = pflux.z();
+      pencil._fluxes[4][iface] = Eflux;
+    }
+
+    // scatter the flux updates
+    for (uint_fast32_t iface = 0; iface < number_of_interfaces; ++iface) {
+      HydroVariables &left_state = left_states[iface];
+      HydroVariables &right_state = right_states[iface];
+      for (uint_fast8_t j = 0; j < 5; ++j) {
+        left_state.delta_conserved(j) -= pencil._fluxes[j][iface];
+        right_state.delta_conserved(j) += pencil._fluxes[j][iface];
+      }
+    }
   }
 
   /**
@@ -851,22 +1098,31 @@ public:
   }
 
   /**
-   * @brief Predict the primitive variables forward in time with the given time
-   * step.
+   * @brief Get the primitive variables of the given cell, predicted forward in
+   * time with the given time step.
    *
    * @param state Hydro variables of the cell.
    * @param dt Time step (in s).
+   * @param W Output predicted primitive variables (density - kg m^-3,
+   * velocity - m s^-1, pressure - kg m^-1 s^-2).
    */
-  inline void predict_primitive_variables(HydroVariables &state,
-                                          const double dt) const {
+  inline void get_predicted_primitive_variables(const HydroVariables &state,
+                                                const double dt,
+                                                double W[5]) const {
 
     const double rho = state.get_primitives_density();
 
     if (rho == 0.) {
+      for (uint_fast8_t j = 0; j < 5; ++j) {
+        W[j] = state.primitives(j);
+      }
       return;
     }
     const double rhoinv = 1. / rho;
     if (std::isinf(rhoinv)) {
+      for (uint_fast8_t j = 0; j < 5; ++j) {
+        W[j] = state.primitives(j);
+      }
       return;
     }
 
@@ -927,9 +1183,56 @@ public:
     cmac_assert(P_new >= 0.);
 #endif
 
-    state.set_primitives_density(rho_new);
-    state.set_primitives_velocity(v_new);
-    state.set_primitives_pressure(P_new);
+    W[0] = rho_new;
+    W[1] = v_new.x();
+    W[2] = v_new.y();
+    W[3] = v_new.z();
+    W[4] = P_new;
+  }
+
+  /**
+   * @brief Predict the primitive variables forward in time with the given time
+   * step.
+   *
+   * @param state Hydro variables of the cell.
+   * @param dt Time step (in s).
+   */
+  inline void predict_primitive_variables(HydroVariables &state,
+                                          const double dt) const {
+
+    double W[5];
+    get_predicted_primitive_variables(state, dt, W);
+    for (uint_fast8_t j = 0; j < 5; ++j) {
+      state.primitives(j) = W[j];
+    }
+  }
+
+  /**
+   * @brief Make a copy of the given cell, predicted forward in time with the
+   * given time step, that can be used in a flux calculation.
+   *
+   * Only the primitive variables, their gradients and the conserved variables
+   * are read from the original cell, and the conserved variable changes of
+   * the copy are set to zero. The original cell is never written to and its
+   * conserved variable changes are not accessed, so that this function can be
+   * used on a cell that is concurrently being updated by another thread.
+   *
+   * @param state Hydro variables of the cell.
+   * @param dt Time step (in s).
+   * @param copy Predicted copy of the cell.
+   */
+  inline void get_predicted_flux_state(const HydroVariables &state,
+                                       const double dt,
+                                       HydroVariables &copy) const {
+
+    double W[5];
+    get_predicted_primitive_variables(state, dt, W);
+    for (uint_fast8_t j = 0; j < 5; ++j) {
+      copy.primitives(j) = W[j];
+      copy.conserved(j) = state.conserved(j);
+      copy.delta_conserved(j) = 0.;
+      copy.primitive_gradients(j) = state.primitive_gradients(j);
+    }
   }
 
   /**
@@ -29,8 +29,14 @@
 #include "DensitySubGrid.hpp"
 #include "DensityValues.hpp"
 #include "Hydro.hpp"
+#include "HydroBoundaryManager.hpp"
 #include "HydroVariables.hpp"
 
+/*! @brief Number of cell rows in the y direction that are processed together
+ *  by the fused hydro sweeps, so that the neighbouring cells in the x
+ *  direction are still in cache when they are needed. */
+#define HYDRODENSITYSUBGRID_FUSED_BLOCK_SIZE 8
+
 /**
  * @brief Extension of DensitySubGrid that adds hydro variables.
  */
@@ -48,12 +54,114 @@ private:
   /*! @brief Hydrodynamical variables. */
   HydroVariables *_hydro_variables;
 
-  /*! @brief Gradient limiters for the primitive hydrodynamical variables. */
+  /*! @brief Gradient limiters for the primitive hydrodynamical variables
+   *  (not used in fused mode, in which case this is a null pointer). */
   double *_primitive_variable_limiters;
 
   /*! @brief Indices of the hydro tasks associated with this subgrid. */
   size_t _hydro_tasks[18];
 
+  /**
+   * @brief Update the conserved variables for a single cell in the grid.
+   *
+   * The primitive variable gradients and limiters are not reset.
+   *
+   * @param i Index of the cell.
+   * @param timestep Integration time step size (in s).
+   */
+  inline void update_cell_conserved_variables(const int_fast32_t i,
+                                              const double timestep) {
+
+    const CoordinateVector<> a =
+        _hydro_variables[i].get_gravitational_acceleration();
+    const CoordinateVector<> p = _hydro_variables[i].get_conserved_momentum();
+    const double mdt = _hydro_variables[i].get_conserved_mass() * timestep;
+    _hydro_variables[i].conserved(1) += mdt * a.x();
+    _hydro_variables[i].conserved(2) += mdt * a.y();
+    _hydro_variables[i].conserved(3) += mdt * a.z();
+    _hydro_variables[i].conserved(4) +=
+        timestep * CoordinateVector<>::dot_product(p, a);
+    _hydro_variables[i].conserved(4) += _hydro_variables[i].get_energy_term();
+    _hydro_variables[i].set_energy_term(0.);
+    for (int_fast8_t j = 0; j < 5; ++j) {
+      _hydro_variables[i].conserved(j) +=
+          _hydro_variables[i].delta_conserved(j) * timestep;
+
+      // reset hydro variables
+      _hydro_variables[i].delta_conserved(j) = 0;
+    }
+
+    cmac_assert(_hydro_variables[i].get_conserved_mass() ==
+                _hydro_variables[i].get_conserved_mass());
+    cmac_assert(_hydro_variables[i].get_conserved_momentum().x() ==
+                _hydro_variables[i].get_conserved_momentum().x());
+    cmac_assert(_hydro_variables[i].get_conserved_momentum().y() ==
+                _hydro_variables[i].get_conserved_momentum().y());
+    cmac_assert(_hydro_variables[i].get_conserved_momentum().z() ==
+                _hydro_variables[i].get_conserved_momentum().z());
+    cmac_assert(_hydro_variables[i].get_conserved_total_energy() ==
+                _hydro_variables[i].get_conserved_total_energy());
+
+#ifdef SAFE_HYDRO_VARIABLES
+    _hydro_variables[i].conserved(0) =
+        std::max(_hydro_variables[i].get_conserved_mass(), 0.);
+    _hydro_variables[i].conserved(4) =
+        std::max(_hydro_variables[i].get_conserved_total_energy(), 0.);
+#else
+    cmac_assert(_hydro_variables[i].get_conserved_mass() >= 0.);
+    cmac_assert(_hydro_variables[i].get_conserved_total_energy() >= 0.);
+#endif
+  }
+
+  /**
+   * @brief Get the hydro variables of the neighbouring cell of the given cell
+   * in the given direction.
+   *
+   * The neighbouring cell can be a cell in this subgrid, a cell in a
+   * neighbouring subgrid, or a ghost cell across a box boundary.
+   *
+   * @param index Index of the cell.
+   * @param cell Three dimensional index of the cell.
+   * @param i Direction: x (0), y (1) or z (2).
+   * @param orientation Orientation along the direction: positive (1) or
+   * negative (-1).
+   * @param strides Index strides in the three directions.
+   * @param neighbours Neighbouring subgrids in the six face directions.
+   * @param boundary_manager HydroBoundaryManager to use for box boundaries.
+   * @param ghost Storage for the ghost cell variables (if necessary).
+   * @return Hydro variables of the neighbouring cell.
+   */
+  inline const HydroVariables &get_neighbouring_hydro_variables(
+      const int_fast32_t index, const int_fast32_t cell[3],
+      const uint_fast8_t i, const int_fast8_t orientation,
+      const int_fast32_t strides[3], HydroDensitySubGrid *const neighbours[6],
+      const HydroBoundaryManager &boundary_manager,
+      HydroVariables &ghost) const {
+
+    const int_fast32_t ngb_cell = cell[i] + orientation;
+    if (ngb_cell >= 0 && ngb_cell < _number_of_cells[i]) {
+      return _hydro_variables[index + orientation * strides[i]];
+    }
+
+    const int_fast32_t direction =
+        TRAVELDIRECTION_FACE_X_P + 2 * i + (orientation < 0);
+    const HydroDensitySubGrid *neighbour =
+        neighbours[direction - TRAVELDIRECTION_FACE_X_P];
+    if (neighbour != nullptr) {
+      return neighbour->_hydro_variables[index - orientation *
+                                                     (_number_of_cells[i] - 1) *
+                                                     strides[i]];
+    }
+
+    CoordinateVector<> offset;
+    offset[i] = orientation * _cell_size[i];
+    ghost = boundary_manager.get_boundary_condition(direction)
+                .get_right_state_gradient_variables(
+                    i, orientation, get_cell_midpoint(index) + offset,
+                    _hydro_variables[index]);
+    return ghost;
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -96,16 +204,20 @@ public:
 
     const int_fast32_t tot_ncell = _number_of_cells[3] * _number_of_cells[0];
     _hydro_variables = new HydroVariables[tot_ncell];
-    _primitive_variable_limiters = new double[tot_ncell * 10];
 
     // copy data arrays
     for (int_fast32_t i = 0; i < tot_ncell; ++i) {
       _hydro_variables[i].copy_all(original._hydro_variables[i]);
     }
 
-    for (int_fast32_t i = 0; i < 10 * tot_ncell; ++i) {
-      _primitive_variable_limiters[i] =
-          original._primitive_variable_limiters[i];
+    if (original._primitive_variable_limiters != nullptr) {
+      _primitive_variable_limiters = new double[tot_ncell * 10];
+      for (int_fast32_t i = 0; i < 10 * tot_ncell; ++i) {
+        _primitive_variable_limiters[i] =
+            original._primitive_variable_limiters[i];
+      }
+    } else {
+      _primitive_variable_limiters = nullptr;
     }
   }
 
@@ -118,6 +230,19 @@ public:
     delete[] _primitive_variable_limiters;
   }
 
+  /**
+   * @brief Switch the subgrid to fused hydro mode.
+   *
+   * In fused mode, the hydro step is done by fused_gradient_sweep(),
+   * fused_flux_sweep() and fused_update(). These compute the slope limiters on
+   * the fly and never store predicted primitive variables, so that the per
+   * cell limiter storage is no longer needed and can be released.
+   */
+  inline void enable_fused_hydro() {
+    delete[] _primitive_variable_limiters;
+    _primitive_variable_limiters = nullptr;
+  }
+
   /**
    * @brief Initialize the conserved variables for the grid.
    *
@@ -155,48 +280,14 @@ public:
     const int_fast32_t tot_num_cells =
         _number_of_cells[0] * _number_of_cells[3];
     for (int_fast32_t i = 0; i < tot_num_cells; ++i) {
-      const CoordinateVector<> a =
-          _hydro_variables[i].get_gravitational_acceleration();
-      const CoordinateVector<> p = _hydro_variables[i].get_conserved_momentum();
-      const double mdt = _hydro_variables[i].get_conserved_mass() * timestep;
-      _hydro_variables[i].conserved(1) += mdt * a.x();
-      _hydro_variables[i].conserved(2) += mdt * a.y();
-      _hydro_variables[i].conserved(3) += mdt * a.z();
-      _hydro_variables[i].conserved(4) +=
-          timestep * CoordinateVector<>::dot_product(p, a);
-      _hydro_variables[i].conserved(4) += _hydro_variables[i].get_energy_term();
-      _hydro_variables[i].set_energy_term(0.);
-      for (int_fast8_t j = 0; j < 5; ++j) {
-        _hydro_variables[i].conserved(j) +=
-            _hydro_variables[i].delta_conserved(j) * timestep;
+      update_cell_conserved_variables(i, timestep);
 
-        // reset hydro variables
-        _hydro_variables[i].delta_conserved(j) = 0;
+      // reset gradients and limiters
+      for (int_fast8_t j = 0; j < 5; ++j) {
         _hydro_variables[i].primitive_gradients(j) = CoordinateVector<>(0.);
         _primitive_variable_limiters[10 * i + 2 * j] = DBL_MAX;
         _primitive_variable_limiters[10 * i + 2 * j + 1] = -DBL_MAX;
       }
-
-      cmac_assert(_hydro_variables[i].get_conserved_mass() ==
-                  _hydro_variables[i].get_conserved_mass());
-      cmac_assert(_hydro_variables[i].get_conserved_momentum().x() ==
-                  _hydro_variables[i].get_conserved_momentum().x());
-      cmac_assert(_hydro_variables[i].get_conserved_momentum().y() ==
-                  _hydro_variables[i].get_conserved_momentum().y());
-      cmac_assert(_hydro_variables[i].get_conserved_momentum().z() ==
-                  _hydro_variables[i].get_conserved_momentum().z());
-      cmac_assert(_hydro_variables[i].get_conserved_total_energy() ==
-                  _hydro_variables[i].get_conserved_total_energy());
-
-#ifdef SAFE_HYDRO_VARIABLES
-      _hydro_variables[i].conserved(0) =
-          std::max(_hydro_variables[i].get_conserved_mass(), 0.);
-      _hydro_variables[i].conserved(4) =
-          std::max(_hydro_variables[i].get_conserved_total_energy(), 0.);
-#else
-      cmac_assert(_hydro_variables[i].get_conserved_mass() >= 0.);
-      cmac_assert(_hydro_variables[i].get_conserved_total_energy() >= 0.);
-#endif
     }
   }
 
@@ -289,11 +380,62 @@ public:
    * @brief Compute the hydrodynamical fluxes for all interfaces inside the
    * subgrid.
    *
+   * The interfaces are processed one pencil along the z axis at a time, using
+   * Hydro::do_pencil_flux_calculation(), so that all cell variables are read
+   * with unit stride. The interfaces are processed in the same order as in
+   * inner_face_flux_sweep(), so that the result is exactly the same.
+   *
    * @param hydro Hydro instance to use.
    * @param dt Current system time step (in s).
    */
   inline void inner_flux_sweep(const Hydro &hydro, const double dt) {
 
+    HydroPencil pencil;
+    // we do three separate sweeps: one for every coordinate direction
+    // x direction
+    for (int_fast32_t ix = 0; ix < _number_of_cells[0] - 1; ++ix) {
+      for (int_fast32_t iy = 0; iy < _number_of_cells[1]; ++iy) {
+        const int_fast32_t index000 =
+            ix * _number_of_cells[3] + iy * _number_of_cells[2];
+        const int_fast32_t index100 = index000 + _number_of_cells[3];
+        hydro.do_pencil_flux_calculation(
+            0, &_hydro_variables[index000], &_hydro_variables[index100],
+            _number_of_cells[2], _cell_size[0], _cell_areas[0], dt, pencil);
+      }
+    }
+    // y direction
+    for (int_fast32_t ix = 0; ix < _number_of_cells[0]; ++ix) {
+      for (int_fast32_t iy = 0; iy < _number_of_cells[1] - 1; ++iy) {
+        const int_fast32_t index000 =
+            ix * _number_of_cells[3] + iy * _number_of_cells[2];
+        const int_fast32_t index010 = index000 + _number_of_cells[2];
+        hydro.do_pencil_flux_calculation(
+            1, &_hydro_variables[index000], &_hydro_variables[index010],
+            _number_of_cells[2], _cell_size[1], _cell_areas[1], dt, pencil);
+      }
+    }
+    // z direction
+    for (int_fast32_t ix = 0; ix < _number_of_cells[0]; ++ix) {
+      for (int_fast32_t iy = 0; iy < _number_of_cells[1]; ++iy) {
+        const int_fast32_t index000 =
+            ix * _number_of_cells[3] + iy * _number_of_cells[2];
+        hydro.do_pencil_flux_calculation(
+            2, &_hydro_variables[index000], &_hydro_variables[index000 + 1],
+            _number_of_cells[2] - 1, _cell_size[2], _cell_areas[2], dt,
+            pencil);
+      }
+    }
+  }
+
+  /**
+   * @brief Compute the hydrodynamical fluxes for all interfaces inside the
+   * subgrid, one interface at a time.
+   *
+   * @param hydro Hydro instance to use.
+   * @param dt Current system time step (in s).
+   */
+  inline void inner_face_flux_sweep(const Hydro &hydro, const double dt) {
+
     // we do three separate sweeps: one for every coordinate direction
     for (int_fast32_t ix = 0; ix < _number_of_cells[0] - 1; ++ix) {
       for (int_fast32_t iy = 0; iy < _number_of_cells[1]; ++iy) {
@@ -346,11 +488,16 @@ public:
    * @param direction TravelDirection of the neighbour.
    * @param hydro Hydro instance to use.
    * @param neighbour Neighbouring DensitySubGrid.
-   * @param dt Current system time step (in s).
+   * @param dt Time step for the interfaces (in s).
+   * @param this_weight Weight of the fluxes in the time derivatives of this
+   * subgrid (ratio of the interface and subgrid time step).
+   * @param neighbour_weight Weight of the fluxes in the time derivatives of
+   * the neighbouring subgrid.
    */
   inline void outer_flux_sweep(const int_fast32_t direction, const Hydro &hydro,
-                               HydroDensitySubGrid &neighbour,
-                               const double dt) {
+                               HydroDensitySubGrid &neighbour, const double dt,
+                               const double this_weight = 1.,
+                               const double neighbour_weight = 1.) {
 
     int_fast32_t i, start_index_left, start_index_right, row_increment,
         row_length, column_increment, column_length;
@@ -440,6 +587,11 @@ public:
       break;
     }
 
+    const double left_weight =
+        (left_grid == this) ? this_weight : neighbour_weight;
+    const double right_weight =
+        (left_grid == this) ? neighbour_weight : this_weight;
+
     // using the index computation below is (much) faster than setting the
     // increment correctly and summing the indices manually
     for (int_fast32_t ic = 0; ic < column_length; ++ic) {
@@ -450,7 +602,7 @@ public:
             start_index_right + ic * column_increment + ir * row_increment;
         hydro.do_flux_calculation(i, left_grid->_hydro_variables[index_left],
                                   right_grid->_hydro_variables[index_right], dx,
-                                  A, dt);
+                                  A, dt, left_weight, right_weight);
       }
     }
   }
@@ -622,10 +774,16 @@ public:
    * @param direction TravelDirection of the neighbour.
    * @param hydro Hydro instance to use.
    * @param neighbour Neighbouring DensitySubGrid.
+   * @param update_this Update the gradients of this subgrid?
+   * @param update_neighbour Update the gradients of the neighbouring subgrid?
+   * A subgrid that is not updated is only read, so that its gradients remain
+   * valid while it is in the middle of a local time step.
    */
   inline void outer_gradient_sweep(const int_fast32_t direction,
                                    const Hydro &hydro,
-                                   HydroDensitySubGrid &neighbour) {
+                                   HydroDensitySubGrid &neighbour,
+                                   const bool update_this = true,
+                                   const bool update_neighbour = true) {
 
     int_fast32_t i, start_index_left, start_index_right, row_increment,
         row_length, column_increment, column_length;
@@ -709,19 +867,62 @@ public:
       break;
     }
 
-    // using the index computation below is (much) faster than setting the
-    // increment correctly and summing the indices manually
-    for (int_fast32_t ic = 0; ic < column_length; ++ic) {
-      for (int_fast32_t ir = 0; ir < row_length; ++ir) {
-        const int_fast32_t index_left =
-            start_index_left + ic * column_increment + ir * row_increment;
-        const int_fast32_t index_right =
-            start_index_right + ic * column_increment + ir * row_increment;
-        hydro.do_gradient_calculation(
-            i, left_grid->_hydro_variables[index_left],
-            right_grid->_hydro_variables[index_right], dxinv,
-            &left_grid->_primitive_variable_limiters[10 * index_left],
-            &right_grid->_primitive_variable_limiters[10 * index_right]);
+    if (update_this && update_neighbour) {
+      // using the index computation below is (much) faster than setting the
+      // increment correctly and summing the indices manually
+      for (int_fast32_t ic = 0; ic < column_length; ++ic) {
+        for (int_fast32_t ir = 0; ir < row_length; ++ir) {
+          const int_fast32_t index_left =
+              start_index_left + ic * column_increment + ir * row_increment;
+          const int_fast32_t index_right =
+              start_index_right + ic * column_increment + ir * row_increment;
+          hydro.do_gradient_calculation(
+              i, left_grid->_hydro_variables[index_left],
+              right_grid->_hydro_variables[index_right], dxinv,
+              &left_grid->_primitive_variable_limiters[10 * index_left],
+              &right_grid->_primitive_variable_limiters[10 * index_right]);
+        }
+      }
+    } else {
+      // one of the two sides is only read: let it write to a scratch copy
+      const bool update_left =
+          (left_grid == this) ? update_this : update_neighbour;
+      const bool update_right =
+          (left_grid == this) ? update_neighbour : update_this;
+      cmac_assert(update_left || update_right);
+      HydroVariables scratch_variables;
+      double scratch_limiters[10];
+      for (int_fast8_t j = 0; j < 5; ++j) {
+        scratch_limiters[2 * j] = DBL_MAX;
+        scratch_limiters[2 * j + 1] = -DBL_MAX;
+      }
+      for (int_fast32_t ic = 0; ic < column_length; ++ic) {
+        for (int_fast32_t ir = 0; ir < row_length; ++ir) {
+          const int_fast32_t index_left =
+              start_index_left + ic * column_increment + ir * row_increment;
+          const int_fast32_t index_right =
+              start_index_right + ic * column_increment + ir * row_increment;
+          HydroVariables *left_variables =
+              &left_grid->_hydro_variables[index_left];
+          double *left_limiters =
+              &left_grid->_primitive_variable_limiters[10 * index_left];
+          HydroVariables *right_variables =
+              &right_grid->_hydro_variables[index_right];
+          double *right_limiters =
+              &right_grid->_primitive_variable_limiters[10 * index_right];
+          if (!update_left) {
+            scratch_variables.copy_all(*left_variables);
+            left_variables = &scratch_variables;
+            left_limiters = scratch_limiters;
+          }
+          if (!update_right) {
+            scratch_variables.copy_all(*right_variables);
+            right_variables = &scratch_variables;
+            right_limiters = scratch_limiters;
+          }
+          hydro.do_gradient_calculation(i, *left_variables, *right_variables,
+                                        dxinv, left_limiters, right_limiters);
+        }
       }
     }
   }
@@ -831,6 +1032,209 @@ public:
     }
   }
 
+  /**
+   * @brief Compute the limited primitive variable gradients for all cells in
+   * the subgrid in a single pass (fused hydro mode).
+   *
+   * Every cell reads the primitive variables of its six neighbours, which can
+   * be cells in this subgrid, cells in a neighbouring subgrid or ghost cells,
+   * and computes its gradients and slope limiters from them. This replaces the
+   * internal and external gradient sweeps and the slope limiter sweep and gives
+   * exactly the same gradients. Neighbouring subgrids are only read.
+   *
+   * @param hydro Hydro instance to use.
+   * @param neighbours Neighbouring subgrids in the six face directions, in
+   * TravelDirection order (nullptr for a box boundary).
+   * @param boundary_manager HydroBoundaryManager to use for box boundaries.
+   */
+  inline void
+  fused_gradient_sweep(const Hydro &hydro,
+                       HydroDensitySubGrid *const neighbours[6],
+                       const HydroBoundaryManager &boundary_manager) {
+
+    const int_fast32_t strides[3] = {_number_of_cells[3], _number_of_cells[2],
+                                     1};
+    HydroVariables ghost;
+    for (int_fast32_t iyblock = 0; iyblock < _number_of_cells[1];
+         iyblock += HYDRODENSITYSUBGRID_FUSED_BLOCK_SIZE) {
+      const int_fast32_t iyend =
+          std::min(iyblock + HYDRODENSITYSUBGRID_FUSED_BLOCK_SIZE,
+                   _number_of_cells[1]);
+      for (int_fast32_t ix = 0; ix < _number_of_cells[0]; ++ix) {
+        for (int_fast32_t iy = iyblock; iy < iyend; ++iy) {
+          for (int_fast32_t iz = 0; iz < _number_of_cells[2]; ++iz) {
+            const int_fast32_t cell[3] = {ix, iy, iz};
+            const int_fast32_t index =
+                ix * strides[0] + iy * strides[1] + iz;
+            HydroVariables &state = _hydro_variables[index];
+
+            double Wlim[10];
+            for (uint_fast8_t j = 0; j < 5; ++j) {
+              Wlim[2 * j] = DBL_MAX;
+              Wlim[2 * j + 1] = -DBL_MAX;
+            }
+            for (uint_fast8_t i = 0; i < 3; ++i) {
+              // we compute the face contributions exactly like
+              // Hydro::do_gradient_calculation() does, so that the gradients
+              // do not depend on the sweep mode
+              double dwdxm[5];
+              const HydroVariables &ngbm = get_neighbouring_hydro_variables(
+                  index, cell, i, -1, strides, neighbours, boundary_manager,
+                  ghost);
+              for (uint_fast8_t j = 0; j < 5; ++j) {
+                dwdxm[j] = 0.5 * (ngbm.primitives(j) + state.primitives(j)) *
+                           _inv_cell_size[i];
+                Wlim[2 * j] = std::min(Wlim[2 * j], ngbm.primitives(j));
+                Wlim[2 * j + 1] = std::max(Wlim[2 * j + 1], ngbm.primitives(j));
+              }
+              const HydroVariables &ngbp = get_neighbouring_hydro_variables(
+                  index, cell, i, 1, strides, neighbours, boundary_manager,
+                  ghost);
+              for (uint_fast8_t j = 0; j < 5; ++j) {
+                const double dwdxp =
+                    0.5 * (state.primitives(j) + ngbp.primitives(j)) *
+                    _inv_cell_size[i];
+                Wlim[2 * j] = std::min(Wlim[2 * j], ngbp.primitives(j));
+                Wlim[2 * j + 1] = std::max(Wlim[2 * j + 1], ngbp.primitives(j));
+                state.primitive_gradients(j)[i] = dwdxp - dwdxm[j];
+              }
+            }
+            hydro.apply_slope_limiter(state, Wlim, _cell_size);
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Compute the hydrodynamical fluxes for all interfaces of the cells in
+   * the subgrid in a single pass (fused hydro mode).
+   *
+   * The primitive variables are predicted forward in time while they are read,
+   * so that no separate prediction sweep is necessary. Interfaces with a
+   * neighbouring subgrid are computed by both subgrids, and every subgrid only
+   * updates its own cells. This way, neighbouring subgrids are only read.
+   *
+   * @param hydro Hydro instance to use.
+   * @param neighbours Neighbouring subgrids in the six face directions, in
+   * TravelDirection order (nullptr for a box boundary).
+   * @param boundary_manager HydroBoundaryManager to use for box boundaries.
+   * @param dt Current system time step (in s).
+   */
+  inline void fused_flux_sweep(const Hydro &hydro,
+                               HydroDensitySubGrid *const neighbours[6],
+                               const HydroBoundaryManager &boundary_manager,
+                               const double dt) {
+
+    const double prediction_dt = 0.5 * dt;
+    const int_fast32_t strides[3] = {_number_of_cells[3], _number_of_cells[2],
+                                     1};
+
+    // internal interfaces: every pencil along the z axis does its interfaces
+    // with the next pencil in the x and y direction and its own interfaces
+    HydroPencil pencil;
+    for (int_fast32_t iyblock = 0; iyblock < _number_of_cells[1];
+         iyblock += HYDRODENSITYSUBGRID_FUSED_BLOCK_SIZE) {
+      const int_fast32_t iyend =
+          std::min(iyblock + HYDRODENSITYSUBGRID_FUSED_BLOCK_SIZE,
+                   _number_of_cells[1]);
+      for (int_fast32_t ix = 0; ix < _number_of_cells[0]; ++ix) {
+        for (int_fast32_t iy = iyblock; iy < iyend; ++iy) {
+          const int_fast32_t index000 = ix * strides[0] + iy * strides[1];
+          if (ix < _number_of_cells[0] - 1) {
+            hydro.do_pencil_flux_calculation(
+                0, &_hydro_variables[index000],
+                &_hydro_variables[index000 + strides[0]], _number_of_cells[2],
+                _cell_size[0], _cell_areas[0], dt, pencil, prediction_dt);
+          }
+          if (iy < _number_of_cells[1] - 1) {
+            hydro.do_pencil_flux_calculation(
+                1, &_hydro_variables[index000],
+                &_hydro_variables[index000 + strides[1]], _number_of_cells[2],
+                _cell_size[1], _cell_areas[1], dt, pencil, prediction_dt);
+          }
+          hydro.do_pencil_flux_calculation(
+              2, &_hydro_variables[index000], &_hydro_variables[index000 + 1],
+              _number_of_cells[2] - 1, _cell_size[2], _cell_areas[2], dt,
+              pencil, prediction_dt);
+        }
+      }
+    }
+
+    // interfaces at the subgrid boundaries
+    // these are computed using predicted copies of the cells, so that the
+    // neighbouring subgrid is not changed
+    for (int_fast32_t direction = TRAVELDIRECTION_FACE_X_P;
+         direction <= TRAVELDIRECTION_FACE_Z_N; ++direction) {
+      const uint_fast8_t i = (direction - TRAVELDIRECTION_FACE_X_P) / 2;
+      const int_fast8_t orientation =
+          ((direction - TRAVELDIRECTION_FACE_X_P) % 2 == 0) ? 1 : -1;
+      const uint_fast8_t i1 = (i + 1) % 3;
+      const uint_fast8_t i2 = (i + 2) % 3;
+      const HydroDensitySubGrid *neighbour =
+          neighbours[direction - TRAVELDIRECTION_FACE_X_P];
+      CoordinateVector<> offset;
+      offset[i] = orientation * _cell_size[i];
+
+      int_fast32_t cell[3];
+      cell[i] = (orientation > 0) ? _number_of_cells[i] - 1 : 0;
+      for (cell[i1] = 0; cell[i1] < _number_of_cells[i1]; ++cell[i1]) {
+        for (cell[i2] = 0; cell[i2] < _number_of_cells[i2]; ++cell[i2]) {
+          const int_fast32_t index =
+              cell[0] * strides[0] + cell[1] * strides[1] + cell[2];
+          HydroVariables &state = _hydro_variables[index];
+
+          HydroVariables this_copy;
+          hydro.get_predicted_flux_state(state, prediction_dt, this_copy);
+          if (neighbour != nullptr) {
+            // the neighbouring subgrid can be doing its own flux sweep, so we
+            // cannot copy the full neighbouring cell (its conserved variable
+            // changes might be written to concurrently)
+            const int_fast32_t ngb_index =
+                index - orientation * (_number_of_cells[i] - 1) * strides[i];
+            HydroVariables ngb_copy;
+            hydro.get_predicted_flux_state(
+                neighbour->_hydro_variables[ngb_index], prediction_dt,
+                ngb_copy);
+            if (orientation > 0) {
+              hydro.do_flux_calculation(i, this_copy, ngb_copy, _cell_size[i],
+                                        _cell_areas[i], dt);
+            } else {
+              hydro.do_flux_calculation(i, ngb_copy, this_copy, _cell_size[i],
+                                        _cell_areas[i], dt);
+            }
+          } else {
+            hydro.do_ghost_flux_calculation(
+                i, get_cell_midpoint(index) + offset, this_copy,
+                boundary_manager.get_boundary_condition(direction),
+                orientation * _cell_size[i], _cell_areas[i], dt);
+          }
+          for (uint_fast8_t j = 0; j < 5; ++j) {
+            state.delta_conserved(j) += this_copy.delta_conserved(j);
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Update the conserved and primitive variables for all cells in the
+   * subgrid in a single pass (fused hydro mode).
+   *
+   * @param hydro Hydro instance to use.
+   * @param timestep Integration time step size (in s).
+   */
+  inline void fused_update(const Hydro &hydro, const double timestep) {
+
+    const int_fast32_t tot_num_cells =
+        _number_of_cells[0] * _number_of_cells[3];
+    for (int_fast32_t i = 0; i < tot_num_cells; ++i) {
+      update_cell_conserved_variables(i, timestep);
+      hydro.set_primitive_variables(
+          _hydro_variables[i], _ionization_variables[i], _inverse_cell_volume);
+    }
+  }
+
   /**
    * @brief Set the hydro task with the given index.
    *
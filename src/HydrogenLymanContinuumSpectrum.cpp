@@ -119,6 +119,17 @@ HydrogenLymanContinuumSpectrum::HydrogenLymanContinuumSpectrum(
                                   [HYDROGENLYMANCONTINUUMSPECTRUM_NUMFREQ - 1];
     }
   }
+
+  // set up the guide tables for the temperature bins and for the cumulative
+  // distribution in every temperature bin
+  _temperature_guide_table.initialize(_temperature.data(),
+                                      HYDROGENLYMANCONTINUUMSPECTRUM_NUMTEMP);
+  _guide_tables.resize(HYDROGENLYMANCONTINUUMSPECTRUM_NUMTEMP);
+  for (uint_fast32_t iT = 0; iT < HYDROGENLYMANCONTINUUMSPECTRUM_NUMTEMP;
+       ++iT) {
+    _guide_tables[iT].initialize(_cumulative_distribution[iT].data(),
+                                 HYDROGENLYMANCONTINUUMSPECTRUM_NUMFREQ);
+  }
 }
 
 /**
@@ -136,15 +147,13 @@ HydrogenLymanContinuumSpectrum::HydrogenLymanContinuumSpectrum(
 double HydrogenLymanContinuumSpectrum::get_random_frequency(
     RandomGenerator &random_generator, double temperature) const {
 
-  const uint_fast32_t iT = Utilities::locate(
-      temperature, _temperature.data(), HYDROGENLYMANCONTINUUMSPECTRUM_NUMTEMP);
+  const uint_fast32_t iT =
+      _temperature_guide_table.locate(temperature, _temperature.data());
   const double x = random_generator.get_uniform_random_double();
   const uint_fast32_t inu1 =
-      Utilities::locate(x, _cumulative_distribution[iT].data(),
-                        HYDROGENLYMANCONTINUUMSPECTRUM_NUMFREQ);
+      _guide_tables[iT].locate(x, _cumulative_distribution[iT].data());
   const uint_fast32_t inu2 =
-      Utilities::locate(x, _cumulative_distribution[iT + 1].data(),
-                        HYDROGENLYMANCONTINUUMSPECTRUM_NUMFREQ);
+      _guide_tables[iT + 1].locate(x, _cumulative_distribution[iT + 1].data());
   const double frequency =
       _frequency[inu1] + (temperature - _temperature[iT]) *
                              (_frequency[inu2] - _frequency[inu1]) /
@@ -27,6 +27,7 @@
 #ifndef HYDROGENLYMANCONTINUUMSPECTRUM_HPP
 #define HYDROGENLYMANCONTINUUMSPECTRUM_HPP
 
+#include "GuideTable.hpp"
 #include "PhotonSourceSpectrum.hpp"
 #include "RandomGenerator.hpp"
 
@@ -61,6 +62,14 @@ private:
   /*! @brief Cumulative distribution function. */
   std::vector< std::vector< double > > _cumulative_distribution;
 
+  /*! @brief Guide table used to locate temperatures in the temperature
+   *  bins. */
+  GuideTable _temperature_guide_table;
+
+  /*! @brief Guide tables used to invert the cumulative distribution function
+   *  for every temperature bin. */
+  std::vector< GuideTable > _guide_tables;
+
 public:
   HydrogenLymanContinuumSpectrum(const CrossSections &cross_sections);
 
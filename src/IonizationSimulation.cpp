@@ -31,6 +31,7 @@
 #include "CrossSectionsFactory.hpp"
 #include "DensityFunctionFactory.hpp"
 #include "DensityGridFactory.hpp"
+#include "DensityGridReductionPipeline.hpp"
 #include "DensityGridWriterFactory.hpp"
 #include "DensityMaskFactory.hpp"
 #include "IonizationVariablesPropertyAccessors.hpp"
@@ -118,7 +119,10 @@ IonizationSimulation::IonizationSimulation(const bool write_output,
           "IonizationSimulation:number of photons first loop",
           _number_of_photons)),
       _abundance_model(AbundanceModelFactory::generate(_parameter_file, log)),
-      _abundances(_abundance_model->get_abundances()) {
+      _abundances(_abundance_model->get_abundances()),
+      _convergence_controller(_number_of_photons, _parameter_file),
+      _warm_start(false), _is_warm_started(false),
+      _number_of_completed_iterations(0) {
 
   function_start_timers();
 
@@ -173,6 +177,10 @@ IonizationSimulation::IonizationSimulation(const bool write_output,
     cmac_error("No spectrum provided for the continuous photon sources!");
   }
 
+  CrossSectionsFactory::add_discrete_frequencies(
+      *_cross_sections, _photon_source_spectrum,
+      _continuous_photon_source_spectrum);
+
   // create the actual photon source objects that emits the UV photons
   _photon_source = new PhotonSource(
       _photon_source_distribution, _photon_source_spectrum,
@@ -230,6 +238,126 @@ IonizationSimulation::IonizationSimulation(const bool write_output,
   function_stop_timers();
 }
 
+/**
+ * @brief Store the temperature and ionic fractions of all cells, so that they
+ * can be used as the initial state of the next run.
+ */
+void IonizationSimulation::store_state() {
+
+  const size_t stride = NUMBER_OF_IONNAMES + 1;
+  _previous_state.resize(_density_grid->get_number_of_cells() * stride);
+  size_t index = 0;
+  for (auto it = _density_grid->begin(); it != _density_grid->end(); ++it) {
+    const IonizationVariables &ionization_variables =
+        it.get_ionization_variables();
+    _previous_state[index] = ionization_variables.get_temperature();
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      _previous_state[index + 1 + ion] =
+          ionization_variables.get_ionic_fraction(ion);
+    }
+    index += stride;
+  }
+}
+
+/**
+ * @brief Overwrite the temperature and ionic fractions of all cells with the
+ * values stored at the end of the previous run.
+ *
+ * @return True if the state was restored, false if no compatible state is
+ * available (no previous run, or the number of cells changed).
+ */
+bool IonizationSimulation::restore_state() {
+
+  const size_t stride = NUMBER_OF_IONNAMES + 1;
+  if (_previous_state.size() == 0 ||
+      _previous_state.size() != _density_grid->get_number_of_cells() * stride) {
+    return false;
+  }
+
+  size_t index = 0;
+  for (auto it = _density_grid->begin(); it != _density_grid->end(); ++it) {
+    IonizationVariables &ionization_variables = it.get_ionization_variables();
+    ionization_variables.set_temperature(_previous_state[index]);
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      ionization_variables.set_ionic_fraction(
+          ion, _previous_state[index + 1 + ion]);
+    }
+    index += stride;
+  }
+  return true;
+}
+
+/**
+ * @brief Compute the changes in the hydrogen neutral fraction and the
+ * temperature since the last call to this function, and store the current
+ * values as reference for the next call.
+ *
+ * @return Changes of all cells.
+ */
+ConvergenceController::Changes IonizationSimulation::compute_changes() {
+
+  _previous_iteration_state.resize(2 * _density_grid->get_number_of_cells(),
+                                   0.);
+  ConvergenceController::Changes changes;
+  size_t index = 0;
+  for (auto it = _density_grid->begin(); it != _density_grid->end(); ++it) {
+    const IonizationVariables &ionization_variables =
+        it.get_ionization_variables();
+    const double xH = ionization_variables.get_ionic_fraction(ION_H_n);
+    const double T = ionization_variables.get_temperature();
+    changes.accumulate(_previous_iteration_state[index], xH,
+                       _previous_iteration_state[index + 1], T);
+    _previous_iteration_state[index] = xH;
+    _previous_iteration_state[index + 1] = T;
+    index += 2;
+  }
+  return changes;
+}
+
+/**
+ * @brief Enable or disable warm starts.
+ *
+ * If warm starts are enabled, the grid keeps the temperature and ionization
+ * state at the end of every run, and the next run starts from this state
+ * instead of from the initial state set by the DensityFunction. This is
+ * useful if the simulation is run repeatedly for a slowly evolving density
+ * field, e.g. when it is coupled to a hydrodynamics code via the library
+ * interface.
+ *
+ * A warm started run does not use the reduced number of photons for the
+ * first iteration, and continues the iteration count of the previous run, so
+ * that the temperature calculation is active from the first iteration. It also
+ * continues with the number of photons that the ConvergenceController used at
+ * the end of the previous run.
+ *
+ * If warm starts are enabled after a run was done, the next run starts from
+ * the final state of that run.
+ *
+ * @param warm_start Enable warm starts?
+ */
+void IonizationSimulation::set_warm_start(const bool warm_start) {
+  _warm_start = warm_start;
+  if (_warm_start) {
+    // if we already did a run, the grid still contains its final state
+    if (_number_of_completed_iterations > 0) {
+      store_state();
+    }
+  } else {
+    _previous_state.clear();
+  }
+}
+
+/**
+ * @brief Get the total number of iterations performed since the last cold
+ * start.
+ *
+ * @return Number of iterations performed by the last run that was not warm
+ * started and all warm started runs after it.
+ */
+uint_fast32_t IonizationSimulation::get_number_of_completed_iterations() const {
+  return _number_of_completed_iterations;
+}
+
 /**
  * @brief Initialize the simulation.
  *
@@ -305,6 +433,17 @@ void IonizationSimulation::initialize(DensityFunction *density_function) {
     stop_parallel_timing_block();
   }
 
+  // if warm starts are enabled, replace the initial temperatures and ionic
+  // fractions with the state at the end of the previous run
+  _is_warm_started = _warm_start && restore_state();
+  if (_is_warm_started) {
+    if (_log) {
+      _log->write_status("Warm starting from the state of the previous run.");
+    }
+  } else {
+    _number_of_completed_iterations = 0;
+  }
+
   // if necessary, initialize and apply the density mask
   if (_density_mask != nullptr) {
     if (_log) {
@@ -349,30 +488,39 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
   } else {
     block = std::make_pair(0, _density_grid->get_number_of_cells());
   }
-  std::pair< DensityGrid::iterator, DensityGrid::iterator > local_chunk =
-      _density_grid->get_chunk(block.first, block.second);
+
+  const bool check_convergence =
+      _convergence_controller.is_active(_trackers != nullptr);
+  if (check_convergence) {
+    _convergence_controller.start_run();
+    // store the initial state as reference for the first iteration
+    compute_changes();
+  }
 
   _time_log.start("photoionization");
   // finally: the actual program loop whereby the density grid is ray traced
   // using photon packets generated by the stellar sources
   uint_fast32_t loop = 0;
+  bool converged = false;
   while (loop < _number_of_iterations) {
 
     if (_log) {
       _log->write_status("Starting loop ", loop, ".");
     }
 
-    uint_fast64_t lnumphoton = _number_of_photons;
+    uint_fast64_t lnumphoton = _convergence_controller.get_number_of_photons();
 
     if (_trackers != nullptr && loop == _number_of_iterations - 1) {
       _trackers->add_trackers(*_density_grid);
       lnumphoton = std::max(lnumphoton, _trackers->get_number_of_photons());
     }
 
-    if (loop == 0) {
+    if (loop == 0 && !_is_warm_started) {
       // overwrite the number of photons for the first loop (might be useful
       // if more than 1 boundary is periodic, since the initial neutral
       // fractions are very low)
+      // a warm started run starts from the previous state, for which the
+      // normal number of photons is appropriate
       lnumphoton = _number_of_photons_init;
     }
 
@@ -452,169 +600,26 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
     }
 
     // reduce the mean intensity integrals and heating terms across all
-    // processes
+    // processes, and compute the new temperatures and ionization state
+    // warm started runs continue the iteration count of the previous run
+    const uint_fast32_t iteration = _number_of_completed_iterations + loop;
     start_parallel_timing_block();
 
-    if (_mpi_communicator) {
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_H_n > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-
-#ifdef HAS_HELIUM
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_He_n > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-#endif
-
-#ifdef HAS_CARBON
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_C_p1 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_C_p2 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-#endif
-
-#ifdef HAS_NITROGEN
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_N_n > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_N_p1 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_N_p2 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-#endif
-
-#ifdef HAS_OXYGEN
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_O_n > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_O_p1 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-#endif
-
-#ifdef HAS_NEON
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_Ne_n > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_Ne_p1 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-#endif
-
-#ifdef HAS_SULPHUR
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_S_p1 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_S_p2 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 MeanIntensityPropertyAccessor< ION_S_p3 > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-#endif
-
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 HeatingPropertyAccessor< HEATINGTERM_H > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-
-#ifdef HAS_HELIUM
-      _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES, double,
-                                 HeatingPropertyAccessor< HEATINGTERM_He > >(
-          _density_grid->begin(), _density_grid->end(), 0);
-#endif
-    }
-
-    _cell_update_timer.start();
-    _temperature_calculator->calculate_temperature(loop, totweight,
-                                                   *_density_grid, block);
-    _cell_update_timer.stop();
-
-    // the calculation above will have changed the ionic fractions, and might
-    // have changed the temperatures
-    // we have to gather these across all processes
-
-    if (_mpi_communicator) {
-      _mpi_communicator->gather< double, TemperaturePropertyAccessor >(
-          _density_grid->begin(), _density_grid->end(), local_chunk.first,
-          local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_H_n > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-
-#ifdef HAS_HELIUM
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_He_n > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-#endif
-
-#ifdef HAS_CARBON
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_C_p1 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_C_p2 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-#endif
-
-#ifdef HAS_NITROGEN
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_N_n > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_N_p1 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_N_p2 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-#endif
-
-#ifdef HAS_OXYGEN
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_O_n > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_O_p1 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-#endif
-
-#ifdef HAS_NEON
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_Ne_n > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_Ne_p1 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-#endif
-
-#ifdef HAS_SULPHUR
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_S_p1 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_S_p2 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-      _mpi_communicator
-          ->gather< double, IonicFractionPropertyAccessor< ION_S_p3 > >(
-              _density_grid->begin(), _density_grid->end(), local_chunk.first,
-              local_chunk.second, 0);
-#endif
+    if (_mpi_communicator && _mpi_communicator->get_size() > 1) {
+      // the reduction is done in chunks, and the local cells in every chunk
+      // are updated as soon as the chunk has been reduced
+      // the resulting temperatures and ionic fractions are then gathered in
+      // chunks as well
+      DensityGridReductionPipeline pipeline(
+          *_density_grid, *_temperature_calculator, iteration, totweight,
+          block, _cell_update_timer, _grid_communication_timer);
+      pipeline.reduce_and_update(*_mpi_communicator);
+      pipeline.gather(*_mpi_communicator);
+    } else {
+      _cell_update_timer.start();
+      _temperature_calculator->calculate_temperature(iteration, totweight,
+                                                     *_density_grid, block);
+      _cell_update_timer.stop();
     }
 
     stop_parallel_timing_block();
@@ -634,8 +639,27 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
     //      emissivity_calculator.calculate_emissivities(*grid);
     //    }
 
+    if (check_convergence) {
+      // the initial state of a cold start is only a guess, and barely changes
+      // during the first iteration if it is very transparent
+      _convergence_controller.update(
+          compute_changes(),
+          _temperature_calculator->allows_convergence(iteration) &&
+              (loop > 0 || _is_warm_started),
+          _log);
+      converged = _convergence_controller.has_converged();
+      _convergence_controller.add_metrics(_parameter_file);
+    }
+
     ++loop;
 
+    if (converged) {
+      if (_log) {
+        _log->write_status("Converged after ", loop, " iterations, stopping.");
+      }
+      break;
+    }
+
     if (_density_grid_writer && _every_iteration_output &&
         loop < _number_of_iterations) {
       _density_grid_writer->write(*_density_grid, loop, _parameter_file);
@@ -643,24 +667,29 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
   }
   _time_log.end("photoionization");
 
-  if (_log && loop == _number_of_iterations) {
+  if (_log && !converged) {
     _log->write_status("Maximum number of iterations (", _number_of_iterations,
                        ") reached, stopping.");
   }
 
+  _number_of_completed_iterations += loop;
+  if (_warm_start) {
+    store_state();
+  }
+
   if (_trackers != nullptr) {
     _trackers->output_trackers();
   }
 
   // write final snapshot
+  // its index is the number of iterations that was actually done, which is
+  // smaller than the maximum if the run converged
   if (_density_grid_writer) {
-    _density_grid_writer->write(*_density_grid, _number_of_iterations,
-                                _parameter_file);
+    _density_grid_writer->write(*_density_grid, loop, _parameter_file);
   }
   if (density_grid_writer) {
     _time_log.start("Reverse mapping");
-    density_grid_writer->write(*_density_grid, _number_of_iterations,
-                               _parameter_file);
+    density_grid_writer->write(*_density_grid, loop, _parameter_file);
     _time_log.end("Reverse mapping");
   }
 
@@ -671,6 +700,12 @@ void IonizationSimulation::run(DensityGridWriter *density_grid_writer) {
     _log->write_status(
         "Total cell update time: ",
         Utilities::human_readable_time(_cell_update_timer.value()), ".");
+    if (_mpi_communicator && _mpi_communicator->get_size() > 1) {
+      _log->write_status(
+          "Total grid communication time: ",
+          Utilities::human_readable_time(_grid_communication_timer.value()),
+          ".");
+    }
   }
 
   _time_log.end("IonizationSimulation:run()");
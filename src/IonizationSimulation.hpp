@@ -29,6 +29,7 @@
 #include "AbundanceModel.hpp"
 #include "Abundances.hpp"
 #include "ChargeTransferRates.hpp"
+#include "ConvergenceController.hpp"
 #include "IonizationPhotonShootJobMarket.hpp"
 #include "LineCoolingData.hpp"
 #include "ParameterFile.hpp"
@@ -36,6 +37,7 @@
 #include "Timer.hpp"
 
 #include <string>
+#include <vector>
 
 class ContinuousPhotonSource;
 class CrossSections;
@@ -172,6 +174,10 @@ private:
   /*! @brief Abundances. */
   const Abundances _abundances;
 
+  /*! @brief Convergence driven control of the number of iterations and the
+   *  number of photons. */
+  ConvergenceController _convergence_controller;
+
   /// internal timers
 
   /*! @brief Timer for the time spent in photon propagations. */
@@ -180,6 +186,10 @@ private:
   /*! @brief Timer for the time spent in cell updates. */
   Timer _cell_update_timer;
 
+  /*! @brief Timer for the time spent in the MPI communication of the cell
+   *  variables after every iteration. */
+  Timer _grid_communication_timer;
+
   /*! @brief Timer to quantify time spent in serial parts of the code .*/
   Timer _serial_timer;
 
@@ -192,6 +202,32 @@ private:
   /*! @brief Time log. */
   TimeLogger _time_log;
 
+  /// persistent state used to warm start consecutive runs
+
+  /*! @brief Should consecutive runs start from the ionization and temperature
+   *  state at the end of the previous run? */
+  bool _warm_start;
+
+  /*! @brief Did the last call to initialize() restore the state of the
+   *  previous run? */
+  bool _is_warm_started;
+
+  /*! @brief Total number of iterations performed since the last cold start.
+   */
+  uint_fast32_t _number_of_completed_iterations;
+
+  /*! @brief Temperature and ionic fractions of all cells at the end of the
+   *  previous run, stored per cell. */
+  std::vector< double > _previous_state;
+
+  /*! @brief Hydrogen neutral fraction and temperature of all cells before the
+   *  current iteration, stored per cell. */
+  std::vector< double > _previous_iteration_state;
+
+  void store_state();
+  bool restore_state();
+  ConvergenceController::Changes compute_changes();
+
 public:
   IonizationSimulation(const bool write_output,
                        const bool every_iteration_output,
@@ -201,6 +237,9 @@ public:
                        MPICommunicator *mpi_communicator = nullptr,
                        Log *log = nullptr);
 
+  void set_warm_start(const bool warm_start);
+  uint_fast32_t get_number_of_completed_iterations() const;
+
   void initialize(DensityFunction *density_function = nullptr);
   void run(DensityGridWriter *density_grid_writer = nullptr);
 
@@ -512,6 +512,28 @@ void IonizationStateCalculator::calculate_ionization_state(
     const double totweight, DensityGrid &grid,
     std::pair< cellsize_t, cellsize_t > &block) const {
 
+  const IonizationStateCalculatorWorkDistributor workers;
+  calculate_ionization_state(totweight, grid, block, workers);
+}
+
+/**
+ * @brief Compute the ionization state of all cells in the given block, using
+ * the given WorkDistributor.
+ *
+ * Creating a WorkDistributor starts a parallel region, so code that updates a
+ * grid in many small blocks should create a single WorkDistributor and pass
+ * it on to this function for every block.
+ *
+ * @param totweight Total weight off all photons used.
+ * @param grid DensityGrid for which the calculation is done.
+ * @param block Block that should be traversed by the local MPI process.
+ * @param workers WorkDistributor used to do the calculation in parallel.
+ */
+void IonizationStateCalculator::calculate_ionization_state(
+    const double totweight, DensityGrid &grid,
+    std::pair< cellsize_t, cellsize_t > &block,
+    const IonizationStateCalculatorWorkDistributor &workers) const {
+
   // compute the normalization factor for the mean intensity integrals, which
   // depends on the total weight of all photons, and on the volume of each cell
   // the volume of the cell is taken into account on a cell level, since cells
@@ -519,10 +541,6 @@ void IonizationStateCalculator::calculate_ionization_state(
   const double jfac = _luminosity / totweight;
   const double hfac =
       jfac * PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_PLANCK);
-  WorkDistributor<
-      DensityGridTraversalJobMarket< IonizationStateCalculatorFunction >,
-      DensityGridTraversalJob< IonizationStateCalculatorFunction > >
-      workers;
   IonizationStateCalculatorFunction do_calculation(*this, jfac, hfac);
   DensityGridTraversalJobMarket< IonizationStateCalculatorFunction > jobs(
       grid, do_calculation, block);
@@ -28,6 +28,8 @@
 #define IONIZATIONSTATECALCULATOR_HPP
 
 #include "DensityGrid.hpp"
+#include "DensityGridTraversalJobMarket.hpp"
+#include "WorkDistributor.hpp"
 
 class Abundances;
 class ChargeTransferRates;
@@ -139,10 +141,22 @@ public:
     }
   };
 
+  /*! @brief WorkDistributor used to compute the ionization state of the cells
+   *  of a DensityGrid in parallel. */
+  typedef WorkDistributor<
+      DensityGridTraversalJobMarket< IonizationStateCalculatorFunction >,
+      DensityGridTraversalJob< IonizationStateCalculatorFunction > >
+      IonizationStateCalculatorWorkDistributor;
+
   void
   calculate_ionization_state(const double totweight, DensityGrid &grid,
                              std::pair< cellsize_t, cellsize_t > &block) const;
 
+  void calculate_ionization_state(
+      const double totweight, DensityGrid &grid,
+      std::pair< cellsize_t, cellsize_t > &block,
+      const IonizationStateCalculatorWorkDistributor &workers) const;
+
   void calculate_ionization_state(const double totweight,
                                   DensitySubGrid &subgrid) const;
 };
@@ -34,12 +34,21 @@
 #include <iostream>
 #include <sstream>
 
+/*! @brief Number of values per temperature in the collision rate table. */
+#define LINECOOLINGDATA_TABLE_ROW_SIZE                                         \
+  (2 * (LINECOOLINGDATA_NUMFIVELEVELELEMENTS * NUMBER_OF_TRANSITIONS +         \
+        LINECOOLINGDATA_NUMTWOLEVELELEMENTS))
+
 /**
  * @brief Constructor.
  *
  * Initializes the data values.
+ *
+ * @param tabulate Tabulate the temperature dependent part of the collision
+ * rates?
  */
-LineCoolingData::LineCoolingData() {
+LineCoolingData::LineCoolingData(const bool tabulate)
+    : _inverse_log_table_spacing(0.) {
 
   /// some energy conversion constants (for energy differences)
 
@@ -1391,6 +1400,88 @@ LineCoolingData::LineCoolingData() {
 
   _collision_strength_prefactor =
       h * h / (std::sqrt(kb) * std::pow(2. * M_PI * m_e, 1.5));
+
+  /// optional collision rate table
+
+  if (tabulate) {
+    const double logTmin = std::log(LINECOOLINGDATA_TABLE_MINIMUM_TEMPERATURE);
+    const double logTmax = std::log(LINECOOLINGDATA_TABLE_MAXIMUM_TEMPERATURE);
+    const double dlogT = (logTmax - logTmin) / (LINECOOLINGDATA_TABLE_SIZE - 1);
+    _inverse_log_table_spacing = 1. / dlogT;
+
+    // note that we cannot fill _collision_rate_table directly, since
+    // compute_collision_rates() uses the table as soon as it is not empty
+    std::vector< double > table(LINECOOLINGDATA_TABLE_SIZE *
+                                LINECOOLINGDATA_TABLE_ROW_SIZE);
+    for (uint_fast32_t i = 0; i < LINECOOLINGDATA_TABLE_SIZE; ++i) {
+      const double logT = logTmin + i * dlogT;
+      const double T = std::exp(logT);
+      const double Tinv = 1. / T;
+      double *row = &table[i * LINECOOLINGDATA_TABLE_ROW_SIZE];
+      // we use a unit collision strength prefactor, so that the tabulated
+      // values only depend on the temperature
+      for (int_fast32_t element = 0;
+           element < LINECOOLINGDATA_NUMFIVELEVELELEMENTS; ++element) {
+        double collision_rate_down[NUMBER_OF_TRANSITIONS];
+        double collision_rate_up[NUMBER_OF_TRANSITIONS];
+        compute_collision_rates(element, 1., T, Tinv, logT,
+                                collision_rate_down, collision_rate_up);
+        for (int_fast32_t j = 0; j < NUMBER_OF_TRANSITIONS; ++j) {
+          row[2 * (element * NUMBER_OF_TRANSITIONS + j)] =
+              collision_rate_down[j];
+          row[2 * (element * NUMBER_OF_TRANSITIONS + j) + 1] =
+              collision_rate_up[j];
+        }
+      }
+      for (int_fast32_t j = 0; j < LINECOOLINGDATA_NUMTWOLEVELELEMENTS; ++j) {
+        const double collision_strength =
+            std::pow(T, 1. + _two_level_collision_strength[j][0]) *
+            (_two_level_collision_strength[j][1] +
+             _two_level_collision_strength[j][2] * Tinv +
+             _two_level_collision_strength[j][3] * logT +
+             _two_level_collision_strength[j][4] * T *
+                 (1. + (_two_level_collision_strength[j][5] - 1.) *
+                           std::pow(T, _two_level_collision_strength[j][6])));
+        const size_t offset =
+            2 * (LINECOOLINGDATA_NUMFIVELEVELELEMENTS * NUMBER_OF_TRANSITIONS +
+                 j);
+        row[offset] = collision_strength;
+        row[offset + 1] =
+            collision_strength *
+            std::exp(-_two_level_energy_difference[j] * Tinv);
+      }
+    }
+    _collision_rate_table.swap(table);
+  }
+}
+
+/**
+ * @brief Get the position of the given temperature in the collision rate
+ * table.
+ *
+ * @param logT Natural logarithm of the temperature in K.
+ * @param index Variable to store the index of the lower table row in.
+ * @param fraction Variable to store the relative distance to the lower table
+ * row in.
+ * @return True if the temperature is inside the table range, false if the
+ * collision rates need to be computed explicitly.
+ */
+bool LineCoolingData::get_table_position(const double logT,
+                                         uint_fast32_t &index,
+                                         double &fraction) const {
+
+  if (_collision_rate_table.empty()) {
+    return false;
+  }
+  const double u =
+      (logT - std::log(LINECOOLINGDATA_TABLE_MINIMUM_TEMPERATURE)) *
+      _inverse_log_table_spacing;
+  if (!(u >= 0. && u < LINECOOLINGDATA_TABLE_SIZE - 1)) {
+    return false;
+  }
+  index = static_cast< uint_fast32_t >(u);
+  fraction = u - index;
+  return true;
 }
 
 /**
@@ -1555,8 +1646,103 @@ int LineCoolingData::solve_system_of_linear_equations(double A[5][5],
 }
 
 /**
- * @brief Find the level populations for the given element at the given
- * temperature.
+ * @brief Solve a batch of LINECOOLINGDATA_BATCH_WIDTH independent systems of 5
+ * coupled linear equations.
+ *
+ * This is the same algorithm as solve_system_of_linear_equations(), but with
+ * the systems stored in structure of arrays layout: the last index of both
+ * matrices is the index of the system. Row interchanges are done using selects
+ * instead of branches, so that all operations are performed on all systems at
+ * once and the innermost loops can be vectorised. The result for every system
+ * is bitwise identical to the result of solve_system_of_linear_equations().
+ *
+ * @param A Elements of the matrices @f$A@f$.
+ * @param B Elements of the matrices @f$B@f$, and elements of the solutions on
+ * exit.
+ * @return Exit code: 0 on success. If a non zero value is returned, bit i is
+ * set for every system i that is singular. The values stored in B for these
+ * systems are meaningless and should not be used.
+ */
+int LineCoolingData::solve_systems_of_linear_equations(
+    double A[5][5][LINECOOLINGDATA_BATCH_WIDTH],
+    double B[5][LINECOOLINGDATA_BATCH_WIDTH]) {
+
+  int status = 0;
+  for (uint_fast8_t j = 0; j < 5; ++j) {
+    // find the next row with the largest coefficient
+    uint_fast8_t imax[LINECOOLINGDATA_BATCH_WIDTH];
+    double Amax[LINECOOLINGDATA_BATCH_WIDTH];
+    for (uint_fast8_t l = 0; l < LINECOOLINGDATA_BATCH_WIDTH; ++l) {
+      imax[l] = 0;
+      Amax[l] = 0.;
+    }
+    for (uint_fast8_t i = j; i < 5; ++i) {
+      for (uint_fast8_t l = 0; l < LINECOOLINGDATA_BATCH_WIDTH; ++l) {
+        const bool larger = std::abs(A[i][j][l]) > std::abs(Amax[l]);
+        Amax[l] = larger ? A[i][j][l] : Amax[l];
+        imax[l] = larger ? i : imax[l];
+      }
+    }
+    // check that the matrices are non-singular
+    double Amax_inv[LINECOOLINGDATA_BATCH_WIDTH];
+    for (uint_fast8_t l = 0; l < LINECOOLINGDATA_BATCH_WIDTH; ++l) {
+      status |= (Amax[l] == 0.) << l;
+      Amax_inv[l] = 1. / ((Amax[l] == 0.) ? 1. : Amax[l]);
+    }
+    // interchange rows where necessary
+    for (uint_fast8_t i = j + 1; i < 5; ++i) {
+      for (uint_fast8_t k = 0; k < 5; ++k) {
+        for (uint_fast8_t l = 0; l < LINECOOLINGDATA_BATCH_WIDTH; ++l) {
+          const double Aj = A[j][k][l];
+          const double Ai = A[i][k][l];
+          A[j][k][l] = (imax[l] == i) ? Ai : Aj;
+          A[i][k][l] = (imax[l] == i) ? Aj : Ai;
+        }
+      }
+      for (uint_fast8_t l = 0; l < LINECOOLINGDATA_BATCH_WIDTH; ++l) {
+        const double Bj = B[j][l];
+        const double Bi = B[i][l];
+        B[j][l] = (imax[l] == i) ? Bi : Bj;
+        B[i][l] = (imax[l] == i) ? Bj : Bi;
+      }
+    }
+    for (uint_fast8_t k = 0; k < 5; ++k) {
+      for (uint_fast8_t l = 0; l < LINECOOLINGDATA_BATCH_WIDTH; ++l) {
+        A[j][k][l] *= Amax_inv[l];
+      }
+    }
+    for (uint_fast8_t l = 0; l < LINECOOLINGDATA_BATCH_WIDTH; ++l) {
+      B[j][l] *= Amax_inv[l];
+    }
+    // use row j to eliminate all rows below row j
+    for (uint_fast8_t i = j + 1; i < 5; ++i) {
+      for (uint_fast8_t k = j + 1; k < 5; ++k) {
+        for (uint_fast8_t l = 0; l < LINECOOLINGDATA_BATCH_WIDTH; ++l) {
+          A[i][k][l] -= A[i][j][l] * A[j][k][l];
+        }
+      }
+      for (uint_fast8_t l = 0; l < LINECOOLINGDATA_BATCH_WIDTH; ++l) {
+        B[i][l] -= A[i][j][l] * B[j][l];
+      }
+    }
+  }
+  // back substitution
+  for (uint_fast8_t i = 0; i < 4; ++i) {
+    for (uint_fast8_t j = 0; j < i + 1; ++j) {
+      for (uint_fast8_t l = 0; l < LINECOOLINGDATA_BATCH_WIDTH; ++l) {
+        B[3 - i][l] -= B[4 - j][l] * A[3 - i][4 - j][l];
+      }
+    }
+  }
+  return status;
+}
+
+/**
+ * @brief Compute the collision rates for all transitions of the given element
+ * at the given temperature.
+ *
+ * If the collision rates are tabulated and the temperature is within the table
+ * range, the rates are interpolated on the table.
  *
  * @param element LineCoolingDataFiveLevelElement.
  * @param collision_strength_prefactor Prefactor for the collision strengths
@@ -1564,27 +1750,34 @@ int LineCoolingData::solve_system_of_linear_equations(double A[5][5],
  * @param T Temperature (in K).
  * @param Tinv Inverse of the temperature (in K^-1).
  * @param logT Natural logarithm of the temperature in K.
- * @param level_populations Array to store the resulting level populations in.
+ * @param collision_rate_down Array to store the deexcitation rates in
+ * (in s^-1).
+ * @param collision_rate_up Array to store the excitation rates in (in s^-1).
  */
-void LineCoolingData::compute_level_populations(
+void LineCoolingData::compute_collision_rates(
     const int_fast32_t element, const double collision_strength_prefactor,
     const double T, const double Tinv, const double logT,
-    double level_populations[5]) const {
-
-  double level_matrix[5][5];
-  // initialize the level populations and the first row of the coefficient
-  // matrix
-  for (uint_fast8_t i = 0; i < 5; ++i) {
-    level_matrix[0][i] = 1.;
-    level_populations[i] = 0.;
+    double collision_rate_down[NUMBER_OF_TRANSITIONS],
+    double collision_rate_up[NUMBER_OF_TRANSITIONS]) const {
+
+  uint_fast32_t index;
+  double fraction;
+  if (get_table_position(logT, index, fraction)) {
+    const double *row0 =
+        &_collision_rate_table[index * LINECOOLINGDATA_TABLE_ROW_SIZE +
+                               2 * element * NUMBER_OF_TRANSITIONS];
+    const double *row1 = row0 + LINECOOLINGDATA_TABLE_ROW_SIZE;
+    for (int_fast32_t i = 0; i < NUMBER_OF_TRANSITIONS; ++i) {
+      collision_rate_down[i] =
+          collision_strength_prefactor *
+          (row0[2 * i] + fraction * (row1[2 * i] - row0[2 * i]));
+      collision_rate_up[i] =
+          collision_strength_prefactor *
+          (row0[2 * i + 1] + fraction * (row1[2 * i + 1] - row0[2 * i + 1]));
+    }
+    return;
   }
-  // the first row of the coefficient matrix expresses the constant number of
-  // particles: the sum of all level populations is unity
-  level_populations[0] = 1.;
 
-  // precompute the collision rates for the given temperature
-  double collision_rate_down[NUMBER_OF_TRANSITIONS];
-  double collision_rate_up[NUMBER_OF_TRANSITIONS];
   for (int_fast32_t i = 0; i < NUMBER_OF_TRANSITIONS; ++i) {
     const double collision_strength =
         collision_strength_prefactor *
@@ -1601,6 +1794,30 @@ void LineCoolingData::compute_level_populations(
         collision_strength *
         std::exp(-_five_level_energy_difference[element][i] * Tinv);
   }
+}
+
+/**
+ * @brief Set up the coefficient matrix for the level population equations of
+ * the given element.
+ *
+ * The first row of the matrix expresses the constant number of particles, the
+ * other rows correspond to equations (3.27) and (3.28) in Osterbrock & Ferland
+ * (2006).
+ *
+ * @param element LineCoolingDataFiveLevelElement.
+ * @param collision_rate_down Deexcitation rates for all transitions (in s^-1).
+ * @param collision_rate_up Excitation rates for all transitions (in s^-1).
+ * @param level_matrix Coefficient matrix.
+ */
+void LineCoolingData::get_level_matrix(
+    const int_fast32_t element,
+    const double collision_rate_down[NUMBER_OF_TRANSITIONS],
+    const double collision_rate_up[NUMBER_OF_TRANSITIONS],
+    double level_matrix[5][5]) const {
+
+  for (uint_fast8_t i = 0; i < 5; ++i) {
+    level_matrix[0][i] = 1.;
+  }
 
   level_matrix[1][0] = collision_rate_up[TRANSITION_0_to_1] *
                        _five_level_inverse_statistical_weight[element][0];
@@ -1683,6 +1900,91 @@ void LineCoolingData::compute_level_populations(
              collision_rate_down[TRANSITION_1_to_4] +
              collision_rate_down[TRANSITION_2_to_4] +
              collision_rate_down[TRANSITION_3_to_4]));
+}
+
+/**
+ * @brief Get the line cooling for the given five level element, given its
+ * level populations.
+ *
+ * This corresponds to equation (3.29) in Osterbrock & Ferland (2006), without
+ * the Boltzmann constant and abundance.
+ *
+ * @param element LineCoolingDataFiveLevelElement.
+ * @param level_populations Level populations.
+ * @param stride Distance between consecutive level populations in the array
+ * (LINECOOLINGDATA_BATCH_WIDTH for the solution of
+ * solve_systems_of_linear_equations()).
+ * @return Line cooling (in K s^-1).
+ */
+double LineCoolingData::get_five_level_cooling(
+    const int_fast32_t element, const double *level_populations,
+    const uint_fast32_t stride) const {
+
+  const double cl2 =
+      level_populations[1 * stride] *
+      _five_level_transition_probability[element][TRANSITION_0_to_1] *
+      _five_level_energy_difference[element][TRANSITION_0_to_1];
+  const double cl3 =
+      level_populations[2 * stride] *
+      (_five_level_transition_probability[element][TRANSITION_0_to_2] *
+           _five_level_energy_difference[element][TRANSITION_0_to_2] +
+       _five_level_transition_probability[element][TRANSITION_1_to_2] *
+           _five_level_energy_difference[element][TRANSITION_1_to_2]);
+  const double cl4 =
+      level_populations[3 * stride] *
+      (_five_level_transition_probability[element][TRANSITION_0_to_3] *
+           _five_level_energy_difference[element][TRANSITION_0_to_3] +
+       _five_level_transition_probability[element][TRANSITION_1_to_3] *
+           _five_level_energy_difference[element][TRANSITION_1_to_3] +
+       _five_level_transition_probability[element][TRANSITION_2_to_3] *
+           _five_level_energy_difference[element][TRANSITION_2_to_3]);
+  const double cl5 =
+      level_populations[4 * stride] *
+      (_five_level_transition_probability[element][TRANSITION_0_to_4] *
+           _five_level_energy_difference[element][TRANSITION_0_to_4] +
+       _five_level_transition_probability[element][TRANSITION_1_to_4] *
+           _five_level_energy_difference[element][TRANSITION_1_to_4] +
+       _five_level_transition_probability[element][TRANSITION_2_to_4] *
+           _five_level_energy_difference[element][TRANSITION_2_to_4] +
+       _five_level_transition_probability[element][TRANSITION_3_to_4] *
+           _five_level_energy_difference[element][TRANSITION_3_to_4]);
+  return cl2 + cl3 + cl4 + cl5;
+}
+
+/**
+ * @brief Find the level populations for the given element at the given
+ * temperature.
+ *
+ * @param element LineCoolingDataFiveLevelElement.
+ * @param collision_strength_prefactor Prefactor for the collision strengths
+ * (in s^-1).
+ * @param T Temperature (in K).
+ * @param Tinv Inverse of the temperature (in K^-1).
+ * @param logT Natural logarithm of the temperature in K.
+ * @param level_populations Array to store the resulting level populations in.
+ */
+void LineCoolingData::compute_level_populations(
+    const int_fast32_t element, const double collision_strength_prefactor,
+    const double T, const double Tinv, const double logT,
+    double level_populations[5]) const {
+
+  // initialize the level populations
+  // the first row of the coefficient matrix expresses the constant number of
+  // particles: the sum of all level populations is unity
+  level_populations[0] = 1.;
+  for (uint_fast8_t i = 1; i < 5; ++i) {
+    level_populations[i] = 0.;
+  }
+
+  // precompute the collision rates for the given temperature
+  double collision_rate_down[NUMBER_OF_TRANSITIONS];
+  double collision_rate_up[NUMBER_OF_TRANSITIONS];
+  compute_collision_rates(element, collision_strength_prefactor, T, Tinv, logT,
+                          collision_rate_down, collision_rate_up);
+
+  double level_matrix[5][5];
+  get_level_matrix(element, collision_rate_down, collision_rate_up,
+                   level_matrix);
 
   // find level populations
   const int_fast32_t status =
@@ -1717,8 +2019,31 @@ double LineCoolingData::compute_level_population(
 
   // note that we need to remap the element index
   const int_fast32_t i = element - LINECOOLINGDATA_NUMFIVELEVELELEMENTS;
-  const double ksi = _two_level_energy_difference[i];
   const double A = _two_level_transition_probability[i];
+  const double inv_omega_1 = _two_level_inverse_statistical_weight[i][0];
+  const double inv_omega_2 = _two_level_inverse_statistical_weight[i][1];
+
+  uint_fast32_t index;
+  double fraction;
+  if (get_table_position(logT, index, fraction)) {
+    const double *row0 =
+        &_collision_rate_table[index * LINECOOLINGDATA_TABLE_ROW_SIZE +
+                               2 * (LINECOOLINGDATA_NUMFIVELEVELELEMENTS *
+                                        NUMBER_OF_TRANSITIONS +
+                                    i)];
+    const double *row1 = row0 + LINECOOLINGDATA_TABLE_ROW_SIZE;
+    const double collision_rate_down =
+        collision_strength_prefactor *
+        (row0[0] + fraction * (row1[0] - row0[0]));
+    const double collision_rate_up =
+        collision_strength_prefactor *
+        (row0[1] + fraction * (row1[1] - row0[1]));
+    return collision_rate_up * inv_omega_1 /
+           (A + collision_rate_down * inv_omega_2 +
+            collision_rate_up * inv_omega_1);
+  }
+
+  const double ksi = _two_level_energy_difference[i];
   const double collision_strength =
       collision_strength_prefactor *
       std::pow(T, 1. + _two_level_collision_strength[i][0]) *
@@ -1728,8 +2053,6 @@ double LineCoolingData::compute_level_population(
        _two_level_collision_strength[i][4] * T *
            (1. + (_two_level_collision_strength[i][5] - 1.) *
                      std::pow(T, _two_level_collision_strength[i][6])));
-  const double inv_omega_1 = _two_level_inverse_statistical_weight[i][0];
-  const double inv_omega_2 = _two_level_inverse_statistical_weight[i][1];
   const double Texp = std::exp(-ksi * Tinv);
   return collision_strength * Texp * inv_omega_1 /
          (A + collision_strength * (inv_omega_2 + Texp * inv_omega_1));
@@ -1799,36 +2122,8 @@ double LineCoolingData::get_cooling(
 
     // compute the cooling for each transition
     // this corresponds to equation (3.29) in Osterbrock & Ferland (2006)
-    const double cl2 =
-        level_populations[1] *
-        _five_level_transition_probability[element][TRANSITION_0_to_1] *
-        _five_level_energy_difference[element][TRANSITION_0_to_1];
-    const double cl3 =
-        level_populations[2] *
-        (_five_level_transition_probability[element][TRANSITION_0_to_2] *
-             _five_level_energy_difference[element][TRANSITION_0_to_2] +
-         _five_level_transition_probability[element][TRANSITION_1_to_2] *
-             _five_level_energy_difference[element][TRANSITION_1_to_2]);
-    const double cl4 =
-        level_populations[3] *
-        (_five_level_transition_probability[element][TRANSITION_0_to_3] *
-             _five_level_energy_difference[element][TRANSITION_0_to_3] +
-         _five_level_transition_probability[element][TRANSITION_1_to_3] *
-             _five_level_energy_difference[element][TRANSITION_1_to_3] +
-         _five_level_transition_probability[element][TRANSITION_2_to_3] *
-             _five_level_energy_difference[element][TRANSITION_2_to_3]);
-    const double cl5 =
-        level_populations[4] *
-        (_five_level_transition_probability[element][TRANSITION_0_to_4] *
-             _five_level_energy_difference[element][TRANSITION_0_to_4] +
-         _five_level_transition_probability[element][TRANSITION_1_to_4] *
-             _five_level_energy_difference[element][TRANSITION_1_to_4] +
-         _five_level_transition_probability[element][TRANSITION_2_to_4] *
-             _five_level_energy_difference[element][TRANSITION_2_to_4] +
-         _five_level_transition_probability[element][TRANSITION_3_to_4] *
-             _five_level_energy_difference[element][TRANSITION_3_to_4]);
-
-    cooling += abundances[element] * kb * (cl2 + cl3 + cl4 + cl5);
+    cooling += abundances[element] * kb *
+               get_five_level_cooling(element, level_populations, 1);
   }
 
   /// 2 level atoms
@@ -1847,6 +2142,141 @@ double LineCoolingData::get_cooling(
   return cooling;
 }
 
+/**
+ * @brief Get the radiative energy losses due to line cooling for a number of
+ * different temperatures, electron densities and coolant abundances.
+ *
+ * The points are processed in batches of LINECOOLINGDATA_BATCH_WIDTH, so that
+ * the level populations for a single element can be obtained for the entire
+ * batch using solve_systems_of_linear_equations(). The result for every point
+ * is bitwise identical to the result of the single point version of this
+ * method.
+ *
+ * @param number_of_points Number of points.
+ * @param temperature Temperatures (in K).
+ * @param electron_density Electron densities (in m^-3).
+ * @param abundances Abundances of coolants for each point.
+ * @param cooling Array to store the radiative cooling per hydrogen atom for
+ * each point in (in kg m^2s^-3).
+ */
+void LineCoolingData::get_cooling(
+    const uint_fast32_t number_of_points, const double *temperature,
+    const double *electron_density,
+    const double abundances[][LINECOOLINGDATA_NUMELEMENTS],
+    double *cooling) const {
+
+  // Boltzmann constant (in J s^-1)
+  const double kb =
+      PhysicalConstants::get_physical_constant(PHYSICALCONSTANT_BOLTZMANN);
+
+  uint_fast32_t ipoint = 0;
+  while (ipoint < number_of_points) {
+
+    // gather the next batch of points with a non zero electron density
+    uint_fast32_t index[LINECOOLINGDATA_BATCH_WIDTH];
+    uint_fast32_t number_of_lanes = 0;
+    while (ipoint < number_of_points &&
+           number_of_lanes < LINECOOLINGDATA_BATCH_WIDTH) {
+      if (electron_density[ipoint] == 0.) {
+        // see the single point version
+        cooling[ipoint] = 1.e-99;
+      } else {
+        index[number_of_lanes] = ipoint;
+        ++number_of_lanes;
+      }
+      ++ipoint;
+    }
+    if (number_of_lanes == 0) {
+      continue;
+    }
+    // pad the batch with copies of the first point
+    for (uint_fast32_t l = number_of_lanes; l < LINECOOLINGDATA_BATCH_WIDTH;
+         ++l) {
+      index[l] = index[0];
+    }
+
+    double collision_strength_prefactor[LINECOOLINGDATA_BATCH_WIDTH];
+    double Tinv[LINECOOLINGDATA_BATCH_WIDTH];
+    double logT[LINECOOLINGDATA_BATCH_WIDTH];
+    double batch_cooling[LINECOOLINGDATA_BATCH_WIDTH];
+    for (uint_fast32_t l = 0; l < LINECOOLINGDATA_BATCH_WIDTH; ++l) {
+      const double T = temperature[index[l]];
+      collision_strength_prefactor[l] = _collision_strength_prefactor *
+                                        electron_density[index[l]] /
+                                        std::sqrt(T);
+      Tinv[l] = 1. / T;
+      logT[l] = std::log(T);
+      batch_cooling[l] = 0.;
+    }
+
+    /// five level elements
+
+    for (int_fast32_t element = 0;
+         element < LINECOOLINGDATA_NUMFIVELEVELELEMENTS; ++element) {
+
+      double level_matrix[5][5][LINECOOLINGDATA_BATCH_WIDTH];
+      double level_populations[5][LINECOOLINGDATA_BATCH_WIDTH];
+      for (uint_fast32_t l = 0; l < LINECOOLINGDATA_BATCH_WIDTH; ++l) {
+        double collision_rate_down[NUMBER_OF_TRANSITIONS];
+        double collision_rate_up[NUMBER_OF_TRANSITIONS];
+        compute_collision_rates(element, collision_strength_prefactor[l],
+                                temperature[index[l]], Tinv[l], logT[l],
+                                collision_rate_down, collision_rate_up);
+        double lane_matrix[5][5];
+        get_level_matrix(element, collision_rate_down, collision_rate_up,
+                         lane_matrix);
+        for (uint_fast8_t i = 0; i < 5; ++i) {
+          for (uint_fast8_t j = 0; j < 5; ++j) {
+            level_matrix[i][j][l] = lane_matrix[i][j];
+          }
+          level_populations[i][l] = 0.;
+        }
+        level_populations[0][l] = 1.;
+      }
+
+      const int status =
+          solve_systems_of_linear_equations(level_matrix, level_populations);
+      if (status != 0) {
+        uint_fast32_t l = 0;
+        while (!(status & (1 << l))) {
+          ++l;
+        }
+        cmac_error("Singular matrix in level population computation "
+                   "(element: %" PRIiFAST32 ", T: %g, n_e: %g)!",
+                   element, temperature[index[l]],
+                   electron_density[index[l]]);
+      }
+
+      for (uint_fast32_t l = 0; l < LINECOOLINGDATA_BATCH_WIDTH; ++l) {
+        batch_cooling[l] +=
+            abundances[index[l]][element] * kb *
+            get_five_level_cooling(element, &level_populations[0][l],
+                                   LINECOOLINGDATA_BATCH_WIDTH);
+      }
+    }
+
+    /// 2 level atoms
+
+    const int_fast32_t offset = LINECOOLINGDATA_NUMFIVELEVELELEMENTS;
+    for (int_fast32_t i = 0; i < LINECOOLINGDATA_NUMTWOLEVELELEMENTS; ++i) {
+      const int_fast32_t element = i + offset;
+      for (uint_fast32_t l = 0; l < number_of_lanes; ++l) {
+        const double level_population = compute_level_population(
+            element, collision_strength_prefactor[l], temperature[index[l]],
+            Tinv[l], logT[l]);
+        batch_cooling[l] += abundances[index[l]][element] * kb *
+                            _two_level_energy_difference[i] *
+                            _two_level_transition_probability[i] *
+                            level_population;
+      }
+    }
+
+    for (uint_fast32_t l = 0; l < number_of_lanes; ++l) {
+      cooling[index[l]] = batch_cooling[l];
+    }
+  }
+}
+
 /**
  * @brief Calculate the strength of all emission lines for which we have data.
  *
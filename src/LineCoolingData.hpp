@@ -27,9 +27,31 @@
 #ifndef LINECOOLINGDATA_HPP
 #define LINECOOLINGDATA_HPP
 
+#include <cinttypes>
 #include <string>
 #include <vector>
 
+/*! @brief Lower limit of the collision rate table (in K). */
+#ifndef LINECOOLINGDATA_TABLE_MINIMUM_TEMPERATURE
+#define LINECOOLINGDATA_TABLE_MINIMUM_TEMPERATURE 100.
+#endif
+
+/*! @brief Upper limit of the collision rate table (in K). */
+#ifndef LINECOOLINGDATA_TABLE_MAXIMUM_TEMPERATURE
+#define LINECOOLINGDATA_TABLE_MAXIMUM_TEMPERATURE 1.e7
+#endif
+
+/*! @brief Number of temperature values in the collision rate table. */
+#ifndef LINECOOLINGDATA_TABLE_SIZE
+#define LINECOOLINGDATA_TABLE_SIZE 10000
+#endif
+
+/*! @brief Number of level population systems that are solved simultaneously
+ *  by the batched cooling routines. */
+#ifndef LINECOOLINGDATA_BATCH_WIDTH
+#define LINECOOLINGDATA_BATCH_WIDTH 4
+#endif
+
 /**
  * @brief Names of supported five level elements.
  *
@@ -186,6 +208,13 @@ enum LineCoolingDataTransition {
  * the counter element), and initialize the data in the constructor. To compute
  * line strengths, add relevant code to linestr(). Adding new elements will
  * break some unit tests in testLineCoolingData, but should work fine.
+ *
+ * The temperature dependent part of the collision rates (the collision
+ * strength fits and the Boltzmann factors) can optionally be tabulated on a
+ * logarithmic temperature grid. Values within the table range are then linearly
+ * interpolated in log space, which avoids all calls to std::pow and std::exp
+ * during the cooling calculation. Temperatures outside the table range still
+ * use the full expressions.
  */
 class LineCoolingData {
 private:
@@ -230,6 +259,35 @@ private:
    *  \left(2\pi{}m_e\right)^\frac{3}{2}\f$ (in K^0.5 m^3 s^-1). */
   double _collision_strength_prefactor;
 
+  /*! @brief Tabulated collision rates per unit collision strength prefactor
+   *  (empty if the rates are not tabulated). For every temperature, the table
+   *  contains the deexcitation and excitation rate for all transitions of the
+   *  five level elements, followed by the same values for the two level
+   *  elements. */
+  std::vector< double > _collision_rate_table;
+
+  /*! @brief Inverse of the natural logarithmic spacing of the collision rate
+   *  table. */
+  double _inverse_log_table_spacing;
+
+  bool get_table_position(const double logT, uint_fast32_t &index,
+                          double &fraction) const;
+
+  void compute_collision_rates(
+      const int_fast32_t element, const double collision_strength_prefactor,
+      const double T, const double Tinv, const double logT,
+      double collision_rate_down[NUMBER_OF_TRANSITIONS],
+      double collision_rate_up[NUMBER_OF_TRANSITIONS]) const;
+
+  void get_level_matrix(const int_fast32_t element,
+                        const double collision_rate_down[NUMBER_OF_TRANSITIONS],
+                        const double collision_rate_up[NUMBER_OF_TRANSITIONS],
+                        double level_matrix[5][5]) const;
+
+  double get_five_level_cooling(const int_fast32_t element,
+                                const double *level_populations,
+                                const uint_fast32_t stride) const;
+
   void compute_level_populations(const int_fast32_t element,
                                  const double collision_strength_prefactor,
                                  const double T, const double Tinv,
@@ -242,7 +300,15 @@ private:
                                   const double logT) const;
 
 public:
-  LineCoolingData();
+  LineCoolingData(const bool tabulate = false);
+
+  /**
+   * @brief Are the collision rates tabulated?
+   *
+   * @return True if the collision rates are interpolated on a temperature
+   * table.
+   */
+  inline bool is_tabulated() const { return !_collision_rate_table.empty(); }
 
   double get_transition_probability(const int_fast32_t element,
                                     const int_fast32_t transition) const;
@@ -253,10 +319,19 @@ public:
 
   static int solve_system_of_linear_equations(double A[5][5], double B[5]);
 
+  static int solve_systems_of_linear_equations(
+      double A[5][5][LINECOOLINGDATA_BATCH_WIDTH],
+      double B[5][LINECOOLINGDATA_BATCH_WIDTH]);
+
   double
   get_cooling(const double temperature, const double electron_density,
               const double abundances[LINECOOLINGDATA_NUMELEMENTS]) const;
 
+  void get_cooling(const uint_fast32_t number_of_points,
+                   const double *temperature, const double *electron_density,
+                   const double abundances[][LINECOOLINGDATA_NUMELEMENTS],
+                   double *cooling) const;
+
   std::vector< std::vector< double > > get_line_strengths(
       const double temperature, const double electron_density,
       const double abundances[LINECOOLINGDATA_NUMELEMENTS]) const;
@@ -32,6 +32,7 @@
 #include "Error.hpp"
 #include "MPIUtilities.hpp"
 
+#include <algorithm>
 #include <vector>
 
 #ifdef HAVE_MPI
@@ -91,8 +92,12 @@ public:
   /**
    * @brief Constructor.
    *
-   * Calls MPI_Init(), sets up custom error handling, and initializes rank and
-   * size variables.
+   * Calls MPI_Init_thread(), sets up custom error handling, and initializes
+   * rank and size variables.
+   *
+   * We request MPI_THREAD_SERIALIZED support, so that the task-based
+   * algorithms can make MPI calls from within a shared memory parallel region
+   * (as long as only a single thread at a time communicates).
    *
    * @param argc Number of command line arguments passed on to the main program.
    * @param argv Command line arguments passed on to the main program.
@@ -103,11 +108,16 @@ public:
     // MPI_Init is known to cause memory leak detections, so we disable the
     // address sanitizer for all allocations made by it
     NO_LEAK_CHECK_BEGIN
-    int_fast32_t status = MPI_Init(&argc, &argv);
+    int thread_support;
+    int_fast32_t status = MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED,
+                                          &thread_support);
     NO_LEAK_CHECK_END
     if (status != MPI_SUCCESS) {
       cmac_error("Failed to initialize MPI!");
     }
+    if (thread_support < MPI_THREAD_SERIALIZED) {
+      cmac_error("MPI library does not support MPI_THREAD_SERIALIZED!");
+    }
 
     // make sure errors are handled by us, not by the MPI library
     MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
@@ -295,6 +305,39 @@ public:
       return 0;
     }
   }
+
+  /**
+   * @brief Pack the chunk with the given index into its buffer in the ring of
+   * chunk buffers and start its reduction.
+   *
+   * @param number_of_elements Total number of elements to reduce.
+   * @param size Number of elements in a single chunk.
+   * @param ichunk Index of the chunk.
+   * @param buffers Ring of chunk buffers.
+   * @param requests Requests for the chunk buffers.
+   * @param function Function used to pack the chunk.
+   */
+  template < MPIOperatorType _operatortype_, typename _datatype_,
+             typename _function_ >
+  void start_pipelined_reduction(const size_t number_of_elements,
+                                 const size_t size, const size_t ichunk,
+                                 std::vector< _datatype_ > &buffers,
+                                 std::vector< MPI_Request > &requests,
+                                 _function_ &function) const {
+
+    const size_t ibuffer = ichunk % requests.size();
+    const size_t chunk_begin = ichunk * size;
+    const size_t chunk_end = std::min(chunk_begin + size, number_of_elements);
+    _datatype_ *buffer = &buffers[ibuffer * size];
+    function.pack(chunk_begin, chunk_end, buffer);
+    const int_fast32_t status = MPI_Iallreduce(
+        MPI_IN_PLACE, buffer, chunk_end - chunk_begin,
+        MPIUtilities::get_datatype< _datatype_ >(),
+        get_operator(_operatortype_), MPI_COMM_WORLD, &requests[ibuffer]);
+    if (status != MPI_SUCCESS) {
+      cmac_error("Error in MPI_Iallreduce!");
+    }
+  }
 #endif
 
   /**
@@ -490,6 +533,149 @@ public:
 #endif
   }
 
+  /**
+   * @brief Functor that progresses the outstanding pipelined reductions.
+   *
+   * MPI implementations do not necessarily progress non-blocking collectives
+   * in the background. Functions that process a reduced chunk of a pipelined
+   * reduction should hence call this functor regularly, so that the reductions
+   * of the next chunks complete while the current chunk is processed.
+   */
+  class PipelineProgress {
+#ifdef HAVE_MPI
+  private:
+    /*! @brief Requests for the outstanding reductions (can be nullptr). */
+    std::vector< MPI_Request > *_requests;
+
+  public:
+    /**
+     * @brief Constructor.
+     *
+     * @param requests Requests for the outstanding reductions (can be
+     * nullptr).
+     */
+    inline PipelineProgress(std::vector< MPI_Request > *requests = nullptr)
+        : _requests(requests) {}
+#endif
+
+  public:
+    /**
+     * @brief Test all outstanding requests, which gives the MPI library the
+     * opportunity to progress them.
+     */
+    inline void operator()() const {
+#ifdef HAVE_MPI
+      if (_requests == nullptr) {
+        return;
+      }
+      for (size_t i = 0; i < _requests->size(); ++i) {
+        if ((*_requests)[i] != MPI_REQUEST_NULL) {
+          int flag;
+          const int_fast32_t status =
+              MPI_Test(&(*_requests)[i], &flag, MPI_STATUS_IGNORE);
+          if (status != MPI_SUCCESS) {
+            cmac_error("Error in MPI_Test!");
+          }
+        }
+      }
+#endif
+    }
+  };
+
+  /**
+   * @brief Reduce the given number of elements across all processes in chunks
+   * of the given size, and call the given function on every chunk as soon as
+   * its reduction has finished.
+   *
+   * The elements are never stored in a single buffer. Instead, a ring of the
+   * given number of chunk buffers is used: all buffers but one hold a chunk
+   * that is being reduced using a non-blocking collective, while the last
+   * buffer holds the chunk that is being processed. As soon as a chunk has been
+   * reduced, the reduction of the next chunk is started in the buffer that was
+   * freed by the previous chunk, before the reduced chunk is processed.
+   *
+   * The function needs to provide two member functions:
+   * \code{.cpp}
+   *   function.pack(chunk_begin, chunk_end, buffer)
+   *   function.update(chunk_begin, chunk_end, buffer, progress)
+   * \endcode
+   * with chunk_begin and chunk_end the index of the first element of the chunk
+   * and of the first element not part of the chunk, and buffer a pointer to
+   * the chunk buffer. The first function should copy the local values of the
+   * elements into the buffer, while the second function should process the
+   * reduced values. The second function should regularly call progress() (a
+   * PipelineProgress functor) while it processes the chunk.
+   *
+   * @param number_of_elements Total number of elements to reduce.
+   * @param size Number of elements to reduce in a single MPI communication.
+   * @param number_of_buffers Number of chunk buffers (at least 2).
+   * @param function Function used to pack and process the chunks.
+   */
+  template < MPIOperatorType _operatortype_, typename _datatype_,
+             typename _function_ >
+  void reduce_pipelined(const size_t number_of_elements, size_t size,
+                        const uint_fast32_t number_of_buffers,
+                        _function_ &function) const {
+
+    cmac_assert(number_of_buffers > 1);
+
+    if (size == 0) {
+      size = MPICOMMUNICATOR_DEFAULT_BUFFERSIZE;
+    }
+    const size_t number_of_chunks = (number_of_elements + size - 1) / size;
+
+#ifdef HAVE_MPI
+    if (_size > 1) {
+      std::vector< _datatype_ > buffers(number_of_buffers * size);
+      std::vector< MPI_Request > requests(number_of_buffers,
+                                          MPI_REQUEST_NULL);
+      const PipelineProgress progress(&requests);
+      // all processes start the reductions in the same order, which is all
+      // that is required to match them
+      size_t next_chunk = 0;
+      while (next_chunk < number_of_chunks &&
+             next_chunk + 1 < number_of_buffers) {
+        start_pipelined_reduction< _operatortype_ >(
+            number_of_elements, size, next_chunk, buffers, requests, function);
+        ++next_chunk;
+      }
+      for (size_t ichunk = 0; ichunk < number_of_chunks; ++ichunk) {
+        const size_t ibuffer = ichunk % number_of_buffers;
+        const int_fast32_t status =
+            MPI_Wait(&requests[ibuffer], MPI_STATUS_IGNORE);
+        if (status != MPI_SUCCESS) {
+          cmac_error("Error in MPI_Iallreduce!");
+        }
+        // the buffer of the previous chunk is free: reuse it for the next
+        // chunk before we start processing this chunk
+        if (next_chunk < number_of_chunks) {
+          start_pipelined_reduction< _operatortype_ >(
+              number_of_elements, size, next_chunk, buffers, requests,
+              function);
+          ++next_chunk;
+        }
+        const size_t chunk_begin = ichunk * size;
+        const size_t chunk_end =
+            std::min(chunk_begin + size, number_of_elements);
+        function.update(chunk_begin, chunk_end, &buffers[ibuffer * size],
+                        progress);
+      }
+      return;
+    }
+#endif
+
+    // no communication required: process the chunks one by one using a
+    // single buffer
+    std::vector< _datatype_ > buffer(size);
+    const PipelineProgress progress;
+    for (size_t ichunk = 0; ichunk < number_of_chunks; ++ichunk) {
+      const size_t chunk_begin = ichunk * size;
+      const size_t chunk_end = std::min(chunk_begin + size, number_of_elements);
+      function.pack(chunk_begin, chunk_end, &buffer[0]);
+      function.update(chunk_begin, chunk_end, &buffer[0], progress);
+    }
+  }
+
   /**
    * @brief Reduce the elements pointed to by the given begin and end iterator,
    * using the given template property accessor to get and set the relevant
@@ -611,6 +797,68 @@ public:
 #endif
   }
 
+  /**
+   * @brief Gather the given number of elements across all processes in chunks
+   * of the given size, assuming that MPI process i holds the block returned by
+   * distribute_block(i, 0, number_of_elements).
+   *
+   * The elements are never stored in a single buffer. Instead, every chunk of
+   * the block of a process is packed into a single chunk buffer by that
+   * process, and is then broadcast to all other processes.
+   *
+   * The function needs to provide two member functions:
+   * \code{.cpp}
+   *   function.pack(chunk_begin, chunk_end, buffer)
+   *   function.unpack(chunk_begin, chunk_end, buffer)
+   * \endcode
+   * with chunk_begin and chunk_end the index of the first element of the chunk
+   * and of the first element not part of the chunk, and buffer a pointer to
+   * the chunk buffer. The first function is called on the process that holds
+   * the chunk and should copy the values of the elements into the buffer,
+   * while the second function is called on all other processes and should
+   * store the values in the buffer.
+   *
+   * @param number_of_elements Total number of elements to gather.
+   * @param element_size Number of values stored per element.
+   * @param size Number of elements to gather in a single MPI communication.
+   * @param function Function used to pack and unpack the chunks.
+   */
+  template < typename _datatype_, typename _function_ >
+  void gather_chunked(const size_t number_of_elements,
+                      const size_t element_size, size_t size,
+                      _function_ &function) const {
+
+#ifdef HAVE_MPI
+    if (_size > 1) {
+      if (size == 0) {
+        size = MPICOMMUNICATOR_DEFAULT_BUFFERSIZE;
+      }
+      std::vector< _datatype_ > buffer(size * element_size);
+      const MPI_Datatype dtype = MPIUtilities::get_datatype< _datatype_ >();
+      for (int_fast32_t irank = 0; irank < _size; ++irank) {
+        const std::pair< size_t, size_t > block =
+            distribute_block(irank, _size, 0, number_of_elements);
+        for (size_t chunk_begin = block.first; chunk_begin < block.second;
+             chunk_begin += size) {
+          const size_t chunk_end = std::min(chunk_begin + size, block.second);
+          if (irank == _rank) {
+            function.pack(chunk_begin, chunk_end, &buffer[0]);
+          }
+          const int_fast32_t status =
+              MPI_Bcast(&buffer[0], (chunk_end - chunk_begin) * element_size,
+                        dtype, irank, MPI_COMM_WORLD);
+          if (status != MPI_SUCCESS) {
+            cmac_error("Error in MPI_Bcast!");
+          }
+          if (irank != _rank) {
+            function.unpack(chunk_begin, chunk_end, &buffer[0]);
+          }
+        }
+      }
+    }
+#endif
+  }
+
   /**
    * @brief Gather the elements pointed to by the given begin and end iterator,
    * using the given getter member function to obtain an object data member to
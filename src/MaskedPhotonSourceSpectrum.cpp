@@ -83,6 +83,8 @@ MaskedPhotonSourceSpectrum::MaskedPhotonSourceSpectrum(
     _cumulative_distribution[i] *= norm_inv;
   }
 
+  _guide_table.initialize(_cumulative_distribution.data(), number_of_bins);
+
   // apply the mask to the total ionizing flux
   _ionizing_flux =
       norm * unmasked_spectrum->get_total_flux() / number_of_samples;
@@ -124,14 +126,25 @@ double MaskedPhotonSourceSpectrum::get_random_frequency(
     RandomGenerator &random_generator, double temperature) const {
 
   const double x = random_generator.get_uniform_random_double();
-  const uint_fast32_t inu = Utilities::locate(
-      x, _cumulative_distribution.data(), _frequency_bins.size());
-  const double frequency =
-      _frequency_bins[inu] +
-      (_frequency_bins[inu + 1] - _frequency_bins[inu]) *
-          (x - _cumulative_distribution[inu]) /
-          (_cumulative_distribution[inu + 1] - _cumulative_distribution[inu]);
-  return frequency;
+  return _guide_table.sample_linear(x, _cumulative_distribution.data(),
+                                    _frequency_bins.data());
+}
+
+/**
+ * @brief Get a number of random frequencies from the spectrum.
+ *
+ * @param random_generator RandomGenerator to use.
+ * @param frequencies Array to store the random frequencies in (in Hz).
+ * @param number_of_frequencies Number of random frequencies to generate.
+ * @param temperature Not used for this spectrum.
+ */
+void MaskedPhotonSourceSpectrum::fill_frequencies(
+    RandomGenerator &random_generator, double *frequencies,
+    const uint_fast32_t number_of_frequencies, double temperature) const {
+
+  _guide_table.fill_linear(random_generator, number_of_frequencies,
+                           frequencies, _cumulative_distribution.data(),
+                           _frequency_bins.data());
 }
 
 /**
@@ -61,12 +61,20 @@ public:
   /**
    * @brief Get the index of a free buffer in the memory space.
    *
+   * All buffers are allocated with the maximum size when the memory space is
+   * created and are reused, so the capacity of a buffer can be chosen freely
+   * every time it is taken from the memory space.
+   *
+   * @param capacity Capacity of the buffer (should be in the range
+   * [1, PHOTONBUFFER_SIZE]).
    * @return Index of a free buffer.
    */
-  inline size_t get_free_buffer() {
+  inline size_t
+  get_free_buffer(const uint_fast32_t capacity = PHOTONBUFFER_SIZE) {
     const size_t index = _memory_space.get_free_element_safe();
     cmac_assert_message(index < _memory_space.max_size(),
                         "No more free elements in memory space!");
+    _memory_space[index].set_capacity(capacity);
     return index;
   }
 
@@ -86,7 +94,7 @@ public:
    *
    * This method assumes the buffer was successfully locked before it was
    * called. It copies photons until the buffer is full, and starts a new buffer
-   * if that happens.
+   * with the same capacity if that happens.
    *
    * @param index Index of the buffer we want to add to.
    * @param buffer Buffer to copy over.
@@ -98,14 +106,14 @@ public:
     PhotonBuffer &buffer_target = _memory_space[index];
     const uint_fast32_t size_in = buffer.size();
     uint_fast32_t counter_in = 0;
-    while (buffer_target.size() < PHOTONBUFFER_SIZE && counter_in < size_in) {
+    while (!buffer_target.is_full() && counter_in < size_in) {
       const uint_fast32_t target_index = buffer_target.get_next_free_photon();
       buffer_target[target_index] = buffer[counter_in];
       ++counter_in;
     }
     size_t index_out = index;
-    if (buffer_target.size() == PHOTONBUFFER_SIZE) {
-      index_out = get_free_buffer();
+    if (buffer_target.is_full()) {
+      index_out = get_free_buffer(buffer_target.get_capacity());
       // note that the hungry other threads might already be attacking this
       // buffer. We need to make sure they release it without deleting it if
       // it does not (yet) contain any photons.
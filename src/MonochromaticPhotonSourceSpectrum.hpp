@@ -110,6 +110,16 @@ public:
     }
     return _total_flux;
   }
+
+  /**
+   * @brief Add the frequency of the spectrum to the given list.
+   *
+   * @param frequencies List of frequencies to add to (in Hz).
+   */
+  virtual void
+  get_discrete_frequencies(std::vector< double > &frequencies) const {
+    frequencies.push_back(_frequency);
+  }
 };
 
 #endif // MONOCHROMATICPHOTONSOURCESPECTRUM_HPP
@@ -0,0 +1,249 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file NUMATopology.hpp
+ *
+ * @brief Mapping of shared memory threads onto NUMA nodes.
+ *
+ * The mapping is either detected at runtime, by querying the core every thread
+ * is running on and looking up the NUMA node of that core in the Linux sysfs
+ * tree, or is imposed by assigning consecutive blocks of threads to a given
+ * number of nodes. The latter corresponds to the actual layout if threads are
+ * pinned to consecutive cores (e.g. OMP_PROC_BIND=close). Detection only makes
+ * sense if threads are pinned, since unpinned threads can migrate between
+ * nodes at any time.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef NUMATOPOLOGY_HPP
+#define NUMATOPOLOGY_HPP
+
+#include "Error.hpp"
+#include "OpenMP.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(HAVE_POSIX) && defined(__linux__)
+#include <sched.h>
+#define NUMATOPOLOGY_CAN_DETECT
+#endif
+
+/**
+ * @brief Mapping of shared memory threads onto NUMA nodes.
+ */
+class NUMATopology {
+private:
+  /*! @brief NUMA node for each thread. */
+  std::vector< int_fast32_t > _thread_nodes;
+
+  /*! @brief Threads on each NUMA node, in increasing thread order. */
+  std::vector< std::vector< int_fast32_t > > _node_threads;
+
+  /**
+   * @brief Get the NUMA node of the given core from the Linux sysfs tree.
+   *
+   * @param cpu Core index.
+   * @return NUMA node that contains the core, or -1 if the node could not be
+   * determined.
+   */
+  inline static int_fast32_t get_cpu_node(const int_fast32_t cpu) {
+    // every node directory contains a cpulist file with a comma separated
+    // list of core ranges, e.g. "0-15,32-47"
+    for (int_fast32_t inode = 0; inode < 1024; ++inode) {
+      std::stringstream filename;
+      filename << "/sys/devices/system/node/node" << inode << "/cpulist";
+      std::ifstream cpulist(filename.str());
+      if (!cpulist) {
+        // nodes are numbered consecutively on almost all systems
+        return -1;
+      }
+      std::string range;
+      while (std::getline(cpulist, range, ',')) {
+        int_fast32_t first, last;
+        const size_t dash = range.find('-');
+        first = std::stoi(range.substr(0, dash));
+        if (dash != std::string::npos) {
+          last = std::stoi(range.substr(dash + 1));
+        } else {
+          last = first;
+        }
+        if (cpu >= first && cpu <= last) {
+          return inode;
+        }
+      }
+    }
+    return -1;
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param number_of_threads Number of shared memory threads.
+   * @param number_of_nodes Number of NUMA nodes. If 0, the node of every
+   * thread is detected at runtime (this requires the threads to be pinned).
+   * If detection is not possible, all threads are put on a single node.
+   */
+  inline NUMATopology(const int_fast32_t number_of_threads,
+                      const int_fast32_t number_of_nodes = 0)
+      : _thread_nodes(number_of_threads, 0) {
+
+    cmac_assert_message(number_of_threads > 0, "No threads!");
+
+    // we do not allow empty nodes
+    int_fast32_t actual_number_of_nodes =
+        std::min(number_of_nodes, number_of_threads);
+    if (actual_number_of_nodes > 0) {
+      // consecutive blocks of threads
+      for (int_fast32_t ithread = 0; ithread < number_of_threads; ++ithread) {
+        _thread_nodes[ithread] =
+            (ithread * actual_number_of_nodes) / number_of_threads;
+      }
+    } else {
+      actual_number_of_nodes = 1;
+#ifdef NUMATOPOLOGY_CAN_DETECT
+      std::vector< int_fast32_t > thread_cpus(number_of_threads, -1);
+#ifdef HAVE_OPENMP
+#pragma omp parallel num_threads(number_of_threads)
+#endif
+      { thread_cpus[get_thread_index()] = sched_getcpu(); }
+      bool success = true;
+      for (int_fast32_t ithread = 0; ithread < number_of_threads; ++ithread) {
+        const int_fast32_t node = (thread_cpus[ithread] >= 0)
+                                      ? get_cpu_node(thread_cpus[ithread])
+                                      : -1;
+        if (node < 0) {
+          success = false;
+          break;
+        }
+        _thread_nodes[ithread] = node;
+      }
+      if (success) {
+        // renumber the nodes that are actually used so that they are
+        // consecutive and in order of first appearance
+        std::vector< int_fast32_t > node_map;
+        actual_number_of_nodes = 0;
+        for (int_fast32_t ithread = 0; ithread < number_of_threads;
+             ++ithread) {
+          const int_fast32_t node = _thread_nodes[ithread];
+          if (node >= static_cast< int_fast32_t >(node_map.size())) {
+            node_map.resize(node + 1, -1);
+          }
+          if (node_map[node] < 0) {
+            node_map[node] = actual_number_of_nodes;
+            ++actual_number_of_nodes;
+          }
+          _thread_nodes[ithread] = node_map[node];
+        }
+      } else {
+        _thread_nodes.assign(number_of_threads, 0);
+      }
+#endif
+    }
+
+    _node_threads.resize(actual_number_of_nodes);
+    for (int_fast32_t ithread = 0; ithread < number_of_threads; ++ithread) {
+      _node_threads[_thread_nodes[ithread]].push_back(ithread);
+    }
+  }
+
+  /**
+   * @brief Get the number of threads.
+   *
+   * @return Number of threads.
+   */
+  inline int_fast32_t get_number_of_threads() const {
+    return _thread_nodes.size();
+  }
+
+  /**
+   * @brief Get the number of NUMA nodes that contain at least one thread.
+   *
+   * @return Number of NUMA nodes.
+   */
+  inline int_fast32_t get_number_of_nodes() const {
+    return _node_threads.size();
+  }
+
+  /**
+   * @brief Get the NUMA node of the given thread.
+   *
+   * @param thread_id Thread index.
+   * @return NUMA node of that thread.
+   */
+  inline int_fast32_t get_node(const int_fast32_t thread_id) const {
+    return _thread_nodes[thread_id];
+  }
+
+  /**
+   * @brief Get the threads on the given NUMA node.
+   *
+   * @param node NUMA node.
+   * @return Threads on that node, in increasing thread order.
+   */
+  inline const std::vector< int_fast32_t > &
+  get_threads(const int_fast32_t node) const {
+    return _node_threads[node];
+  }
+
+  /**
+   * @brief Check if the two given threads are on the same NUMA node.
+   *
+   * @param thread_a First thread.
+   * @param thread_b Second thread.
+   * @return True if both threads are on the same node.
+   */
+  inline bool same_node(const int_fast32_t thread_a,
+                        const int_fast32_t thread_b) const {
+    return _thread_nodes[thread_a] == _thread_nodes[thread_b];
+  }
+
+  /**
+   * @brief Get the thread that owns the given element when the given number
+   * of elements is split into contiguous blocks, first over the NUMA nodes
+   * (proportional to the number of threads on each node) and then over the
+   * threads on each node.
+   *
+   * @param index Index of the element.
+   * @param number_of_elements Total number of elements.
+   * @return Thread that owns the element.
+   */
+  inline int_fast32_t get_block_thread(const size_t index,
+                                       const size_t number_of_elements) const {
+    // since threads are grouped per node, splitting the elements over the
+    // threads ordered per node automatically gives contiguous node blocks
+    const size_t number_of_threads = _thread_nodes.size();
+    size_t rank = (index * number_of_threads) / number_of_elements;
+    for (size_t inode = 0; inode < _node_threads.size(); ++inode) {
+      if (rank < _node_threads[inode].size()) {
+        return _node_threads[inode][rank];
+      }
+      rank -= _node_threads[inode].size();
+    }
+    cmac_error("Element index out of range!");
+    return -1;
+  }
+};
+
+#endif // NUMATOPOLOGY_HPP
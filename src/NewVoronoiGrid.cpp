@@ -27,6 +27,7 @@
 #include "ExactGeometricTests.hpp"
 #include "NewVoronoiCellConstructor.hpp"
 #include "WorkDistributor.hpp"
+#include <algorithm>
 #include <cfloat>
 
 /*! @brief If not commented out, this checks the empty circumsphere condition
@@ -76,22 +77,51 @@
 /**
  * @brief Compute the cell with the given index.
  *
+ * If requested, the neighbours of the previous version of the cell are
+ * inserted first. Since generators usually only move a small distance in
+ * between grid updates, these are very likely to be the neighbours of the new
+ * cell as well, so that the cell converges to its final shape very quickly and
+ * most other generators can be discarded based on their distance alone.
+ *
  * @param index Index of the cell to compute.
  * @param constructor NewVoronoiCellConstructor to use.
+ * @param use_previous_cell Use the neighbours of the previous version of the
+ * cell as a starting guess?
  * @return NewVoronoiCell.
  */
 NewVoronoiCell
 NewVoronoiGrid::compute_cell(uint_fast32_t index,
-                             NewVoronoiCellConstructor &constructor) const {
+                             NewVoronoiCellConstructor &constructor,
+                             bool use_previous_cell) const {
 
   constructor.setup(index, _real_generator_positions, _real_voronoi_box,
                     _real_rescaled_positions, _real_rescaled_box, true);
 
+  // sorted list of generators that were already inserted
+  std::vector< uint_fast32_t > inserted;
+  if (use_previous_cell) {
+    const std::vector< VoronoiFace > &faces = _cells[index].get_faces();
+    for (auto faceit = faces.begin(); faceit != faces.end(); ++faceit) {
+      const uint_fast32_t j = faceit->get_neighbour();
+      if (is_real_neighbour(j)) {
+        inserted.push_back(j);
+      }
+    }
+    std::sort(inserted.begin(), inserted.end());
+    for (auto ngbit = inserted.begin(); ngbit != inserted.end(); ++ngbit) {
+      constructor.intersect(*ngbit, _real_rescaled_box,
+                            _real_rescaled_positions, _real_voronoi_box,
+                            _real_generator_positions);
+      newvoronoigrid_check_cell(constructor);
+    }
+  }
+
   auto it = _point_locations.get_neighbours(index);
   auto ngbs = it.get_neighbours();
   for (auto ngbit = ngbs.begin(); ngbit != ngbs.end(); ++ngbit) {
     const uint_fast32_t j = *ngbit;
-    if (j != index) {
+    if (j != index &&
+        !std::binary_search(inserted.begin(), inserted.end(), j)) {
       constructor.intersect(j, _real_rescaled_box, _real_rescaled_positions,
                             _real_voronoi_box, _real_generator_positions);
       newvoronoigrid_check_cell(constructor);
@@ -102,9 +132,11 @@ NewVoronoiGrid::compute_cell(uint_fast32_t index,
     ngbs = it.get_neighbours();
     for (auto ngbit = ngbs.begin(); ngbit != ngbs.end(); ++ngbit) {
       const uint_fast32_t j = *ngbit;
-      constructor.intersect(j, _real_rescaled_box, _real_rescaled_positions,
-                            _real_voronoi_box, _real_generator_positions);
-      newvoronoigrid_check_cell(constructor);
+      if (!std::binary_search(inserted.begin(), inserted.end(), j)) {
+        constructor.intersect(j, _real_rescaled_box, _real_rescaled_positions,
+                              _real_voronoi_box, _real_generator_positions);
+        newvoronoigrid_check_cell(constructor);
+      }
     }
   }
 
@@ -176,14 +208,9 @@ NewVoronoiGrid::NewVoronoiGrid(
                                box_top_anchor_y - box_bottom_anchor_y,
                                box_top_anchor_z - box_bottom_anchor_z)));
 
-  const size_t psize = positions.size();
-  _real_rescaled_positions.resize(psize);
-  for (size_t i = 0; i < psize; ++i) {
-    const double x = 1. + (positions[i].x() - min_anchor.x()) / max_anchor.x();
-    const double y = 1. + (positions[i].y() - min_anchor.y()) / max_anchor.y();
-    const double z = 1. + (positions[i].z() - min_anchor.z()) / max_anchor.z();
-    _real_rescaled_positions[i] = CoordinateVector<>(x, y, z);
-  }
+  _rescale_anchor = min_anchor;
+  _rescale_sides = max_anchor;
+  update_rescaled_positions();
 }
 
 /**
@@ -191,6 +218,26 @@ NewVoronoiGrid::NewVoronoiGrid(
  */
 NewVoronoiGrid::~NewVoronoiGrid() {}
 
+/**
+ * @brief Recompute the rescaled representation of the mesh generating
+ * positions.
+ */
+void NewVoronoiGrid::update_rescaled_positions() {
+
+  const size_t psize = _real_generator_positions.size();
+  _real_rescaled_positions.resize(psize);
+  for (size_t i = 0; i < psize; ++i) {
+    const CoordinateVector<> &position = _real_generator_positions[i];
+    const double x =
+        1. + (position.x() - _rescale_anchor.x()) / _rescale_sides.x();
+    const double y =
+        1. + (position.y() - _rescale_anchor.y()) / _rescale_sides.y();
+    const double z =
+        1. + (position.z() - _rescale_anchor.z()) / _rescale_sides.z();
+    _real_rescaled_positions[i] = CoordinateVector<>(x, y, z);
+  }
+}
+
 /**
  * @brief Construct the Voronoi grid.
  *
@@ -201,6 +248,7 @@ void NewVoronoiGrid::compute_grid(int_fast32_t worksize) {
 
   const size_t psize = _real_generator_positions.size();
   _cells.resize(psize);
+  _max_radii_squared.resize(psize);
 
   WorkDistributor< NewVoronoiGridConstructionJobMarket,
                    NewVoronoiGridConstructionJob >
@@ -208,7 +256,136 @@ void NewVoronoiGrid::compute_grid(int_fast32_t worksize) {
   NewVoronoiGridConstructionJobMarket jobs(*this, 100);
   workers.do_in_parallel(jobs);
 
+  _computed_generator_positions = _real_generator_positions;
+
+  newvoronoigrid_check_volume();
+}
+
+/**
+ * @brief Check if inserting a generator at the given position would change the
+ * given cell.
+ *
+ * This is the case if the position is closer to one of the vertices of the
+ * cell than the cell generator itself, i.e. if the position lies inside the
+ * circumsphere of one of the Delaunay tetrahedra that make up the cell. We use
+ * a small tolerance to make sure marginal cases are recomputed.
+ *
+ * @param index Index of an unmoved cell.
+ * @param position Position of the new generator (in m).
+ * @return True if the new generator could change the cell.
+ */
+bool NewVoronoiGrid::is_affected_by(uint_fast32_t index,
+                                    const CoordinateVector<> &position) const {
+
+  const CoordinateVector<> &generator = _real_generator_positions[index];
+  const std::vector< VoronoiFace > &faces = _cells[index].get_faces();
+  for (auto faceit = faces.begin(); faceit != faces.end(); ++faceit) {
+    const std::vector< CoordinateVector<> > vertices = faceit->get_vertices();
+    for (auto vertexit = vertices.begin(); vertexit != vertices.end();
+         ++vertexit) {
+      const double r2_generator = (*vertexit - generator).norm2();
+      const double r2_position = (*vertexit - position).norm2();
+      if (r2_position <= (1. + 1.e-10) * r2_generator) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Update the Voronoi grid after the mesh generating positions have
+ * changed.
+ *
+ * Only cells that can be affected by the generator movement are recomputed:
+ *  - cells whose generator moved,
+ *  - cells that had a moved generator as a neighbour,
+ *  - cells for which the new position of a moved generator lies within the
+ *    influence radius of the cell, i.e. the maximum distance at which another
+ *    generator can still change the cell structure, and that are actually
+ *    cut by the moved generator (see is_affected_by()).
+ * The recomputed cells use their previous neighbours as a starting guess.
+ * If too many cells are affected, the grid is reconstructed from scratch.
+ *
+ * @param worksize Number of shared memory threads to use during the grid
+ * update.
+ * @return True, since this grid supports incremental updates.
+ */
+bool NewVoronoiGrid::update_grid(int_fast32_t worksize) {
+
+  const size_t psize = _real_generator_positions.size();
+  if (_computed_generator_positions.size() != psize) {
+    cmac_error("The grid needs to be computed before it can be updated!");
+  }
+
+  std::vector< uint_fast32_t > moved;
+  double max_radius_squared = 0.;
+  for (size_t i = 0; i < psize; ++i) {
+    if (_real_generator_positions[i] != _computed_generator_positions[i]) {
+      moved.push_back(i);
+    }
+    max_radius_squared = std::max(max_radius_squared, _max_radii_squared[i]);
+  }
+  if (moved.size() == 0) {
+    return true;
+  }
+
+  update_rescaled_positions();
+  _point_locations.update();
+
+  if (moved.size() > NEWVORONOIGRID_MAXIMUM_UPDATE_FRACTION * psize) {
+    compute_grid(worksize);
+    return true;
+  }
+
+  std::vector< bool > affected(psize, false);
+  for (auto movedit = moved.begin(); movedit != moved.end(); ++movedit) {
+    const uint_fast32_t i = *movedit;
+    affected[i] = true;
+    const std::vector< VoronoiFace > &faces = _cells[i].get_faces();
+    for (auto faceit = faces.begin(); faceit != faces.end(); ++faceit) {
+      const uint_fast32_t j = faceit->get_neighbour();
+      if (is_real_neighbour(j)) {
+        affected[j] = true;
+      }
+    }
+    const CoordinateVector<> &position = _real_generator_positions[i];
+    auto it = _point_locations.get_neighbours(i);
+    do {
+      const auto ngbs = it.get_neighbours();
+      for (auto ngbit = ngbs.begin(); ngbit != ngbs.end(); ++ngbit) {
+        const uint_fast32_t j = *ngbit;
+        if (!affected[j] && (_real_generator_positions[j] - position).norm2() <=
+                                _max_radii_squared[j]) {
+          affected[j] = is_affected_by(j, position);
+        }
+      }
+    } while (it.get_max_radius2() < max_radius_squared && it.increase_range());
+  }
+
+  std::vector< uint_fast32_t > cell_list;
+  for (size_t i = 0; i < psize; ++i) {
+    if (affected[i]) {
+      cell_list.push_back(i);
+    }
+  }
+
+  if (cell_list.size() > NEWVORONOIGRID_MAXIMUM_UPDATE_FRACTION * psize) {
+    compute_grid(worksize);
+    return true;
+  }
+
+  WorkDistributor< NewVoronoiGridConstructionJobMarket,
+                   NewVoronoiGridConstructionJob >
+      workers(worksize);
+  NewVoronoiGridConstructionJobMarket jobs(*this, 100, &cell_list);
+  workers.do_in_parallel(jobs);
+
+  _computed_generator_positions = _real_generator_positions;
+
   newvoronoigrid_check_volume();
+
+  return true;
 }
 
 /**
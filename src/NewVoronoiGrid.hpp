@@ -58,6 +58,21 @@ private:
    *  the range [1,2[). */
   std::vector< CoordinateVector<> > _real_rescaled_positions;
 
+  /*! @brief Anchor of the range that is mapped to the rescaled range (in m). */
+  CoordinateVector<> _rescale_anchor;
+
+  /*! @brief Side lengths of the range that is mapped to the rescaled range
+   *  (in m). */
+  CoordinateVector<> _rescale_sides;
+
+  /*! @brief Mesh generating positions for which the current cells were
+   *  computed (in m). */
+  std::vector< CoordinateVector<> > _computed_generator_positions;
+
+  /*! @brief Maximum distance (squared) between the generator of each cell and
+   *  another generator that could still change the cell structure (in m^2). */
+  std::vector< double > _max_radii_squared;
+
   /*! @brief Real rescaled representation of the VoronoiBox (in the range
    *  [1,2[). */
   NewVoronoiBox _real_rescaled_box;
@@ -69,7 +84,11 @@ private:
   PointLocations _point_locations;
 
   NewVoronoiCell compute_cell(uint_fast32_t index,
-                              NewVoronoiCellConstructor &constructor) const;
+                              NewVoronoiCellConstructor &constructor,
+                              bool use_previous_cell = false) const;
+  void update_rescaled_positions();
+  bool is_affected_by(uint_fast32_t index,
+                      const CoordinateVector<> &position) const;
 
   /**
    * @brief Job that constructs part of the Voronoi grid.
@@ -85,6 +104,11 @@ private:
     /*! @brief Index of the beyond last cell that this job will construct. */
     uint_fast32_t _last_index;
 
+    /*! @brief List of cell indices to construct. If set, the job range refers
+     *  to this list instead of to the cells themselves, and the previous
+     *  version of each cell is used as a starting guess. */
+    const std::vector< uint_fast32_t > *_cell_list;
+
     /*! @brief NewVoronoiCellConstructor object used by this thread. */
     NewVoronoiCellConstructor _constructor;
 
@@ -93,9 +117,13 @@ private:
      * @brief Constructor.
      *
      * @param grid Reference to the NewVoronoiGrid we are constructing.
+     * @param cell_list List of cell indices to construct (optional).
      */
-    inline NewVoronoiGridConstructionJob(NewVoronoiGrid &grid)
-        : _grid(grid), _first_index(0), _last_index(0) {}
+    inline NewVoronoiGridConstructionJob(
+        NewVoronoiGrid &grid,
+        const std::vector< uint_fast32_t > *cell_list = nullptr)
+        : _grid(grid), _first_index(0), _last_index(0), _cell_list(cell_list) {
+    }
 
     /**
      * @brief Update the cell range that will be constructed during the next run
@@ -124,7 +152,11 @@ private:
      */
     inline void execute() {
       for (uint_fast32_t i = _first_index; i < _last_index; ++i) {
-        _grid._cells[i] = _grid.compute_cell(i, _constructor);
+        const uint_fast32_t index = _cell_list ? (*_cell_list)[i] : i;
+        _grid._cells[index] =
+            _grid.compute_cell(index, _constructor, _cell_list != nullptr);
+        _grid._max_radii_squared[index] =
+            _constructor.get_max_radius_squared();
       }
     }
 
@@ -144,6 +176,13 @@ private:
     /*! @brief Reference to the NewVoronoiGrid we want to construct. */
     NewVoronoiGrid &_grid;
 
+    /*! @brief List of cell indices to construct (if not set, all cells are
+     *  constructed). */
+    const std::vector< uint_fast32_t > *_cell_list;
+
+    /*! @brief Number of cells that needs to be constructed. */
+    const uint_fast32_t _number_of_cells;
+
     /*! @brief Per thread NewVoronoiGridConstructionJob. */
     NewVoronoiGridConstructionJob *_jobs[MAX_NUM_THREADS];
 
@@ -162,10 +201,14 @@ private:
      *
      * @param grid NewVoronoiGrid we want to construct.
      * @param jobsize Number of cell constructed by a single job.
+     * @param cell_list List of cell indices to construct (optional).
      */
-    inline NewVoronoiGridConstructionJobMarket(NewVoronoiGrid &grid,
-                                               uint_fast32_t jobsize)
-        : _grid(grid), _current_index(0), _jobsize(jobsize) {
+    inline NewVoronoiGridConstructionJobMarket(
+        NewVoronoiGrid &grid, uint_fast32_t jobsize,
+        const std::vector< uint_fast32_t > *cell_list = nullptr)
+        : _grid(grid), _cell_list(cell_list),
+          _number_of_cells(cell_list ? cell_list->size() : grid._cells.size()),
+          _current_index(0), _jobsize(jobsize) {
 
       for (uint_fast32_t i = 0; i < MAX_NUM_THREADS; ++i) {
         _jobs[i] = nullptr;
@@ -191,7 +234,7 @@ private:
      */
     inline void set_worksize(int_fast32_t worksize) {
       for (int_fast32_t i = 0; i < worksize; ++i) {
-        _jobs[i] = new NewVoronoiGridConstructionJob(_grid);
+        _jobs[i] = new NewVoronoiGridConstructionJob(_grid, _cell_list);
       }
     }
 
@@ -203,7 +246,7 @@ private:
      * NewVoronoiGridConstructionJob.
      */
     inline NewVoronoiGridConstructionJob *get_job(int_fast32_t thread_id) {
-      const uint_fast32_t cellsize = _grid._cells.size();
+      const uint_fast32_t cellsize = _number_of_cells;
       if (_current_index == cellsize) {
         return nullptr;
       }
@@ -236,6 +279,7 @@ public:
   /// grid computation methods
 
   virtual void compute_grid(int_fast32_t worksize = -1);
+  virtual bool update_grid(int_fast32_t worksize = -1);
 
   /// cell/grid property access
 
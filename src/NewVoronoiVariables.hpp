@@ -44,6 +44,11 @@
  *  structure. */
 #define NEWVORONOIGRID_NUM_BUCKET 1
 
+/*! @brief Maximum fraction of the cells that can be affected by moving
+ *  generators for which an incremental grid update is still used. If more
+ *  cells are affected, the grid is reconstructed from scratch. */
+#define NEWVORONOIGRID_MAXIMUM_UPDATE_FRACTION 0.5
+
 /// fixed parameters: do not touch!
 
 /*! @brief Some neighbour indices are reserved for special neighbours: the
@@ -238,6 +238,9 @@ Pegase3PhotonSourceSpectrum::Pegase3PhotonSourceSpectrum(
         _cumulative_distribution[PEGASE3PHOTONSOURCESPECTRUM_NUMFREQ - 1];
   }
 
+  _guide_table.initialize(_cumulative_distribution.data(),
+                          PEGASE3PHOTONSOURCESPECTRUM_NUMFREQ);
+
   if (log) {
     log->write_status(
         "Constructed Pegase3PhotonSourceSpectrum with total ionizing flux ",
@@ -279,14 +282,25 @@ double Pegase3PhotonSourceSpectrum::get_random_frequency(
     RandomGenerator &random_generator, double temperature) const {
 
   const double x = random_generator.get_uniform_random_double();
-  const uint_fast32_t inu = Utilities::locate(
-      x, _cumulative_distribution.data(), PEGASE3PHOTONSOURCESPECTRUM_NUMFREQ);
-  const double frequency =
-      _frequencies[inu] +
-      (_frequencies[inu + 1] - _frequencies[inu]) *
-          (x - _cumulative_distribution[inu]) /
-          (_cumulative_distribution[inu + 1] - _cumulative_distribution[inu]);
-  return frequency;
+  return _guide_table.sample_linear(x, _cumulative_distribution.data(),
+                                    _frequencies.data());
+}
+
+/**
+ * @brief Get a number of random frequencies from the spectrum.
+ *
+ * @param random_generator RandomGenerator to use.
+ * @param frequencies Array to store the random frequencies in (in Hz).
+ * @param number_of_frequencies Number of random frequencies to generate.
+ * @param temperature Not used for this spectrum.
+ */
+void Pegase3PhotonSourceSpectrum::fill_frequencies(
+    RandomGenerator &random_generator, double *frequencies,
+    const uint_fast32_t number_of_frequencies, double temperature) const {
+
+  _guide_table.fill_linear(random_generator, number_of_frequencies,
+                           frequencies, _cumulative_distribution.data(),
+                           _frequencies.data());
 }
 
 /**
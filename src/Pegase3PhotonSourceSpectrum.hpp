@@ -26,6 +26,7 @@
 #ifndef PEGASE3PHOTONSOURCESPECTRUM_HPP
 #define PEGASE3PHOTONSOURCESPECTRUM_HPP
 
+#include "GuideTable.hpp"
 #include "PhotonSourceSpectrum.hpp"
 
 #include <string>
@@ -57,6 +58,9 @@ private:
   /*! @brief Cumulative distribution of the spectrum. */
   std::vector< double > _cumulative_distribution;
 
+  /*! @brief Guide table used to invert the cumulative distribution. */
+  GuideTable _guide_table;
+
   /*! @brief Total ionizing flux of the spectrum (in m^-2 s^-1). */
   double _total_flux;
 
@@ -78,6 +82,11 @@ public:
   virtual double get_random_frequency(RandomGenerator &random_generator,
                                       double temperature = 0.) const;
 
+  virtual void fill_frequencies(RandomGenerator &random_generator,
+                                double *frequencies,
+                                const uint_fast32_t number_of_frequencies,
+                                double temperature = 0.) const;
+
   virtual double get_total_flux() const;
 };
 
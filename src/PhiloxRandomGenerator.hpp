@@ -0,0 +1,301 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file PhiloxRandomGenerator.hpp
+ *
+ * @brief Counter-based Philox4x32-10 random generator.
+ *
+ * Based on Salmon et al., 2011, Proceedings of 2011 International Conference
+ * for High Performance Computing, Networking, Storage and Analysis, 16
+ * (https://doi.org/10.1145/2063384.2063405).
+ *
+ * The generator encrypts a 128-bit counter with a 64-bit key. The key is set
+ * by the seed, the upper half of the counter selects an independent
+ * substream and the lower half is the position within that substream. The
+ * full state of the generator is hence given by the key and the counter.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef PHILOXRANDOMGENERATOR_HPP
+#define PHILOXRANDOMGENERATOR_HPP
+
+#include "RestartReader.hpp"
+#include "RestartWriter.hpp"
+
+#include <cstdint>
+
+/*! @brief Number of Philox blocks that are generated together by the bulk
+ *  interface. The rounds for all blocks in a batch are done in lock step, so
+ *  that the compiler can vectorise them. */
+#define PHILOXRANDOMGENERATOR_BATCH_SIZE 16
+
+/**
+ * @brief Counter-based Philox4x32-10 random generator.
+ */
+class PhiloxRandomGenerator {
+private:
+  /*! @brief Key. */
+  uint32_t _key[2];
+
+  /*! @brief Index of the substream (upper half of the counter). */
+  uint64_t _substream;
+
+  /*! @brief Index of the next block that will be generated within the
+   *  substream (lower half of the counter). */
+  uint64_t _counter;
+
+  /*! @brief Last generated block. */
+  uint32_t _block[4];
+
+  /*! @brief Index of the next unused element of the last generated block (4
+   *  if the block has been used up). */
+  uint_fast8_t _block_index;
+
+  /**
+   * @brief Apply the Philox4x32-10 bijection to a batch of counters.
+   *
+   * @param key Key.
+   * @param x0 First element of the counters (overwritten with the first
+   * element of the output).
+   * @param x1 Second element of the counters (idem).
+   * @param x2 Third element of the counters (idem).
+   * @param x3 Fourth element of the counters (idem).
+   * @param n Number of counters in the batch.
+   */
+  static inline void philox(const uint32_t key[2], uint32_t *x0, uint32_t *x1,
+                            uint32_t *x2, uint32_t *x3, const uint_fast32_t n) {
+
+    uint32_t k0 = key[0];
+    uint32_t k1 = key[1];
+    for (uint_fast8_t round = 0; round < 10; ++round) {
+      for (uint_fast32_t i = 0; i < n; ++i) {
+        const uint64_t p0 = static_cast< uint64_t >(0xD2511F53) * x0[i];
+        const uint64_t p1 = static_cast< uint64_t >(0xCD9E8D57) * x2[i];
+        const uint32_t y0 = static_cast< uint32_t >(p1 >> 32) ^ x1[i] ^ k0;
+        const uint32_t y2 = static_cast< uint32_t >(p0 >> 32) ^ x3[i] ^ k1;
+        x0[i] = y0;
+        x1[i] = static_cast< uint32_t >(p1);
+        x2[i] = y2;
+        x3[i] = static_cast< uint32_t >(p0);
+      }
+      k0 += 0x9E3779B9;
+      k1 += 0xBB67AE85;
+    }
+  }
+
+  /**
+   * @brief Convert two random 32-bit integers into a double precision
+   * floating point value in the range ]0., 1.[ with 53 random bits.
+   *
+   * @param a First 32-bit integer.
+   * @param b Second 32-bit integer.
+   * @return Double precision floating point value.
+   */
+  static inline double to_double(const uint32_t a, const uint32_t b) {
+    const uint64_t bits = (static_cast< uint64_t >(a >> 5) << 26) | (b >> 6);
+    return (bits + 0.5) * (1. / 9007199254740992.);
+  }
+
+  /**
+   * @brief Generate the next block.
+   */
+  inline void generate_block() {
+    _block[0] = static_cast< uint32_t >(_counter);
+    _block[1] = static_cast< uint32_t >(_counter >> 32);
+    _block[2] = static_cast< uint32_t >(_substream);
+    _block[3] = static_cast< uint32_t >(_substream >> 32);
+    philox(_key, &_block[0], &_block[1], &_block[2], &_block[3], 1);
+    ++_counter;
+    _block_index = 0;
+  }
+
+public:
+  /**
+   * @brief Set a new seed for the random generator.
+   *
+   * This also resets the generator to the start of substream 0.
+   *
+   * @param seed New seed.
+   */
+  inline void set_seed(const int_fast32_t seed) {
+    _key[0] = static_cast< uint32_t >(seed);
+    _key[1] = 0;
+    set_substream(0);
+  }
+
+  /**
+   * @brief Move the generator to the start of the given substream.
+   *
+   * Different substreams for the same seed are statistically independent, so
+   * that e.g. every photon batch can use its own substream and produce the
+   * same random numbers, irrespective of the thread that executes it.
+   *
+   * @param substream Index of the substream.
+   */
+  inline void set_substream(const uint64_t substream) {
+    _substream = substream;
+    _counter = 0;
+    _block_index = 4;
+  }
+
+  /**
+   * @brief Constructor.
+   *
+   * @param seed Initial seed for the random number generator.
+   */
+  inline PhiloxRandomGenerator(const int_fast32_t seed = 42) {
+    set_seed(seed);
+  }
+
+  /**
+   * @brief Get the raw Philox4x32-10 output for the given counter and key.
+   *
+   * @param counter Counter.
+   * @param key Key.
+   * @param output Output.
+   */
+  static inline void get_raw_block(const uint32_t counter[4],
+                                   const uint32_t key[2], uint32_t output[4]) {
+    for (uint_fast8_t i = 0; i < 4; ++i) {
+      output[i] = counter[i];
+    }
+    philox(key, &output[0], &output[1], &output[2], &output[3], 1);
+  }
+
+  /**
+   * @brief Get a uniform random double precision floating point value in the
+   * range ]0., 1.[.
+   *
+   * Note that this function changes the internal state of the generator.
+   *
+   * @return Random double precision floating point value.
+   */
+  inline double get_uniform_random_double() {
+    if (_block_index > 2) {
+      generate_block();
+    }
+    const double value =
+        to_double(_block[_block_index], _block[_block_index + 1]);
+    _block_index += 2;
+    return value;
+  }
+
+  /**
+   * @brief Fill the given array with uniform random double precision floating
+   * point values in the range ]0., 1.[.
+   *
+   * The result is the same as for consecutive calls to
+   * get_uniform_random_double(), but complete blocks are generated in batches
+   * that can be vectorised.
+   *
+   * @param values Array to fill.
+   * @param number_of_values Number of values to generate.
+   */
+  inline void get_uniform_random_doubles(double *values,
+                                         const size_t number_of_values) {
+
+    size_t i = 0;
+    // use up the current block
+    while (i < number_of_values && _block_index < 3) {
+      values[i] = get_uniform_random_double();
+      ++i;
+    }
+
+    // every block produces two values
+    uint32_t x0[PHILOXRANDOMGENERATOR_BATCH_SIZE];
+    uint32_t x1[PHILOXRANDOMGENERATOR_BATCH_SIZE];
+    uint32_t x2[PHILOXRANDOMGENERATOR_BATCH_SIZE];
+    uint32_t x3[PHILOXRANDOMGENERATOR_BATCH_SIZE];
+    while (number_of_values - i >= 2 * PHILOXRANDOMGENERATOR_BATCH_SIZE) {
+      for (uint_fast32_t j = 0; j < PHILOXRANDOMGENERATOR_BATCH_SIZE; ++j) {
+        const uint64_t counter = _counter + j;
+        x0[j] = static_cast< uint32_t >(counter);
+        x1[j] = static_cast< uint32_t >(counter >> 32);
+        x2[j] = static_cast< uint32_t >(_substream);
+        x3[j] = static_cast< uint32_t >(_substream >> 32);
+      }
+      philox(_key, x0, x1, x2, x3, PHILOXRANDOMGENERATOR_BATCH_SIZE);
+      for (uint_fast32_t j = 0; j < PHILOXRANDOMGENERATOR_BATCH_SIZE; ++j) {
+        values[i + 2 * j] = to_double(x0[j], x1[j]);
+        values[i + 2 * j + 1] = to_double(x2[j], x3[j]);
+      }
+      _counter += PHILOXRANDOMGENERATOR_BATCH_SIZE;
+      i += 2 * PHILOXRANDOMGENERATOR_BATCH_SIZE;
+    }
+
+    // remainder
+    while (i < number_of_values) {
+      values[i] = get_uniform_random_double();
+      ++i;
+    }
+  }
+
+  /**
+   * @brief Get a random integer value.
+   *
+   * @return Random integer value in the range [0, 2^31[.
+   */
+  inline int_fast32_t get_random_integer() {
+    if (_block_index > 3) {
+      generate_block();
+    }
+    const uint32_t value = _block[_block_index];
+    ++_block_index;
+    return value >> 1;
+  }
+
+  /**
+   * @brief Write the random number generator to the given restart file.
+   *
+   * Only the key and counter are stored; the current block is regenerated
+   * when the generator is restarted.
+   *
+   * @param restart_writer RestartWriter to use.
+   */
+  inline void write_restart_file(RestartWriter &restart_writer) const {
+
+    restart_writer.write(_key[0]);
+    restart_writer.write(_key[1]);
+    restart_writer.write(_substream);
+    restart_writer.write(_counter);
+    restart_writer.write(_block_index);
+  }
+
+  /**
+   * @brief Restart constructor.
+   *
+   * @param restart_reader Restart file to read from.
+   */
+  inline PhiloxRandomGenerator(RestartReader &restart_reader)
+      : _key{restart_reader.read< uint32_t >(),
+             restart_reader.read< uint32_t >()},
+        _substream(restart_reader.read< uint64_t >()),
+        _counter(restart_reader.read< uint64_t >()),
+        _block_index(restart_reader.read< uint_fast8_t >()) {
+
+    if (_block_index < 4) {
+      const uint_fast8_t block_index = _block_index;
+      --_counter;
+      generate_block();
+      _block_index = block_index;
+    }
+  }
+};
+
+#endif // PHILOXRANDOMGENERATOR_HPP
@@ -28,8 +28,10 @@
 #define PHOTONBUFFER_HPP
 
 // project includes
+#include "Abundances.hpp"
 #include "AtomicValue.hpp"
 #include "Configuration.hpp"
+#include "CrossSections.hpp"
 #include "Error.hpp"
 #include "PhotonPacket.hpp"
 #include "ThreadLock.hpp"
@@ -39,7 +41,9 @@
 #include <mpi.h>
 #endif
 
-/*! @brief Number of photons that can be stored in a single buffer. */
+/*! @brief Maximum number of photons that can be stored in a single buffer. The
+ *  actual capacity of a buffer can be set at runtime, but cannot exceed this
+ *  value. */
 #define PHOTONBUFFER_SIZE 200u
 
 /*! @brief Size of the MPI buffer necessary to store a PhotonBuffer. */
@@ -61,6 +65,10 @@ private:
   /*! @brief Number of photons in the buffer. */
   uint_least32_t _actual_size;
 
+  /*! @brief Number of photons the buffer can hold before it is considered
+   *  full. */
+  uint_least32_t _capacity;
+
   /*! @brief Actual photon buffer. */
   PhotonPacket _photons[PHOTONBUFFER_SIZE];
 
@@ -68,7 +76,7 @@ public:
   /**
    * @brief Empty constructor.
    */
-  PhotonBuffer() : _actual_size(0) {}
+  PhotonBuffer() : _actual_size(0), _capacity(PHOTONBUFFER_SIZE) {}
 
 #ifdef HAVE_MPI
   /**
@@ -169,11 +177,38 @@ public:
    * @return Index of the next available Photon in the buffer.
    */
   inline uint_fast32_t get_next_free_photon() {
-    cmac_assert_message(_actual_size < PHOTONBUFFER_SIZE,
+    cmac_assert_message(_actual_size < _capacity,
                         "No more free elements in PhotonBuffer!");
     return _actual_size++;
   }
 
+  /**
+   * @brief Get the capacity of the buffer.
+   *
+   * @return Number of photons the buffer can hold.
+   */
+  inline uint_fast32_t get_capacity() const { return _capacity; }
+
+  /**
+   * @brief Set the capacity of the buffer.
+   *
+   * @param capacity Number of photons the buffer can hold (should be in the
+   * range [1, PHOTONBUFFER_SIZE]).
+   */
+  inline void set_capacity(const uint_fast32_t capacity) {
+    cmac_assert_message(capacity > 0 && capacity <= PHOTONBUFFER_SIZE,
+                        "Invalid PhotonBuffer capacity: %" PRIuFAST32 "!",
+                        capacity);
+    _capacity = capacity;
+  }
+
+  /**
+   * @brief Check if the buffer is full.
+   *
+   * @return True if the number of photons in the buffer equals its capacity.
+   */
+  inline bool is_full() const { return _actual_size >= _capacity; }
+
   /**
    * @brief Grow the buffer to the given size.
    *
@@ -183,6 +218,45 @@ public:
    */
   inline void grow(const uint_fast32_t size) { _actual_size = size; }
 
+  /**
+   * @brief Set the photoionization cross sections for all photons in the
+   * buffer, starting from the given index, based on their energy.
+   *
+   * For ions other than hydrogen, the cross sections include the abundance of
+   * the corresponding element, unless abundances are variable. If compact
+   * photon packets are used, the cross sections are looked up in the shared
+   * TabulatedCrossSections table and this function does nothing.
+   *
+   * @param cross_sections Photoionization cross sections.
+   * @param abundances Abundances.
+   * @param first_photon Index of the first photon to update.
+   */
+  inline void
+  set_photoionization_cross_sections(const CrossSections &cross_sections,
+                                     const Abundances &abundances,
+                                     const uint_fast32_t first_photon = 0) {
+#ifndef USE_COMPACT_PHOTON_PACKET
+    double abundance_factors[NUMBER_OF_IONNAMES];
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+#ifndef VARIABLE_ABUNDANCES
+      abundance_factors[ion] =
+          (ion != ION_H_n) ? abundances.get_abundance(get_element(ion)) : 1.;
+#else
+      abundance_factors[ion] = 1.;
+#endif
+    }
+    double sigma[NUMBER_OF_IONNAMES];
+    for (uint_fast32_t i = first_photon; i < _actual_size; ++i) {
+      PhotonPacket &photon = _photons[i];
+      cross_sections.get_cross_sections(photon.get_energy(), sigma);
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        photon.set_photoionization_cross_section(
+            ion, sigma[ion] * abundance_factors[ion]);
+      }
+    }
+#endif
+  }
+
   /**
    * @brief Set the subgrid index for this buffer.
    *
@@ -0,0 +1,298 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file PhotonBufferCommunicator.hpp
+ *
+ * @brief Non-blocking exchange of photon buffers between MPI processes that
+ * each own part of a distributed grid.
+ *
+ * All MPI calls are protected by a single lock, so that the communicator can
+ * be used from within a shared memory parallel region when MPI only provides
+ * MPI_THREAD_SERIALIZED support.
+ *
+ * Termination of the photon propagation phase is detected using repeated
+ * non-blocking reductions of the number of photon packets that were
+ * terminated on every process. Since these numbers can only grow, the
+ * propagation phase is finished as soon as a reduction returns the total
+ * number of photon packets: at that point no photon packets can still be in
+ * transit.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef PHOTONBUFFERCOMMUNICATOR_HPP
+#define PHOTONBUFFERCOMMUNICATOR_HPP
+
+#include "AtomicValue.hpp"
+#include "Configuration.hpp"
+#include "Error.hpp"
+#include "MemorySpace.hpp"
+#include "PhotonBuffer.hpp"
+#include "ThreadLock.hpp"
+
+#include <cinttypes>
+#include <vector>
+
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
+
+/*! @brief MPI tag used for photon buffer messages. */
+#define PHOTONBUFFERCOMMUNICATOR_TAG 1
+
+/**
+ * @brief Non-blocking exchange of photon buffers between MPI processes.
+ */
+class PhotonBufferCommunicator {
+private:
+  /*! @brief Lock that makes sure only a single thread at a time does MPI
+   *  calls. */
+  ThreadLock _lock;
+
+  /*! @brief Flag signalling the end of the photon propagation phase (only
+   *  set while holding the lock, but read by all threads without it). */
+  AtomicValue< bool > _finished;
+
+  /*! @brief Is a termination reduction currently in progress? */
+  bool _reduction_active;
+
+  /*! @brief Local number of terminated photon packets that is used as input
+   *  for the active reduction. */
+  uint64_t _local_number_done;
+
+  /*! @brief Result of the active reduction. */
+  uint64_t _global_number_done;
+
+  /*! @brief Communication buffers for sends that have not completed yet. */
+  std::vector< char * > _send_buffers;
+
+  /*! @brief Receive buffer. */
+  char *_receive_buffer;
+
+#ifdef HAVE_MPI
+  /*! @brief Private communicator, so that messages and reductions can never be
+   *  confused with communications done elsewhere. */
+  MPI_Comm _communicator;
+
+  /*! @brief Requests for sends that have not completed yet. */
+  std::vector< MPI_Request > _send_requests;
+
+  /*! @brief Request for the active reduction. */
+  MPI_Request _reduction_request;
+#endif
+
+  /**
+   * @brief Free the communication buffers of all sends that have completed.
+   *
+   * Should only be called by the thread that holds the lock.
+   */
+  inline void clean_up_sends() {
+#ifdef HAVE_MPI
+    size_t i = 0;
+    while (i < _send_requests.size()) {
+      int flag;
+      MPI_Test(&_send_requests[i], &flag, MPI_STATUS_IGNORE);
+      if (flag) {
+        delete[] _send_buffers[i];
+        _send_buffers[i] = _send_buffers.back();
+        _send_buffers.pop_back();
+        _send_requests[i] = _send_requests.back();
+        _send_requests.pop_back();
+      } else {
+        ++i;
+      }
+    }
+#endif
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * This is a collective operation that needs to be called by all processes.
+   *
+   * @param number_of_threads Number of threads that will use the
+   * communicator.
+   */
+  inline PhotonBufferCommunicator(const int_fast32_t number_of_threads)
+      : _finished(false), _reduction_active(false), _local_number_done(0),
+        _global_number_done(0) {
+
+#ifdef HAVE_MPI
+    if (number_of_threads > 1) {
+      int thread_support;
+      MPI_Query_thread(&thread_support);
+      if (thread_support < MPI_THREAD_SERIALIZED) {
+        cmac_error("The MPI library does not support MPI calls from multiple "
+                   "threads (MPI_THREAD_SERIALIZED)!");
+      }
+    }
+    MPI_Comm_dup(MPI_COMM_WORLD, &_communicator);
+    _receive_buffer = new char[PHOTONBUFFER_MPI_SIZE];
+#else
+    cmac_error("Photon buffer communication requires MPI!");
+#endif
+  }
+
+  /**
+   * @brief Destructor.
+   *
+   * Waits for all pending sends to finish.
+   */
+  inline ~PhotonBufferCommunicator() {
+#ifdef HAVE_MPI
+    reset();
+    delete[] _receive_buffer;
+    MPI_Comm_free(&_communicator);
+#endif
+  }
+
+  /**
+   * @brief Send the given photon buffer to the given process.
+   *
+   * The send is non-blocking: the buffer contents are copied into a
+   * communication buffer, so that the PhotonBuffer can be reused as soon as
+   * this method returns.
+   *
+   * @param buffer PhotonBuffer to send.
+   * @param rank Rank of the receiving process.
+   */
+  inline void send(PhotonBuffer &buffer, const int_fast32_t rank) {
+#ifdef HAVE_MPI
+    char *send_buffer = new char[PHOTONBUFFER_MPI_SIZE];
+    _lock.lock();
+    buffer.pack(send_buffer);
+    MPI_Request request;
+    const int status =
+        MPI_Isend(send_buffer, PHOTONBUFFER_MPI_SIZE, MPI_PACKED, rank,
+                  PHOTONBUFFERCOMMUNICATOR_TAG, _communicator, &request);
+    if (status != MPI_SUCCESS) {
+      cmac_error("Failed to send photon buffer to process %" PRIiFAST32 "!",
+                 rank);
+    }
+    _send_buffers.push_back(send_buffer);
+    _send_requests.push_back(request);
+    clean_up_sends();
+    _lock.unlock();
+#endif
+  }
+
+  /**
+   * @brief Try to receive a photon buffer from any other process.
+   *
+   * If another thread is currently communicating, this method returns
+   * immediately without checking for incoming messages.
+   *
+   * @param buffers Photon buffer array in which a new buffer is allocated for
+   * the received photon packets.
+   * @param buffer_index Index of the new buffer (only set if a buffer was
+   * received).
+   * @return True if a photon buffer was received.
+   */
+  inline bool try_receive(MemorySpace &buffers, size_t &buffer_index) {
+#ifdef HAVE_MPI
+    if (!_lock.try_lock()) {
+      return false;
+    }
+    int flag;
+    MPI_Status status;
+    MPI_Iprobe(MPI_ANY_SOURCE, PHOTONBUFFERCOMMUNICATOR_TAG, _communicator,
+               &flag, &status);
+    if (flag) {
+      MPI_Recv(_receive_buffer, PHOTONBUFFER_MPI_SIZE, MPI_PACKED,
+               status.MPI_SOURCE, PHOTONBUFFERCOMMUNICATOR_TAG, _communicator,
+               MPI_STATUS_IGNORE);
+      buffer_index = buffers.get_free_buffer();
+      buffers[buffer_index].unpack(_receive_buffer);
+    }
+    _lock.unlock();
+    return flag;
+#else
+    return false;
+#endif
+  }
+
+  /**
+   * @brief Check if the photon propagation phase has finished on all
+   * processes.
+   *
+   * This method needs to be called repeatedly by all processes until it
+   * returns true: every call progresses the active termination reduction, or
+   * starts a new one with the current local number of terminated photon
+   * packets.
+   *
+   * @param local_number_done Number of photon packets that were terminated on
+   * this process.
+   * @param total_number_of_photons Total number of photon packets on all
+   * processes.
+   * @return True if all photon packets on all processes have been terminated.
+   */
+  inline bool is_finished(const uint64_t local_number_done,
+                          const uint64_t total_number_of_photons) {
+#ifdef HAVE_MPI
+    if (_finished.value() || !_lock.try_lock()) {
+      return _finished.value();
+    }
+    if (!_reduction_active) {
+      _local_number_done = local_number_done;
+      MPI_Iallreduce(&_local_number_done, &_global_number_done, 1,
+                     MPI_UINT64_T, MPI_SUM, _communicator,
+                     &_reduction_request);
+      _reduction_active = true;
+    }
+    int flag;
+    MPI_Test(&_reduction_request, &flag, MPI_STATUS_IGNORE);
+    if (flag) {
+      _reduction_active = false;
+      cmac_assert_message(_global_number_done <= total_number_of_photons,
+                          "Too many photons terminated: %" PRIu64
+                          " (expected %" PRIu64 ")!",
+                          _global_number_done, total_number_of_photons);
+      _finished.set(_global_number_done == total_number_of_photons);
+    }
+    _lock.unlock();
+    return _finished.value();
+#else
+    return true;
+#endif
+  }
+
+  /**
+   * @brief Prepare the communicator for a new photon propagation phase.
+   *
+   * Waits for all pending sends to complete. Should only be called from
+   * serial code after is_finished() returned true.
+   */
+  inline void reset() {
+#ifdef HAVE_MPI
+    if (_send_requests.size() > 0) {
+      MPI_Waitall(_send_requests.size(), &_send_requests[0],
+                  MPI_STATUSES_IGNORE);
+    }
+    for (size_t i = 0; i < _send_buffers.size(); ++i) {
+      delete[] _send_buffers[i];
+    }
+    _send_buffers.clear();
+    _send_requests.clear();
+    cmac_assert(!_reduction_active);
+    _finished.set(false);
+#endif
+  }
+};
+
+#endif // PHOTONBUFFERCOMMUNICATOR_HPP
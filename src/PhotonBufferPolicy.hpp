@@ -0,0 +1,340 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file PhotonBufferPolicy.hpp
+ *
+ * @brief Adaptive choice of the photon buffer capacity and the premature
+ * launch threshold for every subgrid.
+ *
+ * During a photon propagation step, every photon traversal task records the
+ * number of photon packets it handled and the number of CPU cycles it took.
+ * At the end of the step, these statistics are used to set the capacity of
+ * the buffers that feed into every subgrid for the next step:
+ *  - the capacity is limited so that a full buffer does not take longer than
+ *    a target number of CPU cycles to traverse (using a running average of the
+ *    cost per photon packet for that subgrid), which keeps the task
+ *    granularity small enough to balance the load for expensive subgrids,
+ *  - the capacity is limited to twice the average number of photon packets
+ *    per task, so that subgrids that only receive a trickle of photon packets
+ *    launch full buffers rather than waiting for a premature launch,
+ *  - the capacity is never smaller than a minimum size (to limit the task
+ *    overhead) and never larger than PHOTONBUFFER_SIZE.
+ *
+ * The policy also sets a flush threshold for every subgrid: idle threads only
+ * prematurely launch buffers that contain at least that many photon packets,
+ * until they failed to find such a buffer a given number of times in a row.
+ * From then on, the thread launches buffers irrespective of their size until
+ * the end of the step (the step is then draining its last photon packets).
+ * This avoids launching very small tasks early on during the step, while still
+ * guaranteeing that all buffers are eventually launched.
+ *
+ * Statistics are recorded with atomic counters; the capacities and
+ * thresholds are only updated in between propagation steps, so that they can
+ * be read by all threads without synchronisation.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef PHOTONBUFFERPOLICY_HPP
+#define PHOTONBUFFERPOLICY_HPP
+
+#include "AtomicValue.hpp"
+#include "Error.hpp"
+#include "ParameterFile.hpp"
+#include "PhotonBuffer.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <vector>
+
+/**
+ * @brief Adaptive choice of the photon buffer capacity and the premature
+ * launch threshold for every subgrid.
+ */
+class PhotonBufferPolicy {
+private:
+  /*! @brief Minimum buffer capacity. */
+  const uint_fast32_t _minimum_capacity;
+
+  /*! @brief Target number of CPU cycles for a single photon traversal task. */
+  const double _target_task_cycles;
+
+  /*! @brief Fraction of the buffer capacity that needs to be filled before a
+   *  buffer can be launched prematurely. */
+  const double _flush_fraction;
+
+  /*! @brief Number of consecutive failed premature launch attempts after which
+   *  a thread launches buffers irrespective of the flush threshold for the
+   *  remainder of the step. */
+  const uint_fast32_t _flush_patience;
+
+  /*! @brief Weight of the newest measurement in the running average of the
+   *  cost per photon packet. */
+  const double _smoothing;
+
+  /*! @brief Number of traversal tasks for every subgrid during the current
+   *  step. */
+  std::vector< AtomicValue< uint_fast64_t > > _number_of_tasks;
+
+  /*! @brief Number of traversed photon packets for every subgrid during the
+   *  current step. */
+  std::vector< AtomicValue< uint_fast64_t > > _number_of_photons;
+
+  /*! @brief Number of CPU cycles spent in traversal tasks for every subgrid
+   *  during the current step. */
+  std::vector< AtomicValue< uint_fast64_t > > _number_of_cycles;
+
+  /*! @brief Running average of the number of CPU cycles per photon packet for
+   *  every subgrid (0 if no information is available yet). */
+  std::vector< double > _cycles_per_photon;
+
+  /*! @brief Capacity of buffers that feed into every subgrid. */
+  std::vector< uint_fast32_t > _capacity;
+
+  /*! @brief Premature launch threshold for every subgrid. */
+  std::vector< uint_fast32_t > _flush_threshold;
+
+  /*! @brief Total number of traversal tasks during the last step. */
+  uint_fast64_t _last_number_of_tasks;
+
+  /*! @brief Total number of traversed photon packets during the last step. */
+  uint_fast64_t _last_number_of_photons;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param minimum_capacity Minimum buffer capacity.
+   * @param target_task_cycles Target number of CPU cycles for a single photon
+   * traversal task.
+   * @param flush_fraction Fraction of the buffer capacity that needs to be
+   * filled before a buffer can be launched prematurely.
+   * @param flush_patience Number of consecutive failed premature launch
+   * attempts after which a thread launches buffers irrespective of the flush
+   * threshold.
+   * @param smoothing Weight of the newest measurement in the running average
+   * of the cost per photon packet.
+   */
+  inline PhotonBufferPolicy(const uint_fast32_t minimum_capacity = 20,
+                            const double target_task_cycles = 1.e6,
+                            const double flush_fraction = 0.25,
+                            const uint_fast32_t flush_patience = 16,
+                            const double smoothing = 0.5)
+      : _minimum_capacity(minimum_capacity),
+        _target_task_cycles(target_task_cycles),
+        _flush_fraction(flush_fraction), _flush_patience(flush_patience),
+        _smoothing(smoothing), _last_number_of_tasks(0),
+        _last_number_of_photons(0) {
+
+    if (_minimum_capacity == 0 || _minimum_capacity > PHOTONBUFFER_SIZE) {
+      cmac_error("Minimum buffer size should be in the range [1, %u]!",
+                 PHOTONBUFFER_SIZE);
+    }
+    if (_flush_fraction < 0. || _flush_fraction > 1.) {
+      cmac_error("Flush fraction should be in the range [0, 1]!");
+    }
+    if (_smoothing <= 0. || _smoothing > 1.) {
+      cmac_error("Smoothing factor should be in the range (0, 1]!");
+    }
+  }
+
+  /**
+   * @brief ParameterFile constructor.
+   *
+   * Parameters are:
+   *  - minimum buffer size: Minimum buffer capacity (default: 20)
+   *  - target task cycles: Target number of CPU cycles for a single photon
+   *    traversal task (default: 1.e6)
+   *  - flush fraction: Fraction of the buffer capacity that needs to be filled
+   *    before a buffer can be launched prematurely (default: 0.25)
+   *  - flush patience: Number of consecutive failed premature launch attempts
+   *    after which buffers are launched irrespective of their size
+   *    (default: 16)
+   *  - smoothing: Weight of the newest measurement in the running average of
+   *    the cost per photon packet (default: 0.5)
+   *
+   * @param params ParameterFile to read from.
+   */
+  inline PhotonBufferPolicy(ParameterFile &params)
+      : PhotonBufferPolicy(
+            params.get_value< uint_fast32_t >(
+                "PhotonBufferPolicy:minimum buffer size", 20),
+            params.get_value< double >("PhotonBufferPolicy:target task cycles",
+                                       1.e6),
+            params.get_value< double >("PhotonBufferPolicy:flush fraction",
+                                       0.25),
+            params.get_value< uint_fast32_t >(
+                "PhotonBufferPolicy:flush patience", 16),
+            params.get_value< double >("PhotonBufferPolicy:smoothing", 0.5)) {
+  }
+
+  /**
+   * @brief Set the number of subgrids.
+   *
+   * If the number of subgrids changed, all statistics are discarded and every
+   * subgrid starts with the maximum capacity.
+   *
+   * @param number_of_subgrids Number of subgrids (including copies).
+   */
+  inline void set_number_of_subgrids(const size_t number_of_subgrids) {
+    if (number_of_subgrids == _capacity.size()) {
+      return;
+    }
+    _number_of_tasks =
+        std::vector< AtomicValue< uint_fast64_t > >(number_of_subgrids);
+    _number_of_photons =
+        std::vector< AtomicValue< uint_fast64_t > >(number_of_subgrids);
+    _number_of_cycles =
+        std::vector< AtomicValue< uint_fast64_t > >(number_of_subgrids);
+    _cycles_per_photon.assign(number_of_subgrids, 0.);
+    _capacity.assign(number_of_subgrids, PHOTONBUFFER_SIZE);
+    _flush_threshold.assign(number_of_subgrids,
+                            _flush_fraction * PHOTONBUFFER_SIZE);
+  }
+
+  /**
+   * @brief Record the execution of a photon traversal task.
+   *
+   * @param subgrid Index of the traversed subgrid.
+   * @param number_of_photons Number of photon packets in the input buffer.
+   * @param number_of_cycles Duration of the task (in CPU cycles).
+   */
+  inline void record_task(const size_t subgrid,
+                          const uint_fast32_t number_of_photons,
+                          const uint_fast64_t number_of_cycles) {
+    _number_of_tasks[subgrid].pre_increment();
+    _number_of_photons[subgrid].pre_add(number_of_photons);
+    _number_of_cycles[subgrid].pre_add(number_of_cycles);
+  }
+
+  /**
+   * @brief Update the capacities and flush thresholds using the statistics
+   * of the last step, and reset the statistics.
+   *
+   * Subgrids without traversal tasks during the last step keep their old
+   * values. This function should not be called while photon packets are
+   * being propagated.
+   */
+  inline void update() {
+    _last_number_of_tasks = 0;
+    _last_number_of_photons = 0;
+    for (size_t igrid = 0; igrid < _capacity.size(); ++igrid) {
+      const uint_fast64_t number_of_tasks = _number_of_tasks[igrid].value();
+      const uint_fast64_t number_of_photons =
+          _number_of_photons[igrid].value();
+      const uint_fast64_t number_of_cycles = _number_of_cycles[igrid].value();
+      _number_of_tasks[igrid].set(0);
+      _number_of_photons[igrid].set(0);
+      _number_of_cycles[igrid].set(0);
+      _last_number_of_tasks += number_of_tasks;
+      _last_number_of_photons += number_of_photons;
+      if (number_of_photons == 0) {
+        continue;
+      }
+
+      const double cycles_per_photon =
+          static_cast< double >(number_of_cycles) / number_of_photons;
+      if (_cycles_per_photon[igrid] > 0.) {
+        _cycles_per_photon[igrid] =
+            _smoothing * cycles_per_photon +
+            (1. - _smoothing) * _cycles_per_photon[igrid];
+      } else {
+        _cycles_per_photon[igrid] = cycles_per_photon;
+      }
+
+      const double occupancy =
+          static_cast< double >(number_of_photons) / number_of_tasks;
+      double capacity = 2. * occupancy;
+      if (_cycles_per_photon[igrid] > 0.) {
+        capacity =
+            std::min(capacity, _target_task_cycles / _cycles_per_photon[igrid]);
+      }
+      capacity = std::max(capacity, static_cast< double >(_minimum_capacity));
+      capacity = std::min(capacity, static_cast< double >(PHOTONBUFFER_SIZE));
+      _capacity[igrid] = capacity;
+      _flush_threshold[igrid] = _flush_fraction * _capacity[igrid];
+    }
+  }
+
+  /**
+   * @brief Get the capacity of buffers that feed into the given subgrid.
+   *
+   * @param subgrid Subgrid index.
+   * @return Buffer capacity.
+   */
+  inline uint_fast32_t get_capacity(const size_t subgrid) const {
+    return _capacity[subgrid];
+  }
+
+  /**
+   * @brief Get the minimum number of photon packets a buffer that feeds into
+   * the given subgrid needs to contain before it can be launched prematurely.
+   *
+   * @param subgrid Subgrid index.
+   * @return Flush threshold.
+   */
+  inline uint_fast32_t get_flush_threshold(const size_t subgrid) const {
+    return _flush_threshold[subgrid];
+  }
+
+  /**
+   * @brief Get the number of consecutive failed premature launch attempts
+   * after which buffers are launched irrespective of the flush threshold.
+   *
+   * @return Flush patience.
+   */
+  inline uint_fast32_t get_flush_patience() const { return _flush_patience; }
+
+  /**
+   * @brief Get the total number of traversal tasks during the last step.
+   *
+   * @return Number of traversal tasks.
+   */
+  inline uint_fast64_t get_last_number_of_tasks() const {
+    return _last_number_of_tasks;
+  }
+
+  /**
+   * @brief Get the total number of traversed photon packets during the last
+   * step.
+   *
+   * @return Number of traversed photon packets (a photon packet is counted
+   * once for every subgrid it traverses).
+   */
+  inline uint_fast64_t get_last_number_of_photons() const {
+    return _last_number_of_photons;
+  }
+
+  /**
+   * @brief Get the average buffer capacity over all subgrids.
+   *
+   * @return Average buffer capacity.
+   */
+  inline double get_average_capacity() const {
+    if (_capacity.empty()) {
+      return PHOTONBUFFER_SIZE;
+    }
+    double sum = 0.;
+    for (size_t igrid = 0; igrid < _capacity.size(); ++igrid) {
+      sum += _capacity[igrid];
+    }
+    return sum / _capacity.size();
+  }
+};
+
+#endif // PHOTONBUFFERPOLICY_HPP
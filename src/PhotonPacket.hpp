@@ -26,20 +26,34 @@
 #ifndef PHOTONPACKET_HPP
 #define PHOTONPACKET_HPP
 
-/*! @brief Size of the MPI buffer necessary to store a single Photon. */
-#define PHOTON_MPI_SIZE ((9 + NUMBER_OF_IONNAMES) * sizeof(double))
-
 #include "Configuration.hpp"
 #include "CoordinateVector.hpp"
 #include "ElementNames.hpp"
 #include "PhotonType.hpp"
 
+#ifdef USE_COMPACT_PHOTON_PACKET
+#include "Abundances.hpp"
+#include "TabulatedCrossSections.hpp"
+
+/*! @brief Size of the MPI buffer necessary to store a single Photon. */
+#define PHOTON_MPI_SIZE                                                        \
+  (8 * sizeof(double) + 2 * sizeof(float) + sizeof(uint_least16_t))
+#else
+/*! @brief Size of the MPI buffer necessary to store a single Photon. */
+#define PHOTON_MPI_SIZE ((9 + NUMBER_OF_IONNAMES) * sizeof(double))
+#endif
+
 #ifdef HAVE_MPI
 #include <mpi.h>
 #endif
 
 /**
  * @brief Photon packet.
+ *
+ * If USE_COMPACT_PHOTON_PACKET is defined, the photon packet does not store
+ * its photoionization cross sections, but only its position in the
+ * TabulatedCrossSections table that is shared by all photon packets. The
+ * weight is then also stored in single precision.
  */
 class PhotonPacket {
 private:
@@ -52,16 +66,30 @@ private:
   /*! @brief Target optical depth for the photon packet. */
   double _target_optical_depth;
 
+#ifndef USE_COMPACT_PHOTON_PACKET
   /*! @brief Photoionization cross section of the photons in the photon packet
    *  (in m^2). Note that for ions other than hydrogen, these values contain an
    *  additional abundance factor. */
   double _photoionization_cross_section[NUMBER_OF_IONNAMES];
+#endif
 
   /*! @brief Energy of the photon packet (in Hz). */
   double _energy;
 
+#ifdef USE_COMPACT_PHOTON_PACKET
+  /*! @brief Weight of the photon packet. */
+  float _weight;
+
+  /*! @brief Relative position of the energy within its frequency bin. */
+  float _frequency_weight;
+
+  /*! @brief Index of the frequency bin in the cross section table (see
+   *  TabulatedCrossSections::get_table_position()). */
+  uint_least16_t _frequency_bin;
+#else
   /*! @brief Weight of the photon packet. */
   double _weight;
+#endif
 
   /*! @brief Type of the photon. All photons start off as PHOTONTYPE_PRIMARY,
    *  but their type can change during reemission events. */
@@ -70,7 +98,60 @@ private:
   /*! @brief Tracer for the number of scatterings the photon experiences */
   uint_fast32_t _scatter_counter;
 
+#ifdef USE_COMPACT_PHOTON_PACKET
+  /**
+   * @brief Get a reference to the pointer to the cross section table that is
+   * shared by all photon packets.
+   *
+   * @return Reference to the table pointer.
+   */
+  static inline const TabulatedCrossSections *&cross_section_table() {
+    static const TabulatedCrossSections *table = nullptr;
+    return table;
+  }
+
+  /**
+   * @brief Get the abundance factors that are applied to the cross sections
+   * from the shared table.
+   *
+   * @return Abundance factors for all ions.
+   */
+  static inline double *abundance_factors() {
+    static double factors[NUMBER_OF_IONNAMES];
+    return factors;
+  }
+#endif
+
 public:
+#ifdef USE_COMPACT_PHOTON_PACKET
+  /**
+   * @brief Set the cross section table that is shared by all photon packets.
+   *
+   * This table needs to be set before the energy of any photon packet is set
+   * and should remain valid for as long as photon packets are in use.
+   *
+   * For ions other than hydrogen, the cross sections include the abundance of
+   * the corresponding element, unless abundances are variable.
+   *
+   * @param table TabulatedCrossSections to use.
+   * @param abundances Abundances.
+   */
+  static inline void
+  set_cross_section_table(const TabulatedCrossSections *table,
+                          const Abundances &abundances) {
+    cross_section_table() = table;
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+#ifndef VARIABLE_ABUNDANCES
+      abundance_factors()[ion] =
+          (ion != ION_H_n) ? abundances.get_abundance(get_element(ion)) : 1.;
+#else
+      abundance_factors()[ion] = 1.;
+#endif
+    }
+  }
+#endif
+
+
 #ifdef HAVE_MPI
   /**
    * @brief Store the contents of the PhotonPacket in the given MPI
@@ -87,12 +168,24 @@ public:
              &buffer_position, MPI_COMM_WORLD);
     MPI_Pack(&_target_optical_depth, 1, MPI_DOUBLE, buffer, PHOTON_MPI_SIZE,
              &buffer_position, MPI_COMM_WORLD);
+#ifdef USE_COMPACT_PHOTON_PACKET
+    MPI_Pack(&_energy, 1, MPI_DOUBLE, buffer, PHOTON_MPI_SIZE, &buffer_position,
+             MPI_COMM_WORLD);
+    MPI_Pack(&_weight, 1, MPI_FLOAT, buffer, PHOTON_MPI_SIZE, &buffer_position,
+             MPI_COMM_WORLD);
+    MPI_Pack(&_frequency_weight, 1, MPI_FLOAT, buffer, PHOTON_MPI_SIZE,
+             &buffer_position, MPI_COMM_WORLD);
+    unsigned short frequency_bin = _frequency_bin;
+    MPI_Pack(&frequency_bin, 1, MPI_UNSIGNED_SHORT, buffer, PHOTON_MPI_SIZE,
+             &buffer_position, MPI_COMM_WORLD);
+#else
     MPI_Pack(_photoionization_cross_section, NUMBER_OF_IONNAMES, MPI_DOUBLE,
              buffer, PHOTON_MPI_SIZE, &buffer_position, MPI_COMM_WORLD);
     MPI_Pack(&_energy, 1, MPI_DOUBLE, buffer, PHOTON_MPI_SIZE, &buffer_position,
              MPI_COMM_WORLD);
     MPI_Pack(&_weight, 1, MPI_DOUBLE, buffer, PHOTON_MPI_SIZE, &buffer_position,
              MPI_COMM_WORLD);
+#endif
   }
 
   /**
@@ -117,6 +210,18 @@ public:
     _direction[2] = temp[2];
     MPI_Unpack(buffer, PHOTON_MPI_SIZE, &buffer_position,
                &_target_optical_depth, 1, MPI_DOUBLE, MPI_COMM_WORLD);
+#ifdef USE_COMPACT_PHOTON_PACKET
+    MPI_Unpack(buffer, PHOTON_MPI_SIZE, &buffer_position, &_energy, 1,
+               MPI_DOUBLE, MPI_COMM_WORLD);
+    MPI_Unpack(buffer, PHOTON_MPI_SIZE, &buffer_position, &_weight, 1,
+               MPI_FLOAT, MPI_COMM_WORLD);
+    MPI_Unpack(buffer, PHOTON_MPI_SIZE, &buffer_position, &_frequency_weight,
+               1, MPI_FLOAT, MPI_COMM_WORLD);
+    unsigned short frequency_bin;
+    MPI_Unpack(buffer, PHOTON_MPI_SIZE, &buffer_position, &frequency_bin, 1,
+               MPI_UNSIGNED_SHORT, MPI_COMM_WORLD);
+    _frequency_bin = frequency_bin;
+#else
     MPI_Unpack(buffer, PHOTON_MPI_SIZE, &buffer_position,
                _photoionization_cross_section, NUMBER_OF_IONNAMES, MPI_DOUBLE,
                MPI_COMM_WORLD);
@@ -124,6 +229,7 @@ public:
                MPI_DOUBLE, MPI_COMM_WORLD);
     MPI_Unpack(buffer, PHOTON_MPI_SIZE, &buffer_position, &_weight, 1,
                MPI_DOUBLE, MPI_COMM_WORLD);
+#endif
   }
 #endif
 
@@ -148,11 +254,17 @@ public:
                         "Directions do not match!");
     cmac_assert_message(_target_optical_depth == other._target_optical_depth,
                         "Target optical depths do not match!");
+#ifdef USE_COMPACT_PHOTON_PACKET
+    cmac_assert_message(_frequency_bin == other._frequency_bin &&
+                            _frequency_weight == other._frequency_weight,
+                        "Frequency bins do not match!");
+#else
     for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
       cmac_assert_message(_photoionization_cross_section[i] ==
                               other._photoionization_cross_section[i],
                           "Cross sections do not match!");
     }
+#endif
     cmac_assert_message(_energy == other._energy, "Energies do not match!");
     cmac_assert_message(_weight == other._weight, "Weights do not match!");
   }
@@ -226,9 +338,16 @@ public:
    */
   inline double
   get_photoionization_cross_section(const int_fast32_t ion) const {
+#ifdef USE_COMPACT_PHOTON_PACKET
+    return abundance_factors()[ion] *
+           cross_section_table()->get_cross_section(
+               ion, _energy, _frequency_bin, _frequency_weight);
+#else
     return _photoionization_cross_section[ion];
+#endif
   }
 
+#ifndef USE_COMPACT_PHOTON_PACKET
   /**
    * @brief Set the photoionization cross section for the given ion for the
    * photon packet.
@@ -241,6 +360,7 @@ public:
       const int_fast32_t ion, const double photoionization_cross_section) {
     _photoionization_cross_section[ion] = photoionization_cross_section;
   }
+#endif
 
   /**
    * @brief Get the energy of the photon packet.
@@ -252,9 +372,20 @@ public:
   /**
    * @brief Set the energy of the photon packet.
    *
+   * If compact photon packets are used, this also sets the photoionization
+   * cross sections.
+   *
    * @param energy Energy of the photon packet (in Hz).
    */
-  inline void set_energy(const double energy) { _energy = energy; }
+  inline void set_energy(const double energy) {
+    _energy = energy;
+#ifdef USE_COMPACT_PHOTON_PACKET
+    cmac_assert_message(cross_section_table() != nullptr,
+                        "No cross section table set!");
+    cross_section_table()->get_table_position(energy, _frequency_bin,
+                                              _frequency_weight);
+#endif
+  }
 
   /**
    * @brief Get the weight for the photon packet.
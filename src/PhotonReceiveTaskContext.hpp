@@ -0,0 +1,107 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file PhotonReceiveTaskContext.hpp
+ *
+ * @brief Task context responsible for receiving photon buffers sent by other
+ * MPI processes.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef PHOTONRECEIVETASKCONTEXT_HPP
+#define PHOTONRECEIVETASKCONTEXT_HPP
+
+#include "DensitySubGridCreator.hpp"
+#include "MemorySpace.hpp"
+#include "PhotonBufferCommunicator.hpp"
+#include "Task.hpp"
+#include "TaskQueue.hpp"
+
+/**
+ * @brief Task context responsible for receiving photon buffers sent by other
+ * MPI processes.
+ *
+ * Incoming photon buffers are polled for by idle threads. Every received
+ * buffer is turned into a photon traversal task for the local subgrid it
+ * belongs to.
+ */
+template < typename _subgrid_type_ > class PhotonReceiveTaskContext {
+private:
+  /*! @brief Photon buffer array. */
+  MemorySpace &_buffers;
+
+  /*! @brief Grid creator. */
+  DensitySubGridCreator< _subgrid_type_ > &_grid_creator;
+
+  /*! @brief Task space. */
+  ThreadSafeVector< Task > &_tasks;
+
+  /*! @brief Queues per thread. */
+  std::vector< TaskQueue * > &_queues;
+
+  /*! @brief Photon buffer communicator. */
+  PhotonBufferCommunicator &_communicator;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param buffers Photon buffer array.
+   * @param grid_creator Grid creator.
+   * @param tasks Task space.
+   * @param queues Thread queues.
+   * @param communicator Photon buffer communicator.
+   */
+  inline PhotonReceiveTaskContext(
+      MemorySpace &buffers,
+      DensitySubGridCreator< _subgrid_type_ > &grid_creator,
+      ThreadSafeVector< Task > &tasks, std::vector< TaskQueue * > &queues,
+      PhotonBufferCommunicator &communicator)
+      : _buffers(buffers), _grid_creator(grid_creator), _tasks(tasks),
+        _queues(queues), _communicator(communicator) {}
+
+  /**
+   * @brief Execute a photon buffer receive task.
+   *
+   * @return True if a photon buffer was received.
+   */
+  inline bool execute() {
+
+    size_t buffer_index = 0;
+    if (!_communicator.try_receive(_buffers, buffer_index)) {
+      return false;
+    }
+
+    const size_t subgrid_index = _buffers[buffer_index].get_subgrid_index();
+    cmac_assert(_grid_creator.is_local(subgrid_index));
+    DensitySubGrid &subgrid = *_grid_creator.get_subgrid(subgrid_index);
+
+    const size_t task_index = _tasks.get_free_element();
+    Task &new_task = _tasks[task_index];
+    new_task.set_subgrid(subgrid_index);
+    new_task.set_buffer(buffer_index);
+    new_task.set_type(TASKTYPE_PHOTON_TRAVERSAL);
+    new_task.set_dependency(subgrid.get_traversal_dependency());
+    _queues[subgrid.get_owning_thread()]->add_task(task_index);
+
+    return true;
+  }
+};
+
+#endif // PHOTONRECEIVETASKCONTEXT_HPP
@@ -68,6 +68,12 @@ private:
   /*! @brief Number of photon packets that has been terminated. */
   AtomicValue< uint_fast32_t > &_num_photon_done;
 
+  /*! @brief Iteration number, used to select random generator substreams. */
+  const uint_fast32_t _iteration;
+
+  /*! @brief Number of reemission tasks that has been started. */
+  AtomicValue< uint_fast32_t > _number_of_tasks_started;
+
 public:
   /**
    * @brief Constructor.
@@ -80,6 +86,8 @@ public:
    * @param grid_creator Grid creator.
    * @param tasks Task space.
    * @param num_photon_done Number of photon packets that has been terminated.
+   * @param iteration Iteration number, used to select random generator
+   * substreams.
    */
   inline PhotonReemitTaskContext(
       MemorySpace &buffers, std::vector< RandomGenerator > &random_generators,
@@ -87,11 +95,13 @@ public:
       const Abundances &abundances, const CrossSections &cross_sections,
       DensitySubGridCreator< _subgrid_type_ > &grid_creator,
       ThreadSafeVector< Task > &tasks,
-      AtomicValue< uint_fast32_t > &num_photon_done)
+      AtomicValue< uint_fast32_t > &num_photon_done,
+      const uint_fast32_t iteration)
       : _buffers(buffers), _random_generators(random_generators),
         _reemission_handler(reemission_handler), _abundances(abundances),
         _cross_sections(cross_sections), _grid_creator(grid_creator),
-        _tasks(tasks), _num_photon_done(num_photon_done) {}
+        _tasks(tasks), _num_photon_done(num_photon_done),
+        _iteration(iteration), _number_of_tasks_started(0) {}
 
   /**
    * @brief Execute a photon reemission task.
@@ -115,6 +125,14 @@ public:
     uint_fast32_t num_photon_done_now = buffer.size();
     DensitySubGrid &subgrid = *_grid_creator.get_subgrid(task.get_subgrid());
 
+    // the contents of the buffer depend on the order in which tasks are
+    // executed, so reemission cannot be reproducible; we only make sure that
+    // every task gets its own substream, by numbering the tasks after all
+    // possible source task indices
+    const uint_fast32_t job =
+        _tasks.max_size() + _number_of_tasks_started.post_increment();
+    _random_generators[thread_id].set_job_substream(_iteration, job);
+
     // reemission
     uint_fast32_t index = 0;
     for (uint_fast32_t iphoton = 0; iphoton < buffer.size(); ++iphoton) {
@@ -145,15 +163,6 @@ public:
         new_photon.set_weight(old_photon.get_weight());
 
         new_photon.set_energy(new_frequency);
-        for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-          double sigma = _cross_sections.get_cross_section(ion, new_frequency);
-#ifndef VARIABLE_ABUNDANCES
-          if (ion != ION_H_n) {
-            sigma *= _abundances.get_abundance(get_element(ion));
-          }
-#endif
-          new_photon.set_photoionization_cross_section(ion, sigma);
-        }
 
         // draw two pseudo random numbers
         const double cost =
@@ -182,6 +191,7 @@ public:
     // update the size of the buffer to account for photons that were
     // not reemitted
     buffer.grow(index);
+    buffer.set_photoionization_cross_sections(_cross_sections, _abundances);
 
     num_photon_done_now -= buffer.size();
     _num_photon_done.pre_add(num_photon_done_now);
@@ -195,7 +205,7 @@ public:
       new_task.set_type(TASKTYPE_PHOTON_TRAVERSAL);
       new_task.set_subgrid(task.get_subgrid());
       new_task.set_buffer(current_buffer_index);
-      new_task.set_dependency(subgrid.get_dependency());
+      new_task.set_dependency(subgrid.get_traversal_dependency());
 
       queues_to_add[num_tasks_to_add] = subgrid.get_owning_thread();
       tasks_to_add[num_tasks_to_add] = task_index;
@@ -72,25 +72,7 @@ PhotonSource::PhotonSource(PhotonSourceDistribution *distribution,
   double discrete_luminosity = 0.;
   double continuous_luminosity = 0.;
   if (distribution != nullptr) {
-    _discrete_positions.resize(distribution->get_number_of_sources());
-    _discrete_probabilities.resize(distribution->get_number_of_sources());
-    for (size_t i = 0; i < _discrete_positions.size(); ++i) {
-      _discrete_positions[i] = distribution->get_position(i);
-      if (i > 0) {
-        _discrete_probabilities[i] =
-            _discrete_probabilities[i - 1] + distribution->get_weight(i);
-      } else {
-        _discrete_probabilities[i] = distribution->get_weight(i);
-      }
-    }
-    if (_discrete_probabilities.size() > 0) {
-      if (std::abs(_discrete_probabilities.back() - 1.) > 1.e-9) {
-        cmac_error("Discrete source weights do not sum to 1.0 (%g)!",
-                   _discrete_probabilities.back());
-      } else {
-        _discrete_probabilities.back() = 1.;
-      }
-    }
+    set_discrete_sources(*distribution);
     discrete_luminosity = distribution->get_total_luminosity();
 
     if (_log) {
@@ -188,9 +170,10 @@ PhotonSource::~PhotonSource() { delete _reemission_handler; }
  */
 void PhotonSource::set_cross_sections(Photon &photon, double energy) const {
 
+  double sigma[NUMBER_OF_IONNAMES];
+  _cross_sections.get_cross_sections(energy, sigma);
   for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-    photon.set_cross_section(ion,
-                             _cross_sections.get_cross_section(ion, energy));
+    photon.set_cross_section(ion, sigma[ion]);
   }
 #ifdef HAS_HELIUM
   photon.set_cross_section_He_corr(_abundances.get_abundance(ELEMENT_He) *
@@ -198,6 +181,34 @@ void PhotonSource::set_cross_sections(Photon &photon, double energy) const {
 #endif
 }
 
+/**
+ * @brief Copy the positions of the discrete sources from the given
+ * PhotonSourceDistribution and (re)build the alias table used to select a
+ * source for every photon.
+ *
+ * @param distribution Discrete PhotonSourceDistribution.
+ */
+void PhotonSource::set_discrete_sources(
+    PhotonSourceDistribution &distribution) {
+
+  const size_t number_of_sources = distribution.get_number_of_sources();
+  _discrete_positions.resize(number_of_sources);
+  _discrete_weights.resize(number_of_sources);
+  double total_weight = 0.;
+  for (size_t i = 0; i < number_of_sources; ++i) {
+    _discrete_positions[i] = distribution.get_position(i);
+    _discrete_weights[i] = distribution.get_weight(i);
+    total_weight += _discrete_weights[i];
+  }
+  if (number_of_sources > 0) {
+    if (std::abs(total_weight - 1.) > 1.e-9) {
+      cmac_error("Discrete source weights do not sum to 1.0 (%g)!",
+                 total_weight);
+    }
+  }
+  _discrete_alias_table.initialize(_discrete_weights);
+}
+
 /**
  * @brief Get a photon with a random direction and energy, originating at one
  * of the discrete sources.
@@ -216,16 +227,10 @@ PhotonSource::get_random_photon(RandomGenerator &random_generator) const {
 
   double x = random_generator.get_uniform_random_double();
   if (x >= _continuous_probability) {
-    cmac_assert(_discrete_probabilities.size() > 0);
-    cmac_assert(_discrete_probabilities.back() == 1.);
-    // discrete photon
+    cmac_assert(_discrete_alias_table.size() > 0);
+    // discrete photon: select a source using the alias table
     x = random_generator.get_uniform_random_double();
-    size_t i = 0;
-    while (x > _discrete_probabilities[i]) {
-      ++i;
-      cmac_assert(i < _discrete_probabilities.size());
-    }
-    position = _discrete_positions[i];
+    position = _discrete_positions[_discrete_alias_table.get_index(x)];
     direction = get_random_direction(random_generator);
     energy = _discrete_spectrum->get_random_frequency(random_generator);
     weight = _discrete_photon_weight;
@@ -318,25 +323,7 @@ void PhotonSource::update(PhotonSourceDistribution *distribution) {
   double discrete_luminosity = 0.;
   double continuous_luminosity = 0.;
   if (distribution != nullptr) {
-    _discrete_positions.resize(distribution->get_number_of_sources());
-    _discrete_probabilities.resize(distribution->get_number_of_sources());
-    for (size_t i = 0; i < _discrete_positions.size(); ++i) {
-      _discrete_positions[i] = distribution->get_position(i);
-      if (i > 0) {
-        _discrete_probabilities[i] =
-            _discrete_probabilities[i - 1] + distribution->get_weight(i);
-      } else {
-        _discrete_probabilities[i] = distribution->get_weight(i);
-      }
-    }
-    if (_discrete_probabilities.size() > 0) {
-      if (std::abs(_discrete_probabilities.back() - 1.) > 1.e-9) {
-        cmac_error("Discrete source weights do not sum to 1.0 (%g)!",
-                   _discrete_probabilities.back());
-      } else {
-        _discrete_probabilities.back() = 1.;
-      }
-    }
+    set_discrete_sources(*distribution);
     discrete_luminosity = distribution->get_total_luminosity();
 
     if (_log) {
@@ -26,6 +26,7 @@
 #ifndef PHOTONSOURCE_HPP
 #define PHOTONSOURCE_HPP
 
+#include "AliasTable.hpp"
 #include "CoordinateVector.hpp"
 #include "DensityGrid.hpp"
 #include "DiffuseReemissionHandler.hpp"
@@ -70,9 +71,13 @@ private:
   /*! @brief Weight of discrete photons. */
   double _discrete_photon_weight;
 
-  /*! @brief Probabilities that a photon is emitted by a specific discrete
-   *  source. */
-  std::vector< double > _discrete_probabilities;
+  /*! @brief Alias table used to select the discrete source that emits a
+   *  photon. */
+  AliasTable _discrete_alias_table;
+
+  /*! @brief Weights of the discrete photon sources (kept to avoid reallocating
+   *  memory when the alias table is rebuilt). */
+  std::vector< double > _discrete_weights;
 
   /// continuous sources
 
@@ -110,6 +115,8 @@ private:
 
   void set_cross_sections(Photon &photon, double energy) const;
 
+  void set_discrete_sources(PhotonSourceDistribution &distribution);
+
 public:
   PhotonSource(PhotonSourceDistribution *distribution,
                const PhotonSourceSpectrum *discrete_spectrum,
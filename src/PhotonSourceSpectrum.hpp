@@ -26,6 +26,9 @@
 #ifndef PHOTONSOURCESPECTRUM_HPP
 #define PHOTONSOURCESPECTRUM_HPP
 
+#include <cinttypes>
+#include <vector>
+
 class RandomGenerator;
 
 /**
@@ -48,12 +51,46 @@ public:
   virtual double get_random_frequency(RandomGenerator &random_generator,
                                       double temperature = 0.) const = 0;
 
+  /**
+   * @brief Get a number of random frequencies from the spectrum.
+   *
+   * The default implementation calls get_random_frequency() for every
+   * frequency. Tabulated spectra override this function to convert all random
+   * numbers at once.
+   *
+   * @param random_generator RandomGenerator to use.
+   * @param frequencies Array to store the random frequencies in (in Hz).
+   * @param number_of_frequencies Number of random frequencies to generate.
+   * @param temperature Temperature of the gas (for reemission spectra) (in K).
+   */
+  virtual void fill_frequencies(RandomGenerator &random_generator,
+                                double *frequencies,
+                                const uint_fast32_t number_of_frequencies,
+                                double temperature = 0.) const {
+    for (uint_fast32_t i = 0; i < number_of_frequencies; ++i) {
+      frequencies[i] = get_random_frequency(random_generator, temperature);
+    }
+  }
+
   /**
    * @brief Get the total ionizing flux emitted by the spectrum.
    *
    * @return Total ionizing flux (in m^-2 s^-1).
    */
   virtual double get_total_flux() const = 0;
+
+  /**
+   * @brief Add the frequencies of a discrete spectrum to the given list.
+   *
+   * Spectra that only emit photons with a small number of distinct frequencies
+   * add these frequencies, so that exact values for e.g. cross sections can be
+   * precomputed. The default implementation (for continuous spectra) does
+   * nothing.
+   *
+   * @param frequencies List of frequencies to add to (in Hz).
+   */
+  virtual void
+  get_discrete_frequencies(std::vector< double > &frequencies) const {}
 };
 
 #endif // PHOTONSOURCESPECTRUM_HPP
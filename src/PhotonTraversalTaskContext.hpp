@@ -32,6 +32,8 @@
 #include "DensitySubGridCreator.hpp"
 #include "DiffuseReemissionHandler.hpp"
 #include "MemorySpace.hpp"
+#include "NUMATopology.hpp"
+#include "PhotonBufferPolicy.hpp"
 #include "PhotonPacketStatistics.hpp"
 #include "PhotonSourceSpectrum.hpp"
 #include "PhotonTraversalThreadContext.hpp"
@@ -64,6 +66,30 @@ private:
   /*! @brief Whether or not to store absorbed photon packets for reemission. */
   const bool _do_reemission;
 
+  /*! @brief Mapping of threads onto NUMA nodes. If set, subgrid ownership is
+   *  never transferred to a thread on another NUMA node (can be a nullptr). */
+  const NUMATopology *_topology;
+
+  /*! @brief Adaptive photon buffer policy. If set, traversal tasks are
+   *  recorded and new output buffers get the capacity set by the policy (can
+   *  be a nullptr). */
+  PhotonBufferPolicy *_buffer_policy;
+
+  /**
+   * @brief Transfer the ownership of the given subgrid to the given thread, if
+   * allowed.
+   *
+   * @param subgrid Subgrid.
+   * @param thread_id Thread that executes a task on the subgrid.
+   */
+  inline void claim_subgrid(DensitySubGrid &subgrid,
+                            const int_fast32_t thread_id) const {
+    if (_topology == nullptr ||
+        _topology->same_node(thread_id, subgrid.get_owning_thread())) {
+      subgrid.set_owning_thread(thread_id);
+    }
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -75,16 +101,22 @@ public:
    * @param statistics Statistical information about photon packets.
    * @param do_reemission Whether or not to store absorbed photon packets for
    * reemission.
+   * @param topology Mapping of threads onto NUMA nodes. If set, stolen tasks
+   * only transfer subgrid ownership within the same NUMA node.
+   * @param buffer_policy Adaptive photon buffer policy.
    */
   inline PhotonTraversalTaskContext(
       MemorySpace &buffers,
       DensitySubGridCreator< _subgrid_type_ > &grid_creator,
       ThreadSafeVector< Task > &tasks,
       AtomicValue< uint_fast32_t > &num_photon_done,
-      PhotonPacketStatistics *statistics, const bool do_reemission)
+      PhotonPacketStatistics *statistics, const bool do_reemission,
+      const NUMATopology *topology = nullptr,
+      PhotonBufferPolicy *buffer_policy = nullptr)
       : _buffers(buffers), _grid_creator(grid_creator), _tasks(tasks),
         _num_photon_done(num_photon_done), _statistics(statistics),
-        _do_reemission(do_reemission) {}
+        _do_reemission(do_reemission), _topology(topology),
+        _buffer_policy(buffer_policy) {}
 
   /**
    * @brief Execute a photon traversal task.
@@ -113,14 +145,33 @@ public:
     const uint_fast32_t igrid = photon_buffer.get_subgrid_index();
     DensitySubGrid &this_grid = *_grid_creator.get_subgrid(igrid);
 
-    // set the ownership of this grid to the current thread (in case this task
-    // was stolen)
-    this_grid.set_owning_thread(thread_id);
+    // subgrids with private intensity counters can be traversed by multiple
+    // threads at the same time; the subgrid dependency then only protects the
+    // output buffer bookkeeping below
+    ThreadLock *bookkeeping_lock = nullptr;
+    if (this_grid.get_traversal_dependency() == nullptr) {
+      bookkeeping_lock = this_grid.get_dependency();
+    } else {
+      // set the ownership of this grid to the current thread (in case this
+      // task was stolen)
+      claim_subgrid(this_grid, thread_id);
+    }
 
     traversal_thread_context.initialize(this_grid, _do_reemission);
 
     // keep track of the original number of photons
-    uint_fast32_t num_photon_done_now = photon_buffer.size();
+    const uint_fast32_t number_of_input_photons = photon_buffer.size();
+    uint_fast32_t num_photon_done_now = number_of_input_photons;
+
+#ifdef HAVE_BATCHED_TRAVERSAL
+    // traverse all photons in the input buffer at once
+    int_fast32_t results[PHOTONBUFFER_SIZE];
+    if (photon_buffer.size() > 0) {
+      this_grid.interact_batch< DENSITYSUBGRID_BATCH_WIDTH >(
+          &photon_buffer[0], photon_buffer.size(),
+          photon_buffer.get_direction(), results, thread_id);
+    }
+#endif
 
     // now loop over the input buffer photons and traverse them one by
     // one
@@ -135,9 +186,13 @@ public:
                               photon.get_direction()[2] != 0.,
                           "size: %" PRIuFAST32, photon_buffer.size());
 
+#ifdef HAVE_BATCHED_TRAVERSAL
+      const int_fast32_t result = results[i];
+#else
       // traverse the photon through the active subgrid
       const int_fast32_t result =
-          this_grid.interact(photon, photon_buffer.get_direction());
+          this_grid.interact(photon, photon_buffer.get_direction(), thread_id);
+#endif
 
       // check that the photon ended up in a valid output buffer
       cmac_assert_message(result >= 0 && result < TRAVELDIRECTION_NUMBER,
@@ -154,6 +209,11 @@ public:
       }
     }
 
+    if (bookkeeping_lock != nullptr) {
+      bookkeeping_lock->lock();
+      claim_subgrid(this_grid, thread_id);
+    }
+
     // add none empty buffers to the appropriate queues
     uint_fast8_t largest_index = TRAVELDIRECTION_NUMBER;
     uint_fast32_t largest_size = 0;
@@ -178,7 +238,15 @@ public:
 
         if (new_index == NEIGHBOUR_OUTSIDE) {
           // buffer was not created yet: create it now
-          new_index = _buffers.get_free_buffer();
+          // buffers for the neighbouring subgrids get the capacity set by the
+          // buffer policy
+          if (_buffer_policy != nullptr && i > 0 &&
+              _grid_creator.is_local(ngb)) {
+            new_index =
+                _buffers.get_free_buffer(_buffer_policy->get_capacity(ngb));
+          } else {
+            new_index = _buffers.get_free_buffer();
+          }
           PhotonBuffer &buffer = _buffers[new_index];
           buffer.set_subgrid_index(ngb);
           buffer.set_direction(TravelDirections::output_to_input_direction(i));
@@ -212,7 +280,19 @@ public:
           // internal buffer were absorbed and could be reemitted,
           // photon packets in the other buffers left the subgrid and
           // need to be traversed in the neighbouring subgrid
-          if (i > 0) {
+          if (i > 0 && !_grid_creator.is_local(ngb)) {
+            // the neighbouring subgrid lives on another process: send the
+            // buffer there
+            const size_t task_index = _tasks.get_free_element();
+            Task &new_task = _tasks[task_index];
+            new_task.set_subgrid(ngb);
+            new_task.set_buffer(new_index);
+            new_task.set_type(TASKTYPE_SEND);
+            // a send task has no dependencies
+            queues_to_add[num_tasks_to_add] = -1;
+            tasks_to_add[num_tasks_to_add] = task_index;
+            ++num_tasks_to_add;
+          } else if (i > 0) {
             DensitySubGrid &subgrid = *_grid_creator.get_subgrid(
                 _buffers[new_index].get_subgrid_index());
             const size_t task_index = _tasks.get_free_element();
@@ -223,7 +303,7 @@ public:
 
             // add dependencies for task:
             //  - subgrid
-            new_task.set_dependency(subgrid.get_dependency());
+            new_task.set_dependency(subgrid.get_traversal_dependency());
 
             // add the task to the queue of the corresponding thread
             const int_fast32_t queue_index =
@@ -273,6 +353,14 @@ public:
     // log the end time of the task
     cpucycle_tick(task_stop);
     this_grid.add_computational_cost(task_stop - task_start);
+    if (_buffer_policy != nullptr) {
+      _buffer_policy->record_task(igrid, number_of_input_photons,
+                                  task_stop - task_start);
+    }
+
+    if (bookkeeping_lock != nullptr) {
+      bookkeeping_lock->unlock();
+    }
 
     return num_tasks_to_add;
   }
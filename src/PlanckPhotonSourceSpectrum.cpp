@@ -101,6 +101,8 @@ PlanckPhotonSourceSpectrum::PlanckPhotonSourceSpectrum(double temperature,
     _log_cumulative_distribution[i] = std::log10(_cumulative_distribution[i]);
     _log_frequency[i] = std::log10(frequency[i]);
   }
+  _guide_table.initialize(_cumulative_distribution.data(),
+                          PLANCKPHOTONSOURCESPECTRUM_NUMFREQ);
 
   if (log) {
     log->write_status("Set up a Planck black body spectrum with temperature ",
@@ -150,8 +152,8 @@ double PlanckPhotonSourceSpectrum::get_random_frequency(
     RandomGenerator &random_generator, double temperature) const {
   double x = random_generator.get_uniform_random_double();
 
-  uint_fast32_t ix = Utilities::locate(x, _cumulative_distribution.data(),
-                                       PLANCKPHOTONSOURCESPECTRUM_NUMFREQ);
+  const uint_fast32_t ix =
+      _guide_table.locate(x, _cumulative_distribution.data());
   double log_random_frequency =
       (std::log10(x) - _log_cumulative_distribution[ix]) /
           (_log_cumulative_distribution[ix + 1] -
@@ -27,6 +27,7 @@
 #ifndef PLANCKPHOTONSOURCESPECTRUM_HPP
 #define PLANCKPHOTONSOURCESPECTRUM_HPP
 
+#include "GuideTable.hpp"
 #include "PhotonSourceSpectrum.hpp"
 
 #include <string>
@@ -56,6 +57,9 @@ private:
   /*! @brief Cumulative distribution in each bin. */
   std::vector< double > _cumulative_distribution;
 
+  /*! @brief Guide table used to invert the cumulative distribution. */
+  GuideTable _guide_table;
+
   /*! @brief Base 10 logarithm of the cumulative distribution in each bin. */
   std::vector< double > _log_cumulative_distribution;
 
@@ -52,6 +52,9 @@ private:
   /*! @brief Side lengths of a single cell of the grid (in m). */
   CoordinateVector<> _grid_cell_sides;
 
+  /*! @brief Side lengths of the entire grid (in m). */
+  CoordinateVector<> _grid_range;
+
   /*! @brief Reference to the underlying positions. */
   const std::vector< CoordinateVector<> > &_positions;
 
@@ -113,21 +116,45 @@ public:
       }
     }
 
+    _grid_range = maxpos;
+
     // add the positions to the positions grid
+    update();
+  }
+
+  /**
+   * @brief Redistribute the positions over the positions grid.
+   *
+   * This function needs to be called every time the underlying positions have
+   * changed. The number of positions and the extent of the grid are assumed to
+   * be constant.
+   */
+  inline void update() {
+
+    for (size_t ix = 0; ix < _grid.size(); ++ix) {
+      for (size_t iy = 0; iy < _grid[ix].size(); ++iy) {
+        for (size_t iz = 0; iz < _grid[ix][iy].size(); ++iz) {
+          _grid[ix][iy][iz].clear();
+        }
+      }
+    }
+
+    const uint_fast32_t positions_size = _positions.size();
+    const uint_fast32_t ncell_1D = _grid.size();
+    const CoordinateVector<> &minpos = _grid_anchor;
+    const CoordinateVector<> &maxpos = _grid_range;
     _cell_map.resize(positions_size);
     for (uint_fast32_t i = 0; i < positions_size; ++i) {
-      cmac_assert(positions[i].x() >= minpos.x() &&
-                  positions[i].x() <= maxpos.x());
-      cmac_assert(positions[i].y() >= minpos.y() &&
-                  positions[i].y() <= maxpos.y());
-      cmac_assert(positions[i].z() >= minpos.z() &&
-                  positions[i].z() <= maxpos.z());
+      const CoordinateVector<> &position = _positions[i];
+      cmac_assert(position.x() >= minpos.x() && position.x() <= maxpos.x());
+      cmac_assert(position.y() >= minpos.y() && position.y() <= maxpos.y());
+      cmac_assert(position.z() >= minpos.z() && position.z() <= maxpos.z());
       const uint_fast32_t ix =
-          (positions[i].x() - minpos.x()) / maxpos.x() * ncell_1D;
+          (position.x() - minpos.x()) / maxpos.x() * ncell_1D;
       const uint_fast32_t iy =
-          (positions[i].y() - minpos.y()) / maxpos.y() * ncell_1D;
+          (position.y() - minpos.y()) / maxpos.y() * ncell_1D;
       const uint_fast32_t iz =
-          (positions[i].z() - minpos.z()) / maxpos.z() * ncell_1D;
+          (position.z() - minpos.z()) / maxpos.z() * ncell_1D;
       _grid[ix][iy][iz].push_back(i);
       _cell_map[i] =
           std::tuple< uint_least32_t, uint_least32_t, uint_least32_t >(ix, iy,
@@ -28,6 +28,7 @@
 
 #include "DensitySubGridCreator.hpp"
 #include "MemorySpace.hpp"
+#include "PhotonBufferPolicy.hpp"
 #include "Task.hpp"
 #include "TaskQueue.hpp"
 
@@ -51,6 +52,15 @@ private:
   /*! @brief General shared queue. */
   TaskQueue &_shared_queue;
 
+  /*! @brief Adaptive photon buffer policy. If set, buffers that feed into a
+   *  local subgrid are only launched if they contain at least the flush
+   *  threshold for that subgrid (can be a nullptr). */
+  const PhotonBufferPolicy *_buffer_policy;
+
+  /*! @brief Number of consecutive failed premature launch attempts for every
+   *  thread. */
+  std::vector< uint_fast32_t > _failed_attempts;
+
 public:
   /**
    * @brief Constructor.
@@ -60,19 +70,34 @@ public:
    * @param tasks Task space.
    * @param queues Thread queues.
    * @param shared_queue Shared queue.
+   * @param buffer_policy Adaptive photon buffer policy.
    */
   inline PrematureLaunchTaskContext(
       MemorySpace &buffers,
       DensitySubGridCreator< _subgrid_type_ > &grid_creator,
       ThreadSafeVector< Task > &tasks, std::vector< TaskQueue * > &queues,
-      TaskQueue &shared_queue)
+      TaskQueue &shared_queue,
+      const PhotonBufferPolicy *buffer_policy = nullptr)
       : _buffers(buffers), _grid_creator(grid_creator), _tasks(tasks),
-        _queues(queues), _shared_queue(shared_queue) {}
+        _queues(queues), _shared_queue(shared_queue),
+        _buffer_policy(buffer_policy), _failed_attempts(queues.size(), 0) {}
 
   /**
    * @brief Execute a premature launch task.
+   *
+   * If a buffer policy is set, buffers below the flush threshold of their
+   * subgrid are skipped, until the calling thread failed to launch a buffer
+   * the flush patience number of times in a row. From then on, the thread
+   * ignores the threshold (the context is recreated for every step).
+   *
+   * @param thread_id ID of the thread that executes the task.
    */
-  inline void execute() {
+  inline void execute(const int_fast32_t thread_id) {
+
+    const bool use_threshold =
+        _buffer_policy != nullptr &&
+        _failed_attempts[thread_id] < _buffer_policy->get_flush_patience();
+    bool launched = false;
 
     uint_fast32_t threshold_size = PHOTONBUFFER_SIZE;
     while (threshold_size > 0) {
@@ -89,19 +114,35 @@ public:
 
             const uint_fast32_t non_full_index =
                 this_subgrid.get_active_buffer(largest_index);
+            const uint_fast32_t target_index =
+                _buffers[non_full_index].get_subgrid_index();
+            if (use_threshold && largest_index > 0 &&
+                _grid_creator.is_local(target_index) &&
+                _buffers[non_full_index].size() <
+                    _buffer_policy->get_flush_threshold(target_index)) {
+              // the buffer is too small to be launched yet
+              this_subgrid.get_dependency()->unlock();
+              continue;
+            }
             this_subgrid.set_active_buffer(largest_index, NEIGHBOUR_OUTSIDE);
 
             const size_t task_index = _tasks.get_free_element();
             Task &new_task = _tasks[task_index];
             new_task.set_subgrid(_buffers[non_full_index].get_subgrid_index());
             new_task.set_buffer(non_full_index);
-            if (largest_index > 0) {
+            if (largest_index > 0 &&
+                !_grid_creator.is_local(
+                    _buffers[non_full_index].get_subgrid_index())) {
+              new_task.set_type(TASKTYPE_SEND);
+              // a send task has no dependencies
+              _shared_queue.add_task(task_index);
+            } else if (largest_index > 0) {
               DensitySubGrid &subgrid = *_grid_creator.get_subgrid(
                   _buffers[non_full_index].get_subgrid_index());
               new_task.set_type(TASKTYPE_PHOTON_TRAVERSAL);
 
               // add dependency
-              new_task.set_dependency(subgrid.get_dependency());
+              new_task.set_dependency(subgrid.get_traversal_dependency());
 
               const uint_fast32_t queue_index = subgrid.get_owning_thread();
               _queues[queue_index]->add_task(task_index);
@@ -132,6 +173,7 @@ public:
             this_subgrid.get_dependency()->unlock();
 
             // we managed to activate a buffer, we are done
+            launched = true;
             threshold_size = 0;
             break;
           } else {
@@ -142,6 +184,15 @@ public:
         }
       }
     }
+
+    // once a thread ran out of patience, it keeps ignoring the threshold
+    if (use_threshold) {
+      if (launched) {
+        _failed_attempts[thread_id] = 0;
+      } else {
+        ++_failed_attempts[thread_id];
+      }
+    }
   }
 };
 
@@ -300,6 +300,9 @@ int RadiationHydrodynamicsSimulation::do_simulation(CommandLineParser &parser,
                  "ignored.");
   }
 
+  CrossSectionsFactory::add_discrete_frequencies(*cross_sections, spectrum,
+                                                 continuousspectrum);
+
   Abundances abundances(*params, log);
 
   PhotonSource source(sourcedistribution, spectrum, continuoussource,
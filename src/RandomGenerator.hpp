@@ -21,16 +21,65 @@
  *
  * @brief Custom random number generator.
  *
+ * By default, this is our own implementation of the GSL ranlxd2 generator. If
+ * the code is configured with PHILOX_RANDOM, the counter-based
+ * PhiloxRandomGenerator is used instead.
+ *
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
 #ifndef RANDOMGENERATOR_HPP
 #define RANDOMGENERATOR_HPP
 
+#include "Configuration.hpp"
 #include "RestartReader.hpp"
 #include "RestartWriter.hpp"
 
 #include <cstdint>
 
+#ifdef USE_PHILOX_RANDOM_GENERATOR
+
+#include "PhiloxRandomGenerator.hpp"
+
+/**
+ * @brief Counter-based random generator.
+ */
+class RandomGenerator : public PhiloxRandomGenerator {
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param seed Initial seed for the random number generator.
+   */
+  inline RandomGenerator(int_fast32_t seed = 42)
+      : PhiloxRandomGenerator(seed) {}
+
+  /**
+   * @brief Restart constructor.
+   *
+   * @param restart_reader Restart file to read from.
+   */
+  inline RandomGenerator(RestartReader &restart_reader)
+      : PhiloxRandomGenerator(restart_reader) {}
+
+  /**
+   * @brief Move the generator to the start of the substream that belongs to
+   * the given job during the given iteration.
+   *
+   * A job that always uses the same substream gets the same random numbers,
+   * irrespective of the thread that executes it.
+   *
+   * @param iteration Iteration number.
+   * @param job Index of the job within the iteration.
+   */
+  inline void set_job_substream(const uint_fast32_t iteration,
+                                const uint_fast32_t job) {
+    set_substream((static_cast< uint64_t >(iteration) << 32) |
+                  static_cast< uint32_t >(job));
+  }
+};
+
+#else
+
 /**
  * @brief Own implementation of the GSL ranlxd2 random generator.
  *
@@ -224,6 +273,20 @@ public:
     return _xdbl[_ir];
   }
 
+  /**
+   * @brief Fill the given array with uniform random double precision floating
+   * point values in the range [0., 1.].
+   *
+   * @param values Array to fill.
+   * @param number_of_values Number of values to generate.
+   */
+  inline void get_uniform_random_doubles(double *values,
+                                         const size_t number_of_values) {
+    for (size_t i = 0; i < number_of_values; ++i) {
+      values[i] = get_uniform_random_double();
+    }
+  }
+
   /**
    * @brief Get a random integer value.
    *
@@ -233,6 +296,19 @@ public:
     return get_uniform_random_double() * 2147483648.0;
   }
 
+  /**
+   * @brief Move the generator to the substream that belongs to the given job
+   * during the given iteration.
+   *
+   * The ranlxd2 generator has no substreams, so this does nothing: the random
+   * numbers a job gets depend on the thread that executes it.
+   *
+   * @param iteration Iteration number.
+   * @param job Index of the job within the iteration.
+   */
+  inline void set_job_substream(const uint_fast32_t iteration,
+                                const uint_fast32_t job) {}
+
   /**
    * @brief Write the random number generator to the given restart file.
    *
@@ -269,4 +345,6 @@ public:
         _pr(restart_reader.read< uint_fast32_t >()) {}
 };
 
+#endif // USE_PHILOX_RANDOM_GENERATOR
+
 #endif // RANDOMGENERATOR_HPP
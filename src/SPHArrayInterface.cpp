@@ -44,7 +44,8 @@ SPHArrayInterface::SPHArrayInterface(const double unit_length_in_SI,
     : DensityGridWriter("", false, DensityGridWriterFields(false), nullptr),
       _unit_length_in_SI(unit_length_in_SI), _unit_mass_in_SI(unit_mass_in_SI),
       _is_periodic(false), _mapping_type(get_mapping_type(mapping_type)),
-      _octree(nullptr) {
+      _octree(nullptr), _incremental_mapping(false),
+      _incremental_tolerance(0.), _mapping_step(0) {
 
   if (_mapping_type == SPHARRAY_MAPPING_PETKOVA) {
     gridding();
@@ -73,7 +74,8 @@ SPHArrayInterface::SPHArrayInterface(const double unit_length_in_SI,
     : DensityGridWriter("", false, DensityGridWriterFields(false), nullptr),
       _unit_length_in_SI(unit_length_in_SI), _unit_mass_in_SI(unit_mass_in_SI),
       _is_periodic(true), _mapping_type(get_mapping_type(mapping_type)),
-      _octree(nullptr) {
+      _octree(nullptr), _incremental_mapping(false),
+      _incremental_tolerance(0.), _mapping_step(0) {
 
   _box.get_anchor()[0] = box_anchor[0] * _unit_length_in_SI;
   _box.get_anchor()[1] = box_anchor[1] * _unit_length_in_SI;
@@ -109,7 +111,8 @@ SPHArrayInterface::SPHArrayInterface(const double unit_length_in_SI,
     : DensityGridWriter("", false, DensityGridWriterFields(false), nullptr),
       _unit_length_in_SI(unit_length_in_SI), _unit_mass_in_SI(unit_mass_in_SI),
       _is_periodic(true), _mapping_type(get_mapping_type(mapping_type)),
-      _octree(nullptr) {
+      _octree(nullptr), _incremental_mapping(false),
+      _incremental_tolerance(0.), _mapping_step(0) {
 
   _box.get_anchor()[0] = box_anchor[0] * _unit_length_in_SI;
   _box.get_anchor()[1] = box_anchor[1] * _unit_length_in_SI;
@@ -175,6 +178,8 @@ void SPHArrayInterface::reset(const double *x, const double *y, const double *z,
     _box.get_anchor() = minpos - 0.005 * maxpos;
     _box.get_sides() = 1.01 * maxpos;
   }
+
+  update_changed_particles();
 }
 
 /**
@@ -220,6 +225,8 @@ void SPHArrayInterface::reset(const double *x, const double *y, const double *z,
     _box.get_anchor() = minpos - 0.005 * maxpos;
     _box.get_sides() = 1.01 * maxpos;
   }
+
+  update_changed_particles();
 }
 
 /**
@@ -265,6 +272,174 @@ void SPHArrayInterface::reset(const float *x, const float *y, const float *z,
     _box.get_anchor() = minpos - 0.005 * maxpos;
     _box.get_sides() = 1.01 * maxpos;
   }
+
+  update_changed_particles();
+}
+
+/**
+ * @brief Find the SPH particles whose overlaps with the grid cells need to be
+ * recomputed during this mapping step.
+ *
+ * Called at the end of every reset. A particle is flagged if its position or
+ * smoothing length changed by more than the tolerance (in units of the
+ * smoothing length) since its overlaps were last computed.
+ */
+void SPHArrayInterface::update_changed_particles() {
+
+  ++_mapping_step;
+
+  if (!_incremental_mapping) {
+    _mapped_positions.clear();
+    _mapped_smoothing_lengths.clear();
+    return;
+  }
+
+  const size_t npart = _positions.size();
+  if (_mapped_positions.size() != npart) {
+    // the cached overlaps refer to a different set of particles
+    _mapped_positions = _positions;
+    _mapped_smoothing_lengths = _smoothing_lengths;
+    _changed_particles.assign(npart, true);
+    _overlaps.clear();
+    _overlap_steps.clear();
+    _overlap_radii.clear();
+    return;
+  }
+
+  for (size_t i = 0; i < npart; ++i) {
+    const double tolerance =
+        _incremental_tolerance * _mapped_smoothing_lengths[i];
+    const bool changed =
+        (_positions[i] - _mapped_positions[i]).norm() > tolerance ||
+        std::abs(_smoothing_lengths[i] - _mapped_smoothing_lengths[i]) >
+            tolerance;
+    _changed_particles[i] = changed;
+    if (changed) {
+      _mapped_positions[i] = _positions[i];
+      _mapped_smoothing_lengths[i] = _smoothing_lengths[i];
+    }
+  }
+}
+
+/**
+ * @brief Enable incremental mapping.
+ *
+ * The overlaps between SPH particles and grid cells are cached in between
+ * mapping steps, and are only recomputed for particles whose position or
+ * smoothing length changed by more than the given tolerance (in units of the
+ * smoothing length). Only used for the centroid and Petkova mappings and only
+ * for grids that provide cell indices. The cache is only valid as long as the
+ * grid itself does not change.
+ *
+ * @param tolerance Relative tolerance. A value of 0 only reuses the overlaps of
+ * particles that did not change at all.
+ */
+void SPHArrayInterface::set_incremental_mapping(const double tolerance) {
+  _incremental_mapping = true;
+  _incremental_tolerance = tolerance;
+}
+
+/**
+ * @brief Get the radius of the sphere around the cell midpoint that contains
+ * all vertices of the given cell.
+ *
+ * @param cell Cell.
+ * @return Distance between the cell midpoint and the furthest vertex (in m).
+ */
+double SPHArrayInterface::get_overlap_radius(const Cell &cell) const {
+
+  const CoordinateVector<> position = cell.get_cell_midpoint();
+  const std::vector< Face > face_vector = cell.get_faces();
+  double radius = 0.0;
+  for (size_t i = 0; i < face_vector.size(); ++i) {
+    for (Face::Vertices j = face_vector[i].first_vertex();
+         j != face_vector[i].last_vertex(); ++j) {
+      radius = std::max(radius, (j.get_position() - position).norm());
+    }
+  }
+  return radius;
+}
+
+/**
+ * @brief Get the weight of the overlap between the given cell and SPH
+ * particle.
+ *
+ * @param cell Cell.
+ * @param midpoint Midpoint of the cell (in m).
+ * @param index Index of the SPH particle.
+ * @return Kernel value at the cell midpoint (centroid mapping, in m^-3) or
+ * fraction of the particle mass inside the cell (Petkova mapping).
+ */
+double SPHArrayInterface::get_overlap_weight(const Cell &cell,
+                                             const CoordinateVector<> &midpoint,
+                                             const uint_fast32_t index) const {
+
+  if (_mapping_type == SPHARRAY_MAPPING_CENTROID) {
+    double r;
+    if (!_box.get_sides().x()) {
+      r = (midpoint - _positions[index]).norm();
+    } else {
+      r = _box.periodic_distance(midpoint, _positions[index]).norm();
+    }
+    const double h = _smoothing_lengths[index];
+    return CubicSplineKernel::kernel_evaluate(r / h, h);
+  } else {
+    return mass_contribution(cell, _positions[index],
+                             _smoothing_lengths[index] / 2.0);
+  }
+}
+
+/**
+ * @brief Make sure the cached overlaps of the given cell are up to date.
+ *
+ * If the overlaps were computed during the previous mapping step, only the
+ * overlaps with changed particles are recomputed. If they are older, all
+ * overlaps are recomputed. Each cell should only be updated by a single thread
+ * at a time.
+ *
+ * @param cell Cell.
+ * @param index Index of the cell in the overlap cache.
+ */
+void SPHArrayInterface::update_overlaps(const Cell &cell, const size_t index) {
+
+  if (_overlap_steps[index] == _mapping_step) {
+    return;
+  }
+
+  std::vector< std::pair< uint_fast32_t, double > > &overlaps =
+      _overlaps[index];
+  const bool is_incremental =
+      _overlap_steps[index] > 0 && _overlap_steps[index] + 1 == _mapping_step;
+  if (is_incremental) {
+    size_t number_kept = 0;
+    for (size_t i = 0; i < overlaps.size(); ++i) {
+      if (!_changed_particles[overlaps[i].first]) {
+        overlaps[number_kept] = overlaps[i];
+        ++number_kept;
+      }
+    }
+    overlaps.resize(number_kept);
+  } else {
+    overlaps.clear();
+    if (_mapping_type == SPHARRAY_MAPPING_PETKOVA) {
+      _overlap_radii[index] = get_overlap_radius(cell);
+    }
+  }
+
+  const CoordinateVector<> midpoint = cell.get_cell_midpoint();
+  auto add_overlap = [&](const uint_fast32_t ngb) {
+    if (!is_incremental || _changed_particles[ngb]) {
+      overlaps.push_back(
+          std::make_pair(ngb, get_overlap_weight(cell, midpoint, ngb)));
+    }
+  };
+  if (_mapping_type == SPHARRAY_MAPPING_CENTROID) {
+    _octree->for_each_ngb(midpoint, add_overlap);
+  } else {
+    _octree->for_each_ngb_sphere(midpoint, _overlap_radii[index], add_overlap);
+  }
+
+  _overlap_steps[index] = _mapping_step;
 }
 
 /**
@@ -272,19 +447,21 @@ void SPHArrayInterface::reset(const float *x, const float *y, const float *z,
  *
  * @return Pointer to the internal Octree.
  */
-Octree *SPHArrayInterface::get_octree() { return _octree; }
+FlatOctree *SPHArrayInterface::get_octree() { return _octree; }
 
 /**
  * @brief Initialize the internal Octree.
  */
 void SPHArrayInterface::initialize() {
-  _octree = new Octree(_positions, _box, _is_periodic);
-  _octree->set_auxiliaries(_smoothing_lengths, Octree::max< double >);
+  _octree = new FlatOctree(_positions, _box, _is_periodic);
+  _octree->set_auxiliaries(_smoothing_lengths, FlatOctree::max< double >);
   //_dens_map = new DensityMapping();
 }
 
 /**
  * @brief Initialize the pre-computed array of density values.
+ *
+ * The radial bins are computed in parallel.
  */
 void SPHArrayInterface::gridding() {
   double phi, r0, R_0, mu0;
@@ -308,6 +485,10 @@ void SPHArrayInterface::gridding() {
     }
   }
 
+  // all radial bins are independent
+#ifdef HAVE_OPENMP
+#pragma omp parallel for default(shared) private(phi, r0, R_0, mu0, j, k)
+#endif
   for (i = 0; i < nr1; ++i) {
     r0 = (rl / nr1) * (i + 1) * h;
     for (j = 0; j < n; ++j) {
@@ -346,6 +527,9 @@ void SPHArrayInterface::gridding() {
     }
   }
 
+#ifdef HAVE_OPENMP
+#pragma omp parallel for default(shared) private(phi, r0, R_0, mu0, j, k)
+#endif
   for (i = 1; i <= nr2; ++i) {
     r0 = rl + ((2.0 - rl) / nr2) * i * h;
     for (j = 0; j < n; ++j) {
@@ -941,15 +1125,23 @@ DensityValues SPHArrayInterface::operator()(const Cell &cell) {
   const CoordinateVector<> position = cell.get_cell_midpoint();
   double density = 0.;
 
-  if (_mapping_type == SPHARRAY_MAPPING_M_OVER_V) {
+  if (has_overlap_cache(cell)) {
+    const size_t index = cell.get_cell_index();
+    update_overlaps(cell, index);
+    const std::vector< std::pair< uint_fast32_t, double > > &overlaps =
+        _overlaps[index];
+    for (size_t i = 0; i < overlaps.size(); ++i) {
+      density += _masses[overlaps[i].first] * overlaps[i].second;
+    }
+    if (_mapping_type == SPHARRAY_MAPPING_PETKOVA) {
+      density = density / cell.get_volume();
+    }
+  } else if (_mapping_type == SPHARRAY_MAPPING_M_OVER_V) {
     const CoordinateVector<> p = cell.get_cell_midpoint();
     uint_fast32_t closest = _octree->get_closest_ngb(p);
     density = _masses[closest] / cell.get_volume();
   } else if (_mapping_type == SPHARRAY_MAPPING_CENTROID) {
-    const std::vector< uint_fast32_t > ngbs = _octree->get_ngbs(position);
-    const size_t numngbs = ngbs.size();
-    for (size_t i = 0; i < numngbs; ++i) {
-      const size_t index = ngbs[i];
+    auto add_density = [&](const uint_fast32_t index) {
       double r;
       if (!_box.get_sides().x()) {
         r = (position - _positions[index]).norm();
@@ -961,7 +1153,8 @@ DensityValues SPHArrayInterface::operator()(const Cell &cell) {
       const double m = _masses[index];
       const double splineval = m * CubicSplineKernel::kernel_evaluate(u, h);
       density += splineval;
-    }
+    };
+    _octree->for_each_ngb(position, add_density);
   } else if (_mapping_type == SPHARRAY_MAPPING_PETKOVA) {
     CoordinateVector<> position = cell.get_cell_midpoint();
 
@@ -980,21 +1173,17 @@ DensityValues SPHArrayInterface::operator()(const Cell &cell) {
     // Find the neighbours that are contained inside of a sphere of centre the
     // cell midpoint
     // and radius given by the distance to the furthest vertex.
-    std::vector< uint_fast32_t > ngbs =
-        _octree->get_ngbs_sphere(position, radius);
-    const unsigned int numngbs = ngbs.size();
-
     // Loop over all the neighbouring particles and calculate their mass
     // contributions.
-    for (unsigned int i = 0; i < numngbs; i++) {
-      const unsigned int index = ngbs[i];
+    auto add_mass = [&](const uint_fast32_t index) {
       const double h = _smoothing_lengths[index] / 2.0;
       const CoordinateVector<> particle = _positions[index];
       if (h < 0)
-        cmac_warning("h < 0: %g, %u", h, index);
+        cmac_warning("h < 0: %g, %" PRIuFAST32, h, index);
       density += SPHArrayInterface::mass_contribution(cell, particle, h) *
                  _masses[index];
-    }
+    };
+    _octree->for_each_ngb_sphere(position, radius, add_mass);
 
     // Divide the cell mass by the cell volume to get density.
     density = density / cell.get_volume();
@@ -1063,6 +1252,16 @@ void SPHArrayInterface::write(DensityGrid &grid, uint_fast32_t iteration,
 
   std::vector< Lock > locks(_neutral_fractions.size());
 
+  // the overlap cache is set up during the first inverse mapping, since this
+  // is the first time we know the size of the grid
+  if (_incremental_mapping && _mapping_type != SPHARRAY_MAPPING_M_OVER_V &&
+      _overlaps.size() != grid.get_number_of_cells()) {
+    _overlaps.clear();
+    _overlaps.resize(grid.get_number_of_cells());
+    _overlap_steps.assign(grid.get_number_of_cells(), 0);
+    _overlap_radii.assign(grid.get_number_of_cells(), 0.);
+  }
+
   std::pair< cellsize_t, cellsize_t > block =
       std::make_pair(0, grid.get_number_of_cells());
   WorkDistributor< DensityGridTraversalJobMarket< InverseMappingFunction >,
@@ -31,7 +31,7 @@
 #include "CubicSplineKernel.hpp"
 #include "DensityFunction.hpp"
 #include "DensityGridWriter.hpp"
-#include "Octree.hpp"
+#include "FlatOctree.hpp"
 #include "TimeLogger.hpp"
 
 #include <iostream>
@@ -94,7 +94,43 @@ private:
   std::vector< std::vector< std::vector< double > > > _density_values;
 
   /*! @brief Octree used to speed up neighbour searching. */
-  Octree *_octree;
+  FlatOctree *_octree;
+
+  /*! @brief Reuse the particle-cell overlaps of the previous mapping for
+   *  particles that did not change? */
+  bool _incremental_mapping;
+
+  /*! @brief Change in position or smoothing length (in units of the smoothing
+   *  length) above which the overlaps of a particle are recomputed. */
+  double _incremental_tolerance;
+
+  /*! @brief Number of times the particles have been reset. */
+  uint_fast32_t _mapping_step;
+
+  /*! @brief Positions of the SPH particles for which the cached overlaps were
+   *  computed (in m). */
+  std::vector< CoordinateVector<> > _mapped_positions;
+
+  /*! @brief Smoothing lengths of the SPH particles for which the cached
+   *  overlaps were computed (in m). */
+  std::vector< double > _mapped_smoothing_lengths;
+
+  /*! @brief Flags for the SPH particles whose overlaps need to be recomputed
+   *  during the current mapping step. */
+  std::vector< bool > _changed_particles;
+
+  /*! @brief Cached overlaps for every cell: index of the overlapping SPH
+   *  particle and corresponding weight (kernel value for the centroid mapping,
+   *  mass fraction for the Petkova mapping). */
+  std::vector< std::vector< std::pair< uint_fast32_t, double > > > _overlaps;
+
+  /*! @brief Mapping step during which the cached overlaps of every cell were
+   *  last updated (0 if the overlaps were never computed). */
+  std::vector< uint_fast32_t > _overlap_steps;
+
+  /*! @brief Radius of the sphere used to find overlapping particles for every
+   *  cell (Petkova mapping only, in m). */
+  std::vector< double > _overlap_radii;
 
   /*! @brief Time log used to register time consumption in various parts of the
    *  algorithm. */
@@ -123,6 +159,27 @@ private:
     }
   }
 
+  void update_changed_particles();
+
+  /**
+   * @brief Check if the overlaps of the given cell are cached.
+   *
+   * @param cell Cell.
+   * @return True if incremental mapping is enabled and the cell has an entry
+   * in the overlap cache.
+   */
+  inline bool has_overlap_cache(const Cell &cell) const {
+    return _incremental_mapping &&
+           _mapping_type != SPHARRAY_MAPPING_M_OVER_V &&
+           cell.get_cell_index() < _overlaps.size();
+  }
+
+  double get_overlap_radius(const Cell &cell) const;
+  double get_overlap_weight(const Cell &cell,
+                            const CoordinateVector<> &midpoint,
+                            const uint_fast32_t index) const;
+  void update_overlaps(const Cell &cell, const size_t index);
+
   /**
    * @brief Functor for the inverse mapping.
    */
@@ -152,7 +209,29 @@ private:
      */
     void operator()(DensityGrid::iterator cell) {
 
-      if (_array_interface._mapping_type == SPHARRAY_MAPPING_M_OVER_V) {
+      if (_array_interface.has_overlap_cache(cell)) {
+        _array_interface.update_overlaps(cell, cell.get_index());
+        const std::vector< std::pair< uint_fast32_t, double > > &overlaps =
+            _array_interface._overlaps[cell.get_index()];
+        const double ionic_fraction =
+            cell.get_ionization_variables().get_ionic_fraction(ION_H_n);
+        const double factor =
+            (_array_interface._mapping_type == SPHARRAY_MAPPING_CENTROID)
+                ? cell.get_volume()
+                : 1.;
+        for (size_t i = 0; i < overlaps.size(); ++i) {
+          const uint_fast32_t index = overlaps[i].first;
+          const double contribution =
+              _array_interface._masses[index] * overlaps[i].second * factor;
+
+          _locks[index].lock();
+          _array_interface._neutral_fractions[index] +=
+              contribution * ionic_fraction;
+          _array_interface._full_mass_contrib[index] += contribution;
+          _locks[index].unlock();
+        }
+
+      } else if (_array_interface._mapping_type == SPHARRAY_MAPPING_M_OVER_V) {
         const CoordinateVector<> p = cell.get_cell_midpoint();
         uint_fast32_t closest = _array_interface._octree->get_closest_ngb(p);
         _locks[closest].lock();
@@ -163,12 +242,10 @@ private:
 
       } else if (_array_interface._mapping_type == SPHARRAY_MAPPING_CENTROID) {
         const CoordinateVector<> p = cell.get_cell_midpoint();
-        const std::vector< uint_fast32_t > ngbs =
-            _array_interface._octree->get_ngbs(p);
-        const unsigned int numngbs = ngbs.size();
-        //double cell_mass = 0.;
-        for (unsigned int i = 0; i < numngbs; ++i) {
-          const unsigned int index = ngbs[i];
+        const double ionic_fraction =
+            cell.get_ionization_variables().get_ionic_fraction(ION_H_n);
+        const double volume = cell.get_volume();
+        auto add_contribution = [&](const uint_fast32_t index) {
           double r;
           if (!_array_interface._box.get_sides().x()) {
             r = (p - _array_interface._positions[index]).norm();
@@ -180,16 +257,16 @@ private:
           const double h = _array_interface._smoothing_lengths[index];
           const double u = r / h;
           const double m = _array_interface._masses[index];
-          const double splineval = m * CubicSplineKernel::kernel_evaluate(u, h) * cell.get_volume();
-
-	        _locks[index].lock();
+          const double splineval =
+              m * CubicSplineKernel::kernel_evaluate(u, h) * volume;
 
-          _array_interface._neutral_fractions[index] += 
-		          splineval * cell.get_ionization_variables().get_ionic_fraction(ION_H_n);
-	        _array_interface._full_mass_contrib[index] += splineval;
-
-	        _locks[index].unlock();
-        }
+          _locks[index].lock();
+          _array_interface._neutral_fractions[index] +=
+              splineval * ionic_fraction;
+          _array_interface._full_mass_contrib[index] += splineval;
+          _locks[index].unlock();
+        };
+        _array_interface._octree->for_each_ngb(p, add_contribution);
 
       } else if (_array_interface._mapping_type == SPHARRAY_MAPPING_PETKOVA) {
 
@@ -209,31 +286,27 @@ private:
         // Find the neighbours that are contained inside of a sphere of centre
         // the cell midpoint and radius given by the distance to the furthest
         // vertex.
-        std::vector< uint_fast32_t > ngbs =
-            _array_interface._octree->get_ngbs_sphere(position, radius);
-        const unsigned int numngbs = ngbs.size();
-
-        std::vector< double > denseval;
-
+        const double ionic_fraction =
+            cell.get_ionization_variables().get_ionic_fraction(ION_H_n);
         // Loop over all the neighbouring particles and calculate their mass
         // contributions.
-        for (unsigned int i = 0; i < numngbs; i++) {
-          const unsigned int index = ngbs[i];
+        auto add_contribution = [&](const uint_fast32_t index) {
           const double h = _array_interface._smoothing_lengths[index] / 2.0;
-	        const double m = _array_interface._masses[index];
+          const double m = _array_interface._masses[index];
           const CoordinateVector<> particle =
               _array_interface._positions[index];
-      
-	        denseval.push_back(_array_interface.mass_contribution(cell, particle, h) * m);
-
-          _locks[index].lock();
 
-          _array_interface._neutral_fractions[index] += 
-	            denseval[i] * cell.get_ionization_variables().get_ionic_fraction(ION_H_n);
-	       _array_interface._full_mass_contrib[index] += denseval[i];
+          const double denseval =
+              _array_interface.mass_contribution(cell, particle, h) * m;
 
-         _locks[index].unlock();
-        }
+          _locks[index].lock();
+          _array_interface._neutral_fractions[index] +=
+              denseval * ionic_fraction;
+          _array_interface._full_mass_contrib[index] += denseval;
+          _locks[index].unlock();
+        };
+        _array_interface._octree->for_each_ngb_sphere(position, radius,
+                                                      add_contribution);
       }
     }
   };
@@ -259,7 +332,9 @@ public:
   void reset(const float *x, const float *y, const float *z, const float *h,
              const float *m, const size_t npart);
 
-  Octree *get_octree();
+  FlatOctree *get_octree();
+
+  void set_incremental_mapping(const double tolerance);
 
   // DensityMapping get_dens_map(){return _dens_map;}
 
@@ -26,17 +26,55 @@
 #ifndef SCHEDULER_HPP
 #define SCHEDULER_HPP
 
+#include "NUMATopology.hpp"
 #include "TaskQueue.hpp"
 #include "ThreadSafeVector.hpp"
-#include "Utilities.hpp"
 
 #include <vector>
 
+/**
+ * @brief Policies used to select the queue to steal from.
+ */
+enum SchedulerStealPolicy {
+  /*! @brief Start with a random other queue. */
+  SCHEDULER_STEAL_RANDOM = 0,
+  /*! @brief Start with the queue of the next thread. If threads are pinned
+   *  to consecutive cores, this is the nearest neighbour in terms of NUMA
+   *  distance. */
+  SCHEDULER_STEAL_NEIGHBOUR,
+  /*! @brief First try all queues of threads on the same NUMA node (starting
+   *  from a random one), then the queues on the other nodes, in order of
+   *  increasing node index offset. Requires a NUMATopology. */
+  SCHEDULER_STEAL_NUMA
+};
+
 /**
  * @brief Task scheduler responsible for scheduling and retrieving tasks.
  */
 class Scheduler {
 private:
+  /**
+   * @brief Per thread stealing state.
+   *
+   * Padded to a full cache line, since every thread updates its own state.
+   */
+  struct ThreadState {
+    /*! @brief State of the xorshift random number generator. */
+    uint_fast64_t _random_state;
+
+    /*! @brief Number of steal attempts. */
+    uint_fast64_t _steal_attempts;
+
+    /*! @brief Number of successful steal attempts. */
+    uint_fast64_t _steal_successes;
+
+    /*! @brief Number of tasks stolen from a thread on another NUMA node. */
+    uint_fast64_t _remote_steals;
+
+    /*! @brief Padding. */
+    char _padding[64 - 4 * sizeof(uint_fast64_t)];
+  };
+
   /*! @brief Task space. */
   ThreadSafeVector< Task > &_tasks;
 
@@ -46,6 +84,81 @@ private:
   /*! @brief General shared queue. */
   TaskQueue &_shared_queue;
 
+  /*! @brief Policy used to select the queue to steal from. */
+  const SchedulerStealPolicy _steal_policy;
+
+  /*! @brief Stealing state for each thread. */
+  std::vector< ThreadState > _thread_states;
+
+  /*! @brief Mapping of threads onto NUMA nodes (can be a nullptr). */
+  const NUMATopology *_topology;
+
+  /*! @brief Victim queues for each thread, ordered by NUMA distance (only
+   *  used for SCHEDULER_STEAL_NUMA). */
+  std::vector< std::vector< uint_fast32_t > > _victims;
+
+  /*! @brief Number of victim queues on the same NUMA node for each thread
+   *  (only used for SCHEDULER_STEAL_NUMA). */
+  std::vector< uint_fast32_t > _number_of_local_victims;
+
+  /**
+   * @brief Advance the random number generator of the given thread.
+   *
+   * @param thread_id Calling thread.
+   * @return New random value.
+   */
+  inline uint_fast64_t get_random_value(const int_fast8_t thread_id) {
+    // xorshift64 (Marsaglia, 2003, Journal of Statistical Software, 8, 14)
+    uint_fast64_t &x = _thread_states[thread_id]._random_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return x;
+  }
+
+  /**
+   * @brief Get the offset of the first queue to steal from.
+   *
+   * @param thread_id Calling thread.
+   * @return Offset of the first victim queue w.r.t. the calling thread's
+   * queue, in the range [1, number of queues - 1].
+   */
+  inline uint_fast32_t get_first_victim_offset(const int_fast8_t thread_id) {
+    const uint_fast32_t number_of_queues = _queues.size();
+    if (_steal_policy == SCHEDULER_STEAL_NEIGHBOUR) {
+      return 1;
+    } else {
+      return 1 + get_random_value(thread_id) % (number_of_queues - 1);
+    }
+  }
+
+  /**
+   * @brief Get the index of the queue to visit during the given steal attempt.
+   *
+   * @param thread_id Calling thread.
+   * @param first_offset Random offset for this round of steal attempts.
+   * @param attempt Index of the steal attempt, in the range
+   * [0, number of queues - 1[.
+   * @return Index of the victim queue.
+   */
+  inline uint_fast32_t get_victim(const int_fast8_t thread_id,
+                                  const uint_fast32_t first_offset,
+                                  const uint_fast32_t attempt) const {
+    const uint_fast32_t number_of_queues = _queues.size();
+    if (_steal_policy == SCHEDULER_STEAL_NUMA) {
+      const uint_fast32_t number_of_local = _number_of_local_victims[thread_id];
+      if (attempt < number_of_local) {
+        return _victims[thread_id][(first_offset + attempt) % number_of_local];
+      } else {
+        return _victims[thread_id][attempt];
+      }
+    } else {
+      const uint_fast32_t offset =
+          1 + (first_offset - 1 + attempt) % (number_of_queues - 1);
+      return (thread_id + offset) % number_of_queues;
+    }
+  }
+
 public:
   /**
    * @brief Constructor.
@@ -53,48 +166,176 @@ public:
    * @param tasks Task space.
    * @param queues Thread queues.
    * @param shared_queue Shared queue.
+   * @param steal_policy Policy used to select the queue to steal from.
+   * @param topology Mapping of threads onto NUMA nodes. Required for
+   * SCHEDULER_STEAL_NUMA; for other policies, it is only used to count the
+   * number of steals across NUMA nodes.
    */
-  inline Scheduler(ThreadSafeVector< Task > &tasks,
-                   std::vector< TaskQueue * > &queues, TaskQueue &shared_queue)
-      : _tasks(tasks), _queues(queues), _shared_queue(shared_queue) {}
+  inline Scheduler(
+      ThreadSafeVector< Task > &tasks, std::vector< TaskQueue * > &queues,
+      TaskQueue &shared_queue,
+      const SchedulerStealPolicy steal_policy = SCHEDULER_STEAL_RANDOM,
+      const NUMATopology *topology = nullptr)
+      : _tasks(tasks), _queues(queues), _shared_queue(shared_queue),
+        _steal_policy(steal_policy), _thread_states(queues.size()),
+        _topology(topology) {
+    for (size_t i = 0; i < _thread_states.size(); ++i) {
+      // the xorshift state cannot be zero
+      _thread_states[i]._random_state = 0x9e3779b97f4a7c15ull + i;
+      _thread_states[i]._steal_attempts = 0;
+      _thread_states[i]._steal_successes = 0;
+      _thread_states[i]._remote_steals = 0;
+    }
+
+    if (_steal_policy == SCHEDULER_STEAL_NUMA) {
+      if (_topology == nullptr) {
+        cmac_error("NUMA steal policy requires a NUMA topology!");
+      }
+      if (_topology->get_number_of_threads() !=
+          static_cast< int_fast32_t >(_queues.size())) {
+        cmac_error("NUMA topology does not match number of queues (%" PRIiFAST32
+                   " vs %zu)!",
+                   _topology->get_number_of_threads(), _queues.size());
+      }
+      const int_fast32_t number_of_nodes = _topology->get_number_of_nodes();
+      _victims.resize(_queues.size());
+      _number_of_local_victims.resize(_queues.size(), 0);
+      for (uint_fast32_t ithread = 0; ithread < _queues.size(); ++ithread) {
+        const int_fast32_t node = _topology->get_node(ithread);
+        // victims on the same node, starting from the next thread
+        const std::vector< int_fast32_t > &local_threads =
+            _topology->get_threads(node);
+        for (size_t i = 0; i < local_threads.size(); ++i) {
+          if (local_threads[i] != static_cast< int_fast32_t >(ithread)) {
+            _victims[ithread].push_back(local_threads[i]);
+          }
+        }
+        _number_of_local_victims[ithread] = _victims[ithread].size();
+        // victims on other nodes, nearest node index first
+        for (int_fast32_t inode = 1; inode < number_of_nodes; ++inode) {
+          const std::vector< int_fast32_t > &remote_threads =
+              _topology->get_threads((node + inode) % number_of_nodes);
+          _victims[ithread].insert(_victims[ithread].end(),
+                                   remote_threads.begin(),
+                                   remote_threads.end());
+        }
+      }
+    }
+  }
 
   /**
    * @brief Get a task from one of the queues.
    *
    * @param thread_id Calling thread.
+   * @param queue_index Variable to store the index of the queue the task was
+   * taken from in (-1 for the shared queue).
    * @return Index of a locked task that is ready for execution, or NO_TASK if
    * no eligible task could be found.
    */
-  inline uint_fast32_t get_task(const int_fast8_t thread_id) {
+  inline uint_fast32_t get_task(const int_fast8_t thread_id,
+                                int_fast32_t &queue_index) {
 
+    queue_index = thread_id;
     uint_fast32_t task_index = _queues[thread_id]->get_task(_tasks);
     if (task_index == NO_TASK) {
 
       // try to steal a task from another thread's queue
-
-      // sort the queues by size
-      std::vector< size_t > queue_sizes(_queues.size(), 0);
-      for (size_t i = 0; i < _queues.size(); ++i) {
-        queue_sizes[i] = _queues[i]->size();
-      }
-      std::vector< uint_fast32_t > sorti = Utilities::argsort(queue_sizes);
-
-      // now try to steal from the largest queue first
-      uint_fast32_t i = 0;
-      while (task_index == NO_TASK && i < queue_sizes.size() &&
-             queue_sizes[sorti[queue_sizes.size() - i - 1]] > 0) {
-        task_index =
-            _queues[sorti[queue_sizes.size() - i - 1]]->try_get_task(_tasks);
-        ++i;
+      // we visit all other queues once, starting from a victim that is chosen
+      // according to the steal policy
+      const uint_fast32_t number_of_queues = _queues.size();
+      if (number_of_queues > 1) {
+        ThreadState &state = _thread_states[thread_id];
+        uint_fast32_t first_offset;
+        if (_steal_policy == SCHEDULER_STEAL_NUMA) {
+          const uint_fast32_t number_of_local =
+              _number_of_local_victims[thread_id];
+          first_offset = (number_of_local > 0)
+                             ? get_random_value(thread_id) % number_of_local
+                             : 0;
+        } else {
+          first_offset = get_first_victim_offset(thread_id);
+        }
+        for (uint_fast32_t i = 0;
+             i < number_of_queues - 1 && task_index == NO_TASK; ++i) {
+          queue_index = get_victim(thread_id, first_offset, i);
+          TaskQueue &victim = *_queues[queue_index];
+          if (victim.size() > 0) {
+            ++state._steal_attempts;
+            task_index = victim.try_get_task(_tasks);
+          }
+        }
+        if (task_index != NO_TASK) {
+          ++state._steal_successes;
+          if (_topology != nullptr &&
+              !_topology->same_node(thread_id, queue_index)) {
+            ++state._remote_steals;
+          }
+        }
       }
       if (task_index == NO_TASK) {
         // get a task from the shared queue
+        queue_index = -1;
         task_index = _shared_queue.get_task(_tasks);
       }
     }
 
     return task_index;
   }
+
+  /**
+   * @brief Get a task from one of the queues.
+   *
+   * @param thread_id Calling thread.
+   * @return Index of a locked task that is ready for execution, or NO_TASK if
+   * no eligible task could be found.
+   */
+  inline uint_fast32_t get_task(const int_fast8_t thread_id) {
+    int_fast32_t queue_index;
+    return get_task(thread_id, queue_index);
+  }
+
+  /**
+   * @brief Get the total number of attempts to steal a task from another
+   * thread's queue.
+   *
+   * @return Number of steal attempts.
+   */
+  inline uint_fast64_t get_number_of_steal_attempts() const {
+    uint_fast64_t number = 0;
+    for (size_t i = 0; i < _thread_states.size(); ++i) {
+      number += _thread_states[i]._steal_attempts;
+    }
+    return number;
+  }
+
+  /**
+   * @brief Get the total number of tasks stolen from another thread's queue.
+   *
+   * @return Number of successful steal attempts.
+   */
+  inline uint_fast64_t get_number_of_successful_steals() const {
+    uint_fast64_t number = 0;
+    for (size_t i = 0; i < _thread_states.size(); ++i) {
+      number += _thread_states[i]._steal_successes;
+    }
+    return number;
+  }
+
+  /**
+   * @brief Get the total number of tasks stolen from a thread on another NUMA
+   * node.
+   *
+   * Only counted if the Scheduler was given a NUMATopology.
+   *
+   * @return Number of successful steal attempts across NUMA nodes.
+   */
+  inline uint_fast64_t get_number_of_remote_steals() const {
+    uint_fast64_t number = 0;
+    for (size_t i = 0; i < _thread_states.size(); ++i) {
+      number += _thread_states[i]._remote_steals;
+    }
+    return number;
+  }
 };
 
 #endif // SCHEDULER_HPP
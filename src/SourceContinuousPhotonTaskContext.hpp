@@ -91,6 +91,9 @@ private:
   /*! @brief Locks for the buffers. */
   std::vector< ThreadLock > &_continuous_source_lock;
 
+  /*! @brief Iteration number, used to select random generator substreams. */
+  const uint_fast32_t _iteration;
+
 public:
   /**
    * @brief Constructor.
@@ -111,6 +114,8 @@ public:
    * @param number_of_continuous_photons Number of continuous photon packets
    * to emit.
    * @param continuous_source_lock Locks for the buffers.
+   * @param iteration Iteration number, used to select random generator
+   * substreams.
    */
   inline SourceContinuousPhotonTaskContext(
       ContinuousPhotonSource &continuous_photon_source, MemorySpace &buffers,
@@ -123,7 +128,8 @@ public:
       std::vector< std::vector< PhotonBuffer > > &continuous_buffers,
       std::vector< TaskQueue * > &queues, TaskQueue &shared_queue,
       const uint_fast32_t number_of_continuous_photons,
-      std::vector< ThreadLock > &continuous_source_lock)
+      std::vector< ThreadLock > &continuous_source_lock,
+      const uint_fast32_t iteration)
       : _continuous_photon_source(continuous_photon_source), _buffers(buffers),
         _random_generators(random_generators),
         _continuous_photon_weight(continuous_photon_weight),
@@ -134,7 +140,8 @@ public:
         _shared_queue(shared_queue),
         _number_of_continuous_photons(number_of_continuous_photons),
         _continuous_photons_flushed(0),
-        _continuous_source_lock(continuous_source_lock) {}
+        _continuous_source_lock(continuous_source_lock),
+        _iteration(iteration) {}
 
   /**
    * @brief Execute a continuous photon source task.
@@ -155,6 +162,11 @@ public:
     const uint_fast32_t source_copy = task.get_subgrid();
     const size_t num_photon_this_loop = task.get_buffer();
 
+    // source tasks are created in a fixed order, so that the task index
+    // identifies the photon batch (if the generator supports substreams)
+    _random_generators[thread_id].set_job_substream(_iteration,
+                                                    _tasks.get_index(task));
+
     // draw random photons and store them in the continuous buffers
     for (uint_fast32_t i = 0; i < num_photon_this_loop; ++i) {
 
@@ -188,15 +200,8 @@ public:
       const double frequency = _photon_source_spectrum.get_random_frequency(
           _random_generators[thread_id]);
       photon.set_energy(frequency);
-      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-        double sigma = _cross_sections.get_cross_section(ion, frequency);
-#ifndef VARIABLE_ABUNDANCES
-        if (ion != ION_H_n) {
-          sigma *= _abundances.get_abundance(get_element(ion));
-        }
-#endif
-        photon.set_photoionization_cross_section(ion, sigma);
-      }
+      active_buffer.set_photoionization_cross_sections(
+          _cross_sections, _abundances, active_index);
 
       // did the photon make the buffer overflow?
       if (active_buffer.size() == PHOTONBUFFER_SIZE) {
@@ -230,7 +235,7 @@ public:
         //  - subgrid
         // (the output buffers belong to the subgrid and do not count
         // as a dependency)
-        new_task.set_dependency(subgrid.get_dependency());
+        new_task.set_dependency(subgrid.get_traversal_dependency());
 
         _queues[subgrid.get_owning_thread()]->add_task(task_index);
       }
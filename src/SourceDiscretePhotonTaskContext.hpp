@@ -68,6 +68,9 @@ private:
   /*! @brief Task space. */
   ThreadSafeVector< Task > &_tasks;
 
+  /*! @brief Iteration number, used to select random generator substreams. */
+  const uint_fast32_t _iteration;
+
 public:
   /**
    * @brief Constructor.
@@ -82,6 +85,8 @@ public:
    * @param cross_sections Cross sections for photoionization.
    * @param grid_creator Grid creator.
    * @param tasks Task space.
+   * @param iteration Iteration number, used to select random generator
+   * substreams.
    */
   inline SourceDiscretePhotonTaskContext(
       DistributedPhotonSource< _subgrid_type_ > &photon_source,
@@ -90,13 +95,13 @@ public:
       PhotonSourceSpectrum &photon_source_spectrum,
       const Abundances &abundances, CrossSections &cross_sections,
       DensitySubGridCreator< _subgrid_type_ > &grid_creator,
-      ThreadSafeVector< Task > &tasks)
+      ThreadSafeVector< Task > &tasks, const uint_fast32_t iteration)
       : _photon_source(photon_source), _buffers(buffers),
         _random_generators(random_generators),
         _discrete_photon_weight(discrete_photon_weight),
         _photon_source_spectrum(photon_source_spectrum),
         _abundances(abundances), _cross_sections(cross_sections),
-        _grid_creator(grid_creator), _tasks(tasks) {}
+        _grid_creator(grid_creator), _tasks(tasks), _iteration(iteration) {}
 
   /**
    * @brief Execute a discrete photon source task.
@@ -131,6 +136,16 @@ public:
     const CoordinateVector<> source_position =
         _photon_source.get_position(source_index);
 
+    // source tasks are created in a fixed order, so that the task index
+    // identifies the photon batch (if the generator supports substreams)
+    _random_generators[thread_id].set_job_substream(_iteration,
+                                                    _tasks.get_index(task));
+
+    // draw the frequencies of all photons at once
+    double frequencies[PHOTONBUFFER_SIZE];
+    _photon_source_spectrum.fill_frequencies(_random_generators[thread_id],
+                                             frequencies, num_photon_this_loop);
+
     // draw random photons and store them in the buffer
     for (uint_fast32_t i = 0; i < num_photon_this_loop; ++i) {
 
@@ -166,19 +181,10 @@ public:
       photon.set_target_optical_depth(
           -std::log(_random_generators[thread_id].get_uniform_random_double()));
 
-      const double frequency = _photon_source_spectrum.get_random_frequency(
-          _random_generators[thread_id]);
-      photon.set_energy(frequency);
-      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
-        double sigma = _cross_sections.get_cross_section(ion, frequency);
-#ifndef VARIABLE_ABUNDANCES
-        if (ion != ION_H_n) {
-          sigma *= _abundances.get_abundance(get_element(ion));
-        }
-#endif
-        photon.set_photoionization_cross_section(ion, sigma);
-      }
+      photon.set_energy(frequencies[i]);
     }
+    input_buffer.set_photoionization_cross_sections(_cross_sections,
+                                                    _abundances);
 
     // add to the queue of the corresponding thread
     DensitySubGrid &subgrid = *_grid_creator.get_subgrid(subgrid_index);
@@ -192,7 +198,7 @@ public:
     //  - subgrid
     // (the output buffers belong to the subgrid and do not count as a
     // dependency)
-    new_task.set_dependency(subgrid.get_dependency());
+    new_task.set_dependency(subgrid.get_traversal_dependency());
 
     queues_to_add[0] = subgrid.get_owning_thread();
     tasks_to_add[0] = task_index;
@@ -0,0 +1,377 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file TabulatedCrossSections.hpp
+ *
+ * @brief CrossSections implementation that tabulates another CrossSections
+ * implementation on a regular frequency grid.
+ *
+ * The cross sections for all ions are evaluated once at the bin edges and are
+ * linearly interpolated afterwards. The cross sections for all ions are stored
+ * contiguously for every bin edge, so that a lookup for all ions only touches
+ * two consecutive blocks of memory.
+ *
+ * Ionization thresholds (of the ion itself or of one of its inner shells)
+ * cause discontinuities that cannot be interpolated. At startup, we detect the
+ * bins that contain a discontinuity by comparing the cross section in the
+ * middle of every bin with the interpolated value. For these bins (and for
+ * frequencies outside the range of the table), the wrapped implementation is
+ * evaluated directly. Frequencies that are known to occur very frequently
+ * (e.g. the frequency of a monochromatic spectrum) can be added to a list of
+ * exact values.
+ *
+ * The table is also shared by all compact photon packets (if
+ * USE_COMPACT_PHOTON_PACKET is defined), which only store their position in
+ * the table. The exact values are stored as additional table positions after
+ * the regular bins, so that photon packets with a discrete frequency find
+ * their cross sections without searching.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef TABULATEDCROSSSECTIONS_HPP
+#define TABULATEDCROSSSECTIONS_HPP
+
+#include "CrossSections.hpp"
+#include "Error.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <vector>
+
+/*! @brief Default number of frequency bins in the table. */
+#define TABULATEDCROSSSECTIONS_DEFAULT_SIZE 4096
+
+/*! @brief Maximum relative difference between the cross section in the middle
+ *  of a bin and the interpolated value before the bin is considered to contain
+ *  a discontinuity. */
+#define TABULATEDCROSSSECTIONS_TOLERANCE 1.e-4
+
+/*! @brief Table position bin index for frequencies whose cross sections are
+ *  not interpolated from the table. */
+#define TABULATEDCROSSSECTIONS_EXACT_BIN UINT16_MAX
+
+/**
+ * @brief CrossSections implementation that tabulates another CrossSections
+ * implementation on a regular frequency grid.
+ */
+class TabulatedCrossSections : public CrossSections {
+private:
+  /*! @brief Wrapped CrossSections implementation. */
+  const CrossSections *_cross_sections;
+
+  /*! @brief Lower limit of the frequency range (in Hz). */
+  const double _minimum_frequency;
+
+  /*! @brief Inverse width of a single frequency bin (in Hz^-1). */
+  const double _inverse_frequency_bin_width;
+
+  /*! @brief Number of frequency bins. */
+  const uint_fast32_t _number_of_bins;
+
+  /*! @brief Cross sections at the bin edges (in m^2), stored per bin edge for
+   *  all ions. */
+  std::vector< double > _table;
+
+  /*! @brief Flag for every bin that is set if the bin contains a
+   *  discontinuity. */
+  std::vector< uint_least8_t > _exact_bins;
+
+  /*! @brief Frequencies for which exact cross sections are stored (in Hz,
+   *  sorted in ascending order). */
+  std::vector< double > _exact_frequencies;
+
+  /*! @brief Exact cross sections for these frequencies (in m^2), stored per
+   *  frequency for all ions, in the same order. */
+  std::vector< double > _exact_cross_sections;
+
+  /**
+   * @brief Get the table position of the given frequency.
+   *
+   * @param frequency Frequency (in Hz).
+   * @param bin Output bin index.
+   * @param weight Output relative position within the bin.
+   * @return True if the cross sections for this frequency can be
+   * interpolated from the table.
+   */
+  inline bool get_bin(const double frequency, uint_fast32_t &bin,
+                      double &weight) const {
+
+    const double x =
+        (frequency - _minimum_frequency) * _inverse_frequency_bin_width;
+    if (!(x >= 0. && x < _number_of_bins)) {
+      return false;
+    }
+    bin = x;
+    weight = x - bin;
+    return _exact_bins[bin] == 0;
+  }
+
+  /**
+   * @brief Get the index of the given frequency in the list of exact
+   * frequencies.
+   *
+   * @param frequency Frequency (in Hz).
+   * @return Index, or the size of the list if the frequency is not in it.
+   */
+  inline size_t get_exact_index(const double frequency) const {
+    if (_exact_frequencies.empty()) {
+      return 0;
+    }
+    const std::vector< double >::const_iterator it = std::lower_bound(
+        _exact_frequencies.begin(), _exact_frequencies.end(), frequency);
+    if (it == _exact_frequencies.end() || *it != frequency) {
+      return _exact_frequencies.size();
+    }
+    return it - _exact_frequencies.begin();
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param cross_sections CrossSections implementation to tabulate. Memory
+   * management for this pointer is taken over by this class.
+   * @param number_of_bins Number of frequency bins.
+   * @param minimum_frequency Lower limit of the frequency range (in Hz).
+   * @param maximum_frequency Upper limit of the frequency range (in Hz).
+   */
+  inline TabulatedCrossSections(
+      const CrossSections *cross_sections,
+      const uint_fast32_t number_of_bins = TABULATEDCROSSSECTIONS_DEFAULT_SIZE,
+      const double minimum_frequency = 3.2e15,
+      const double maximum_frequency = 1.4e16)
+      : _cross_sections(cross_sections), _minimum_frequency(minimum_frequency),
+        _inverse_frequency_bin_width(number_of_bins /
+                                     (maximum_frequency - minimum_frequency)),
+        _number_of_bins(number_of_bins),
+        _table((number_of_bins + 1) * NUMBER_OF_IONNAMES),
+        _exact_bins(number_of_bins, 0) {
+
+    if (number_of_bins == 0) {
+      cmac_error("Cross section table needs at least 1 frequency bin!");
+    }
+    // the bin index of a table position needs to fit in 16 bits
+    if (number_of_bins >= TABULATEDCROSSSECTIONS_EXACT_BIN) {
+      cmac_error("Too many frequency bins in cross section table (%" PRIuFAST32
+                 ", maximum: %u)!",
+                 number_of_bins, TABULATEDCROSSSECTIONS_EXACT_BIN - 1);
+    }
+
+    const double frequency_bin_width =
+        (maximum_frequency - minimum_frequency) / number_of_bins;
+    for (uint_fast32_t i = 0; i < _number_of_bins + 1; ++i) {
+      const double frequency = _minimum_frequency + i * frequency_bin_width;
+      _cross_sections->get_cross_sections(frequency,
+                                          &_table[i * NUMBER_OF_IONNAMES]);
+    }
+
+    double midpoint_sigma[NUMBER_OF_IONNAMES];
+    for (uint_fast32_t i = 0; i < _number_of_bins; ++i) {
+      const double frequency =
+          _minimum_frequency + (i + 0.5) * frequency_bin_width;
+      _cross_sections->get_cross_sections(frequency, midpoint_sigma);
+      const double *edges = &_table[i * NUMBER_OF_IONNAMES];
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        const double sigma_low = edges[ion];
+        const double sigma_high = edges[NUMBER_OF_IONNAMES + ion];
+        const double interpolated = 0.5 * (sigma_low + sigma_high);
+        const double norm =
+            std::max(std::abs(midpoint_sigma[ion]),
+                     std::max(std::abs(sigma_low), std::abs(sigma_high)));
+        if (std::abs(midpoint_sigma[ion] - interpolated) >
+            TABULATEDCROSSSECTIONS_TOLERANCE * norm) {
+          _exact_bins[i] = 1;
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Virtual destructor.
+   *
+   * Deletes the wrapped CrossSections implementation.
+   */
+  virtual ~TabulatedCrossSections() { delete _cross_sections; }
+
+  /**
+   * @brief Get the number of bins that contain a discontinuity.
+   *
+   * @return Number of bins that are evaluated exactly.
+   */
+  inline uint_fast32_t get_number_of_exact_bins() const {
+    uint_fast32_t number_of_exact_bins = 0;
+    for (uint_fast32_t i = 0; i < _number_of_bins; ++i) {
+      number_of_exact_bins += _exact_bins[i];
+    }
+    return number_of_exact_bins;
+  }
+
+  /**
+   * @brief Store the exact cross sections for the given frequency.
+   *
+   * All discrete frequencies should be added before table positions are
+   * computed, since adding a frequency can change the table position of
+   * other discrete frequencies.
+   *
+   * @param frequency Frequency (in Hz).
+   */
+  virtual void add_discrete_frequency(const double frequency) {
+    if (get_exact_index(frequency) < _exact_frequencies.size()) {
+      return;
+    }
+    // the table position of an exact value needs to fit in 16 bits
+    if (_number_of_bins + _exact_frequencies.size() + 1 >=
+        TABULATEDCROSSSECTIONS_EXACT_BIN) {
+      cmac_error("Too many discrete frequencies in cross section table!");
+    }
+    const size_t index =
+        std::lower_bound(_exact_frequencies.begin(), _exact_frequencies.end(),
+                         frequency) -
+        _exact_frequencies.begin();
+    _exact_frequencies.insert(_exact_frequencies.begin() + index, frequency);
+    double cross_sections[NUMBER_OF_IONNAMES];
+    _cross_sections->get_cross_sections(frequency, cross_sections);
+    _exact_cross_sections.insert(_exact_cross_sections.begin() +
+                                     index * NUMBER_OF_IONNAMES,
+                                 cross_sections,
+                                 cross_sections + NUMBER_OF_IONNAMES);
+  }
+
+  /**
+   * @brief Get the photoionization cross section for the given ion at the
+   * given photon energy.
+   *
+   * @param ion IonName for a valid ion.
+   * @param energy Photon frequency (in Hz).
+   * @return Photoionization cross section (in m^2).
+   */
+  virtual double get_cross_section(const int_fast32_t ion,
+                                   const double energy) const {
+
+    const size_t exact_index = get_exact_index(energy);
+    if (exact_index < _exact_frequencies.size()) {
+      return _exact_cross_sections[exact_index * NUMBER_OF_IONNAMES + ion];
+    }
+
+    uint_fast32_t bin;
+    double weight;
+    if (!get_bin(energy, bin, weight)) {
+      return _cross_sections->get_cross_section(ion, energy);
+    }
+    const double *edges = &_table[bin * NUMBER_OF_IONNAMES + ion];
+    return edges[0] + weight * (edges[NUMBER_OF_IONNAMES] - edges[0]);
+  }
+
+  /**
+   * @brief Get the photoionization cross sections for all ions at the given
+   * photon energy.
+   *
+   * @param energy Photon frequency (in Hz).
+   * @param cross_sections Output array for the photoionization cross sections
+   * (in m^2).
+   */
+  virtual void get_cross_sections(const double energy,
+                                  double *cross_sections) const {
+
+    const size_t exact_index = get_exact_index(energy);
+    if (exact_index < _exact_frequencies.size()) {
+      const double *exact =
+          &_exact_cross_sections[exact_index * NUMBER_OF_IONNAMES];
+      std::copy(exact, exact + NUMBER_OF_IONNAMES, cross_sections);
+      return;
+    }
+
+    uint_fast32_t bin;
+    double weight;
+    if (!get_bin(energy, bin, weight)) {
+      _cross_sections->get_cross_sections(energy, cross_sections);
+      return;
+    }
+    const double *edges = &_table[bin * NUMBER_OF_IONNAMES];
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      cross_sections[ion] =
+          edges[ion] + weight * (edges[NUMBER_OF_IONNAMES + ion] - edges[ion]);
+    }
+  }
+
+  /**
+   * @brief Get the position of the given frequency in the table.
+   *
+   * This is the compact representation stored by photon packets. Discrete
+   * frequencies get a bin index after the regular bins, that directly refers
+   * to their exact values. Other frequencies for which the cross sections are
+   * not interpolated (bins that contain a discontinuity and frequencies
+   * outside the range of the table) get the bin index
+   * TABULATEDCROSSSECTIONS_EXACT_BIN.
+   *
+   * @param frequency Frequency (in Hz).
+   * @param bin Output bin index.
+   * @param weight Output relative position within the bin.
+   */
+  inline void get_table_position(const double frequency, uint_least16_t &bin,
+                                 float &weight) const {
+
+    const size_t exact_index = get_exact_index(frequency);
+    if (exact_index < _exact_frequencies.size()) {
+      bin = _number_of_bins + exact_index;
+      weight = 0.f;
+      return;
+    }
+
+    uint_fast32_t index;
+    double index_weight;
+    if (get_bin(frequency, index, index_weight)) {
+      bin = index;
+      weight = index_weight;
+    } else {
+      bin = TABULATEDCROSSSECTIONS_EXACT_BIN;
+      weight = 0.f;
+    }
+  }
+
+  /**
+   * @brief Get the photoionization cross section for the given ion at the
+   * given photon energy and corresponding table position.
+   *
+   * @param ion IonName for a valid ion.
+   * @param energy Photon frequency (in Hz).
+   * @param bin Bin index, as returned by get_table_position().
+   * @param weight Relative position within the bin, as returned by
+   * get_table_position().
+   * @return Photoionization cross section (in m^2).
+   */
+  inline double get_cross_section(const int_fast32_t ion, const double energy,
+                                  const uint_least16_t bin,
+                                  const float weight) const {
+
+    if (bin >= _number_of_bins) {
+      if (bin == TABULATEDCROSSSECTIONS_EXACT_BIN) {
+        return _cross_sections->get_cross_section(ion, energy);
+      }
+      return _exact_cross_sections[(bin - _number_of_bins) *
+                                       NUMBER_OF_IONNAMES +
+                                   ion];
+    }
+    const double *edges = &_table[bin * NUMBER_OF_IONNAMES + ion];
+    return edges[0] + weight * (edges[NUMBER_OF_IONNAMES] - edges[0]);
+  }
+};
+
+#endif // TABULATEDCROSSSECTIONS_HPP
@@ -0,0 +1,127 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file TabulatedRecombinationRates.hpp
+ *
+ * @brief RecombinationRates implementation that interpolates the rates of
+ * another RecombinationRates implementation on a temperature table.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef TABULATEDRECOMBINATIONRATES_HPP
+#define TABULATEDRECOMBINATIONRATES_HPP
+
+#include "RecombinationRates.hpp"
+
+#include <cmath>
+#include <vector>
+
+/*! @brief Lower limit of the recombination rate table (in K). */
+#ifndef TABULATEDRECOMBINATIONRATES_MINIMUM_TEMPERATURE
+#define TABULATEDRECOMBINATIONRATES_MINIMUM_TEMPERATURE 100.
+#endif
+
+/*! @brief Upper limit of the recombination rate table (in K). */
+#ifndef TABULATEDRECOMBINATIONRATES_MAXIMUM_TEMPERATURE
+#define TABULATEDRECOMBINATIONRATES_MAXIMUM_TEMPERATURE 1.e7
+#endif
+
+/*! @brief Number of temperature values in the recombination rate table. */
+#ifndef TABULATEDRECOMBINATIONRATES_TABLE_SIZE
+#define TABULATEDRECOMBINATIONRATES_TABLE_SIZE 10000
+#endif
+
+/**
+ * @brief RecombinationRates implementation that interpolates the rates of
+ * another RecombinationRates implementation on a temperature table.
+ *
+ * The rates for all ions are tabulated on a logarithmic temperature grid when
+ * the object is constructed, and are linearly interpolated in log temperature
+ * afterwards. Temperatures outside the table range are passed on to the
+ * underlying RecombinationRates.
+ */
+class TabulatedRecombinationRates : public RecombinationRates {
+private:
+  /*! @brief RecombinationRates that are tabulated. */
+  const RecombinationRates &_recombination_rates;
+
+  /*! @brief Natural logarithm of the lower limit of the table (in K). */
+  const double _log_minimum_temperature;
+
+  /*! @brief Inverse of the natural logarithmic spacing of the table. */
+  double _inverse_log_table_spacing;
+
+  /*! @brief Recombination rate table: for every temperature, the rates for
+   *  all ions (in m^3 s^-1). */
+  std::vector< double > _table;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param recombination_rates RecombinationRates to tabulate. This object
+   * should not be destroyed before the TabulatedRecombinationRates.
+   */
+  inline TabulatedRecombinationRates(
+      const RecombinationRates &recombination_rates)
+      : _recombination_rates(recombination_rates),
+        _log_minimum_temperature(
+            std::log(TABULATEDRECOMBINATIONRATES_MINIMUM_TEMPERATURE)),
+        _table(TABULATEDRECOMBINATIONRATES_TABLE_SIZE * NUMBER_OF_IONNAMES) {
+
+    const double dlogT =
+        (std::log(TABULATEDRECOMBINATIONRATES_MAXIMUM_TEMPERATURE) -
+         _log_minimum_temperature) /
+        (TABULATEDRECOMBINATIONRATES_TABLE_SIZE - 1);
+    _inverse_log_table_spacing = 1. / dlogT;
+    for (uint_fast32_t i = 0; i < TABULATEDRECOMBINATIONRATES_TABLE_SIZE;
+         ++i) {
+      const double T = std::exp(_log_minimum_temperature + i * dlogT);
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        _table[i * NUMBER_OF_IONNAMES + ion] =
+            _recombination_rates.get_recombination_rate(ion, T);
+      }
+    }
+  }
+
+  /**
+   * @brief Get the recombination rate for the given ion at the given
+   * temperature.
+   *
+   * @param ion IonName for a valid ion.
+   * @param temperature Temperature (in K).
+   * @return Recombination rate (in m^3s^-1).
+   */
+  virtual double get_recombination_rate(const int_fast32_t ion,
+                                        const double temperature) const {
+
+    const double u = (std::log(temperature) - _log_minimum_temperature) *
+                     _inverse_log_table_spacing;
+    if (!(u >= 0. && u < TABULATEDRECOMBINATIONRATES_TABLE_SIZE - 1)) {
+      return _recombination_rates.get_recombination_rate(ion, temperature);
+    }
+    const uint_fast32_t index = static_cast< uint_fast32_t >(u);
+    const double fraction = u - index;
+    const double rate0 = _table[index * NUMBER_OF_IONNAMES + ion];
+    const double rate1 = _table[(index + 1) * NUMBER_OF_IONNAMES + ion];
+    return rate0 + fraction * (rate1 - rate0);
+  }
+};
+
+#endif // TABULATEDRECOMBINATIONRATES_HPP
@@ -73,6 +73,12 @@ enum TaskType {
   /*! @brief Flush the continuous source photon buffers at the end of the photon
    *  packet creation phase of the iteration. */
   TASKTYPE_FLUSH_CONTINUOUS_PHOTON_BUFFERS,
+  /*! @brief Do a fused gradient and slope limiter sweep. */
+  TASKTYPE_GRADIENTSWEEP_FUSED,
+  /*! @brief Do a fused primitive variable prediction and flux sweep. */
+  TASKTYPE_FLUXSWEEP_FUSED,
+  /*! @brief Do a fused conserved and primitive variable update sweep. */
+  TASKTYPE_UPDATE_FUSED,
   /*! @brief Task type counter. */
   TASKTYPE_NUMBER
 };
@@ -35,11 +35,17 @@
 #include "DiffuseReemissionHandlerFactory.hpp"
 #include "DistributedPhotonSource.hpp"
 #include "FlushContinuousPhotonBuffersTaskContext.hpp"
+#include "MPICommunicator.hpp"
 #include "MemorySpace.hpp"
+#include "NUMATopology.hpp"
 #include "OpenMP.hpp"
 #include "ParameterFile.hpp"
+#include "PhotonBufferCommunicator.hpp"
+#include "PhotonBufferPolicy.hpp"
 #include "PhotonPacketStatistics.hpp"
+#include "PhotonReceiveTaskContext.hpp"
 #include "PhotonReemitTaskContext.hpp"
+#include "PhotonSendTaskContext.hpp"
 #include "PhotonSourceDistributionFactory.hpp"
 #include "PhotonSourceSpectrumFactory.hpp"
 #include "PhotonTraversalTaskContext.hpp"
@@ -52,6 +58,7 @@
 #include "SourceContinuousPhotonTaskContext.hpp"
 #include "SourceDiscretePhotonTaskContext.hpp"
 #include "TaskQueue.hpp"
+#include "TaskTrace.hpp"
 #include "TemperatureCalculator.hpp"
 #include "ThreadStats.hpp"
 #include "TrackerManager.hpp"
@@ -80,16 +87,20 @@
  * @param iteration_start Start CPU cycle count of the iteration on this
  * process.
  * @param iteration_end End CPU cycle count of the iteration on this process.
+ * @param rank Rank of the local MPI process.
+ * @param rank_suffix Suffix to add to the file name.
  */
 inline void output_tasks(const uint_fast32_t iloop,
                          ThreadSafeVector< Task > &tasks,
                          const uint_fast64_t iteration_start,
-                         const uint_fast64_t iteration_end) {
+                         const uint_fast64_t iteration_end,
+                         const int_fast32_t rank,
+                         const std::string rank_suffix) {
 
   {
     // compose the file name
     std::stringstream filename;
-    filename << "tasks_";
+    filename << "tasks" << rank_suffix << "_";
     filename.fill('0');
     filename.width(2);
     filename << iloop;
@@ -103,7 +114,8 @@ inline void output_tasks(const uint_fast32_t iloop,
     // write the start and end CPU cycle count
     // this is a dummy task executed by thread 0 (so that the min or max
     // thread count is not affected), but with non-existing type -1
-    ofile << "0\t0\t" << iteration_start << "\t" << iteration_end << "\t-1\n";
+    ofile << rank << "\t0\t" << iteration_start << "\t" << iteration_end
+          << "\t-1\n";
 
     // write the task info
     const size_t tsize = tasks.size();
@@ -114,26 +126,56 @@ inline void output_tasks(const uint_fast32_t iloop,
       int_fast32_t thread_id;
       uint_fast64_t start, end;
       task.get_timing_information(type, thread_id, start, end);
-      ofile << "0\t" << thread_id << "\t" << start << "\t" << end << "\t"
-            << static_cast< int_fast32_t >(type) << "\n";
+      ofile << rank << "\t" << thread_id << "\t" << start << "\t" << end
+            << "\t" << static_cast< int_fast32_t >(type) << "\n";
     }
   }
 }
 
+/**
+ * @brief Get the number of photon packets that are handled by the given task.
+ *
+ * Should be called before the task is executed, since executing the task
+ * might free its input buffer.
+ *
+ * @param task Task.
+ * @param buffers Photon buffers.
+ * @return Number of photon packets (0 if the task does not handle photon
+ * packets).
+ */
+inline uint_fast32_t get_number_of_photons(const Task &task,
+                                           MemorySpace &buffers) {
+  switch (task.get_type()) {
+  case TASKTYPE_SOURCE_DISCRETE_PHOTON:
+  case TASKTYPE_SOURCE_CONTINUOUS_PHOTON:
+    // source tasks store the number of photon packets to generate
+    return task.get_buffer();
+  case TASKTYPE_PHOTON_TRAVERSAL:
+  case TASKTYPE_PHOTON_REEMIT:
+  case TASKTYPE_SEND:
+    return buffers[task.get_buffer()].size();
+  default:
+    return 0;
+  }
+}
+
 /**
  * @brief Write file with queue size information for an iteration.
  *
  * @param iloop Iteration number (added to file names).
  * @param queues Per thread queues.
  * @param general_queue General queue.
+ * @param rank Rank of the local MPI process.
+ * @param rank_suffix Suffix to add to the file name.
  */
 inline void output_queues(const unsigned int iloop,
                           std::vector< TaskQueue * > &queues,
-                          TaskQueue &general_queue) {
+                          TaskQueue &general_queue, const int_fast32_t rank,
+                          const std::string rank_suffix) {
 
   // first compose the file name
   std::stringstream filename;
-  filename << "queues_";
+  filename << "queues" << rank_suffix << "_";
   filename.fill('0');
   filename.width(2);
   filename << iloop;
@@ -146,13 +188,13 @@ inline void output_queues(const unsigned int iloop,
   ofile << "# rank\tqueue\tsize\n";
 
   // start with the general queue (-1)
-  ofile << "0\t-1\t" << general_queue.get_max_queue_size() << "\n";
+  ofile << rank << "\t-1\t" << general_queue.get_max_queue_size() << "\n";
   general_queue.reset_max_queue_size();
 
   // now do the other queues
   for (size_t i = 0; i < queues.size(); ++i) {
     TaskQueue &queue = *queues[i];
-    ofile << "0\t" << i << "\t" << queue.get_max_queue_size() << "\n";
+    ofile << rank << "\t" << i << "\t" << queue.get_max_queue_size() << "\n";
     queue.reset_max_queue_size();
   }
 }
@@ -177,33 +219,81 @@ inline void output_queues(const unsigned int iloop,
  *  - diffuse field: Should the diffuse field be tracked? (default: false)
  *  - source copy level: Copy level for subgrids that contain a source (default:
  *    4)
+ *  - private intensity counters: Give every thread its own intensity counters
+ *    for subgrids that contain a source, so that these can be traversed by
+ *    multiple threads simultaneously, instead of creating subgrid copies
+ *    (default: false)
  *  - enable trackers: Track photon packets travelling through specific
  *    positions? (default: no)
+ *  - task trace sampling rate: Fraction of the tasks that is recorded in the
+ *    low overhead task trace, or 0 to disable the trace (default: 0)
+ *  - task trace buffer size: Maximum number of trace records that is kept per
+ *    thread and per iteration (default: 65536)
+ *  - task trace format: Format of the task trace output files, binary or
+ *    Chrome (trace event JSON, default: binary)
+ *  - NUMA affinity: Place subgrids in spatially contiguous blocks on the NUMA
+ *    nodes of the threads that own them, and prefer stealing tasks from
+ *    threads on the same NUMA node (default: false)
+ *  - number of NUMA nodes: Number of NUMA nodes to distribute the threads
+ *    over, in consecutive blocks, or 0 to detect the NUMA node of every
+ *    thread at runtime. Detection requires threads to be pinned (e.g.
+ *    OMP_PROC_BIND=true) (default: 0)
+ *  - adaptive photon buffers: Adapt the photon buffer size and premature
+ *    launch threshold for every subgrid to the observed buffer occupancy and
+ *    traversal cost, using the parameters in the PhotonBufferPolicy block
+ *    (default: false)
+ *
+ * If the given MPICommunicator contains more than one process, the grid is
+ * distributed across all processes. Every process then only stores and
+ * traverses its own part of the grid, and photon buffers that cross a process
+ * boundary are sent to the process that owns the target subgrid. Every
+ * process writes its own snapshots and diagnostic output files. Continuous
+ * sources, trackers and subgrid copies are not supported in this mode.
  *
  * @param num_thread Number of shared memory parallel threads to use.
  * @param parameterfile_name Name of the parameter file to use.
  * @param task_plot Output task plot information?
  * @param output_initial_snapshot Output a snapshot before the initial
  * iteration?
+ * @param mpi_communicator MPICommunicator to use for distributed memory
+ * communications.
  * @param log Log to write logging info to.
  */
 TaskBasedIonizationSimulation::TaskBasedIonizationSimulation(
     const int_fast32_t num_thread, const std::string parameterfile_name,
-    const bool task_plot, const bool output_initial_snapshot, Log *log)
+    const bool task_plot, const bool output_initial_snapshot,
+    MPICommunicator *mpi_communicator, Log *log)
     : _parameter_file(parameterfile_name),
       _number_of_iterations(_parameter_file.get_value< uint_fast32_t >(
           "TaskBasedIonizationSimulation:number of iterations", 10)),
       _number_of_photons(_parameter_file.get_value< uint_fast64_t >(
           "TaskBasedIonizationSimulation:number of photons", 1e6)),
+      _convergence_controller(_number_of_photons, _parameter_file),
       _source_copy_level(_parameter_file.get_value< uint_fast32_t >(
           "TaskBasedIonizationSimulation:source copy level", 4)),
-      _simulation_box(_parameter_file),
+      _private_intensity_counters(_parameter_file.get_value< bool >(
+          "TaskBasedIonizationSimulation:private intensity counters", false)),
+      _simulation_box(_parameter_file), _mpi_rank(-1),
+      _mpi_communicator(nullptr),
+      _photon_buffer_communicator(nullptr),
       _abundance_model(AbundanceModelFactory::generate(_parameter_file, log)),
       _abundances(_abundance_model->get_abundances()), _log(log),
       _task_plot(task_plot), _output_initial_snapshot(output_initial_snapshot) {
 
   set_number_of_threads(num_thread);
 
+  // distributed memory mode: every process only stores part of the grid
+  if (mpi_communicator != nullptr && mpi_communicator->get_size() > 1) {
+    _mpi_rank = mpi_communicator->get_rank();
+    _mpi_communicator = mpi_communicator;
+    std::stringstream rank_suffix;
+    rank_suffix << "_rank";
+    rank_suffix.fill('0');
+    rank_suffix.width(3);
+    rank_suffix << _mpi_rank;
+    _rank_suffix = rank_suffix.str();
+  }
+
   // install signal handlers
   OperatingSystem::install_signal_handlers(true);
 
@@ -230,7 +320,8 @@ TaskBasedIonizationSimulation::TaskBasedIonizationSimulation(
   for (int_fast8_t ithread = 0; ithread < num_thread; ++ithread) {
     std::stringstream queue_name;
     queue_name << "Queue for Thread " << static_cast< int_fast32_t >(ithread);
-    _queues[ithread] = new TaskQueue(queue_size_per_thread, queue_name.str());
+    _queues[ithread] =
+        new TaskQueue(queue_size_per_thread, queue_name.str(), ithread);
   }
   _memory_log.finalize_entry();
   _time_log.end("thread queues");
@@ -255,12 +346,19 @@ TaskBasedIonizationSimulation::TaskBasedIonizationSimulation(
   const int_fast32_t random_seed = _parameter_file.get_value< int_fast32_t >(
       "TaskBasedIonizationSimulation:random seed", 42);
   for (uint_fast8_t ithread = 0; ithread < num_thread; ++ithread) {
-    _random_generators[ithread].set_seed(random_seed + ithread);
+    _random_generators[ithread].set_seed(
+        random_seed + std::max(_mpi_rank, static_cast< int_fast32_t >(0)) *
+                          num_thread +
+        ithread);
   }
 
   _time_log.start("grid creator");
   _grid_creator = new DensitySubGridCreator< DensitySubGrid >(
       _simulation_box.get_box(), _parameter_file);
+  if (_mpi_rank >= 0) {
+    _grid_creator->set_domain_decomposition(_mpi_rank,
+                                            mpi_communicator->get_size());
+  }
   _time_log.end("grid creator");
 
   _time_log.start("density function");
@@ -271,6 +369,13 @@ TaskBasedIonizationSimulation::TaskBasedIonizationSimulation(
   std::string output_folder =
       Utilities::get_absolute_path(_parameter_file.get_value< std::string >(
           "TaskBasedIonizationSimulation:output folder", "."));
+  if (_mpi_rank >= 0) {
+    // every process writes its own part of the grid to a separate snapshot
+    const std::string prefix = _parameter_file.get_value< std::string >(
+        "DensityGridWriter:prefix", "snapshot");
+    _parameter_file.add_value("DensityGridWriter:prefix",
+                              prefix + _rank_suffix + "_");
+  }
   _density_grid_writer = DensityGridWriterFactory::generate(
       output_folder, _parameter_file, false, _log);
 
@@ -285,7 +390,18 @@ TaskBasedIonizationSimulation::TaskBasedIonizationSimulation(
   _continuous_photon_source_spectrum = PhotonSourceSpectrumFactory::generate(
       "ContinuousPhotonSourceSpectrum", _parameter_file, _log);
 
+#ifdef USE_COMPACT_PHOTON_PACKET
+  // compact photon packets look up their cross sections in a shared table
+  TabulatedCrossSections *cross_section_table =
+      CrossSectionsFactory::generate_tabulated(_parameter_file, _log);
+  PhotonPacket::set_cross_section_table(cross_section_table, _abundances);
+  _cross_sections = cross_section_table;
+#else
   _cross_sections = CrossSectionsFactory::generate(_parameter_file, _log);
+#endif
+  CrossSectionsFactory::add_discrete_frequencies(
+      *_cross_sections, _photon_source_spectrum,
+      _continuous_photon_source_spectrum);
   _recombination_rates =
       RecombinationRatesFactory::generate(_parameter_file, _log);
 
@@ -352,14 +468,72 @@ TaskBasedIonizationSimulation::TaskBasedIonizationSimulation(
     _trackers = nullptr;
   }
 
+  const double task_trace_sampling_rate = _parameter_file.get_value< double >(
+      "TaskBasedIonizationSimulation:task trace sampling rate", 0.);
+  if (task_trace_sampling_rate > 0.) {
+    const size_t task_trace_buffer_size = _parameter_file.get_value< size_t >(
+        "TaskBasedIonizationSimulation:task trace buffer size", 65536);
+    const std::string task_trace_format =
+        _parameter_file.get_value< std::string >(
+            "TaskBasedIonizationSimulation:task trace format", "binary");
+    if (task_trace_format == "binary") {
+      _task_trace_chrome_format = false;
+    } else if (task_trace_format == "Chrome") {
+      _task_trace_chrome_format = true;
+    } else {
+      cmac_error("Unknown task trace format: \"%s\"!",
+                 task_trace_format.c_str());
+    }
+    _task_trace = new TaskTrace(num_thread, task_trace_buffer_size,
+                                task_trace_sampling_rate);
+  } else {
+    _task_trace = nullptr;
+    _task_trace_chrome_format = false;
+  }
+
+  if (_parameter_file.get_value< bool >(
+          "TaskBasedIonizationSimulation:NUMA affinity", false)) {
+    const int_fast32_t number_of_numa_nodes =
+        _parameter_file.get_value< int_fast32_t >(
+            "TaskBasedIonizationSimulation:number of NUMA nodes", 0);
+    _numa_topology = new NUMATopology(num_thread, number_of_numa_nodes);
+    if (_log) {
+      _log->write_status("NUMA affinity: ", num_thread, " threads on ",
+                         _numa_topology->get_number_of_nodes(),
+                         " NUMA node(s).");
+    }
+  } else {
+    _numa_topology = nullptr;
+  }
+
+  if (_parameter_file.get_value< bool >(
+          "TaskBasedIonizationSimulation:adaptive photon buffers", false)) {
+    _photon_buffer_policy = new PhotonBufferPolicy(_parameter_file);
+  } else {
+    _photon_buffer_policy = nullptr;
+  }
+
+  if (_mpi_rank >= 0) {
+    if (_continuous_photon_source != nullptr) {
+      cmac_error("Continuous photon sources are not supported for "
+                 "distributed grids!");
+    }
+    if (_trackers != nullptr) {
+      cmac_error("Trackers are not supported for distributed grids!");
+    }
+    _photon_buffer_communicator = new PhotonBufferCommunicator(num_thread);
+  }
+
   // we are done reading the parameter file
   // now output all parameters (also those for which default values were used)
-  const std::string usedvaluename = parameterfile_name + ".used-values";
-  std::ofstream pfile(usedvaluename);
-  _parameter_file.print_contents(pfile);
-  pfile.close();
-  if (_log) {
-    _log->write_status("Wrote used parameters to ", usedvaluename, ".");
+  if (_mpi_rank <= 0) {
+    const std::string usedvaluename = parameterfile_name + ".used-values";
+    std::ofstream pfile(usedvaluename);
+    _parameter_file.print_contents(pfile);
+    pfile.close();
+    if (_log) {
+      _log->write_status("Wrote used parameters to ", usedvaluename, ".");
+    }
   }
 
   _memory_log.add_entry("parameters done");
@@ -397,18 +571,19 @@ TaskBasedIonizationSimulation::~TaskBasedIonizationSimulation() {
   }
 
   if (_task_plot) {
-    std::ofstream pfile("program_time.txt");
+    std::ofstream pfile("program_time" + _rank_suffix + ".txt");
     pfile << "# rank\tstart\tstop\ttime\n";
-    pfile << "0\t" << _program_start << "\t" << program_end << "\t"
+    pfile << std::max(_mpi_rank, static_cast< int_fast32_t >(0)) << "\t"
+          << _program_start << "\t" << program_end << "\t"
           << _total_timer.value() << "\n";
   }
 
   {
-    std::ofstream mfile("memory_timeline.txt");
+    std::ofstream mfile("memory_timeline" + _rank_suffix + ".txt");
     _memory_log.print(mfile, true);
   }
 
-  _time_log.output("time_log.txt", false);
+  _time_log.output("time_log" + _rank_suffix + ".txt", false);
 
   delete _buffers;
   for (uint_fast8_t ithread = 0; ithread < _queues.size(); ++ithread) {
@@ -429,6 +604,10 @@ TaskBasedIonizationSimulation::~TaskBasedIonizationSimulation() {
   delete _reemission_handler;
   delete _trackers;
   delete _abundance_model;
+  delete _photon_buffer_communicator;
+  delete _task_trace;
+  delete _numa_topology;
+  delete _photon_buffer_policy;
 }
 
 /**
@@ -454,7 +633,11 @@ void TaskBasedIonizationSimulation::initialize(
   _time_log.start("grid");
   _memory_log.add_entry("grid");
   start_parallel_timing_block();
-  _grid_creator->initialize(*density_function);
+  if (_numa_topology != nullptr) {
+    _grid_creator->initialize(*density_function, *_numa_topology);
+  } else {
+    _grid_creator->initialize(*density_function);
+  }
   stop_parallel_timing_block();
 
   if (_log) {
@@ -515,9 +698,49 @@ void TaskBasedIonizationSimulation::run(
   std::vector< uint_fast8_t > levels(
       _grid_creator->number_of_original_subgrids(), 0);
 
+  // private intensity counters do not work with trackers, since trackers are
+  // not thread safe
+  const bool private_intensity_counters =
+      _private_intensity_counters && _trackers == nullptr;
+  if (_private_intensity_counters && !private_intensity_counters && _log) {
+    _log->write_warning("Private intensity counters cannot be used together "
+                        "with trackers. Using subgrid copies instead.");
+  }
+
+  if (private_intensity_counters && _photon_source_distribution) {
+    // give all subgrids containing a source private intensity counters for
+    // every thread, so that they can be traversed by all threads at the same
+    // time
+    const photonsourcenumber_t number_of_sources =
+        _photon_source_distribution->get_number_of_sources();
+    for (photonsourcenumber_t isource = 0; isource < number_of_sources;
+         ++isource) {
+      const CoordinateVector<> position =
+          _photon_source_distribution->get_position(isource);
+      DensitySubGridCreator< DensitySubGrid >::iterator gridit =
+          _grid_creator->get_subgrid(position);
+      if (!_grid_creator->is_local(gridit.get_index())) {
+        continue;
+      }
+      DensitySubGrid &subgrid = *gridit;
+      if (!subgrid.has_private_counters()) {
+        subgrid.activate_private_counters(_queues.size());
+      }
+    }
+  }
+
+  // subgrid copies cannot be used for distributed grids, since the copies
+  // would have to be traversed on another process
+  if (_photon_buffer_communicator != nullptr && !private_intensity_counters &&
+      _source_copy_level > 0 && _log) {
+    _log->write_warning("Subgrid copies cannot be used for distributed "
+                        "grids. Disabling subgrid copies.");
+  }
+
   // set the copy level of all subgrids containing a source to the given
   // parameter value (for now)
-  if (_photon_source_distribution) {
+  if (!private_intensity_counters && _photon_source_distribution &&
+      _photon_buffer_communicator == nullptr) {
     const photonsourcenumber_t number_of_sources =
         _photon_source_distribution->get_number_of_sources();
     for (photonsourcenumber_t isource = 0; isource < number_of_sources;
@@ -569,7 +792,7 @@ void TaskBasedIonizationSimulation::run(
     if (_log) {
       _log->write_status("Outputting memory allocation stats to memory.txt.");
     }
-    std::ofstream mfile("memory.txt");
+    std::ofstream mfile("memory" + _rank_suffix + ".txt");
     _memory_log.print(mfile, false);
   }
 
@@ -609,7 +832,7 @@ void TaskBasedIonizationSimulation::run(
     continuous_photon_weight = 2. * luminosity_ratio / (luminosity_ratio + 1.);
   }
 
-  const uint_fast32_t fixed_number_of_continuous_photons =
+  uint_fast32_t fixed_number_of_continuous_photons =
       number_of_continuous_photons;
 
   if (_photon_source_distribution != nullptr) {
@@ -627,18 +850,40 @@ void TaskBasedIonizationSimulation::run(
 #endif
     while (igrid.value() < _grid_creator->number_of_actual_subgrids()) {
       const size_t this_igrid = igrid.post_increment();
-      if (this_igrid < _grid_creator->number_of_actual_subgrids()) {
+      if (this_igrid < _grid_creator->number_of_actual_subgrids() &&
+          _grid_creator->is_local(this_igrid)) {
         DensitySubGrid &subgrid = *_grid_creator->get_subgrid(this_igrid);
         for (int ingb = 0; ingb < TRAVELDIRECTION_NUMBER; ++ingb) {
           subgrid.set_active_buffer(ingb, NEIGHBOUR_OUTSIDE);
-          subgrid.set_owning_thread(get_thread_index());
+          // with NUMA affinity, subgrids keep the owner that allocated them
+          if (_numa_topology == nullptr) {
+            subgrid.set_owning_thread(get_thread_index());
+          }
         }
       }
     }
     stop_parallel_timing_block();
   }
+  if (_photon_buffer_policy != nullptr) {
+    _photon_buffer_policy->set_number_of_subgrids(
+        _grid_creator->number_of_actual_subgrids());
+  }
   _time_log.end("subgrid initialisation");
 
+  const bool check_convergence =
+      _convergence_controller.is_active(_trackers != nullptr);
+  // changes during the current iteration for every thread, and a scratch
+  // buffer per thread that stores the old state of a subgrid
+  std::vector< ConvergenceController::Changes > thread_changes;
+  std::vector< std::vector< double > > old_states;
+  if (check_convergence) {
+    thread_changes.resize(_queues.size());
+    old_states.resize(_queues.size());
+    _convergence_controller.start_run();
+  }
+  // number of iterations that was actually done
+  uint_fast32_t number_of_iterations_done = _number_of_iterations;
+
   _time_log.start("photoionization loop");
   for (uint_fast32_t iloop = 0; iloop < _number_of_iterations; ++iloop) {
 
@@ -653,6 +898,9 @@ void TaskBasedIonizationSimulation::run(
 
     uint_fast64_t iteration_start, iteration_end;
     cpucycle_tick(iteration_start);
+    if (_task_trace != nullptr) {
+      _task_trace->reset();
+    }
     _photon_propagation_timer.start();
 
     // reset the photon source information
@@ -684,7 +932,8 @@ void TaskBasedIonizationSimulation::run(
 #endif
       while (igrid.value() < _grid_creator->number_of_actual_subgrids()) {
         const size_t this_igrid = igrid.post_increment();
-        if (this_igrid < _grid_creator->number_of_actual_subgrids()) {
+        if (this_igrid < _grid_creator->number_of_actual_subgrids() &&
+            _grid_creator->is_local(this_igrid)) {
           auto gridit = _grid_creator->get_subgrid(this_igrid);
           (*gridit).reset_intensities();
         }
@@ -702,7 +951,8 @@ void TaskBasedIonizationSimulation::run(
 #endif
       while (igrid.value() < _grid_creator->number_of_actual_subgrids()) {
         const size_t this_igrid = igrid.post_increment();
-        if (this_igrid < _grid_creator->number_of_actual_subgrids()) {
+        if (this_igrid < _grid_creator->number_of_actual_subgrids() &&
+            _grid_creator->is_local(this_igrid)) {
           auto gridit = _grid_creator->get_subgrid(this_igrid);
           for (auto cellit = (*gridit).begin(); cellit != (*gridit).end();
                ++cellit) {
@@ -725,11 +975,14 @@ void TaskBasedIonizationSimulation::run(
           const size_t number_of_photons_this_batch =
               photon_source->get_photon_batch(isrc, PHOTONBUFFER_SIZE);
           if (number_of_photons_this_batch > 0) {
-            const size_t new_task = _tasks->get_free_element();
-            (*_tasks)[new_task].set_type(TASKTYPE_SOURCE_DISCRETE_PHOTON);
-            (*_tasks)[new_task].set_subgrid(isrc);
-            (*_tasks)[new_task].set_buffer(number_of_photons_this_batch);
-            _shared_queue->add_task(new_task);
+            // sources in remote subgrids are handled by another process
+            if (_grid_creator->is_local(photon_source->get_subgrid(isrc))) {
+              const size_t new_task = _tasks->get_free_element();
+              (*_tasks)[new_task].set_type(TASKTYPE_SOURCE_DISCRETE_PHOTON);
+              (*_tasks)[new_task].set_subgrid(isrc);
+              (*_tasks)[new_task].set_buffer(number_of_photons_this_batch);
+              _shared_queue->add_task(new_task);
+            }
             number_of_photons_done += number_of_photons_this_batch;
           }
         }
@@ -786,7 +1039,7 @@ void TaskBasedIonizationSimulation::run(
           new SourceDiscretePhotonTaskContext< DensitySubGrid >(
               *photon_source, *_buffers, _random_generators,
               discrete_photon_weight, *_photon_source_spectrum, _abundances,
-              *_cross_sections, *_grid_creator, *_tasks);
+              *_cross_sections, *_grid_creator, *_tasks, iloop);
     }
 
     if (_continuous_photon_source) {
@@ -796,7 +1049,7 @@ void TaskBasedIonizationSimulation::run(
               continuous_photon_weight, *_continuous_photon_source_spectrum,
               _abundances, *_cross_sections, *_grid_creator, *_tasks,
               continuous_buffers, _queues, *_shared_queue,
-              number_of_continuous_photons, continuous_source_lock);
+              number_of_continuous_photons, continuous_source_lock, iloop);
       task_contexts[TASKTYPE_FLUSH_CONTINUOUS_PHOTON_BUFFERS] =
           new FlushContinuousPhotonBuffersTaskContext(
               *_buffers, *_grid_creator, *_tasks, continuous_buffers, _queues);
@@ -806,18 +1059,34 @@ void TaskBasedIonizationSimulation::run(
       task_contexts[TASKTYPE_PHOTON_REEMIT] =
           new PhotonReemitTaskContext< DensitySubGrid >(
               *_buffers, _random_generators, *_reemission_handler, _abundances,
-              *_cross_sections, *_grid_creator, *_tasks, num_photon_done);
+              *_cross_sections, *_grid_creator, *_tasks, num_photon_done,
+              iloop);
     }
 
     task_contexts[TASKTYPE_PHOTON_TRAVERSAL] =
         new PhotonTraversalTaskContext< DensitySubGrid >(
             *_buffers, *_grid_creator, *_tasks, num_photon_done, &statistics,
-            _reemission_handler != nullptr);
+            _reemission_handler != nullptr, _numa_topology,
+            _photon_buffer_policy);
 
     PrematureLaunchTaskContext< DensitySubGrid > premature_launch(
-        *_buffers, *_grid_creator, *_tasks, _queues, *_shared_queue);
+        *_buffers, *_grid_creator, *_tasks, _queues, *_shared_queue,
+        _photon_buffer_policy);
+
+    PhotonReceiveTaskContext< DensitySubGrid > *photon_receive = nullptr;
+    if (_photon_buffer_communicator) {
+      task_contexts[TASKTYPE_SEND] =
+          new PhotonSendTaskContext< DensitySubGrid >(
+              *_buffers, *_grid_creator, *_photon_buffer_communicator);
+      photon_receive = new PhotonReceiveTaskContext< DensitySubGrid >(
+          *_buffers, *_grid_creator, *_tasks, _queues,
+          *_photon_buffer_communicator);
+    }
 
-    Scheduler scheduler(*_tasks, _queues, *_shared_queue);
+    Scheduler scheduler(*_tasks, _queues, *_shared_queue,
+                        (_numa_topology != nullptr) ? SCHEDULER_STEAL_NUMA
+                                                    : SCHEDULER_STEAL_RANDOM,
+                        _numa_topology);
 
     start_parallel_timing_block();
 #ifdef HAVE_OPENMP
@@ -835,11 +1104,16 @@ void TaskBasedIonizationSimulation::run(
 
       // actual run flag
       uint_fast32_t current_index = _shared_queue->get_task(*_tasks);
+      // queue the current task was taken from (only used for the task trace)
+      int_fast32_t current_queue = -1;
       while (global_run_flag) {
 
         if (current_index == NO_TASK) {
-          premature_launch.execute();
-          current_index = scheduler.get_task(thread_id);
+          if (photon_receive != nullptr) {
+            photon_receive->execute();
+          }
+          premature_launch.execute(thread_id);
+          current_index = scheduler.get_task(thread_id, current_queue);
         }
 
         while (current_index != NO_TASK) {
@@ -852,6 +1126,13 @@ void TaskBasedIonizationSimulation::run(
           Task &task = (*_tasks)[current_index];
           thread_stats[thread_id].start(task.get_type());
 
+          const bool trace_task =
+              (_task_trace != nullptr) && _task_trace->sample(thread_id);
+          uint_fast32_t number_of_photons = 0;
+          if (trace_task) {
+            number_of_photons = get_number_of_photons(task, *_buffers);
+          }
+
           task.start(thread_id);
 
           num_tasks_to_add = task_contexts[task.get_type()]->execute(
@@ -861,6 +1142,11 @@ void TaskBasedIonizationSimulation::run(
           // log the end time of the task
           task.stop();
 
+          if (trace_task) {
+            _task_trace->record(thread_id, task, current_queue,
+                                number_of_photons);
+          }
+
           task.unlock_dependency();
           thread_stats[thread_id].stop(task.get_type());
 
@@ -878,14 +1164,24 @@ void TaskBasedIonizationSimulation::run(
             }
           }
 
-          current_index = scheduler.get_task(thread_id);
+          current_index = scheduler.get_task(thread_id, current_queue);
         }
 
-        if (_buffers->is_empty() &&
-            num_photon_done.value() == _number_of_photons) {
+        bool finished;
+        if (_photon_buffer_communicator != nullptr) {
+          // the termination check needs to progress, even if this process
+          // still has work to do
+          finished = _photon_buffer_communicator->is_finished(
+                         num_photon_done.value(), _number_of_photons) &&
+                     _buffers->is_empty();
+        } else {
+          finished = _buffers->is_empty() &&
+                     num_photon_done.value() == _number_of_photons;
+        }
+        if (finished) {
           global_run_flag = false;
         } else {
-          current_index = scheduler.get_task(thread_id);
+          current_index = scheduler.get_task(thread_id, current_queue);
         }
       } // while(global_run_flag)
 
@@ -894,6 +1190,25 @@ void TaskBasedIonizationSimulation::run(
       }
     } // parallel region
     stop_parallel_timing_block();
+    if (_photon_buffer_communicator != nullptr) {
+      _photon_buffer_communicator->reset();
+      delete photon_receive;
+    }
+    if (_photon_buffer_policy != nullptr) {
+      _photon_buffer_policy->update();
+      if (_log != nullptr) {
+        const uint_fast64_t number_of_traversal_tasks =
+            _photon_buffer_policy->get_last_number_of_tasks();
+        _log->write_info(
+            "Photon traversal tasks: ", number_of_traversal_tasks,
+            " (average ",
+            static_cast< double >(
+                _photon_buffer_policy->get_last_number_of_photons()) /
+                std::max(number_of_traversal_tasks, uint_fast64_t(1)),
+            " photon packets per task), new average buffer size: ",
+            _photon_buffer_policy->get_average_capacity(), ".");
+      }
+    }
     _time_log.end("photon propagation");
 
     _time_log.start("update copies");
@@ -920,7 +1235,8 @@ void TaskBasedIonizationSimulation::run(
 #endif
       while (igrid.value() < _grid_creator->number_of_original_subgrids()) {
         const size_t this_igrid = igrid.post_increment();
-        if (this_igrid < _grid_creator->number_of_original_subgrids()) {
+        if (this_igrid < _grid_creator->number_of_original_subgrids() &&
+            _grid_creator->is_local(this_igrid)) {
           auto gridit = _grid_creator->get_subgrid(this_igrid);
 
           const size_t itask = _tasks->get_free_element();
@@ -949,11 +1265,45 @@ void TaskBasedIonizationSimulation::run(
 #endif
           }
 #endif
+          // store the old state to measure the changes
+          if (check_convergence) {
+            std::vector< double > &old_state = old_states[get_thread_index()];
+            old_state.clear();
+            for (auto cellit = (*gridit).begin(); cellit != (*gridit).end();
+                 ++cellit) {
+              const IonizationVariables &vars =
+                  cellit.get_ionization_variables();
+              old_state.push_back(vars.get_ionic_fraction(ION_H_n));
+              old_state.push_back(vars.get_temperature());
+            }
+          }
           _temperature_calculator->calculate_temperature(
               iloop, _number_of_photons, *gridit);
+          if (check_convergence) {
+            const std::vector< double > &old_state =
+                old_states[get_thread_index()];
+            ConvergenceController::Changes &changes =
+                thread_changes[get_thread_index()];
+            size_t index = 0;
+            for (auto cellit = (*gridit).begin(); cellit != (*gridit).end();
+                 ++cellit) {
+              const IonizationVariables &vars =
+                  cellit.get_ionization_variables();
+              changes.accumulate(old_state[index],
+                                 vars.get_ionic_fraction(ION_H_n),
+                                 old_state[index + 1], vars.get_temperature());
+              index += 2;
+            }
+          }
           task.stop();
           thread_stats[get_thread_index()].stop(TASKTYPE_TEMPERATURE_STATE);
 
+          if (_task_trace != nullptr &&
+              _task_trace->sample(get_thread_index())) {
+            task.set_subgrid(this_igrid);
+            _task_trace->record(get_thread_index(), task, -1, 0);
+          }
+
           // clean up (if we don't need the task any more)
           if (!_task_plot) {
             _tasks->free_element(itask);
@@ -966,13 +1316,45 @@ void TaskBasedIonizationSimulation::run(
 
     _cell_update_timer.stop();
 
+    bool converged = false;
+    if (check_convergence) {
+      ConvergenceController::Changes changes;
+      for (size_t ithread = 0; ithread < thread_changes.size(); ++ithread) {
+        changes += thread_changes[ithread];
+        thread_changes[ithread].reset();
+      }
+      if (_mpi_communicator != nullptr) {
+        _mpi_communicator->reduce< MPI_SUM_OF_ALL_PROCESSES,
+                                   CONVERGENCECONTROLLER_NUMBER_OF_SUMS >(
+            changes.get_sums());
+      }
+      // the initial state is only a guess, and barely changes during the
+      // first iteration if it is very transparent
+      const bool more_photons = _convergence_controller.update(
+          changes,
+          _temperature_calculator->allows_convergence(iloop) && iloop > 0,
+          _log);
+      converged = _convergence_controller.has_converged();
+      _convergence_controller.add_metrics(_parameter_file);
+      if (more_photons) {
+        const uint_fast32_t factor =
+            _convergence_controller.get_photon_growth_factor();
+        _number_of_photons *= factor;
+        number_of_discrete_photons *= factor;
+        fixed_number_of_continuous_photons *= factor;
+        if (photon_source) {
+          photon_source->scale_number_of_photons(factor);
+        }
+      }
+    }
+
     // output diagnostic information
     {
       uint_fast64_t early_iteration_end;
       cpucycle_tick(early_iteration_end);
       // compose the file name
       std::stringstream filename;
-      filename << "diagnostics_";
+      filename << "diagnostics" << _rank_suffix << "_";
       filename.fill('0');
       filename.width(2);
       filename << iloop;
@@ -1055,11 +1437,33 @@ void TaskBasedIonizationSimulation::run(
     if (_task_plot) {
       _time_log.start("task output");
       cpucycle_tick(iteration_end);
-      output_tasks(iloop, *_tasks, iteration_start, iteration_end);
-      output_queues(iloop, _queues, *_shared_queue);
+      const int_fast32_t rank =
+          std::max(_mpi_rank, static_cast< int_fast32_t >(0));
+      output_tasks(iloop, *_tasks, iteration_start, iteration_end, rank,
+                   _rank_suffix);
+      output_queues(iloop, _queues, *_shared_queue, rank, _rank_suffix);
       _time_log.end("task output");
     }
 
+    if (_task_trace != nullptr) {
+      _time_log.start("task trace output");
+      std::stringstream filename;
+      filename << "task_trace" << _rank_suffix << "_";
+      filename.fill('0');
+      filename.width(2);
+      filename << iloop;
+      const int_fast32_t rank =
+          std::max(_mpi_rank, static_cast< int_fast32_t >(0));
+      if (_task_trace_chrome_format) {
+        filename << ".json";
+        _task_trace->write_chrome_trace(filename.str(), rank);
+      } else {
+        filename << ".dat";
+        _task_trace->write_binary(filename.str(), rank);
+      }
+      _time_log.end("task trace output");
+    }
+
     _time_log.start("task reset");
     _tasks->clear();
     _time_log.end("task reset");
@@ -1070,6 +1474,15 @@ void TaskBasedIonizationSimulation::run(
       delete task_contexts[itask];
     }
 
+    if (converged) {
+      if (_log) {
+        _log->write_status("Converged after ", iloop + 1,
+                           " iterations, stopping.");
+      }
+      number_of_iterations_done = iloop + 1;
+      break;
+    }
+
   } // photoionization loop
   _time_log.end("photoionization loop");
 
@@ -1088,7 +1501,8 @@ void TaskBasedIonizationSimulation::run(
   }
 
   _time_log.start("snapshot");
-  _density_grid_writer->write(*_grid_creator, _number_of_iterations,
+  // the snapshot index is the number of iterations that was actually done
+  _density_grid_writer->write(*_grid_creator, number_of_iterations_done,
                               _parameter_file);
   _time_log.end("snapshot");
 
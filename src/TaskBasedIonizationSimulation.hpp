@@ -30,6 +30,8 @@
 #include "AbundanceModel.hpp"
 #include "Abundances.hpp"
 #include "ChargeTransferRates.hpp"
+#include "Configuration.hpp"
+#include "ConvergenceController.hpp"
 #include "LineCoolingData.hpp"
 #include "MemoryLogger.hpp"
 #include "ParameterFile.hpp"
@@ -39,6 +41,7 @@
 #include "ThreadSafeVector.hpp"
 #include "TimeLogger.hpp"
 
+#include <string>
 #include <vector>
 
 class ContinuousPhotonSource;
@@ -49,10 +52,15 @@ class DensitySubGrid;
 template < class _subgrid_type_ > class DensitySubGridCreator;
 class DiffuseReemissionHandler;
 class MemorySpace;
+class MPICommunicator;
+class NUMATopology;
+class PhotonBufferCommunicator;
+class PhotonBufferPolicy;
 class PhotonSourceDistribution;
 class PhotonSourceSpectrum;
 class RecombinationRates;
 class TaskQueue;
+class TaskTrace;
 class TemperatureCalculator;
 class TrackerManager;
 
@@ -87,12 +95,36 @@ private:
    *  loop. */
   uint_fast64_t _number_of_photons;
 
+  /*! @brief Convergence driven control of the number of iterations and the
+   *  number of photons. */
+  ConvergenceController _convergence_controller;
+
   /*! @brief Copy level for subgrids that contain a source. */
   const uint_fast8_t _source_copy_level;
 
+  /*! @brief Use private intensity counters per thread for subgrids that
+   *  contain a source, instead of subgrid copies? */
+  const bool _private_intensity_counters;
+
   /*! @brief Simulation box (in m). */
   SimulationBox _simulation_box;
 
+  /*! @brief Rank of the local MPI process (-1 if the grid is not distributed
+   *  across MPI processes). */
+  int_fast32_t _mpi_rank;
+
+  /*! @brief MPI communicator (nullptr if the grid is not distributed across
+   *  MPI processes). */
+  MPICommunicator *_mpi_communicator;
+
+  /*! @brief Suffix added to the names of diagnostic output files that are
+   *  written by every MPI process. */
+  std::string _rank_suffix;
+
+  /*! @brief Communicator used to exchange photon buffers between MPI processes
+   *  (nullptr if the grid is not distributed across MPI processes). */
+  PhotonBufferCommunicator *_photon_buffer_communicator;
+
   /*! @brief Grid creator. */
   DensitySubGridCreator< DensitySubGrid > *_grid_creator;
 
@@ -179,11 +211,27 @@ private:
   /*! @brief Output a snapshot before the initial iteration? */
   const bool _output_initial_snapshot;
 
+  /*! @brief Sampled task trace (nullptr if task tracing is disabled). */
+  TaskTrace *_task_trace;
+
+  /*! @brief Write the task trace in the Chrome trace event format instead of
+   *  the binary format? */
+  bool _task_trace_chrome_format;
+
+  /*! @brief Mapping of threads onto NUMA nodes (nullptr if NUMA affinity is
+   *  disabled). */
+  NUMATopology *_numa_topology;
+
+  /*! @brief Adaptive photon buffer policy (nullptr if adaptive photon buffers
+   *  are disabled). */
+  PhotonBufferPolicy *_photon_buffer_policy;
+
 public:
   TaskBasedIonizationSimulation(const int_fast32_t num_thread,
                                 const std::string parameterfile_name,
                                 const bool task_plot = false,
                                 const bool output_initial_snapshot = false,
+                                MPICommunicator *mpi_communicator = nullptr,
                                 Log *log = nullptr);
   ~TaskBasedIonizationSimulation();
 
@@ -45,6 +45,7 @@
 #include "MemorySpace.hpp"
 #include "OpenMP.hpp"
 #include "ParameterFile.hpp"
+#include "PhotonBufferPolicy.hpp"
 #include "PhotonReemitTaskContext.hpp"
 #include "PhotonSourceDistributionFactory.hpp"
 #include "PhotonSourceSpectrumFactory.hpp"
@@ -60,6 +61,7 @@
 #include "TemperatureCalculator.hpp"
 #include "TimeLine.hpp"
 #include "TimeLogger.hpp"
+#include "TimeStepBins.hpp"
 
 /*! @brief Stop the serial time timer and start the parallel time timer. */
 #define start_parallel_timing_block()                                          \
@@ -596,6 +598,183 @@ inline void reset_hydro_tasks(ThreadSafeVector< Task > &tasks,
   tasks[this_grid.get_hydro_task(17)].set_number_of_unfinished_parents(1);
 }
 
+/**
+ * @brief Check if the given hydro task needs to be executed during the given
+ * sub step.
+ *
+ * Subgrids that start a new local time step do the full gradient, prediction
+ * and flux calculation. Interfaces between two subgrids are integrated with
+ * the smaller time step of the two, so that the tasks for these interfaces
+ * are executed whenever one of the two subgrids starts a new time step. The
+ * conserved and primitive variables of a subgrid are only updated at the end
+ * of its time step, after the fluxes of all its interfaces have been
+ * accumulated.
+ *
+ * @param task Hydro task.
+ * @param timestep_bins Time step bins of the subgrids.
+ * @param substep Sub step index.
+ * @return True if the task needs to be executed.
+ */
+inline bool is_active_hydro_task(const Task &task,
+                                 const TimeStepBins &timestep_bins,
+                                 const uint_fast32_t substep) {
+
+  switch (task.get_type()) {
+  case TASKTYPE_GRADIENTSWEEP_EXTERNAL_NEIGHBOUR:
+  case TASKTYPE_FLUXSWEEP_EXTERNAL_NEIGHBOUR:
+    return timestep_bins.is_starting(task.get_subgrid(), substep) ||
+           timestep_bins.is_starting(task.get_buffer(), substep);
+  case TASKTYPE_UPDATE_CONSERVED:
+  case TASKTYPE_UPDATE_PRIMITIVES:
+    return timestep_bins.is_ending(task.get_subgrid(), substep);
+  default:
+    return timestep_bins.is_starting(task.get_subgrid(), substep);
+  }
+}
+
+/**
+ * @brief Reset the hydro tasks of all subgrids for the given local time
+ * stepping sub step.
+ *
+ * Only the parents that are active during the sub step are counted. Inactive
+ * tasks get a number of unfinished parents that can never reach zero, so that
+ * they are never queued.
+ *
+ * @param tasks Tasks.
+ * @param grid_creator Subgrids.
+ * @param timestep_bins Time step bins of the subgrids.
+ * @param substep Sub step index.
+ */
+inline void reset_local_hydro_tasks(
+    ThreadSafeVector< Task > &tasks,
+    DensitySubGridCreator< HydroDensitySubGrid > &grid_creator,
+    const TimeStepBins &timestep_bins, const uint_fast32_t substep) {
+
+  for (auto cellit = grid_creator.begin();
+       cellit != grid_creator.original_end(); ++cellit) {
+    for (int_fast8_t i = 0; i < 18; ++i) {
+      const size_t itask = (*cellit).get_hydro_task(i);
+      if (itask != NO_TASK) {
+        if (is_active_hydro_task(tasks[itask], timestep_bins, substep)) {
+          tasks[itask].set_number_of_unfinished_parents(0);
+        } else {
+          // a task has at most 7 parents
+          tasks[itask].set_number_of_unfinished_parents(0xff);
+        }
+      }
+    }
+  }
+  for (auto cellit = grid_creator.begin();
+       cellit != grid_creator.original_end(); ++cellit) {
+    for (int_fast8_t i = 0; i < 18; ++i) {
+      const size_t itask = (*cellit).get_hydro_task(i);
+      if (itask != NO_TASK &&
+          is_active_hydro_task(tasks[itask], timestep_bins, substep)) {
+        const uint_fast8_t numchild = tasks[itask].get_number_of_children();
+        for (uint_fast8_t ichild = 0; ichild < numchild; ++ichild) {
+          Task &child = tasks[tasks[itask].get_child(ichild)];
+          if (is_active_hydro_task(child, timestep_bins, substep)) {
+            child.set_number_of_unfinished_parents(
+                child.get_number_of_unfinished_parents() + 1);
+          }
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Make the fused mode hydro tasks for the given subgrid.
+ *
+ * In fused mode, every subgrid only has three hydro tasks: a gradient sweep
+ * (including the slope limiter), a flux sweep (including the primitive variable
+ * prediction) and an update sweep. All three tasks only change the variables of
+ * their own subgrid.
+ *
+ * @param tasks Task vector.
+ * @param igrid Index of the subgrid.
+ * @param grid_creator Subgrids.
+ */
+inline void make_fused_hydro_tasks(
+    ThreadSafeVector< Task > &tasks, const uint_fast32_t igrid,
+    DensitySubGridCreator< HydroDensitySubGrid > &grid_creator) {
+
+  HydroDensitySubGrid &this_grid = *grid_creator.get_subgrid(igrid);
+  const TaskType types[3] = {TASKTYPE_GRADIENTSWEEP_FUSED,
+                             TASKTYPE_FLUXSWEEP_FUSED, TASKTYPE_UPDATE_FUSED};
+  for (int_fast8_t i = 0; i < 3; ++i) {
+    const size_t next_task = tasks.get_free_element();
+    Task &task = tasks[next_task];
+    task.set_type(types[i]);
+    task.set_dependency(this_grid.get_dependency());
+    task.set_subgrid(igrid);
+    this_grid.set_hydro_task(i, next_task);
+  }
+  for (int_fast8_t i = 3; i < 18; ++i) {
+    this_grid.set_hydro_task(i, NO_TASK);
+  }
+}
+
+/**
+ * @brief Set the fused mode task dependencies for the given subgrid.
+ *
+ * The flux sweep of a subgrid reads the gradients of its neighbours, and the
+ * update sweep of a subgrid changes variables that are read by the flux sweeps
+ * of its neighbours. Both therefore depend on the previous task of the subgrid
+ * itself and of all its neighbours.
+ *
+ * @param igrid Subgrid index.
+ * @param grid_creator Subgrids.
+ * @param tasks Tasks.
+ */
+inline void set_fused_dependencies(
+    const uint_fast32_t igrid,
+    DensitySubGridCreator< HydroDensitySubGrid > &grid_creator,
+    ThreadSafeVector< Task > &tasks) {
+
+  const HydroDensitySubGrid &this_grid = *grid_creator.get_subgrid(igrid);
+
+  for (int_fast8_t i = 0; i < 2; ++i) {
+    const size_t ichild = this_grid.get_hydro_task(i + 1);
+    tasks[this_grid.get_hydro_task(i)].add_child(ichild);
+    for (int_fast32_t direction = TRAVELDIRECTION_FACE_X_P;
+         direction <= TRAVELDIRECTION_FACE_Z_N; ++direction) {
+      const uint_fast32_t ngb = this_grid.get_neighbour(direction);
+      if (ngb != NEIGHBOUR_OUTSIDE) {
+        tasks[(*grid_creator.get_subgrid(ngb)).get_hydro_task(i)].add_child(
+            ichild);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Reset the fused mode hydro tasks for the given subgrid.
+ *
+ * @param tasks Tasks.
+ * @param this_grid Subgrid.
+ */
+inline void reset_fused_hydro_tasks(ThreadSafeVector< Task > &tasks,
+                                    HydroDensitySubGrid &this_grid) {
+
+  uint_least8_t number_of_parents = 1;
+  for (int_fast32_t direction = TRAVELDIRECTION_FACE_X_P;
+       direction <= TRAVELDIRECTION_FACE_Z_N; ++direction) {
+    if (this_grid.get_neighbour(direction) != NEIGHBOUR_OUTSIDE) {
+      ++number_of_parents;
+    }
+  }
+
+  // gradient sweep
+  tasks[this_grid.get_hydro_task(0)].set_number_of_unfinished_parents(0);
+  // flux sweep
+  tasks[this_grid.get_hydro_task(1)].set_number_of_unfinished_parents(
+      number_of_parents);
+  // update sweep
+  tasks[this_grid.get_hydro_task(2)].set_number_of_unfinished_parents(
+      number_of_parents);
+}
+
 /**
  * @brief Steal a task from another queue.
  *
@@ -642,25 +821,33 @@ steal_task(const int_fast32_t thread_id, const int_fast32_t num_threads,
  * @param itask Task index.
  * @param grid_creator Subgrids.
  * @param tasks Tasks.
- * @param timestep System time step (in s).
+ * @param system_timestep System time step (in s).
+ * @param timestep_bins Time step bins of the subgrids.
+ * @param substep Local time stepping sub step index.
  * @param hydro Hydro instance to use.
  * @param boundary_manager HydroBoundaryManager to use.
  */
 inline void
 execute_task(const size_t itask,
              DensitySubGridCreator< HydroDensitySubGrid > &grid_creator,
-             ThreadSafeVector< Task > &tasks, const double timestep,
+             ThreadSafeVector< Task > &tasks, const double system_timestep,
+             const TimeStepBins &timestep_bins, const uint_fast32_t substep,
              const Hydro &hydro, const HydroBoundaryManager &boundary_manager) {
 
   const Task &task = tasks[itask];
   HydroDensitySubGrid &subgrid = *grid_creator.get_subgrid(task.get_subgrid());
+  const double timestep =
+      timestep_bins.get_timestep(task.get_subgrid(), system_timestep);
   switch (task.get_type()) {
   case TASKTYPE_GRADIENTSWEEP_INTERNAL:
     subgrid.inner_gradient_sweep(hydro);
     break;
   case TASKTYPE_GRADIENTSWEEP_EXTERNAL_NEIGHBOUR:
-    subgrid.outer_gradient_sweep(task.get_interaction_direction(), hydro,
-                                 *grid_creator.get_subgrid(task.get_buffer()));
+    subgrid.outer_gradient_sweep(
+        task.get_interaction_direction(), hydro,
+        *grid_creator.get_subgrid(task.get_buffer()),
+        timestep_bins.is_starting(task.get_subgrid(), substep),
+        timestep_bins.is_starting(task.get_buffer(), substep));
     break;
   case TASKTYPE_GRADIENTSWEEP_EXTERNAL_BOUNDARY:
     subgrid.outer_ghost_gradient_sweep(task.get_interaction_direction(), hydro,
@@ -676,11 +863,17 @@ execute_task(const size_t itask,
   case TASKTYPE_FLUXSWEEP_INTERNAL:
     subgrid.inner_flux_sweep(hydro, timestep);
     break;
-  case TASKTYPE_FLUXSWEEP_EXTERNAL_NEIGHBOUR:
+  case TASKTYPE_FLUXSWEEP_EXTERNAL_NEIGHBOUR: {
+    // the interface is integrated with the smaller of the two time steps
+    const double neighbour_timestep =
+        timestep_bins.get_timestep(task.get_buffer(), system_timestep);
+    const double interface_timestep = std::min(timestep, neighbour_timestep);
     subgrid.outer_flux_sweep(task.get_interaction_direction(), hydro,
                              *grid_creator.get_subgrid(task.get_buffer()),
-                             timestep);
+                             interface_timestep, interface_timestep / timestep,
+                             interface_timestep / neighbour_timestep);
     break;
+  }
   case TASKTYPE_FLUXSWEEP_EXTERNAL_BOUNDARY:
     subgrid.outer_ghost_flux_sweep(task.get_interaction_direction(), hydro,
                                    boundary_manager.get_boundary_condition(
@@ -693,6 +886,29 @@ execute_task(const size_t itask,
   case TASKTYPE_UPDATE_PRIMITIVES:
     subgrid.update_primitive_variables(hydro);
     break;
+  case TASKTYPE_GRADIENTSWEEP_FUSED:
+  case TASKTYPE_FLUXSWEEP_FUSED: {
+    HydroDensitySubGrid *neighbours[6];
+    for (int_fast32_t direction = TRAVELDIRECTION_FACE_X_P;
+         direction <= TRAVELDIRECTION_FACE_Z_N; ++direction) {
+      const uint_fast32_t ngb = subgrid.get_neighbour(direction);
+      if (ngb != NEIGHBOUR_OUTSIDE) {
+        neighbours[direction - TRAVELDIRECTION_FACE_X_P] =
+            &*grid_creator.get_subgrid(ngb);
+      } else {
+        neighbours[direction - TRAVELDIRECTION_FACE_X_P] = nullptr;
+      }
+    }
+    if (task.get_type() == TASKTYPE_GRADIENTSWEEP_FUSED) {
+      subgrid.fused_gradient_sweep(hydro, neighbours, boundary_manager);
+    } else {
+      subgrid.fused_flux_sweep(hydro, neighbours, boundary_manager, timestep);
+    }
+    break;
+  }
+  case TASKTYPE_UPDATE_FUSED:
+    subgrid.fused_update(hydro, timestep);
+    break;
   default:
     cmac_error("Unknown hydro task: %" PRIiFAST32, task.get_type());
   }
@@ -883,6 +1099,19 @@ inline static void do_cooling(IonizationVariables &ionization_variables,
  *  - do radiation: Enable radiation? (default: yes)
  *  - do radiative cooling: Enable radiative cooling? (default: no)
  *  - do stellar feedback: Enable stellar feedback? (default: no)
+ *  - fused hydro: Use three fused hydro tasks per subgrid instead of separate
+ *    gradient, limiter, prediction, flux and update tasks? This reduces the
+ *    number of passes over the hydro variables and the per cell memory usage
+ *    (default: no)
+ *  - maximum time step level: Maximum number of times the system time step can
+ *    be halved for subgrids that require a smaller time step. Every subgrid is
+ *    then integrated with its own power of two fraction of the system time
+ *    step. A value of 0 integrates all subgrids with the same time step. Local
+ *    time stepping cannot be combined with fused hydro tasks (default: 0)
+ *  - adaptive photon buffers: Adapt the photon buffer size and premature
+ *    launch threshold for every subgrid to the observed buffer occupancy and
+ *    traversal cost, using the parameters in the PhotonBufferPolicy block
+ *    (default: no)
  *
  * @param parser CommandLineParser that contains the parsed command line
  * arguments.
@@ -961,7 +1190,14 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
   DensityFunction *density_function =
       DensityFunctionFactory::generate(*params, log);
   time_logger.end("density function creation");
+#ifdef USE_COMPACT_PHOTON_PACKET
+  // compact photon packets look up their cross sections in a shared table
+  TabulatedCrossSections *cross_section_table =
+      CrossSectionsFactory::generate_tabulated(*params, log);
+  CrossSections *cross_sections = cross_section_table;
+#else
   CrossSections *cross_sections = CrossSectionsFactory::generate(*params, log);
+#endif
   RecombinationRates *recombination_rates =
       RecombinationRatesFactory::generate(*params, log);
   DiffuseReemissionHandler *reemission_handler = nullptr;
@@ -1083,6 +1319,22 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
   const bool do_stellar_feedback = params->get_value< bool >(
       "TaskBasedRadiationHydrodynamicsSimulation:do stellar feedback", false);
 
+  const bool fused_hydro = params->get_value< bool >(
+      "TaskBasedRadiationHydrodynamicsSimulation:fused hydro", false);
+
+  const uint_fast8_t maximum_timestep_level = params->get_value< uint_fast8_t >(
+      "TaskBasedRadiationHydrodynamicsSimulation:maximum time step level", 0);
+  if (fused_hydro && maximum_timestep_level > 0) {
+    cmac_error("Local time stepping is not supported for fused hydro tasks!");
+  }
+
+  PhotonBufferPolicy *photon_buffer_policy = nullptr;
+  if (params->get_value< bool >(
+          "TaskBasedRadiationHydrodynamicsSimulation:adaptive photon buffers",
+          false)) {
+    photon_buffer_policy = new PhotonBufferPolicy(*params);
+  }
+
   // fifth: construct the stellar sources. These should be stored in a
   // separate StellarSources object with geometrical and physical properties.
   PhotonSourceDistribution *sourcedistribution = nullptr;
@@ -1121,7 +1373,13 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
                  "ignored.");
   }
 
+  CrossSectionsFactory::add_discrete_frequencies(*cross_sections, spectrum,
+                                                 continuousspectrum);
+
   Abundances abundances(*params, log);
+#ifdef USE_COMPACT_PHOTON_PACKET
+  PhotonPacket::set_cross_section_table(cross_section_table, abundances);
+#endif
 
   // set up output
   std::string output_folder =
@@ -1261,7 +1519,8 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
   for (int_fast8_t ithread = 0; ithread < num_thread; ++ithread) {
     std::stringstream queue_name;
     queue_name << "Queue for Thread " << static_cast< int_fast32_t >(ithread);
-    queues[ithread] = new TaskQueue(queue_size_per_thread, queue_name.str());
+    queues[ithread] =
+        new TaskQueue(queue_size_per_thread, queue_name.str(), ithread);
   }
   memory_logger.finalize_entry();
   if (log) {
@@ -1292,13 +1551,28 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
   time_logger.end("initial time step");
 
   time_logger.start("hydro task creation");
-  for (auto cellit = grid_creator->begin();
-       cellit != grid_creator->original_end(); ++cellit) {
-    make_hydro_tasks(*tasks, cellit.get_index(), *grid_creator);
-  }
-  for (auto cellit = grid_creator->begin();
-       cellit != grid_creator->original_end(); ++cellit) {
-    set_dependencies(cellit.get_index(), *grid_creator, *tasks);
+  if (fused_hydro) {
+    if (log) {
+      log->write_status("Using fused hydro tasks.");
+    }
+    for (auto cellit = grid_creator->begin();
+         cellit != grid_creator->original_end(); ++cellit) {
+      (*cellit).enable_fused_hydro();
+      make_fused_hydro_tasks(*tasks, cellit.get_index(), *grid_creator);
+    }
+    for (auto cellit = grid_creator->begin();
+         cellit != grid_creator->original_end(); ++cellit) {
+      set_fused_dependencies(cellit.get_index(), *grid_creator, *tasks);
+    }
+  } else {
+    for (auto cellit = grid_creator->begin();
+         cellit != grid_creator->original_end(); ++cellit) {
+      make_hydro_tasks(*tasks, cellit.get_index(), *grid_creator);
+    }
+    for (auto cellit = grid_creator->begin();
+         cellit != grid_creator->original_end(); ++cellit) {
+      set_dependencies(cellit.get_index(), *grid_creator, *tasks);
+    }
   }
   const size_t radiation_task_offset = tasks->size();
   time_logger.end("hydro task creation");
@@ -1391,14 +1665,17 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
     maximum_timestep = std::min(maximum_timestep, hydro_radtime);
   }
 
+  // time step requested by each subgrid, and the corresponding local time step
+  // bins
+  std::vector< double > requested_timestep_list(
+      grid_creator->number_of_original_subgrids(), DBL_MAX);
+  TimeStepBins timestep_bins(grid_creator->number_of_original_subgrids(),
+                             maximum_timestep_level);
   if (restart_reader == nullptr) {
     time_logger.start("first time step");
-    requested_timestep = DBL_MAX;
     {
       // first figure out the time step for each subgrid, then do the global
       // time step
-      std::vector< double > requested_timestep_list(
-          grid_creator->number_of_original_subgrids(), DBL_MAX);
       AtomicValue< size_t > igrid(0);
       start_parallel_timing_block();
 #ifdef HAVE_OPENMP
@@ -1420,9 +1697,10 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
       }
       stop_parallel_timing_block();
       for (uint_fast32_t i = 0; i < requested_timestep_list.size(); ++i) {
-        requested_timestep =
-            std::min(requested_timestep, requested_timestep_list[i]);
+        requested_timestep_list[i] *= CFL;
       }
+      requested_timestep =
+          timestep_bins.get_system_timestep_request(requested_timestep_list);
     }
     time_logger.end("first time step");
   }
@@ -1488,7 +1766,6 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
   TimeLine *timeline = nullptr;
   int_fast32_t num_step = 0;
   double actual_timestep, current_time;
-  requested_timestep *= CFL;
   bool has_next_step;
   if (restart_reader == nullptr) {
     timeline = new TimeLine(0., hydro_total_time, hydro_minimum_timestep,
@@ -1504,7 +1781,26 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
     current_time = restart_reader->read< double >();
     delete restart_reader;
     restart_reader = nullptr;
+
+    // the subgrid time steps are not stored in the restart file, but can be
+    // recomputed from the restarted hydro variables
+    if (maximum_timestep_level > 0) {
+      for (auto gridit = grid_creator->begin();
+           gridit != grid_creator->original_end(); ++gridit) {
+        double &subgrid_timestep = requested_timestep_list[gridit.get_index()];
+        for (auto cellit = (*gridit).hydro_begin();
+             cellit != (*gridit).hydro_end(); ++cellit) {
+          subgrid_timestep =
+              std::min(subgrid_timestep,
+                       hydro.get_timestep(cellit.get_hydro_variables(),
+                                          cellit.get_ionization_variables(),
+                                          cellit.get_volume()));
+        }
+        subgrid_timestep *= CFL;
+      }
+    }
   }
+  timestep_bins.set_levels(requested_timestep_list, actual_timestep);
 
   time_logger.end("initialization");
 
@@ -1654,6 +1950,10 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
           }
           stop_parallel_timing_block();
         }
+        if (photon_buffer_policy != nullptr) {
+          photon_buffer_policy->set_number_of_subgrids(
+              grid_creator->number_of_actual_subgrids());
+        }
 
         for (uint_fast32_t iloop = 0; iloop < nloop; ++iloop) {
 
@@ -1730,25 +2030,30 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
           AtomicValue< uint_fast32_t > num_photon_done(0);
 
           // create task contexts
+          // every radiation iteration during the run gets its own iteration
+          // number
+          const uint_fast32_t iteration = num_step * nloop + iloop;
           TaskContext *task_contexts[TASKTYPE_NUMBER] = {nullptr};
           task_contexts[TASKTYPE_SOURCE_DISCRETE_PHOTON] =
               new SourceDiscretePhotonTaskContext< HydroDensitySubGrid >(
                   photon_source, *buffers, random_generators, 1., *spectrum,
-                  abundances, *cross_sections, *grid_creator, *tasks);
+                  abundances, *cross_sections, *grid_creator, *tasks,
+                  iteration);
           if (reemission_handler) {
             task_contexts[TASKTYPE_PHOTON_REEMIT] =
                 new PhotonReemitTaskContext< HydroDensitySubGrid >(
                     *buffers, random_generators, *reemission_handler,
                     abundances, *cross_sections, *grid_creator, *tasks,
-                    num_photon_done);
+                    num_photon_done, iteration);
           }
           task_contexts[TASKTYPE_PHOTON_TRAVERSAL] =
               new PhotonTraversalTaskContext< HydroDensitySubGrid >(
                   *buffers, *grid_creator, *tasks, num_photon_done, nullptr,
-                  reemission_handler != nullptr);
+                  reemission_handler != nullptr, nullptr, photon_buffer_policy);
 
           PrematureLaunchTaskContext< HydroDensitySubGrid > premature_launch(
-              *buffers, *grid_creator, *tasks, queues, *shared_queue);
+              *buffers, *grid_creator, *tasks, queues, *shared_queue,
+              photon_buffer_policy);
 
           Scheduler scheduler(*tasks, queues, *shared_queue);
 
@@ -1772,7 +2077,7 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
             while (global_run_flag) {
 
               if (current_index == NO_TASK) {
-                premature_launch.execute();
+                premature_launch.execute(thread_id);
                 current_index = scheduler.get_task(thread_id);
               }
 
@@ -1831,6 +2136,10 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
           } // parallel region
           stop_parallel_timing_block();
 
+          if (photon_buffer_policy != nullptr) {
+            photon_buffer_policy->update();
+          }
+
           buffers->reset();
 
           // update copies
@@ -2061,65 +2370,84 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
       time_logger.end("turbulence");
     }
 
-    // reset the hydro tasks and add them to the queue
-    AtomicValue< uint_fast32_t > number_of_tasks;
-    for (auto cellit = grid_creator->begin();
-         cellit != grid_creator->original_end(); ++cellit) {
-      reset_hydro_tasks(*tasks, *cellit);
-      for (int_fast8_t i = 0; i < 18; ++i) {
-        const size_t itask = (*cellit).get_hydro_task(i);
-        if (itask != NO_TASK &&
-            (*tasks)[itask].get_number_of_unfinished_parents() == 0) {
-          queues[(*cellit).get_owning_thread()]->add_task(itask);
-          number_of_tasks.pre_increment();
+    // the system time step is divided into sub steps; every sub step only
+    // executes the hydro tasks of the subgrids that are active
+    const uint_fast32_t number_of_substeps =
+        timestep_bins.get_number_of_substeps();
+    if (log && number_of_substeps > 1) {
+      log->write_status("Hydro step consists of ", number_of_substeps,
+                        " local time step sub steps.");
+    }
+    for (uint_fast32_t substep = 0; substep < number_of_substeps; ++substep) {
+
+      // reset the hydro tasks and add them to the queue
+      AtomicValue< uint_fast32_t > number_of_tasks;
+      if (maximum_timestep_level > 0) {
+        reset_local_hydro_tasks(*tasks, *grid_creator, timestep_bins, substep);
+      }
+      for (auto cellit = grid_creator->begin();
+           cellit != grid_creator->original_end(); ++cellit) {
+        if (fused_hydro) {
+          reset_fused_hydro_tasks(*tasks, *cellit);
+        } else if (maximum_timestep_level == 0) {
+          reset_hydro_tasks(*tasks, *cellit);
+        }
+        for (int_fast8_t i = 0; i < 18; ++i) {
+          const size_t itask = (*cellit).get_hydro_task(i);
+          if (itask != NO_TASK &&
+              (*tasks)[itask].get_number_of_unfinished_parents() == 0) {
+            queues[(*cellit).get_owning_thread()]->add_task(itask);
+            number_of_tasks.pre_increment();
+          }
         }
       }
-    }
 
-    start_parallel_timing_block();
+      start_parallel_timing_block();
 #ifdef HAVE_OPENMP
 #pragma omp parallel default(shared)
 #endif
-    {
-      const int_fast32_t thread_id = get_thread_index();
-      while (number_of_tasks.value() > 0) {
-        size_t current_task = queues[thread_id]->get_task(*tasks);
-        if (current_task == NO_TASK) {
-          current_task =
-              steal_task(thread_id, num_thread, queues, *tasks, *grid_creator);
-        }
-        if (current_task != NO_TASK) {
-          (*tasks)[current_task].start(thread_id);
-
-          uint_fast64_t task_start, task_stop;
-          cpucycle_tick(task_start);
-
-          execute_task(current_task, *grid_creator, *tasks, actual_timestep,
-                       hydro, hydro_boundary_manager);
-          (*tasks)[current_task].stop();
-
-          cpucycle_tick(task_stop);
-          active_time[thread_id] += task_stop - task_start;
-
-          (*tasks)[current_task].unlock_dependency();
-          const unsigned char numchild =
-              (*tasks)[current_task].get_number_of_children();
-          for (uint_fast8_t i = 0; i < numchild; ++i) {
-            const size_t ichild = (*tasks)[current_task].get_child(i);
-            if ((*tasks)[ichild].decrement_number_of_unfinished_parents() ==
-                0) {
-              queues[(*grid_creator->get_subgrid(
-                          (*tasks)[ichild].get_subgrid()))
-                         .get_owning_thread()]
-                  ->add_task(ichild);
-              number_of_tasks.pre_increment();
+      {
+        const int_fast32_t thread_id = get_thread_index();
+        while (number_of_tasks.value() > 0) {
+          size_t current_task = queues[thread_id]->get_task(*tasks);
+          if (current_task == NO_TASK) {
+            current_task = steal_task(thread_id, num_thread, queues, *tasks,
+                                      *grid_creator);
+          }
+          if (current_task != NO_TASK) {
+            (*tasks)[current_task].start(thread_id);
+
+            uint_fast64_t task_start, task_stop;
+            cpucycle_tick(task_start);
+
+            execute_task(current_task, *grid_creator, *tasks, actual_timestep,
+                         timestep_bins, substep, hydro,
+                         hydro_boundary_manager);
+            (*tasks)[current_task].stop();
+
+            cpucycle_tick(task_stop);
+            active_time[thread_id] += task_stop - task_start;
+
+            (*tasks)[current_task].unlock_dependency();
+            const unsigned char numchild =
+                (*tasks)[current_task].get_number_of_children();
+            for (uint_fast8_t i = 0; i < numchild; ++i) {
+              const size_t ichild = (*tasks)[current_task].get_child(i);
+              if ((*tasks)[ichild].decrement_number_of_unfinished_parents() ==
+                  0) {
+                queues[(*grid_creator->get_subgrid(
+                            (*tasks)[ichild].get_subgrid()))
+                           .get_owning_thread()]
+                    ->add_task(ichild);
+                number_of_tasks.pre_increment();
+              }
             }
+            number_of_tasks.pre_decrement();
           }
-          number_of_tasks.pre_decrement();
         }
       }
+      stop_parallel_timing_block();
     }
-    stop_parallel_timing_block();
 
     // apply the mask (if applicable)
     if (hydro_mask != nullptr) {
@@ -2238,12 +2566,11 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
     }
 
     time_logger.start("time step");
-    requested_timestep = DBL_MAX;
     {
       // first figure out the time step for each subgrid, then do the global
       // time step
-      std::vector< double > requested_timestep_list(
-          grid_creator->number_of_original_subgrids(), DBL_MAX);
+      std::fill(requested_timestep_list.begin(), requested_timestep_list.end(),
+                DBL_MAX);
       AtomicValue< size_t > igrid(0);
       start_parallel_timing_block();
 #ifdef HAVE_OPENMP
@@ -2265,13 +2592,14 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
       }
       stop_parallel_timing_block();
       for (uint_fast32_t i = 0; i < requested_timestep_list.size(); ++i) {
-        requested_timestep =
-            std::min(requested_timestep, requested_timestep_list[i]);
+        requested_timestep_list[i] *= CFL;
       }
+      requested_timestep =
+          timestep_bins.get_system_timestep_request(requested_timestep_list);
     }
-    requested_timestep *= CFL;
     has_next_step =
         timeline->advance(requested_timestep, actual_timestep, current_time);
+    timestep_bins.set_levels(requested_timestep_list, actual_timestep);
     time_logger.end("time step");
 
     random_seed = restart_generator.get_random_integer();
@@ -2413,6 +2741,7 @@ int TaskBasedRadiationHydrodynamicsSimulation::do_simulation(
   if (radiative_cooling != nullptr) {
     delete radiative_cooling;
   }
+  delete photon_buffer_policy;
 
   delete params;
 
@@ -28,9 +28,11 @@
 
 #include "AtomicValue.hpp"
 #include "Error.hpp"
+#include "OpenMP.hpp"
 #include "Task.hpp"
 #include "ThreadLock.hpp"
 #include "ThreadSafeVector.hpp"
+#include "WorkStealingDeque.hpp"
 
 /*! @brief Index used to signal queue is out of tasks. */
 #define NO_TASK 0xffffffff
@@ -47,10 +49,25 @@
 
 /**
  * @brief Task queue.
+ *
+ * A queue can have an owner thread. The owner adds and retrieves tasks through
+ * a lock-free work-stealing deque, from which other threads can steal tasks
+ * without locking. Tasks added by other threads, and tasks whose dependency
+ * could not be locked when they were taken from the deque, are stored in a
+ * separate locked queue. Queues without owner (like the shared queue) only
+ * use the locked queue.
  */
 class TaskQueue {
 private:
-  /*! @brief Queue. */
+  /*! @brief Work-stealing deque used by the owner thread (nullptr if the
+   *  queue has no owner). */
+  WorkStealingDeque *_deque;
+
+  /*! @brief Index of the thread that owns the deque (-1 if there is no
+   *  owner). */
+  const int_fast32_t _owner;
+
+  /*! @brief Locked queue. */
   size_t *_queue;
 
   /*! @brief Current size of the queue. */
@@ -74,53 +91,180 @@ private:
 
   /*! @brief Average queue size evaluation counter. */
   double _avg_queue_size_count;
+
+  /*! @brief Maximum size of the queue, as seen by the owner. */
+  size_t _owner_max_queue_size;
+
+  /*! @brief Total number of tasks stored in the deque. */
+  size_t _owner_total_queue_size;
+
+  /*! @brief Average queue size accumulator for the owner. */
+  double _owner_avg_queue_size;
+
+  /*! @brief Average queue size evaluation counter for the owner. */
+  double _owner_avg_queue_size_count;
 #endif
 
   /*! @brief Label to identify this queue in error messages. */
   const std::string _label;
 
+  /**
+   * @brief Check if the calling thread owns the work-stealing deque.
+   *
+   * @return True if the calling thread is the owner.
+   */
+  inline bool is_owner() const {
+    return _deque != nullptr && get_thread_index() == _owner;
+  }
+
+  /**
+   * @brief Store a task in the locked queue.
+   *
+   * @param task Task to add.
+   */
+  inline void add_locked_task(const size_t task) {
+    _queue_lock.lock();
+    cmac_assert_message(_current_queue_size < _size,
+                        "Too many tasks in queue (%zu < %zu)! (%s)",
+                        _current_queue_size, _size, _label.c_str());
+    _queue[_current_queue_size] = task;
+    ++_current_queue_size;
+#ifdef QUEUE_STATS
+    _max_queue_size = std::max(_max_queue_size, _current_queue_size);
+    ++_total_queue_size;
+    _avg_queue_size += _current_queue_size;
+    ++_avg_queue_size_count;
+#endif
+    _queue_lock.unlock();
+  }
+
+  /**
+   * @brief Remove the task with the given index from the locked queue.
+   *
+   * The queue should be locked by the calling thread. The order of the
+   * remaining tasks is not preserved.
+   *
+   * @param index Index of the task in the locked queue.
+   * @return Task.
+   */
+  inline size_t remove_locked_task(const size_t index) {
+    const size_t task = _queue[index];
+    --_current_queue_size;
+    _queue[index] = _queue[_current_queue_size];
+    return task;
+  }
+
+  /**
+   * @brief Try to get a task from the locked queue.
+   *
+   * The queue should be locked by the calling thread.
+   *
+   * @param tasks Task space.
+   * @return Task, or NO_TASK if no task is available.
+   */
+  inline size_t get_locked_task(ThreadSafeVector< Task > &tasks) {
+
+    // initialize an empty task
+    size_t task = NO_TASK;
+
+    // now try to find a task whose dependency can be locked
+    size_t index = _current_queue_size;
+    while (index > 0 && !tasks[_queue[index - 1]].lock_dependency()) {
+      --index;
+    }
+    if (index > 0) {
+      // we found a task and locked it
+      task = remove_locked_task(index - 1);
+    }
+
+#ifdef QUEUE_STATS
+    _avg_queue_size += _current_queue_size;
+    ++_avg_queue_size_count;
+#endif
+
+    return task;
+  }
+
+  /**
+   * @brief Try to steal a task from the top of the work-stealing deque.
+   *
+   * If the dependency of the stolen task cannot be locked, the task is moved
+   * to the locked queue.
+   *
+   * @param tasks Task space.
+   * @return Task, or NO_TASK if no task could be stolen.
+   */
+  inline size_t steal_task(ThreadSafeVector< Task > &tasks) {
+    size_t task;
+    if (_deque->steal(task)) {
+      if (tasks[task].lock_dependency()) {
+        return task;
+      }
+      add_locked_task(task);
+    }
+    return NO_TASK;
+  }
+
 public:
   /**
    * @brief Constructor.
    *
    * @param size Size of the queue.
    * @param label Label to identify this queue in error messages.
+   * @param owner Index of the thread that owns the queue, or -1 if the queue
+   * has no owner (default: -1).
    */
-  inline TaskQueue(const size_t size, const std::string label = "")
-      : _current_queue_size(0), _size(size), _label(label) {
+  inline TaskQueue(const size_t size, const std::string label = "",
+                   const int_fast32_t owner = -1)
+      : _deque(nullptr), _owner(owner), _current_queue_size(0), _size(size),
+        _label(label) {
+    if (owner >= 0) {
+      _deque = new WorkStealingDeque(size);
+    }
     _queue = new size_t[size];
 #ifdef QUEUE_STATS
     _max_queue_size = 0;
     _total_queue_size = 0;
     _avg_queue_size = 0;
     _avg_queue_size_count = 0;
+    _owner_max_queue_size = 0;
+    _owner_total_queue_size = 0;
+    _owner_avg_queue_size = 0;
+    _owner_avg_queue_size_count = 0;
 #endif
   }
 
   /**
    * @brief Destructor.
    */
-  inline ~TaskQueue() { delete[] _queue; }
+  inline ~TaskQueue() {
+    delete[] _queue;
+    if (_deque != nullptr) {
+      delete _deque;
+    }
+  }
 
   /**
    * @brief Add a task to the queue.
    *
+   * If the calling thread owns the queue, the task is added to the
+   * work-stealing deque without locking.
+   *
    * @param task Task to add.
    */
   inline void add_task(const size_t task) {
-    _queue_lock.lock();
-    cmac_assert_message(_current_queue_size < _size,
-                        "Too many tasks in queue (%zu < %zu)! (%s)",
-                        _current_queue_size, _size, _label.c_str());
-    _queue[_current_queue_size] = task;
-    ++_current_queue_size;
+    if (is_owner()) {
+      _deque->push(task);
 #ifdef QUEUE_STATS
-    _max_queue_size = std::max(_max_queue_size, _current_queue_size);
-    ++_total_queue_size;
-    _avg_queue_size += _current_queue_size;
-    ++_avg_queue_size_count;
+      const size_t current_size = size();
+      _owner_max_queue_size = std::max(_owner_max_queue_size, current_size);
+      ++_owner_total_queue_size;
+      _owner_avg_queue_size += current_size;
+      ++_owner_avg_queue_size_count;
 #endif
-    _queue_lock.unlock();
+    } else {
+      add_locked_task(task);
+    }
   }
 
   /**
@@ -157,40 +301,36 @@ public:
   /**
    * @brief Get a task from the queue.
    *
-   * This version locks the queue.
+   * The owner first takes tasks from the bottom of its deque. Tasks whose
+   * dependency cannot be locked are moved to the locked queue. If the deque is
+   * empty, this version locks the locked queue.
    *
    * @param tasks Task space.
    * @return Task, or NO_TASK if no task is available.
    */
   inline size_t get_task(ThreadSafeVector< Task > &tasks) {
 
-    // initialize an empty task
-    size_t task = NO_TASK;
-
-    _queue_lock.lock();
-
-    // now try to find a task whose dependency can be locked
-    size_t index = _current_queue_size;
-    while (index > 0 && !tasks[_queue[index - 1]].lock_dependency()) {
-      --index;
-    }
-    if (index > 0) {
-      // we found a task and locked it
-      --index;
-      --_current_queue_size;
-      task = _queue[index];
-
-      // shuffle all tasks to close the gap created by removing the task
-      for (; index < _current_queue_size; ++index) {
-        _queue[index] = _queue[index + 1];
-      }
-    }
-
+    if (is_owner()) {
+      size_t task;
+      while (_deque->pop(task)) {
+        if (tasks[task].lock_dependency()) {
 #ifdef QUEUE_STATS
-    _avg_queue_size += _current_queue_size;
-    ++_avg_queue_size_count;
+          _owner_avg_queue_size += size();
+          ++_owner_avg_queue_size_count;
 #endif
+          return task;
+        }
+        add_locked_task(task);
+      }
+    } else if (_deque != nullptr) {
+      const size_t task = steal_task(tasks);
+      if (task != NO_TASK) {
+        return task;
+      }
+    }
 
+    _queue_lock.lock();
+    const size_t task = get_locked_task(tasks);
     // we're done: unlock the queue
     _queue_lock.unlock();
 
@@ -201,42 +341,28 @@ public:
   /**
    * @brief Try to get a task from the queue.
    *
-   * This version tries to lock the queue and bails out if another thread is
-   * accessing it.
+   * This version is meant for threads that do not own the queue: it tries to
+   * steal a task from the top of the deque, and then tries to lock the locked
+   * queue and bails out if another thread is accessing it.
    *
    * @param tasks Task space.
    * @return Task, or NO_TASK if no task is available.
    */
   inline size_t try_get_task(ThreadSafeVector< Task > &tasks) {
 
+    if (_deque != nullptr) {
+      const size_t task = steal_task(tasks);
+      if (task != NO_TASK) {
+        return task;
+      }
+    }
+
     // initialize an empty task
     size_t task = NO_TASK;
 
     // lock the queue while we are getting a task
     if (_queue_lock.try_lock()) {
-
-      // now try to find a task whose dependency can be locked
-      size_t index = _current_queue_size;
-      while (index > 0 && !tasks[_queue[index - 1]].lock_dependency()) {
-        --index;
-      }
-      if (index > 0) {
-        // we found a task and locked it
-        --index;
-        --_current_queue_size;
-        task = _queue[index];
-
-        // shuffle all tasks to close the gap created by removing the task
-        for (; index < _current_queue_size; ++index) {
-          _queue[index] = _queue[index + 1];
-        }
-      }
-
-#ifdef QUEUE_STATS
-      _avg_queue_size += _current_queue_size;
-      ++_avg_queue_size_count;
-#endif
-
+      task = get_locked_task(tasks);
       // we're done: unlock the queue
       _queue_lock.unlock();
     }
@@ -250,7 +376,13 @@ public:
    *
    * @return Current size of the queue.
    */
-  inline size_t size() const { return _current_queue_size; }
+  inline size_t size() const {
+    if (_deque != nullptr) {
+      return _current_queue_size + _deque->size();
+    } else {
+      return _current_queue_size;
+    }
+  }
 
   /**
    * @brief Get the size in memory of the queue.
@@ -258,7 +390,12 @@ public:
    * @return Size in memory of the queue (in bytes).
    */
   inline size_t get_memory_size() const {
-    return QUEUE_FIXED_SIZE + _size * QUEUE_ELEMENT_SIZE;
+    if (_deque != nullptr) {
+      return QUEUE_FIXED_SIZE + sizeof(WorkStealingDeque) +
+             2 * _size * QUEUE_ELEMENT_SIZE;
+    } else {
+      return QUEUE_FIXED_SIZE + _size * QUEUE_ELEMENT_SIZE;
+    }
   }
 
 /**
@@ -267,7 +404,9 @@ public:
  * @return Maximum size of the queue.
  */
 #ifdef QUEUE_STATS
-  inline size_t get_max_queue_size() const { return _max_queue_size; }
+  inline size_t get_max_queue_size() const {
+    return std::max(_max_queue_size, _owner_max_queue_size);
+  }
 #endif
 
 /**
@@ -276,7 +415,9 @@ public:
  * @return Total number of tasks stored in the queue.
  */
 #ifdef QUEUE_STATS
-  inline size_t get_total_queue_size() const { return _total_queue_size; }
+  inline size_t get_total_queue_size() const {
+    return _total_queue_size + _owner_total_queue_size;
+  }
 #endif
 
   /**
@@ -286,7 +427,8 @@ public:
    */
 #ifdef QUEUE_STATS
   inline double get_average_queue_size() const {
-    return _avg_queue_size / _avg_queue_size_count;
+    return (_avg_queue_size + _owner_avg_queue_size) /
+           (_avg_queue_size_count + _owner_avg_queue_size_count);
   }
 #endif
 
@@ -294,14 +436,20 @@ public:
  * @brief Reset the maximum size of the queue counter.
  */
 #ifdef QUEUE_STATS
-  inline void reset_max_queue_size() { _max_queue_size = 0; }
+  inline void reset_max_queue_size() {
+    _max_queue_size = 0;
+    _owner_max_queue_size = 0;
+  }
 #endif
 
 /**
  * @brief Reset the counter for the total number of tasks in the queue.
  */
 #ifdef QUEUE_STATS
-  inline void reset_total_queue_size() { _total_queue_size = 0; }
+  inline void reset_total_queue_size() {
+    _total_queue_size = 0;
+    _owner_total_queue_size = 0;
+  }
 #endif
 
 /**
@@ -311,6 +459,8 @@ public:
   inline void reset_average_queue_size() {
     _avg_queue_size = 0;
     _avg_queue_size_count = 0;
+    _owner_avg_queue_size = 0;
+    _owner_avg_queue_size_count = 0;
   }
 #endif
 };
@@ -0,0 +1,428 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file TaskTrace.hpp
+ *
+ * @brief Low overhead sampled trace of executed tasks.
+ *
+ * Every thread writes compact binary records into its own fixed size ring
+ * buffer, so that recording a task does not require any synchronisation and
+ * never allocates memory. If a ring buffer is full, the oldest records are
+ * overwritten. Only one in every N tasks is recorded, with N set by the
+ * sampling rate.
+ *
+ * The trace can be written to a binary file, or exported in the Chrome trace
+ * event JSON format, which can be opened in chrome://tracing or in the
+ * Perfetto UI (https://ui.perfetto.dev).
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef TASKTRACE_HPP
+#define TASKTRACE_HPP
+
+#include "CPUCycle.hpp"
+#include "Error.hpp"
+#include "Task.hpp"
+#include "Timer.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*! @brief Version number of the binary trace file format. */
+#define TASKTRACE_FILE_VERSION 2
+
+/*! @brief Flag set for tasks that were stolen from another thread's queue. */
+#define TASKTRACE_FLAG_STOLEN 1
+
+/**
+ * @brief Compact binary record for a single executed task.
+ */
+struct TaskTraceRecord {
+  /*! @brief CPU cycle count at the start of the task. */
+  uint64_t _start;
+
+  /*! @brief CPU cycle count at the end of the task. */
+  uint64_t _end;
+
+  /*! @brief Index of the associated subgrid. */
+  uint32_t _subgrid;
+
+  /*! @brief Number of photon packets handled by the task (if applicable). */
+  uint32_t _number_of_photons;
+
+  /*! @brief Queue the task was taken from (-1 for the shared queue). */
+  int32_t _queue;
+
+  /*! @brief Task type. */
+  int8_t _type;
+
+  /*! @brief Flags (see TASKTRACE_FLAG_*). */
+  uint8_t _flags;
+
+  /*! @brief Padding. */
+  uint8_t _padding[2];
+};
+
+/**
+ * @brief Low overhead sampled trace of executed tasks.
+ */
+class TaskTrace {
+private:
+  /**
+   * @brief Per thread trace state.
+   *
+   * Padded to a full cache line, since every thread updates its own state.
+   */
+  struct ThreadTrace {
+    /*! @brief Ring buffer with records. */
+    TaskTraceRecord *_records;
+
+    /*! @brief Total number of records written since the last reset. */
+    uint_fast64_t _number_of_records;
+
+    /*! @brief Number of tasks that still need to be skipped before the next
+     *  task is sampled. */
+    uint_fast32_t _skip;
+
+    /*! @brief Padding. */
+    char _padding[64 - sizeof(TaskTraceRecord *) - sizeof(uint_fast64_t) -
+                  sizeof(uint_fast32_t)];
+  };
+
+  /*! @brief Number of records in every ring buffer (power of 2). */
+  const uint_fast64_t _buffer_size;
+
+  /*! @brief Sampling interval: only one in this many tasks is recorded. */
+  const uint_fast32_t _sampling_interval;
+
+  /*! @brief Per thread trace state. */
+  std::vector< ThreadTrace > _threads;
+
+  /*! @brief CPU cycle count at the last reset. */
+  uint_fast64_t _reset_cycle;
+
+  /*! @brief Timer started at the last reset, used to convert CPU cycles to
+   *  time. */
+  Timer _reset_timer;
+
+  /**
+   * @brief Get the name of the given task type.
+   *
+   * @param type TaskType.
+   * @return Human readable name.
+   */
+  static inline std::string get_type_name(const int_fast32_t type) {
+    switch (type) {
+    case TASKTYPE_SOURCE_DISCRETE_PHOTON:
+      return "source photon (discrete)";
+    case TASKTYPE_SOURCE_CONTINUOUS_PHOTON:
+      return "source photon (continuous)";
+    case TASKTYPE_PHOTON_TRAVERSAL:
+      return "photon traversal";
+    case TASKTYPE_PHOTON_REEMIT:
+      return "reemission";
+    case TASKTYPE_TEMPERATURE_STATE:
+      return "temperature/ionization state";
+    case TASKTYPE_SEND:
+      return "send";
+    case TASKTYPE_RECV:
+      return "receive";
+    case TASKTYPE_GRADIENTSWEEP_INTERNAL:
+      return "gradsweep internal";
+    case TASKTYPE_GRADIENTSWEEP_EXTERNAL_NEIGHBOUR:
+      return "gradsweep neighbour";
+    case TASKTYPE_GRADIENTSWEEP_EXTERNAL_BOUNDARY:
+      return "gradsweep boundary";
+    case TASKTYPE_SLOPE_LIMITER:
+      return "slope limiter";
+    case TASKTYPE_PREDICT_PRIMITIVES:
+      return "predict primitives";
+    case TASKTYPE_FLUXSWEEP_INTERNAL:
+      return "fluxsweep internal";
+    case TASKTYPE_FLUXSWEEP_EXTERNAL_NEIGHBOUR:
+      return "fluxsweep neighbour";
+    case TASKTYPE_FLUXSWEEP_EXTERNAL_BOUNDARY:
+      return "fluxsweep boundary";
+    case TASKTYPE_UPDATE_CONSERVED:
+      return "update conserved";
+    case TASKTYPE_UPDATE_PRIMITIVES:
+      return "update primitives";
+    case TASKTYPE_FLUSH_CONTINUOUS_PHOTON_BUFFERS:
+      return "flush continuous buffers";
+    case TASKTYPE_GRADIENTSWEEP_FUSED:
+      return "gradsweep fused";
+    case TASKTYPE_FLUXSWEEP_FUSED:
+      return "fluxsweep fused";
+    case TASKTYPE_UPDATE_FUSED:
+      return "update fused";
+    default:
+      return "task " + std::to_string(type);
+    }
+  }
+
+  /**
+   * @brief Get the sampling interval corresponding to the given sampling
+   * rate.
+   *
+   * @param sampling_rate Fraction of the tasks that is recorded (in ]0, 1]).
+   * @return Sampling interval: only one in this many tasks is recorded.
+   */
+  static inline uint_fast32_t
+  get_sampling_interval(const double sampling_rate) {
+    if (sampling_rate <= 0. || sampling_rate > 1.) {
+      cmac_error("Task trace sampling rate should be in ]0, 1] (got %g)!",
+                 sampling_rate);
+    }
+    return static_cast< uint_fast32_t >(std::round(1. / sampling_rate));
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param number_of_threads Number of threads that record tasks.
+   * @param buffer_size Number of records in the ring buffer of every thread
+   * (rounded up to the next power of 2).
+   * @param sampling_rate Fraction of the tasks that is recorded (in ]0, 1]).
+   */
+  inline TaskTrace(const int_fast32_t number_of_threads,
+                   const uint_fast64_t buffer_size, const double sampling_rate)
+      : _buffer_size(static_cast< uint_fast64_t >(1)
+                     << static_cast< uint_fast32_t >(
+                            std::ceil(std::log2(std::max(
+                                static_cast< double >(buffer_size), 1.))))),
+        _sampling_interval(get_sampling_interval(sampling_rate)),
+        _threads(number_of_threads) {
+
+    for (size_t i = 0; i < _threads.size(); ++i) {
+      _threads[i]._records = new TaskTraceRecord[_buffer_size];
+    }
+    reset();
+  }
+
+  /**
+   * @brief Destructor.
+   */
+  inline ~TaskTrace() {
+    for (size_t i = 0; i < _threads.size(); ++i) {
+      delete[] _threads[i]._records;
+    }
+  }
+
+  /**
+   * @brief Discard all records and restart the clock used for the time
+   * conversion.
+   *
+   * Should only be called from serial code.
+   */
+  inline void reset() {
+    for (size_t i = 0; i < _threads.size(); ++i) {
+      _threads[i]._number_of_records = 0;
+      _threads[i]._skip = 0;
+    }
+    cpucycle_tick(_reset_cycle);
+    _reset_timer.start();
+  }
+
+  /**
+   * @brief Decide if the next task executed by the given thread should be
+   * recorded.
+   *
+   * @param thread_id Calling thread.
+   * @return True if the task should be recorded.
+   */
+  inline bool sample(const int_fast32_t thread_id) {
+    ThreadTrace &thread = _threads[thread_id];
+    if (thread._skip == 0) {
+      thread._skip = _sampling_interval - 1;
+      return true;
+    } else {
+      --thread._skip;
+      return false;
+    }
+  }
+
+  /**
+   * @brief Record the given task.
+   *
+   * @param thread_id Thread that executed the task.
+   * @param task Task (should be finished).
+   * @param queue Queue the task was taken from (-1 for the shared queue).
+   * @param number_of_photons Number of photon packets handled by the task.
+   */
+  inline void record(const int_fast32_t thread_id, const Task &task,
+                     const int_fast32_t queue,
+                     const uint_fast32_t number_of_photons) {
+
+    ThreadTrace &thread = _threads[thread_id];
+    TaskTraceRecord &record =
+        thread._records[thread._number_of_records & (_buffer_size - 1)];
+    int_fast8_t type;
+    int_fast32_t task_thread_id;
+    uint_fast64_t start, end;
+    task.get_timing_information(type, task_thread_id, start, end);
+    record._start = start;
+    record._end = end;
+    record._subgrid = task.get_subgrid();
+    record._number_of_photons = number_of_photons;
+    record._type = type;
+    record._queue = queue;
+    record._flags = (queue >= 0 && queue != thread_id) ? TASKTRACE_FLAG_STOLEN
+                                                       : 0;
+    ++thread._number_of_records;
+  }
+
+  /**
+   * @brief Get the number of records that are available for the given
+   * thread.
+   *
+   * @param thread_id Thread.
+   * @return Number of records in the ring buffer.
+   */
+  inline uint_fast64_t
+  get_number_of_records(const int_fast32_t thread_id) const {
+    return std::min(_threads[thread_id]._number_of_records, _buffer_size);
+  }
+
+  /**
+   * @brief Get the record with the given index for the given thread.
+   *
+   * Records are ordered from oldest to newest.
+   *
+   * @param thread_id Thread.
+   * @param index Index, in the range [0, get_number_of_records(thread_id)[.
+   * @return Corresponding record.
+   */
+  inline const TaskTraceRecord &get_record(const int_fast32_t thread_id,
+                                           const uint_fast64_t index) const {
+    const ThreadTrace &thread = _threads[thread_id];
+    const uint_fast64_t first =
+        thread._number_of_records - get_number_of_records(thread_id);
+    return thread._records[(first + index) & (_buffer_size - 1)];
+  }
+
+  /**
+   * @brief Get the number of CPU cycles per microsecond, as measured since
+   * the last reset.
+   *
+   * @return Number of CPU cycles per microsecond.
+   */
+  inline double get_cycles_per_microsecond() const {
+    uint_fast64_t now;
+    cpucycle_tick(now);
+    const double interval = _reset_timer.interval();
+    if (interval > 0.) {
+      return 1.e-6 * (now - _reset_cycle) / interval;
+    } else {
+      return 1.;
+    }
+  }
+
+  /**
+   * @brief Write the trace to a binary file.
+   *
+   * The file starts with a header containing the file version, the rank, the
+   * number of threads, the CPU cycle count at the last reset and the number
+   * of CPU cycles per microsecond. This is followed by the number of records
+   * and the raw TaskTraceRecords for every thread.
+   *
+   * @param filename Name of the file.
+   * @param rank Rank of the local MPI process.
+   */
+  inline void write_binary(const std::string filename,
+                           const int_fast32_t rank) const {
+
+    std::ofstream ofile(filename, std::ios::binary | std::ofstream::trunc);
+    const uint32_t version = TASKTRACE_FILE_VERSION;
+    const int32_t rank_value = rank;
+    const uint32_t number_of_threads = _threads.size();
+    const uint64_t reset_cycle = _reset_cycle;
+    const double cycles_per_microsecond = get_cycles_per_microsecond();
+    ofile.write(reinterpret_cast< const char * >(&version), sizeof(version));
+    ofile.write(reinterpret_cast< const char * >(&rank_value),
+                sizeof(rank_value));
+    ofile.write(reinterpret_cast< const char * >(&number_of_threads),
+                sizeof(number_of_threads));
+    ofile.write(reinterpret_cast< const char * >(&reset_cycle),
+                sizeof(reset_cycle));
+    ofile.write(reinterpret_cast< const char * >(&cycles_per_microsecond),
+                sizeof(cycles_per_microsecond));
+    for (uint_fast32_t ithread = 0; ithread < number_of_threads; ++ithread) {
+      const uint64_t number_of_records = get_number_of_records(ithread);
+      ofile.write(reinterpret_cast< const char * >(&number_of_records),
+                  sizeof(number_of_records));
+      for (uint_fast64_t i = 0; i < number_of_records; ++i) {
+        ofile.write(reinterpret_cast< const char * >(&get_record(ithread, i)),
+                    sizeof(TaskTraceRecord));
+      }
+    }
+  }
+
+  /**
+   * @brief Write the trace to a file in the Chrome trace event JSON format.
+   *
+   * Every task is written as a complete event, with the rank as process ID
+   * and the thread as thread ID. Times are in microseconds since the last
+   * reset.
+   *
+   * @param filename Name of the file.
+   * @param rank Rank of the local MPI process.
+   */
+  inline void write_chrome_trace(const std::string filename,
+                                 const int_fast32_t rank) const {
+
+    const double cycles_per_microsecond = get_cycles_per_microsecond();
+    std::ofstream ofile(filename, std::ofstream::trunc);
+    ofile << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+    bool first = true;
+    for (uint_fast32_t ithread = 0; ithread < _threads.size(); ++ithread) {
+      const uint_fast64_t number_of_records = get_number_of_records(ithread);
+      for (uint_fast64_t i = 0; i < number_of_records; ++i) {
+        const TaskTraceRecord &record = get_record(ithread, i);
+        if (!first) {
+          ofile << ",";
+        }
+        first = false;
+        // tasks that started before the last reset get a negative time stamp
+        const double start =
+            (static_cast< double >(record._start) - _reset_cycle) /
+            cycles_per_microsecond;
+        const double duration =
+            (record._end - record._start) / cycles_per_microsecond;
+        ofile << "\n{\"name\": \"" << get_type_name(record._type)
+              << "\", \"cat\": \"task\", \"ph\": \"X\", \"ts\": " << start
+              << ", \"dur\": " << duration << ", \"pid\": " << rank
+              << ", \"tid\": " << ithread
+              << ", \"args\": {\"subgrid\": " << record._subgrid
+              << ", \"photons\": " << record._number_of_photons
+              << ", \"queue\": " << static_cast< int_fast32_t >(record._queue)
+              << ", \"stolen\": "
+              << ((record._flags & TASKTRACE_FLAG_STOLEN) ? "true" : "false")
+              << "}}";
+      }
+    }
+    ofile << "\n]}\n";
+  }
+};
+
+#endif // TASKTRACE_HPP
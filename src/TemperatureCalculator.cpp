@@ -35,8 +35,10 @@
 #include "LineCoolingData.hpp"
 #include "PhysicalConstants.hpp"
 #include "RecombinationRates.hpp"
+#include "TabulatedRecombinationRates.hpp"
 #include "WorkDistributor.hpp"
 
+#include <algorithm>
 #include <cinttypes>
 #include <cmath>
 
@@ -60,6 +62,8 @@
  * heating term; in m).
  * @param minimum_ionized_temperature Temperature below which gas is assumed to
  * be neutral (in K).
+ * @param tabulate_rates Use tabulated versions of the line cooling data and
+ * recombination rates?
  * @param line_cooling_data LineCoolingData use to calculate cooling due to line
  * emission.
  * @param recombination_rates RecombinationRates used to calculate ionic
@@ -73,15 +77,23 @@ TemperatureCalculator::TemperatureCalculator(
     double luminosity, const Abundances &abundances, double epsilon_convergence,
     uint_fast32_t maximum_number_of_iterations, double pahfac, double crfac,
     double crlim, double crscale, const double minimum_ionized_temperature,
-    const LineCoolingData &line_cooling_data,
+    const bool tabulate_rates, const LineCoolingData &line_cooling_data,
     const RecombinationRates &recombination_rates,
     const ChargeTransferRates &charge_transfer_rates, Log *log)
     : _luminosity(luminosity), _abundances(abundances), _pahfac(pahfac),
       _crfac(crfac), _crlim(crlim), _crscale(crscale),
-      _line_cooling_data(line_cooling_data),
-      _recombination_rates(recombination_rates),
+      _tabulated_line_cooling_data(tabulate_rates ? new LineCoolingData(true)
+                                                  : nullptr),
+      _tabulated_recombination_rates(
+          tabulate_rates ? new TabulatedRecombinationRates(recombination_rates)
+                         : nullptr),
+      _line_cooling_data(tabulate_rates ? *_tabulated_line_cooling_data
+                                        : line_cooling_data),
+      _recombination_rates(tabulate_rates ? *_tabulated_recombination_rates
+                                          : recombination_rates),
       _charge_transfer_rates(charge_transfer_rates),
-      _ionization_state_calculator(luminosity, abundances, recombination_rates,
+      _ionization_state_calculator(luminosity, abundances,
+                                   _recombination_rates,
                                    charge_transfer_rates),
       _do_temperature_computation(do_temperature_computation),
       _epsilon_convergence(epsilon_convergence),
@@ -94,6 +106,10 @@ TemperatureCalculator::TemperatureCalculator(
                        _luminosity, " s^-1, PAH factor ", _pahfac,
                        ", and cosmic ray factor ", _crfac, " (limit: ", _crlim,
                        ", scale height: ", _crscale, " m).");
+    if (tabulate_rates) {
+      _log->write_status("Using tabulated line cooling data and recombination "
+                         "rates.");
+    }
   }
 }
 
@@ -118,6 +134,8 @@ TemperatureCalculator::TemperatureCalculator(
  *    (default: 1.33333 kpc)
  *  - minimum ionized temperature: Temperature below which gas is assumed to be
  *    neutral (default: 4000. K).
+ *  - tabulate rates: Interpolate line cooling collision rates and
+ *    recombination rates on a precomputed temperature table (default: false)
  *
  * @param luminosity Total ionizing luminosity of all photon sources (in s^-1).
  * @param abundances Abundances.
@@ -157,35 +175,37 @@ TemperatureCalculator::TemperatureCalculator(
               "1.33333 kpc"),
           params.get_physical_value< QUANTITY_TEMPERATURE >(
               "TemperatureCalculator:minimum ionized temperature", "4000. K"),
+          params.get_value< bool >("TemperatureCalculator:tabulate rates",
+                                   false),
           line_cooling_data, recombination_rates, charge_transfer_rates, log) {}
 
 /**
- * @brief Function that calculates the cooling and heating rate for a given
- * cell, together with the ionization balance.
- *
- * The process occurs in four steps: first we compute the ionization balance of
- * hydrogen and helium at the given temperature, using the same algorithm that
- * is used in IonizationStateCalculator. Once we know the neutral fractions of
- * hydrogen and helium, we also know the number of free electrons (since
- * coolants contribute a negligible amount of electrons due to their low
- * abundances). This allows us to compute heating terms in the second step,
- * which involve the heating integrals, but also the number density of free
- * electrons.
+ * @brief Destructor.
  *
- * In the third step, we use our knowledge about the densities of electrons and
- * neutral and ionized hydrogen and helium to compute the ionization balance for
- * the coolants. These balances are set by the mean ionizing intensities and
- * recombination rates at the given temperature, but also involve charge
- * transfer ionization and recombination due to interactions with hydrogen and
- * helium.
+ * Frees up memory used by the tabulated rates.
+ */
+TemperatureCalculator::~TemperatureCalculator() {
+  delete _tabulated_line_cooling_data;
+  delete _tabulated_recombination_rates;
+}
+
+/**
+ * @brief Compute the ionization balance and heating for a given cell, and all
+ * the ingredients needed to compute the cooling.
  *
- * In the fourth and final step, we use our knowledge of the ionization state of
- * the coolants to compute actual cooling rates.
+ * This corresponds to the first three steps of
+ * compute_cooling_and_heating_balance(), and the parts of the fourth step that
+ * do not involve line cooling.
  *
  * @param h0 Variable to store the hydrogen neutral fraction in.
  * @param he0 Variable to store the helium neutral fraction in.
  * @param gain Total energy gain due to heating.
- * @param loss Total energy loss due to cooling.
+ * @param ne Variable to store the electron density in (in m^-3).
+ * @param free_free_cooling Variable to store the energy loss due to free-free
+ * radiation in.
+ * @param recombination_cooling Variable to store the energy loss due to
+ * recombination of hydrogen and helium in.
+ * @param abund Array to store the abundances of the line cooling ions in.
  * @param T Temperature (in K).
  * @param ionization_variables Ionization variables for the cell for which we
  * compute the balance.
@@ -198,19 +218,19 @@ TemperatureCalculator::TemperatureCalculator(
  * @param crfac Normalization factor for cosmic ray heating.
  * @param crscale Scale height of the cosmic ray heating term (0 for a constant
  * heating term; in m).
- * @param line_cooling_data LineCoolingData used to calculate line cooling.
  * @param recombination_rates RecombinationRates used to calculate ionic
  * fractions.
  * @param charge_transfer_rates ChargeTransferRates used to calculate ionic
  * fractions.
  */
-void TemperatureCalculator::compute_cooling_and_heating_balance(
-    double &h0, double &he0, double &gain, double &loss, double T,
+void TemperatureCalculator::compute_heating_and_coolant_abundances(
+    double &h0, double &he0, double &gain, double &ne,
+    double &free_free_cooling, double &recombination_cooling,
+    double abund[LINECOOLINGDATA_NUMELEMENTS], double T,
     IonizationVariables &ionization_variables,
     const CoordinateVector<> cell_midpoint, const double j[NUMBER_OF_IONNAMES],
     const Abundances &input_abundances, const double h[NUMBER_OF_HEATINGTERMS],
     double pahfac, double crfac, double crscale,
-    const LineCoolingData &line_cooling_data,
     const RecombinationRates &recombination_rates,
     const ChargeTransferRates &charge_transfer_rates) {
 
@@ -272,7 +292,7 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
 
   // the ionization equilibrium gives us the electron density (we neglect free
   // electrons coming from ionization of coolants)
-  const double ne = n * (1. - h0 + AHe * (1. - he0));
+  ne = n * (1. - h0 + AHe * (1. - he0));
 
   // make sure the electron density is a number
   cmac_assert(ne == ne);
@@ -351,8 +371,8 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
   //  - cooling due to recombination of hydrogen and helium
 
   // coolants
-  // get the abundances required by LineCoolingData and feed them to that class
-  double abund[LINECOOLINGDATA_NUMELEMENTS];
+  // get the abundances required by LineCoolingData (the line cooling itself is
+  // computed by the caller)
 
 #ifdef HAS_CARBON
   // carbon
@@ -418,6 +438,111 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
                ionization_variables.get_ionic_fraction(ION_S_p2);
 #endif
 
+  // free-free cooling (bremsstrahlung)
+
+  // fit to the free-free emission Gaunt factor from Katz, N., Weinberg, D. H. &
+  // Hernquist, L. 1996, ApJS, 105, 19
+  // (http://adsabs.harvard.edu/abs/1996ApJS..105...19K), equation 23
+  const double c = 5.5 - logT;
+  const double gff = 1.1 + 0.34 * std::exp(-c * c / 3.);
+  // Wood, Mathis & Ercolano (2004), equation 22
+  // based on section 3.4 of Osterbrock, D. E. & Ferland, G. J. 2006,
+  // Astrophysics of Gaseous Nebulae and Active Galactic Nuclei, 2nd edition
+  // (http://adsabs.harvard.edu/abs/2006agna.book.....O)
+  free_free_cooling = 1.42e-40 * gff * sqrtT * (nenhp + nenhep);
+
+  // cooling due to recombination of hydrogen and helium
+
+  // we multiplied Kenny's value with 1.e-12 to convert the densities into m^-3
+  // we then multiplied with 0.1 to convert them to J m^-3s^-1
+  // expressions come from Black (1981), table 3
+  // valid in the range [5,000 K; 50,000 K]
+  // NOTE that the expression for helium is different from that in Kenny's code
+  // (it is the same as the commented out expression in Kenny's code)
+  const double Lhp =
+      2.85e-40 * nenhp * sqrtT * (5.914 - 0.5 * logT + 0.01184 * std::cbrt(T));
+  const double Lhep = 1.55e-39 * nenhep * std::pow(T, 0.3647);
+#ifdef DO_OUTPUT_COOLING
+  ionization_variables.set_cooling(ION_H_n, Lhp);
+#ifdef HAS_HELIUM
+  ionization_variables.set_cooling(ION_He_n, Lhep);
+#endif
+#endif
+  recombination_cooling = Lhp + Lhep;
+
+  // make sure gains are gains
+  gain = std::max(gain, 0.);
+}
+
+/**
+ * @brief Function that calculates the cooling and heating rate for a given
+ * cell, together with the ionization balance.
+ *
+ * The process occurs in four steps: first we compute the ionization balance of
+ * hydrogen and helium at the given temperature, using the same algorithm that
+ * is used in IonizationStateCalculator. Once we know the neutral fractions of
+ * hydrogen and helium, we also know the number of free electrons (since
+ * coolants contribute a negligible amount of electrons due to their low
+ * abundances). This allows us to compute heating terms in the second step,
+ * which involve the heating integrals, but also the number density of free
+ * electrons.
+ *
+ * In the third step, we use our knowledge about the densities of electrons and
+ * neutral and ionized hydrogen and helium to compute the ionization balance for
+ * the coolants. These balances are set by the mean ionizing intensities and
+ * recombination rates at the given temperature, but also involve charge
+ * transfer ionization and recombination due to interactions with hydrogen and
+ * helium.
+ *
+ * In the fourth and final step, we use our knowledge of the ionization state of
+ * the coolants to compute actual cooling rates.
+ *
+ * @param h0 Variable to store the hydrogen neutral fraction in.
+ * @param he0 Variable to store the helium neutral fraction in.
+ * @param gain Total energy gain due to heating.
+ * @param loss Total energy loss due to cooling.
+ * @param T Temperature (in K).
+ * @param ionization_variables Ionization variables for the cell for which we
+ * compute the balance.
+ * @param cell_midpoint Midpoint of the cell for which we compute the ionization
+ * equilibrium and cooling and heating.
+ * @param j Mean ionizing intensity integrals (in s^-1).
+ * @param input_abundances Abundances.
+ * @param h Heating integrals (in J s^-1).
+ * @param pahfac Normalization factor for PAH heating.
+ * @param crfac Normalization factor for cosmic ray heating.
+ * @param crscale Scale height of the cosmic ray heating term (0 for a constant
+ * heating term; in m).
+ * @param line_cooling_data LineCoolingData used to calculate line cooling.
+ * @param recombination_rates RecombinationRates used to calculate ionic
+ * fractions.
+ * @param charge_transfer_rates ChargeTransferRates used to calculate ionic
+ * fractions.
+ */
+void TemperatureCalculator::compute_cooling_and_heating_balance(
+    double &h0, double &he0, double &gain, double &loss, double T,
+    IonizationVariables &ionization_variables,
+    const CoordinateVector<> cell_midpoint, const double j[NUMBER_OF_IONNAMES],
+    const Abundances &input_abundances, const double h[NUMBER_OF_HEATINGTERMS],
+    double pahfac, double crfac, double crscale,
+    const LineCoolingData &line_cooling_data,
+    const RecombinationRates &recombination_rates,
+    const ChargeTransferRates &charge_transfer_rates) {
+
+  /// steps 0-3: ionization balance, heating and coolant abundances
+
+  double ne, free_free_cooling, recombination_cooling;
+  double abund[LINECOOLINGDATA_NUMELEMENTS];
+  compute_heating_and_coolant_abundances(
+      h0, he0, gain, ne, free_free_cooling, recombination_cooling, abund, T,
+      ionization_variables, cell_midpoint, j, input_abundances, h, pahfac,
+      crfac, crscale, recombination_rates, charge_transfer_rates);
+
+  /// step 4: cooling
+
+  // number density in the cell
+  const double n = ionization_variables.get_number_density();
+
 #ifdef DO_OUTPUT_COOLING
   loss = 0.;
   std::vector< std::vector< double > > lines =
@@ -463,41 +588,102 @@ void TemperatureCalculator::compute_cooling_and_heating_balance(
   loss = line_cooling_data.get_cooling(T, ne, abund) * n;
 #endif
 
-  // free-free cooling (bremsstrahlung)
+  loss += free_free_cooling;
+  loss += recombination_cooling;
 
-  // fit to the free-free emission Gaunt factor from Katz, N., Weinberg, D. H. &
-  // Hernquist, L. 1996, ApJS, 105, 19
-  // (http://adsabs.harvard.edu/abs/1996ApJS..105...19K), equation 23
-  const double c = 5.5 - logT;
-  const double gff = 1.1 + 0.34 * std::exp(-c * c / 3.);
-  // Wood, Mathis & Ercolano (2004), equation 22
-  // based on section 3.4 of Osterbrock, D. E. & Ferland, G. J. 2006,
-  // Astrophysics of Gaseous Nebulae and Active Galactic Nuclei, 2nd edition
-  // (http://adsabs.harvard.edu/abs/2006agna.book.....O)
-  loss += 1.42e-40 * gff * sqrtT * (nenhp + nenhep);
+  // make sure losses are losses
+  loss = std::max(loss, 0.);
+}
 
-  // cooling due to recombination of hydrogen and helium
+/**
+ * @brief Function that calculates the cooling and heating rate for a given
+ * cell, together with the ionization balance, for a number of different
+ * temperatures.
+ *
+ * This function gives the same result as calling the single temperature
+ * version for every temperature in order (the ionization variables of the cell
+ * hence correspond to the last temperature on exit), but computes the line
+ * cooling for all temperatures at once, so that the level population equations
+ * can be solved simultaneously.
+ *
+ * @param number_of_temperatures Number of temperatures.
+ * @param T Temperatures (in K).
+ * @param h0 Array to store the hydrogen neutral fractions in.
+ * @param he0 Array to store the helium neutral fractions in.
+ * @param gain Array to store the total energy gains due to heating in.
+ * @param loss Array to store the total energy losses due to cooling in.
+ * @param ionization_variables Ionization variables for the cell for which we
+ * compute the balance.
+ * @param cell_midpoint Midpoint of the cell for which we compute the ionization
+ * equilibrium and cooling and heating.
+ * @param j Mean ionizing intensity integrals (in s^-1).
+ * @param input_abundances Abundances.
+ * @param h Heating integrals (in J s^-1).
+ * @param pahfac Normalization factor for PAH heating.
+ * @param crfac Normalization factor for cosmic ray heating.
+ * @param crscale Scale height of the cosmic ray heating term (0 for a constant
+ * heating term; in m).
+ * @param line_cooling_data LineCoolingData used to calculate line cooling.
+ * @param recombination_rates RecombinationRates used to calculate ionic
+ * fractions.
+ * @param charge_transfer_rates ChargeTransferRates used to calculate ionic
+ * fractions.
+ */
+void TemperatureCalculator::compute_cooling_and_heating_balance(
+    const uint_fast32_t number_of_temperatures, const double *T, double *h0,
+    double *he0, double *gain, double *loss,
+    IonizationVariables &ionization_variables,
+    const CoordinateVector<> cell_midpoint, const double j[NUMBER_OF_IONNAMES],
+    const Abundances &input_abundances, const double h[NUMBER_OF_HEATINGTERMS],
+    double pahfac, double crfac, double crscale,
+    const LineCoolingData &line_cooling_data,
+    const RecombinationRates &recombination_rates,
+    const ChargeTransferRates &charge_transfer_rates) {
 
-  // we multiplied Kenny's value with 1.e-12 to convert the densities into m^-3
-  // we then multiplied with 0.1 to convert them to J m^-3s^-1
-  // expressions come from Black (1981), table 3
-  // valid in the range [5,000 K; 50,000 K]
-  // NOTE that the expression for helium is different from that in Kenny's code
-  // (it is the same as the commented out expression in Kenny's code)
-  const double Lhp =
-      2.85e-40 * nenhp * sqrtT * (5.914 - 0.5 * logT + 0.01184 * std::cbrt(T));
-  const double Lhep = 1.55e-39 * nenhep * std::pow(T, 0.3647);
 #ifdef DO_OUTPUT_COOLING
-  ionization_variables.set_cooling(ION_H_n, Lhp);
-#ifdef HAS_HELIUM
-  ionization_variables.set_cooling(ION_He_n, Lhep);
-#endif
-#endif
-  loss += Lhp + Lhep;
+  // the line strengths are stored in the ionization variables, so we need to
+  // compute them for one temperature at a time
+  for (uint_fast32_t i = 0; i < number_of_temperatures; ++i) {
+    compute_cooling_and_heating_balance(
+        h0[i], he0[i], gain[i], loss[i], T[i], ionization_variables,
+        cell_midpoint, j, input_abundances, h, pahfac, crfac, crscale,
+        line_cooling_data, recombination_rates, charge_transfer_rates);
+  }
+#else
+  const double n = ionization_variables.get_number_density();
+  for (uint_fast32_t ibatch = 0; ibatch < number_of_temperatures;
+       ibatch += LINECOOLINGDATA_BATCH_WIDTH) {
+
+    const uint_fast32_t batch_size =
+        std::min< uint_fast32_t >(number_of_temperatures - ibatch,
+                                  LINECOOLINGDATA_BATCH_WIDTH);
+
+    double ne[LINECOOLINGDATA_BATCH_WIDTH];
+    double free_free_cooling[LINECOOLINGDATA_BATCH_WIDTH];
+    double recombination_cooling[LINECOOLINGDATA_BATCH_WIDTH];
+    double abund[LINECOOLINGDATA_BATCH_WIDTH][LINECOOLINGDATA_NUMELEMENTS];
+    for (uint_fast32_t i = 0; i < batch_size; ++i) {
+      const uint_fast32_t index = ibatch + i;
+      compute_heating_and_coolant_abundances(
+          h0[index], he0[index], gain[index], ne[i], free_free_cooling[i],
+          recombination_cooling[i], abund[i], T[index], ionization_variables,
+          cell_midpoint, j, input_abundances, h, pahfac, crfac, crscale,
+          recombination_rates, charge_transfer_rates);
+    }
 
-  // make sure losses are losses and gains are gains
-  loss = std::max(loss, 0.);
-  gain = std::max(gain, 0.);
+    double line_cooling[LINECOOLINGDATA_BATCH_WIDTH];
+    line_cooling_data.get_cooling(batch_size, &T[ibatch], ne, abund,
+                                  line_cooling);
+
+    for (uint_fast32_t i = 0; i < batch_size; ++i) {
+      const uint_fast32_t index = ibatch + i;
+      loss[index] = line_cooling[i] * n;
+      loss[index] += free_free_cooling[i];
+      loss[index] += recombination_cooling[i];
+      loss[index] = std::max(loss[index], 0.);
+    }
+  }
+#endif
 }
 
 /**
@@ -731,26 +917,24 @@ void TemperatureCalculator::calculate_temperature(
          niter < _maximum_number_of_iterations) {
     ++niter;
     const double T1 = 1.1 * T0;
-    // ioneng
-    double h01, he01, gain1, loss1;
-    compute_cooling_and_heating_balance(
-        h01, he01, gain1, loss1, T1, ionization_variables, cell_midpoint, j,
-        _abundances, h, _pahfac, crfac, _crscale, _line_cooling_data,
-        _recombination_rates, _charge_transfer_rates);
-
     const double T2 = 0.9 * T0;
-    // ioneng
-    double h02, he02, gain2, loss2;
+    // ioneng for all three temperatures at once
+    // T0 comes last, so that the final ionization state corresponds to T0
+    const double T[3] = {T1, T2, T0};
+    double h0s[3], he0s[3], gains[3], losses[3];
     compute_cooling_and_heating_balance(
-        h02, he02, gain2, loss2, T2, ionization_variables, cell_midpoint, j,
-        _abundances, h, _pahfac, crfac, _crscale, _line_cooling_data,
-        _recombination_rates, _charge_transfer_rates);
-
-    // ioneng - this one sets h0, he0, gain0 and loss0
-    compute_cooling_and_heating_balance(
-        h0, he0, gain0, loss0, T0, ionization_variables, cell_midpoint, j,
+        3, T, h0s, he0s, gains, losses, ionization_variables, cell_midpoint, j,
         _abundances, h, _pahfac, crfac, _crscale, _line_cooling_data,
         _recombination_rates, _charge_transfer_rates);
+    const double gain1 = gains[0];
+    const double loss1 = losses[0];
+    const double gain2 = gains[1];
+    const double loss2 = losses[1];
+    // this one sets h0, he0, gain0 and loss0
+    h0 = h0s[2];
+    he0 = he0s[2];
+    gain0 = gains[2];
+    loss0 = losses[2];
 
     // funny detail: this value is actually constant :p
     static const double logtt = std::log(1.1 / 0.9);
@@ -945,6 +1129,37 @@ void TemperatureCalculator::calculate_temperature(
     uint_fast32_t loop, double totweight, DensityGrid &grid,
     std::pair< cellsize_t, cellsize_t > &block) const {
 
+  const TemperatureCalculatorWorkDistributor temperature_workers;
+  const IonizationStateCalculator::IonizationStateCalculatorWorkDistributor
+      ionization_workers;
+  calculate_temperature(loop, totweight, grid, block, temperature_workers,
+                        ionization_workers);
+}
+
+/**
+ * @brief Calculate a new temperature for each cell in the given block after
+ * shooting the given number of photons, using the given WorkDistributors.
+ *
+ * Creating a WorkDistributor starts a parallel region, so code that updates a
+ * grid in many small blocks should create the WorkDistributors once and pass
+ * them on to this function for every block.
+ *
+ * @param loop Current iteration number of the photoionization algorithm.
+ * @param totweight Total weight of all photons that were used.
+ * @param grid DensityGrid on which to operate.
+ * @param block Block that should be traversed by the local MPI process.
+ * @param temperature_workers WorkDistributor used for the temperature
+ * calculation.
+ * @param ionization_workers WorkDistributor used for the ionization state
+ * calculation (if the temperature is not computed).
+ */
+void TemperatureCalculator::calculate_temperature(
+    uint_fast32_t loop, double totweight, DensityGrid &grid,
+    std::pair< cellsize_t, cellsize_t > &block,
+    const TemperatureCalculatorWorkDistributor &temperature_workers,
+    const IonizationStateCalculator::IonizationStateCalculatorWorkDistributor
+        &ionization_workers) const {
+
   if (_do_temperature_computation && loop > _minimum_iteration_number) {
     // get the normalization factors for the ionizing intensity and heating
     // integrals (they depend on the total weight of the photons)
@@ -955,17 +1170,13 @@ void TemperatureCalculator::calculate_temperature(
     double hfac = jfac * PhysicalConstants::get_physical_constant(
                              PHYSICALCONSTANT_PLANCK);
 
-    WorkDistributor<
-        DensityGridTraversalJobMarket< TemperatureCalculatorFunction >,
-        DensityGridTraversalJob< TemperatureCalculatorFunction > >
-        workers;
     TemperatureCalculatorFunction do_calculation(*this, jfac, hfac);
     DensityGridTraversalJobMarket< TemperatureCalculatorFunction > jobs(
         grid, do_calculation, block);
-    workers.do_in_parallel(jobs);
+    temperature_workers.do_in_parallel(jobs);
   } else {
-    _ionization_state_calculator.calculate_ionization_state(totweight, grid,
-                                                            block);
+    _ionization_state_calculator.calculate_ionization_state(
+        totweight, grid, block, ionization_workers);
   }
 }
 
@@ -28,12 +28,14 @@
 #define TEMPERATURECALCULATOR_HPP
 
 #include "DensityGrid.hpp"
+#include "DensityGridTraversalJobMarket.hpp"
 #include "IonizationStateCalculator.hpp"
+#include "LineCoolingData.hpp"
 #include "ParameterFile.hpp"
+#include "WorkDistributor.hpp"
 
 class Abundances;
 class ChargeTransferRates;
-class LineCoolingData;
 class Log;
 class RecombinationRates;
 
@@ -78,6 +80,14 @@ private:
    *  heating term; in m). */
   const double _crscale;
 
+  /*! @brief Tabulated LineCoolingData owned by this object (if rates are
+   *  tabulated). */
+  LineCoolingData *_tabulated_line_cooling_data;
+
+  /*! @brief Tabulated RecombinationRates owned by this object (if rates are
+   *  tabulated). */
+  RecombinationRates *_tabulated_recombination_rates;
+
   /*! @brief LineCoolingData used to calculate cooling due to line emission. */
   const LineCoolingData &_line_cooling_data;
 
@@ -111,13 +121,24 @@ private:
   /*! @brief Log to write logging info to. */
   Log *_log;
 
+  static void compute_heating_and_coolant_abundances(
+      double &h0, double &he0, double &gain, double &ne,
+      double &free_free_cooling, double &recombination_cooling,
+      double abund[LINECOOLINGDATA_NUMELEMENTS], double T,
+      IonizationVariables &ionization_variables,
+      const CoordinateVector<> cell_midpoint,
+      const double j[NUMBER_OF_IONNAMES], const Abundances &abundances,
+      const double h[NUMBER_OF_HEATINGTERMS], double pahfac, double crfac,
+      double crscale, const RecombinationRates &recombination_rates,
+      const ChargeTransferRates &charge_transfer_rates);
+
 public:
   TemperatureCalculator(
       bool do_temperature_computation, uint_fast32_t minimum_iteration_number,
       double luminosity, const Abundances &abundances,
       double epsilon_convergence, uint_fast32_t maximum_number_of_iterations,
       double pahfac, double crfac, double crlim, double crscale,
-      const double minimum_ionized_temperature,
+      const double minimum_ionized_temperature, const bool tabulate_rates,
       const LineCoolingData &line_cooling_data,
       const RecombinationRates &recombination_rates,
       const ChargeTransferRates &charge_transfer_rates, Log *log = nullptr);
@@ -128,6 +149,19 @@ public:
                         const ChargeTransferRates &charge_transfer_rates,
                         ParameterFile &params, Log *log = nullptr);
 
+  ~TemperatureCalculator();
+
+  /**
+   * @brief Copy constructor. Deleted, since the object owns its tabulated
+   * line cooling data and recombination rates.
+   */
+  TemperatureCalculator(const TemperatureCalculator &) = delete;
+
+  /**
+   * @brief Copy assignment operator. Deleted for the same reason.
+   */
+  TemperatureCalculator &operator=(const TemperatureCalculator &) = delete;
+
   static void compute_cooling_and_heating_balance(
       double &h0, double &he0, double &gain, double &loss, double T,
       IonizationVariables &ionization_variables,
@@ -138,6 +172,17 @@ public:
       const RecombinationRates &recombination_rates,
       const ChargeTransferRates &charge_transfer_rates);
 
+  static void compute_cooling_and_heating_balance(
+      const uint_fast32_t number_of_temperatures, const double *T, double *h0,
+      double *he0, double *gain, double *loss,
+      IonizationVariables &ionization_variables,
+      const CoordinateVector<> cell_midpoint,
+      const double j[NUMBER_OF_IONNAMES], const Abundances &abundances,
+      const double h[NUMBER_OF_HEATINGTERMS], double pahfac, double crfac,
+      double crscale, const LineCoolingData &line_cooling_data,
+      const RecombinationRates &recombination_rates,
+      const ChargeTransferRates &charge_transfer_rates);
+
   void calculate_temperature(IonizationVariables &ionization_variables,
                              const double jfac, const double hfac,
                              const CoordinateVector<> cell_midpoint) const;
@@ -152,6 +197,22 @@ public:
     _ionization_state_calculator.update_luminosity(luminosity);
   }
 
+  /**
+   * @brief Check if the state computed during the given iteration can be
+   * considered to be converged.
+   *
+   * This is not the case during the iterations in which the temperature is
+   * not computed yet, and during the first iteration in which it is, since the
+   * temperature only changes from its initial value then.
+   *
+   * @param loop Iteration number.
+   * @return True if convergence checks make sense for this iteration.
+   */
+  inline bool allows_convergence(const uint_fast32_t loop) const {
+    return !_do_temperature_computation ||
+           loop > _minimum_iteration_number + 1;
+  }
+
   /**
    * @brief Functor used to calculate the temperature of a single cell.
    *
@@ -199,10 +260,24 @@ public:
     }
   };
 
+  /*! @brief WorkDistributor used to compute the temperature of the cells of a
+   *  DensityGrid in parallel. */
+  typedef WorkDistributor<
+      DensityGridTraversalJobMarket< TemperatureCalculatorFunction >,
+      DensityGridTraversalJob< TemperatureCalculatorFunction > >
+      TemperatureCalculatorWorkDistributor;
+
   void calculate_temperature(uint_fast32_t loop, double totweight,
                              DensityGrid &grid,
                              std::pair< cellsize_t, cellsize_t > &block) const;
 
+  void calculate_temperature(
+      uint_fast32_t loop, double totweight, DensityGrid &grid,
+      std::pair< cellsize_t, cellsize_t > &block,
+      const TemperatureCalculatorWorkDistributor &temperature_workers,
+      const IonizationStateCalculator::IonizationStateCalculatorWorkDistributor
+          &ionization_workers) const;
+
   void calculate_temperature(const uint_fast32_t loop, const double totweight,
                              DensitySubGrid &subgrid) const;
 };
@@ -198,6 +198,18 @@ public:
     return _vector[index];
   }
 
+  /**
+   * @brief Get the index of the given element.
+   *
+   * @param element Reference to an element of the vector.
+   * @return Index of that element.
+   */
+  inline size_t get_index(const _datatype_ &element) const {
+    cmac_assert_message(&element >= _vector && &element < _vector + _size,
+                        "Element not in vector! (%s)", _label.c_str());
+    return &element - _vector;
+  }
+
   /**
    * @brief Read-only access to the element with the given index.
    *
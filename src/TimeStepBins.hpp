@@ -0,0 +1,213 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file TimeStepBins.hpp
+ *
+ * @brief Power of two time step bins for a set of elements that are
+ * integrated with local time steps.
+ *
+ * Element \f$i\f$ is assigned a level \f$L_i\f$ and is integrated with a time
+ * step \f$\Delta{}t_i = \Delta{}t_{sys} / 2^{L_i}\f$, with
+ * \f$\Delta{}t_{sys}\f$ the system time step. The system time step is
+ * divided into \f$2^{L_{max}}\f$ sub steps, with \f$L_{max}\f$ the largest
+ * level that is in use. Element \f$i\f$ starts a new time step on every sub
+ * step that is a multiple of \f$2^{L_{max}-L_i}\f$, so that the time steps of
+ * elements on different levels are always nested.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef TIMESTEPBINS_HPP
+#define TIMESTEPBINS_HPP
+
+#include "Error.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cinttypes>
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief Power of two time step bins for a set of elements that are
+ * integrated with local time steps.
+ */
+class TimeStepBins {
+private:
+  /*! @brief Maximum level that can be assigned to an element. */
+  const uint_fast8_t _maximum_level;
+
+  /*! @brief Largest level that is currently in use. */
+  uint_fast8_t _current_maximum_level;
+
+  /*! @brief Level of each element. */
+  std::vector< uint_fast8_t > _levels;
+
+  /**
+   * @brief Get the bit mask that selects the sub step index within the time
+   * step of an element on the given level.
+   *
+   * @param level Level.
+   * @return Bit mask.
+   */
+  inline uint_fast32_t get_substep_mask(const uint_fast8_t level) const {
+    return (static_cast< uint_fast32_t >(1)
+            << (_current_maximum_level - level)) -
+           1;
+  }
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param number_of_elements Number of elements.
+   * @param maximum_level Maximum level that can be assigned to an element. A
+   * value of 0 disables local time stepping: all elements are then integrated
+   * with the system time step.
+   */
+  inline TimeStepBins(const size_t number_of_elements,
+                      const uint_fast8_t maximum_level)
+      : _maximum_level(maximum_level), _current_maximum_level(0),
+        _levels(number_of_elements, 0) {
+
+    if (_maximum_level > 31) {
+      cmac_error("Maximum time step level is too large (%" PRIuFAST8
+                 ", maximum: 31)!",
+                 _maximum_level);
+    }
+  }
+
+  /**
+   * @brief Get the maximum level that can be assigned to an element.
+   *
+   * @return Maximum level.
+   */
+  inline uint_fast8_t get_maximum_level() const { return _maximum_level; }
+
+  /**
+   * @brief Get the system time step that should be requested from the time
+   * line, given the time steps requested by the individual elements.
+   *
+   * This is the largest requested time step, but limited so that the element
+   * with the smallest requested time step still fits within the maximum
+   * level.
+   *
+   * @param requested_timesteps Time step requested by each element (in s).
+   * @return System time step request (in s).
+   */
+  inline double get_system_timestep_request(
+      const std::vector< double > &requested_timesteps) const {
+
+    cmac_assert(requested_timesteps.size() == _levels.size());
+
+    double minimum_timestep = DBL_MAX;
+    double maximum_timestep = 0.;
+    for (size_t i = 0; i < requested_timesteps.size(); ++i) {
+      minimum_timestep = std::min(minimum_timestep, requested_timesteps[i]);
+      maximum_timestep = std::max(maximum_timestep, requested_timesteps[i]);
+    }
+    if (_maximum_level == 0) {
+      return minimum_timestep;
+    }
+    return std::min(maximum_timestep,
+                    std::ldexp(minimum_timestep, _maximum_level));
+  }
+
+  /**
+   * @brief Assign a level to every element.
+   *
+   * Every element gets the smallest level for which the local time step does
+   * not exceed its requested time step, limited to the maximum level.
+   *
+   * @param requested_timesteps Time step requested by each element (in s).
+   * @param system_timestep System time step (in s).
+   */
+  inline void set_levels(const std::vector< double > &requested_timesteps,
+                         const double system_timestep) {
+
+    cmac_assert(requested_timesteps.size() == _levels.size());
+
+    _current_maximum_level = 0;
+    for (size_t i = 0; i < requested_timesteps.size(); ++i) {
+      uint_fast8_t level = 0;
+      while (level < _maximum_level &&
+             std::ldexp(system_timestep, -level) > requested_timesteps[i]) {
+        ++level;
+      }
+      _levels[i] = level;
+      _current_maximum_level = std::max(_current_maximum_level, level);
+    }
+  }
+
+  /**
+   * @brief Get the number of sub steps in the current system time step.
+   *
+   * @return Number of sub steps.
+   */
+  inline uint_fast32_t get_number_of_substeps() const {
+    return static_cast< uint_fast32_t >(1) << _current_maximum_level;
+  }
+
+  /**
+   * @brief Get the level of the given element.
+   *
+   * @param index Element index.
+   * @return Level of the element.
+   */
+  inline uint_fast8_t get_level(const size_t index) const {
+    return _levels[index];
+  }
+
+  /**
+   * @brief Get the time step of the given element.
+   *
+   * @param index Element index.
+   * @param system_timestep System time step (in s).
+   * @return Local time step of the element (in s).
+   */
+  inline double get_timestep(const size_t index,
+                             const double system_timestep) const {
+    return std::ldexp(system_timestep, -_levels[index]);
+  }
+
+  /**
+   * @brief Does the given element start a new time step on the given sub step?
+   *
+   * @param index Element index.
+   * @param substep Sub step index.
+   * @return True if the element starts a new time step.
+   */
+  inline bool is_starting(const size_t index,
+                          const uint_fast32_t substep) const {
+    return (substep & get_substep_mask(_levels[index])) == 0;
+  }
+
+  /**
+   * @brief Does the time step of the given element end on the given sub step?
+   *
+   * @param index Element index.
+   * @param substep Sub step index.
+   * @return True if the time step of the element ends at the end of the sub
+   * step.
+   */
+  inline bool is_ending(const size_t index, const uint_fast32_t substep) const {
+    return ((substep + 1) & get_substep_mask(_levels[index])) == 0;
+  }
+};
+
+#endif // TIMESTEPBINS_HPP
@@ -25,6 +25,7 @@
  */
 
 #include "VoronoiDensityGrid.hpp"
+#include "Configuration.hpp"
 #include "SimulationBox.hpp"
 #include "VoronoiGeneratorDistribution.hpp"
 #include "VoronoiGeneratorDistributionFactory.hpp"
@@ -227,6 +228,8 @@ void VoronoiDensityGrid::initialize(std::pair< cellsize_t, cellsize_t > &block,
     time_log->end("Lloyd iterations");
   }
 
+  build_face_table();
+
   DensityGrid::initialize(block, density_function);
 
   if (time_log) {
@@ -267,10 +270,15 @@ void VoronoiDensityGrid::evolve(double timestep) {
 
     voronoidensitygrid_print_generators();
 
-    delete _voronoi_grid;
-    _voronoi_grid = VoronoiGridFactory::generate(
-        _voronoi_grid_type, _generator_positions, _box, _periodicity_flags);
-    _voronoi_grid->compute_grid();
+    // try to update the existing grid; if the grid does not support this,
+    // we reconstruct it from scratch
+    if (!_voronoi_grid->update_grid()) {
+      delete _voronoi_grid;
+      _voronoi_grid = VoronoiGridFactory::generate(
+          _voronoi_grid_type, _generator_positions, _box, _periodicity_flags);
+      _voronoi_grid->compute_grid();
+    }
+    build_face_table();
 
     if (_log) {
       _log->write_status("Done evolving Voronoi grid.");
@@ -459,6 +467,107 @@ double VoronoiDensityGrid::get_cell_volume(cellsize_t index) const {
   return _voronoi_grid->get_volume(index);
 }
 
+/**
+ * @brief Build the face table used during photon traversal.
+ *
+ * This function needs to be called every time the underlying Voronoi grid is
+ * recomputed.
+ */
+void VoronoiDensityGrid::build_face_table() {
+
+  const cellsize_t numcell = _generator_positions.size();
+  _face_offsets.resize(numcell + 1);
+  _face_offsets[0] = 0;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for default(shared)
+#endif
+  for (cellsize_t i = 0; i < numcell; ++i) {
+    _face_offsets[i + 1] = _voronoi_grid->get_faces(i).size();
+  }
+  for (cellsize_t i = 0; i < numcell; ++i) {
+    _face_offsets[i + 1] += _face_offsets[i];
+  }
+
+  _face_table.resize(_face_offsets[numcell]);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for default(shared)
+#endif
+  for (cellsize_t i = 0; i < numcell; ++i) {
+    const CoordinateVector<> ipos = _generator_positions[i];
+    const std::vector< VoronoiFace > faces = _voronoi_grid->get_faces(i);
+    for (size_t j = 0; j < faces.size(); ++j) {
+      TraversalFace &face = _face_table[_face_offsets[i] + j];
+      const uint_fast32_t ngb = faces[j].get_neighbour();
+      face._midpoint = faces[j].get_midpoint();
+      if (_voronoi_grid->is_real_neighbour(ngb)) {
+        face._normal = _generator_positions[ngb] - ipos;
+      } else {
+        face._normal = _voronoi_grid->get_wall_normal(ngb);
+      }
+      face._neighbour = ngb;
+    }
+  }
+}
+
+/**
+ * @brief Get the distance a ray travels within its current cell before it
+ * enters the next cell.
+ *
+ * If the ray origin lies (marginally) outside the given cell due to roundoff,
+ * the origin is moved a tiny bit along the ray direction and the cell index is
+ * recomputed, until a positive distance is found or the ray leaves the grid.
+ *
+ * @param index Index of the cell that contains the ray origin. Is updated if
+ * the origin needs to be moved.
+ * @param origin Origin of the ray (in m). Is updated if the origin needs to be
+ * moved.
+ * @param direction Direction of the ray.
+ * @param next_index Variable to store the index of the next cell (or wall) in.
+ * @return Distance to the exit point of the cell (in m).
+ */
+double VoronoiDensityGrid::get_exit_distance(
+    uint_fast32_t &index, CoordinateVector<> &origin,
+    const CoordinateVector<> &direction, uint_fast32_t &next_index) const {
+
+  uint_fast32_t loopcount = 0;
+  double mins = -1.;
+  while (mins <= 0.) {
+    mins = -1.;
+    const size_t face_end = _face_offsets[index + 1];
+    for (size_t iface = _face_offsets[index]; iface < face_end; ++iface) {
+      const TraversalFace &face = _face_table[iface];
+      const double nk =
+          CoordinateVector<>::dot_product(face._normal, direction);
+      if (nk > 0) {
+        // in principle, the dot product should always be positive (as
+        // 'origin' is supposed to lie inside the cell)
+        // however, due to roundoff, it could happen that 'origin' actually is
+        // marginally outside the cell, making the dot product negative. To
+        // resolve this issue, we take the absolute value of the dot product;
+        // this guarantees that the sign of 'sngb' is set by the sign of 'nk',
+        // as is the case in a perfect world without roundoff
+        const double sngb = std::abs(CoordinateVector<>::dot_product(
+                                face._normal, (face._midpoint - origin))) /
+                            nk;
+        if (mins < 0. || (sngb > 0. && sngb < mins)) {
+          mins = sngb;
+          next_index = face._neighbour;
+        }
+      }
+    }
+    ++loopcount;
+    cmac_assert_message(loopcount < 100, "mins: %g", mins);
+    if (mins <= 0.) {
+      origin += _epsilon * direction;
+      index = _voronoi_grid->get_index(origin);
+      if (!_voronoi_grid->is_real_neighbour(index)) {
+        return 0.;
+      }
+    }
+  }
+  return mins;
+}
+
 /**
  * @brief Get the total optical depth traversed by the given Photon until it
  * reaches the boundaries of the simulation box.
@@ -468,8 +577,30 @@ double VoronoiDensityGrid::get_cell_volume(cellsize_t index) const {
  * boundaries of the simulation box.
  */
 double VoronoiDensityGrid::integrate_optical_depth(const Photon &photon) {
-  cmac_error("This function is not implemented (yet)!");
-  return 0.;
+
+  CoordinateVector<> photon_origin = photon.get_position();
+  const CoordinateVector<> photon_direction = photon.get_direction();
+  // move the photon a tiny bit to make sure it is inside the cell
+  photon_origin += _epsilon * photon_direction;
+
+  double tau = 0.;
+  uint_fast32_t index = _voronoi_grid->get_index(photon_origin);
+  while (_voronoi_grid->is_real_neighbour(index)) {
+    uint_fast32_t next_index = 0;
+    const double mins = get_exit_distance(index, photon_origin,
+                                          photon_direction, next_index);
+    if (!_voronoi_grid->is_real_neighbour(index)) {
+      break;
+    }
+
+    DensityGrid::iterator it(index, *this);
+    tau += get_optical_depth(mins, it.get_ionization_variables(), photon);
+
+    index = next_index;
+    photon_origin += mins * photon_direction;
+  }
+
+  return tau;
 }
 
 /**
@@ -494,50 +625,9 @@ DensityGrid::iterator VoronoiDensityGrid::interact(Photon &photon,
 
   uint_fast32_t index = _voronoi_grid->get_index(photon_origin);
   while (_voronoi_grid->is_real_neighbour(index) && optical_depth > 0.) {
-    CoordinateVector<> ipos = _generator_positions[index];
     uint_fast32_t next_index = 0;
-    uint_fast32_t loopcount = 0;
-    double mins = -1.;
-    while (mins <= 0.) {
-      mins = -1;
-      auto faces = _voronoi_grid->get_faces(index);
-      for (auto it = faces.begin(); it != faces.end(); ++it) {
-        const VoronoiFace &face = *it;
-        const uint_fast32_t ngb = face.get_neighbour();
-        CoordinateVector<> normal;
-        if (_voronoi_grid->is_real_neighbour(ngb)) {
-          normal = _generator_positions[ngb] - ipos;
-        } else {
-          normal = _voronoi_grid->get_wall_normal(ngb);
-        }
-        const double nk =
-            CoordinateVector<>::dot_product(normal, photon_direction);
-        if (nk > 0) {
-          const CoordinateVector<> point = face.get_midpoint();
-          // in principle, the dot product should always be positive (as
-          // 'photon_origin' is supposed to lie inside the cell)
-          // however, due to roundoff, it could happen that 'photon_origin'
-          // actually is marginally outside the cell, making the dot product
-          // negative. To resolve this issue, we take the absolute value of the
-          // dot product; this guarantees that the sign of 'sngb' is set by the
-          // sign of 'nk', as is the case in a perfect world without roundoff
-          const double sngb = std::abs(CoordinateVector<>::dot_product(
-                                  normal, (point - photon_origin))) /
-                              nk;
-          if (mins < 0. || (sngb > 0. && sngb < mins)) {
-            mins = sngb;
-            next_index = ngb;
-          }
-        }
-      }
-      ++loopcount;
-      cmac_assert_message(loopcount < 100, "mins: %g", mins);
-      if (mins <= 0.) {
-        photon_origin += _epsilon * photon_direction;
-        index = _voronoi_grid->get_index(photon_origin);
-        ipos = _generator_positions[index];
-      }
-    }
+    double mins = get_exit_distance(index, photon_origin, photon_direction,
+                                    next_index);
     if (!_voronoi_grid->is_real_neighbour(index)) {
       break;
     }
@@ -597,42 +687,9 @@ double VoronoiDensityGrid::get_total_emission(CoordinateVector<> origin,
 
   uint_fast32_t index = _voronoi_grid->get_index(origin);
   while (_voronoi_grid->is_real_neighbour(index)) {
-    CoordinateVector<> ipos = _generator_positions[index];
     uint_fast32_t next_index = 0;
-    uint_fast32_t loopcount = 0;
-    double mins = -1.;
-    while (mins <= 0.) {
-      mins = -1;
-      auto faces = _voronoi_grid->get_faces(index);
-      for (auto it = faces.begin(); it != faces.end(); ++it) {
-        const VoronoiFace &face = *it;
-        const uint_fast32_t ngb = face.get_neighbour();
-        CoordinateVector<> normal;
-        if (_voronoi_grid->is_real_neighbour(ngb)) {
-          normal = _generator_positions[ngb] - ipos;
-        } else {
-          normal = _voronoi_grid->get_wall_normal(ngb);
-        }
-        const double nk = CoordinateVector<>::dot_product(normal, direction);
-        if (nk > 0) {
-          const CoordinateVector<> point = face.get_midpoint();
-          const double sngb = std::abs(CoordinateVector<>::dot_product(
-                                  normal, (point - origin))) /
-                              nk;
-          if (mins < 0. || (sngb > 0. && sngb < mins)) {
-            mins = sngb;
-            next_index = ngb;
-          }
-        }
-      }
-      ++loopcount;
-      cmac_assert_message(loopcount < 100, "mins: %g", mins);
-      if (mins <= 0.) {
-        origin += _epsilon * direction;
-        index = _voronoi_grid->get_index(origin);
-        ipos = _generator_positions[index];
-      }
-    }
+    const double mins =
+        get_exit_distance(index, origin, direction, next_index);
     if (!_voronoi_grid->is_real_neighbour(index)) {
       break;
     }
@@ -68,6 +68,35 @@ private:
   /*! @brief Use a co-moving Voronoi grid? */
   bool _comoving;
 
+  /**
+   * @brief Compact representation of a Voronoi face, used during photon
+   * traversal.
+   */
+  struct TraversalFace {
+    /*! @brief Midpoint of the face (in m). */
+    CoordinateVector<> _midpoint;
+
+    /*! @brief Unnormalised outward normal of the face (in m for faces between
+     *  cells, dimensionless for walls). */
+    CoordinateVector<> _normal;
+
+    /*! @brief Index of the neighbouring cell (or wall) on the other side of
+     *  the face. */
+    uint_fast32_t _neighbour;
+  };
+
+  /*! @brief Offsets of the faces of each cell in the face table: the faces of
+   *  cell i are stored in the range [_face_offsets[i], _face_offsets[i+1]). */
+  std::vector< size_t > _face_offsets;
+
+  /*! @brief Face table containing the faces of all cells. */
+  std::vector< TraversalFace > _face_table;
+
+  void build_face_table();
+  double get_exit_distance(uint_fast32_t &index, CoordinateVector<> &origin,
+                           const CoordinateVector<> &direction,
+                           uint_fast32_t &next_index) const;
+
 public:
   VoronoiDensityGrid(
       VoronoiGeneratorDistribution *position_generator,
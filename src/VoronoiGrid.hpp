@@ -48,6 +48,20 @@ public:
    */
   virtual void compute_grid(int_fast32_t worksize = -1) = 0;
 
+  /**
+   * @brief Update the Voronoi grid after the generator positions have changed.
+   *
+   * Implementations that support this can reuse information from the previous
+   * grid construction. The default implementation does nothing and signals
+   * that the grid needs to be reconstructed from scratch.
+   *
+   * @param worksize Number of shared memory threads to use during the grid
+   * update.
+   * @return True if the grid was updated, false if the grid needs to be
+   * reconstructed.
+   */
+  virtual bool update_grid(int_fast32_t worksize = -1) { return false; }
+
   /**
    * @brief Get the volume of the Voronoi cell with the given index.
    *
@@ -0,0 +1,167 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file WorkStealingDeque.hpp
+ *
+ * @brief Lock-free work-stealing deque.
+ *
+ * Fixed size version of the deque described in Chase & Lev, 2005, Proceedings
+ * of the 17th annual ACM symposium on Parallelism in algorithms and
+ * architectures, 21 (https://doi.org/10.1145/1073970.1073974), with the memory
+ * orderings from Lê et al., 2013, Proceedings of the 18th ACM SIGPLAN symposium
+ * on Principles and practice of parallel programming, 69
+ * (https://doi.org/10.1145/2442516.2442524).
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef WORKSTEALINGDEQUE_HPP
+#define WORKSTEALINGDEQUE_HPP
+
+#include "Error.hpp"
+
+#include <atomic>
+#include <cinttypes>
+
+/**
+ * @brief Lock-free work-stealing deque.
+ *
+ * The deque has a single owner that can push and pop elements at the bottom
+ * end without locking. All other threads can only steal elements from the top
+ * end, using a single atomic compare-and-swap.
+ */
+class WorkStealingDeque {
+private:
+  /*! @brief Index of the top element (the next element that will be
+   *  stolen). */
+  std::atomic< int_fast64_t > _top;
+
+  /*! @brief Padding to put _top and _bottom on separate cache lines, to avoid
+   *  false sharing between the owner and thieves. */
+  char _padding[64 - sizeof(std::atomic< int_fast64_t >)];
+
+  /*! @brief Index of the bottom element (the next free position). */
+  std::atomic< int_fast64_t > _bottom;
+
+  /*! @brief Elements. */
+  std::atomic< size_t > *_elements;
+
+  /*! @brief Size of the element array. */
+  const int_fast64_t _size;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param size Maximum number of elements that can be stored in the deque.
+   */
+  inline WorkStealingDeque(const size_t size)
+      : _top(0), _bottom(0), _size(size) {
+    _elements = new std::atomic< size_t >[size];
+  }
+
+  /**
+   * @brief Destructor.
+   */
+  inline ~WorkStealingDeque() { delete[] _elements; }
+
+  /**
+   * @brief Add an element to the bottom of the deque.
+   *
+   * Should only be called by the owner.
+   *
+   * @param element Element to add.
+   */
+  inline void push(const size_t element) {
+    const int_fast64_t bottom = _bottom.load(std::memory_order_relaxed);
+    const int_fast64_t top = _top.load(std::memory_order_acquire);
+    if (bottom - top >= _size) {
+      cmac_error("Too many elements in deque (%" PRIiFAST64 " >= %" PRIiFAST64
+                 ")!",
+                 bottom - top, _size);
+    }
+    _elements[bottom % _size].store(element, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Remove an element from the bottom of the deque.
+   *
+   * Should only be called by the owner.
+   *
+   * @param element Variable to store the removed element in.
+   * @return True if an element was removed, false if the deque was empty.
+   */
+  inline bool pop(size_t &element) {
+    const int_fast64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int_fast64_t top = _top.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      // empty deque
+      _bottom.store(bottom + 1, std::memory_order_relaxed);
+      return false;
+    }
+    element = _elements[bottom % _size].load(std::memory_order_relaxed);
+    if (top == bottom) {
+      // last element: compete with thieves
+      const bool success = _top.compare_exchange_strong(
+          top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      _bottom.store(bottom + 1, std::memory_order_relaxed);
+      return success;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Remove an element from the top of the deque.
+   *
+   * Can be called by any thread.
+   *
+   * @param element Variable to store the removed element in.
+   * @return True if an element was removed, false if the deque was empty or
+   * another thread removed the top element first.
+   */
+  inline bool steal(size_t &element) {
+    int_fast64_t top = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int_fast64_t bottom = _bottom.load(std::memory_order_acquire);
+    if (top >= bottom) {
+      return false;
+    }
+    element = _elements[top % _size].load(std::memory_order_relaxed);
+    return _top.compare_exchange_strong(
+        top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Get the number of elements in the deque.
+   *
+   * The result is only approximate if other threads are accessing the deque.
+   *
+   * @return Number of elements in the deque.
+   */
+  inline size_t size() const {
+    const int_fast64_t bottom = _bottom.load(std::memory_order_relaxed);
+    const int_fast64_t top = _top.load(std::memory_order_relaxed);
+    return (bottom > top) ? bottom - top : 0;
+  }
+};
+
+#endif // WORKSTEALINGDEQUE_HPP
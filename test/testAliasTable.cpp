@@ -0,0 +1,130 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testAliasTable.cpp
+ *
+ * @brief Unit test for the AliasTable class.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "AliasTable.hpp"
+#include "Assert.hpp"
+#include "RandomGenerator.hpp"
+
+/**
+ * @brief Get the fraction of a regular grid of uniform numbers in [0, 1[ that
+ * is mapped onto every index of the given table.
+ *
+ * For a correct table, this is the normalised weight of every index, up to
+ * the grid resolution.
+ *
+ * @param table AliasTable.
+ * @param number_of_samples Number of grid points.
+ * @return Fraction of the grid points for every index.
+ */
+std::vector< double > get_fractions(const AliasTable &table,
+                                    const uint_fast32_t number_of_samples) {
+  std::vector< double > fractions(table.size(), 0.);
+  for (uint_fast32_t i = 0; i < number_of_samples; ++i) {
+    const double x = (i + 0.5) / number_of_samples;
+    fractions[table.get_index(x)] += 1. / number_of_samples;
+  }
+  return fractions;
+}
+
+/**
+ * @brief Unit test for the AliasTable class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  AliasTable table;
+
+  /// non-normalised weights, including zero weights
+  {
+    std::vector< double > weights(6);
+    weights[0] = 1.;
+    weights[1] = 0.;
+    weights[2] = 5.;
+    weights[3] = 3.;
+    weights[4] = 0.;
+    weights[5] = 1.;
+    table.initialize(weights);
+    assert_condition(table.size() == 6);
+
+    const std::vector< double > fractions = get_fractions(table, 1000000);
+    for (uint_fast32_t i = 0; i < 6; ++i) {
+      assert_values_equal_tol(fractions[i], 0.1 * weights[i], 1.e-6);
+    }
+    assert_condition(fractions[1] == 0.);
+    assert_condition(fractions[4] == 0.);
+
+    // x values very close to 1 still map onto a valid index
+    assert_condition(table.get_index(1. - 1.e-16) < 6);
+  }
+
+  /// random sampling from a large table
+  {
+    const uint_fast32_t number_of_sources = 1000;
+    std::vector< double > weights(number_of_sources);
+    double total_weight = 0.;
+    RandomGenerator random_generator(42);
+    for (uint_fast32_t i = 0; i < number_of_sources; ++i) {
+      weights[i] = random_generator.get_uniform_random_double();
+      total_weight += weights[i];
+    }
+    table.initialize(weights);
+
+    const std::vector< double > fractions = get_fractions(table, 10000000);
+    for (uint_fast32_t i = 0; i < number_of_sources; ++i) {
+      assert_values_equal_tol(fractions[i], weights[i] / total_weight, 1.e-6);
+    }
+
+    // the mean of randomly sampled indices matches the weighted mean index
+    double expected_mean = 0.;
+    for (uint_fast32_t i = 0; i < number_of_sources; ++i) {
+      expected_mean += i * weights[i] / total_weight;
+    }
+    double mean = 0.;
+    const uint_fast32_t number_of_samples = 1000000;
+    for (uint_fast32_t i = 0; i < number_of_samples; ++i) {
+      mean += table.get_index(random_generator.get_uniform_random_double());
+    }
+    mean /= number_of_samples;
+    assert_values_equal_rel(mean, expected_mean, 1.e-2);
+  }
+
+  /// rebuilding with fewer elements (sources were removed)
+  {
+    std::vector< double > weights(1, 2.);
+    table.initialize(weights);
+    assert_condition(table.size() == 1);
+    assert_condition(table.get_index(0.) == 0);
+    assert_condition(table.get_index(0.99) == 0);
+
+    weights.clear();
+    table.initialize(weights);
+    assert_condition(table.size() == 0);
+  }
+
+  return 0;
+}
@@ -24,8 +24,12 @@
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
 
+#include "Assert.hpp"
 #include "CMILibrary.hpp"
+#include "IonizationSimulation.hpp"
+#include "SPHArrayInterface.hpp"
 
+#include <cmath>
 #include <fstream>
 #include <vector>
 
@@ -77,6 +81,42 @@ int main(int argc, char **argv) {
   }
   ofile.close();
 
+  // the number of iterations done by the first computation
+  const uint_fast32_t cold_iterations =
+      global_ionization_simulation->get_number_of_completed_iterations();
+  assert_condition(cold_iterations > 0);
+
+  // warm start a second computation from the result of the first one
+  // the density field did not change, so before any iteration is done, the
+  // grid should contain exactly the result of the first computation
+  cmi_set_warm_start();
+  global_interface->reset(x.data(), y.data(), z.data(), h.data(), m.data(),
+                          1000);
+  global_ionization_simulation->initialize(global_interface);
+  std::vector< double > nH_restored(1000, 0.);
+  global_interface->fill_array(nH_restored.data());
+  for (uint_fast32_t i = 0; i < 1000; ++i) {
+    assert_condition(nH_restored[i] == nH[i]);
+  }
+
+  // the warm started computation starts close to convergence, and should
+  // hence need fewer iterations than the first one
+  global_ionization_simulation->run(global_interface);
+  std::vector< double > nH_warm(1000, 0.);
+  global_interface->fill_array(nH_warm.data());
+  const uint_fast32_t warm_iterations =
+      global_ionization_simulation->get_number_of_completed_iterations() -
+      cold_iterations;
+  assert_condition(warm_iterations > 0);
+  assert_condition(warm_iterations < cold_iterations);
+  double mean_change = 0.;
+  for (uint_fast32_t i = 0; i < 1000; ++i) {
+    assert_condition(nH_warm[i] >= 0. && nH_warm[i] <= 1.);
+    mean_change += std::abs(nH_warm[i] - nH[i]);
+  }
+  mean_change /= 1000.;
+  assert_condition(mean_change < 0.05);
+
   // clean up the library
   cmi_destroy();
 
@@ -0,0 +1,123 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testConvergenceController.cpp
+ *
+ * @brief Unit test for the ConvergenceController class.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "Assert.hpp"
+#include "ConvergenceController.hpp"
+
+/**
+ * @brief Unit test for the ConvergenceController class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  /// default parameters: disabled
+  {
+    ParameterFile params;
+    ConvergenceController controller(1000, params);
+    assert_condition(!controller.is_enabled());
+    assert_condition(controller.get_number_of_photons() == 1000);
+    controller.set_tolerance(1.e-3);
+    assert_condition(controller.is_enabled());
+  }
+
+  /// systematic convergence: no extra photons
+  {
+    ConvergenceController controller(1000, 1.e-2, 8000, 2, 0.8);
+    controller.start_run();
+    // changes before the state can be converged are ignored
+    assert_condition(!controller.update(1.e-4, 1.e-4, false));
+    assert_condition(!controller.has_converged());
+    double change = 0.5;
+    uint_fast32_t number_of_iterations = 0;
+    while (!controller.has_converged()) {
+      assert_condition(!controller.update(change, 0.1 * change, true));
+      change *= 0.5;
+      ++number_of_iterations;
+    }
+    // 0.5 * 2^-6 < 1.e-2
+    assert_condition(number_of_iterations == 7);
+    assert_condition(controller.get_number_of_photons() == 1000);
+    assert_values_equal(controller.get_neutral_fraction_change(),
+                        0.5 / 64.);
+    assert_values_equal(controller.get_temperature_change(), 0.05 / 64.);
+  }
+
+  /// the largest change determines convergence
+  {
+    ConvergenceController controller(1000, 1.e-2, 1000, 2, 0.8);
+    controller.start_run();
+    controller.update(1.e-3, 0.1, true);
+    assert_condition(!controller.has_converged());
+    controller.update(1.e-3, 1.e-3, true);
+    assert_condition(controller.has_converged());
+  }
+
+  /// noise plateau: grow the number of photons up to the maximum
+  {
+    ConvergenceController controller(1000, 1.e-3, 4000, 2, 0.8);
+    controller.start_run();
+    assert_condition(!controller.update(0.1, 0.01, true));
+    // the change did not decrease: noise dominates
+    assert_condition(controller.update(0.09, 0.01, true));
+    assert_condition(controller.get_number_of_photons() == 2000);
+    // we need two iterations with the new number before growing again
+    assert_condition(!controller.update(0.07, 0.01, true));
+    assert_condition(controller.update(0.07, 0.01, true));
+    assert_condition(controller.get_number_of_photons() == 4000);
+    assert_condition(!controller.update(0.05, 0.01, true));
+    // maximum reached
+    assert_condition(!controller.update(0.05, 0.01, true));
+    assert_condition(controller.get_number_of_photons() == 4000);
+
+    // a new run starts from the previous number of photons
+    controller.start_run();
+    assert_condition(!controller.has_converged());
+    assert_condition(controller.get_number_of_photons() == 4000);
+
+    ParameterFile params;
+    controller.update(5.e-4, 2.e-4, true);
+    assert_condition(controller.has_converged());
+    controller.add_metrics(params);
+    assert_values_equal(
+        params.get_value< double >(
+            "ConvergenceController:achieved neutral fraction change"),
+        5.e-4);
+    assert_values_equal(
+        params.get_value< double >(
+            "ConvergenceController:achieved temperature change"),
+        2.e-4);
+    assert_condition(params.get_value< uint_fast32_t >(
+                         "ConvergenceController:number of iterations done") ==
+                     1);
+    assert_condition(params.get_value< uint_fast64_t >(
+                         "ConvergenceController:final number of photons") ==
+                     4000);
+  }
+
+  return 0;
+}
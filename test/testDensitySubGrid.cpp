@@ -25,11 +25,40 @@
  */
 
 #include "Assert.hpp"
+#include "CrossSections.hpp"
 #include "DensitySubGrid.hpp"
 #include "IonizationStateCalculator.hpp"
 #include "RandomGenerator.hpp"
 
 #include <fstream>
+#include <vector>
+
+#ifdef USE_COMPACT_PHOTON_PACKET
+/**
+ * @brief Cross sections that only have a constant hydrogen cross section.
+ *
+ * Used to give all photon packets the same cross section as in the default
+ * photon packet case.
+ */
+class HydrogenOnlyCrossSections : public CrossSections {
+public:
+  /**
+   * @brief Get the photoionization cross section for the given ion.
+   *
+   * @param ion IonName for a valid ion.
+   * @param energy Photon frequency (in Hz).
+   * @return Photoionization cross section (in m^2).
+   */
+  virtual double get_cross_section(const int_fast32_t ion,
+                                   const double energy) const {
+    if (ion == ION_H_n) {
+      return 6.3e-22;
+    } else {
+      return 0.;
+    }
+  }
+};
+#endif
 
 /**
  * @brief Unit test for the DensitySubGrid class.
@@ -46,19 +75,28 @@ int main(int argc, char **argv) {
   DensitySubGrid grid(box, ncell);
   RandomGenerator random_generator(42);
 
+#ifdef USE_COMPACT_PHOTON_PACKET
+  const TabulatedCrossSections cross_section_table(
+      new HydrogenOnlyCrossSections());
+  PhotonPacket::set_cross_section_table(&cross_section_table, Abundances());
+#endif
+
   for (auto cellit = grid.begin(); cellit != grid.end(); ++cellit) {
     cellit.get_ionization_variables().set_number_density(1.e8);
     cellit.get_ionization_variables().set_ionic_fraction(ION_H_n, 1.e-6);
   }
 
   for (uint_fast32_t iloop = 0; iloop < 10; ++iloop) {
+    grid.reset_intensities();
     for (uint_fast32_t i = 0; i < 1e5; ++i) {
       PhotonPacket photon;
 
       photon.set_energy(3.288e15);
+#ifndef USE_COMPACT_PHOTON_PACKET
       for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
         photon.set_photoionization_cross_section(i, 0.);
       }
+#endif
 
       const double cost =
           2. * random_generator.get_uniform_random_double() - 1.;
@@ -74,12 +112,15 @@ int main(int argc, char **argv) {
 
       photon.set_position(CoordinateVector<>(0.));
       photon.set_direction(d);
+#ifndef USE_COMPACT_PHOTON_PACKET
       photon.set_photoionization_cross_section(ION_H_n, 6.3e-22);
+#endif
       photon.set_weight(1.);
       photon.set_target_optical_depth(tau);
 
       grid.interact(photon, TRAVELDIRECTION_INSIDE);
     }
+    grid.flush_traversal_counters();
 
     for (auto cellit = grid.begin(); cellit != grid.end(); ++cellit) {
       const double jH =
@@ -117,6 +158,182 @@ int main(int argc, char **argv) {
     }
   }
 
+  /// check that private intensity counters per thread give the same result
+  /// as the shared counters
+  {
+    DensitySubGrid grid3(grid);
+    grid3.activate_private_counters(4);
+    assert_condition(grid3.has_private_counters());
+    assert_condition(grid3.get_traversal_dependency() == nullptr);
+    assert_condition(grid.get_traversal_dependency() == grid.get_dependency());
+
+    grid.reset_intensities();
+    grid3.reset_intensities();
+    for (uint_fast32_t i = 0; i < 1e4; ++i) {
+      PhotonPacket photon;
+
+      photon.set_energy(4.e15);
+#ifndef USE_COMPACT_PHOTON_PACKET
+      for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+        photon.set_photoionization_cross_section(i, 0.);
+      }
+#endif
+
+      const double cost =
+          2. * random_generator.get_uniform_random_double() - 1.;
+      const double phi =
+          2. * M_PI * random_generator.get_uniform_random_double();
+      const double sint = std::sqrt(std::max(1. - cost * cost, 0.));
+      const double cosp = std::cos(phi);
+      const double sinp = std::sin(phi);
+      const CoordinateVector<> d(sint * cosp, sint * sinp, cost);
+
+      const double tau =
+          -std::log(random_generator.get_uniform_random_double());
+
+      photon.set_position(CoordinateVector<>(0.));
+      photon.set_direction(d);
+#ifndef USE_COMPACT_PHOTON_PACKET
+      photon.set_photoionization_cross_section(ION_H_n, 6.3e-22);
+#endif
+      photon.set_weight(1.);
+      photon.set_target_optical_depth(tau);
+
+      PhotonPacket photon3(photon);
+      const int_fast32_t result = grid.interact(photon, TRAVELDIRECTION_INSIDE);
+      const int_fast32_t result3 =
+          grid3.interact(photon3, TRAVELDIRECTION_INSIDE, i % 4);
+      assert_condition(result == result3);
+    }
+    grid.flush_traversal_counters();
+    grid3.flush_traversal_counters();
+
+    auto it = grid.begin();
+    auto it3 = grid3.begin();
+    while (it != grid.end() && it3 != grid3.end()) {
+      assert_values_equal_rel(
+          it.get_ionization_variables().get_mean_intensity(ION_H_n),
+          it3.get_ionization_variables().get_mean_intensity(ION_H_n), 1.e-12);
+      assert_values_equal_rel(
+          it.get_ionization_variables().get_heating(HEATINGTERM_H),
+          it3.get_ionization_variables().get_heating(HEATINGTERM_H), 1.e-12);
+      it.get_ionization_variables().reset_mean_intensities();
+      ++it;
+      ++it3;
+    }
+  }
+
+  /// check that the batched traversal gives the same result as the scalar
+  /// traversal: bitwise identical for a lane width of 1, identical photons
+  /// and counters up to round off for larger lane widths
+  {
+    const uint_fast32_t number_of_photons = 1000;
+    std::vector< PhotonPacket > photons(number_of_photons);
+    for (uint_fast32_t i = 0; i < number_of_photons; ++i) {
+      PhotonPacket &photon = photons[i];
+
+      photon.set_energy(4.e15);
+#ifndef USE_COMPACT_PHOTON_PACKET
+      for (int_fast32_t i = 0; i < NUMBER_OF_IONNAMES; ++i) {
+        photon.set_photoionization_cross_section(i, 0.);
+      }
+#endif
+
+      const double cost =
+          2. * random_generator.get_uniform_random_double() - 1.;
+      const double phi =
+          2. * M_PI * random_generator.get_uniform_random_double();
+      const double sint = std::sqrt(std::max(1. - cost * cost, 0.));
+      const double cosp = std::cos(phi);
+      const double sinp = std::sin(phi);
+      const CoordinateVector<> d(sint * cosp, sint * sinp, cost);
+
+      const double tau =
+          -std::log(random_generator.get_uniform_random_double());
+
+      photon.set_position(CoordinateVector<>(0.));
+      photon.set_direction(d);
+#ifndef USE_COMPACT_PHOTON_PACKET
+      photon.set_photoionization_cross_section(ION_H_n, 6.3e-22);
+#endif
+      photon.set_weight(1.);
+      photon.set_target_optical_depth(tau);
+    }
+
+    grid.reset_intensities();
+    std::vector< int_fast32_t > results(number_of_photons);
+    std::vector< PhotonPacket > scalar_photons(photons);
+    for (uint_fast32_t i = 0; i < number_of_photons; ++i) {
+      results[i] = grid.interact(scalar_photons[i], TRAVELDIRECTION_INSIDE);
+    }
+    grid.flush_traversal_counters();
+
+    for (uint_fast32_t lane_width = 1; lane_width <= 8; lane_width *= 2) {
+      DensitySubGrid batch_grid(grid);
+      batch_grid.reset_intensities();
+      std::vector< int_fast32_t > batch_results(number_of_photons);
+      std::vector< PhotonPacket > batch_photons(photons);
+      // traverse the photons in chunks, like photon buffers
+      for (uint_fast32_t i = 0; i < number_of_photons; i += 200) {
+        const uint_fast32_t size =
+            std::min< uint_fast32_t >(number_of_photons - i, 200);
+        switch (lane_width) {
+        case 1:
+          batch_grid.interact_batch< 1 >(&batch_photons[i], size,
+                                         TRAVELDIRECTION_INSIDE,
+                                         &batch_results[i]);
+          break;
+        case 2:
+          batch_grid.interact_batch< 2 >(&batch_photons[i], size,
+                                         TRAVELDIRECTION_INSIDE,
+                                         &batch_results[i]);
+          break;
+        case 4:
+          batch_grid.interact_batch< 4 >(&batch_photons[i], size,
+                                         TRAVELDIRECTION_INSIDE,
+                                         &batch_results[i]);
+          break;
+        case 8:
+          batch_grid.interact_batch< 8 >(&batch_photons[i], size,
+                                         TRAVELDIRECTION_INSIDE,
+                                         &batch_results[i]);
+          break;
+        }
+      }
+      batch_grid.flush_traversal_counters();
+
+      for (uint_fast32_t i = 0; i < number_of_photons; ++i) {
+        assert_condition(results[i] == batch_results[i]);
+        for (uint_fast8_t idim = 0; idim < 3; ++idim) {
+          assert_condition(scalar_photons[i].get_position()[idim] ==
+                           batch_photons[i].get_position()[idim]);
+        }
+        assert_condition(scalar_photons[i].get_target_optical_depth() ==
+                         batch_photons[i].get_target_optical_depth());
+      }
+
+      auto it = grid.begin();
+      auto itb = batch_grid.begin();
+      while (it != grid.end() && itb != batch_grid.end()) {
+        const double J = it.get_ionization_variables().get_mean_intensity(
+            ION_H_n);
+        const double Jb =
+            itb.get_ionization_variables().get_mean_intensity(ION_H_n);
+        if (lane_width == 1) {
+          assert_condition(J == Jb);
+        } else {
+          assert_values_equal_rel(J, Jb, 1.e-12);
+        }
+        ++it;
+        ++itb;
+      }
+    }
+
+    for (auto cellit = grid.begin(); cellit != grid.end(); ++cellit) {
+      cellit.get_ionization_variables().reset_mean_intensities();
+    }
+  }
+
   std::ofstream ofile("testDensitySubGrid_output.txt");
   ofile << "# x (m)\ty (m)\tz (m)\txH\tnH (m^-3)\n";
   grid.print_intensities(ofile);
@@ -27,6 +27,7 @@
 #include "Assert.hpp"
 #include "DensitySubGridCreator.hpp"
 #include "HomogeneousDensityFunction.hpp"
+#include "NUMATopology.hpp"
 
 #include <fstream>
 #include <vector>
@@ -361,5 +362,33 @@ int main(int argc, char **argv) {
   assert_condition(grid131.get_neighbour(TRAVELDIRECTION_FACE_Z_N) == 128);
   assert_condition(grid131.get_neighbour(TRAVELDIRECTION_FACE_Z_P) == 84);
 
+  /// NUMA aware initialization
+  {
+    DensitySubGridCreator< DensitySubGrid > numa_grid_creator(
+        Box<>(box_anchor, box_sides), ncell, nsubgrid,
+        CoordinateVector< bool >(false));
+    // 4 threads on 2 NUMA nodes: threads 0 and 1 on node 0, 2 and 3 on node 1
+    NUMATopology topology(4, 2);
+    numa_grid_creator.initialize(density_function, topology);
+
+    std::vector< uint_fast32_t > thread_count(4, 0);
+    for (uint_fast32_t igrid = 0;
+         igrid < numa_grid_creator.number_of_original_subgrids(); ++igrid) {
+      DensitySubGrid &subgrid = *numa_grid_creator.get_subgrid(igrid);
+      assert_condition(subgrid.get_number_of_cells() == 32);
+      const int_fast32_t owner = subgrid.get_owning_thread();
+      assert_condition(owner >= 0 && owner < 4);
+      ++thread_count[owner];
+      // the highest Morton key bit is the x coordinate, so the first node
+      // owns the lower half of the box in x
+      const CoordinateVector< int_fast32_t > p =
+          numa_grid_creator.get_grid_position(igrid);
+      assert_condition(topology.get_node(owner) == ((p.x() < 2) ? 0 : 1));
+    }
+    for (uint_fast32_t ithread = 0; ithread < 4; ++ithread) {
+      assert_condition(thread_count[ithread] == 32);
+    }
+  }
+
   return 0;
 }
@@ -81,6 +81,16 @@ int main(int argc, char **argv) {
     GadgetDensityGridWriter writer("testgrid", ".", false,
                                    DensityGridWriterFields(fields), &log);
     writer.write(grid, 0, params);
+
+    // write the same grid twice using a compressed asynchronous writer; the
+    // writer destructor waits for both snapshots to be written
+    {
+      GadgetDensityGridWriter async_writer(
+          "testgrid_async", ".", false, DensityGridWriterFields(fields), &log,
+          3, true, 4, 100, true, true);
+      async_writer.write(grid, 0, params);
+      async_writer.write(grid, 1, params, 1.);
+    }
   }
 
   // read file and check contents
@@ -213,5 +223,64 @@ int main(int argc, char **argv) {
     HDF5Tools::close_file(file);
   }
 
+  // check that the asynchronous snapshots contain the same cell data as the
+  // synchronous one
+  {
+    HDF5Tools::HDF5File file =
+        HDF5Tools::open_file("testgrid000.hdf5", HDF5Tools::HDF5FILEMODE_READ);
+    HDF5Tools::HDF5Group group = HDF5Tools::open_group(file, "PartType0");
+    std::vector< CoordinateVector<> > coords =
+        HDF5Tools::read_dataset< CoordinateVector<> >(group, "Coordinates");
+    std::vector< double > nfracH =
+        HDF5Tools::read_dataset< double >(group, "NeutralFractionH");
+    std::vector< double > ntot =
+        HDF5Tools::read_dataset< double >(group, "NumberDensity");
+    std::vector< double > temperature =
+        HDF5Tools::read_dataset< double >(group, "Temperature");
+    HDF5Tools::close_group(group);
+    HDF5Tools::close_file(file);
+
+    for (uint_fast32_t isnap = 0; isnap < 2; ++isnap) {
+      const std::string filename =
+          isnap == 0 ? "testgrid_async000.hdf5" : "testgrid_async001.hdf5";
+      file = HDF5Tools::open_file(filename, HDF5Tools::HDF5FILEMODE_READ);
+
+      group = HDF5Tools::open_group(file, "Header");
+      std::vector< uint32_t > numpart_tot =
+          HDF5Tools::read_attribute< std::vector< uint32_t > >(
+              group, "NumPart_Total");
+      assert_condition(numpart_tot[0] == 512);
+      const double time = HDF5Tools::read_attribute< double >(group, "Time");
+      assert_condition(time == isnap);
+      HDF5Tools::close_group(group);
+
+      group = HDF5Tools::open_group(file, "RuntimePars");
+      const uint32_t iteration =
+          HDF5Tools::read_attribute< uint32_t >(group, "Iteration");
+      assert_condition(iteration == isnap);
+      HDF5Tools::close_group(group);
+
+      group = HDF5Tools::open_group(file, "PartType0");
+      std::vector< CoordinateVector<> > async_coords =
+          HDF5Tools::read_dataset< CoordinateVector<> >(group, "Coordinates");
+      std::vector< double > async_nfracH =
+          HDF5Tools::read_dataset< double >(group, "NeutralFractionH");
+      std::vector< double > async_ntot =
+          HDF5Tools::read_dataset< double >(group, "NumberDensity");
+      std::vector< double > async_temperature =
+          HDF5Tools::read_dataset< double >(group, "Temperature");
+      HDF5Tools::close_group(group);
+      HDF5Tools::close_file(file);
+
+      assert_condition(async_coords.size() == coords.size());
+      for (uint_fast32_t i = 0; i < coords.size(); ++i) {
+        assert_condition(async_coords[i] == coords[i]);
+        assert_condition(async_nfracH[i] == nfracH[i]);
+        assert_condition(async_ntot[i] == ntot[i]);
+        assert_condition(async_temperature[i] == temperature[i]);
+      }
+    }
+  }
+
   return 0;
 }
@@ -0,0 +1,170 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testGuideTable.cpp
+ *
+ * @brief Unit test for the GuideTable class.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "Assert.hpp"
+#include "GuideTable.hpp"
+#include "RandomGenerator.hpp"
+#include "Utilities.hpp"
+
+#include <vector>
+
+/**
+ * @brief Unit test for the GuideTable class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  RandomGenerator random_generator(42);
+
+  /// locate() returns the same index as Utilities::locate()
+  {
+    // cumulative distribution with flat regions (zero probability bins) and a
+    // very steep part
+    const uint_fast32_t length = 1000;
+    std::vector< double > cumulative_distribution(length);
+    cumulative_distribution[0] = 0.;
+    for (uint_fast32_t i = 1; i < length; ++i) {
+      double weight = random_generator.get_uniform_random_double();
+      if (i % 7 == 0 || (i > 300 && i < 350)) {
+        weight = 0.;
+      }
+      if (i == 500) {
+        weight = 1000.;
+      }
+      cumulative_distribution[i] = cumulative_distribution[i - 1] + weight;
+    }
+    for (uint_fast32_t i = 0; i < length; ++i) {
+      cumulative_distribution[i] /= cumulative_distribution[length - 1];
+    }
+
+    const uint_fast32_t number_of_guides[3] = {0, 10, 10000};
+    for (uint_fast32_t iguide = 0; iguide < 3; ++iguide) {
+      GuideTable table;
+      table.initialize(cumulative_distribution.data(), length,
+                       number_of_guides[iguide]);
+
+      for (uint_fast32_t i = 0; i < 100000; ++i) {
+        const double x = random_generator.get_uniform_random_double();
+        assert_condition(
+            table.locate(x, cumulative_distribution.data()) ==
+            Utilities::locate(x, cumulative_distribution.data(), length));
+      }
+      // values that are exactly on a bin edge, and values outside the range
+      for (uint_fast32_t i = 0; i < length; ++i) {
+        const double x = cumulative_distribution[i];
+        assert_condition(
+            table.locate(x, cumulative_distribution.data()) ==
+            Utilities::locate(x, cumulative_distribution.data(), length));
+      }
+      const double outside[3] = {-1., 1., 2.};
+      for (uint_fast32_t i = 0; i < 3; ++i) {
+        assert_condition(table.locate(outside[i],
+                                      cumulative_distribution.data()) ==
+                         Utilities::locate(outside[i],
+                                           cumulative_distribution.data(),
+                                           length));
+      }
+    }
+  }
+
+  /// arbitrary monotonic tables (e.g. temperature bins), including a table
+  /// with only 2 elements
+  {
+    std::vector< double > temperature(100);
+    for (uint_fast32_t i = 0; i < 100; ++i) {
+      temperature[i] = 1500. + (i + 0.5) * 135.;
+    }
+    GuideTable table;
+    table.initialize(temperature.data(), 100);
+    for (uint_fast32_t i = 0; i < 10000; ++i) {
+      const double T = 20000. * random_generator.get_uniform_random_double();
+      assert_condition(table.locate(T, temperature.data()) ==
+                       Utilities::locate(T, temperature.data(), 100));
+    }
+
+    const double pair[2] = {1., 3.};
+    table.initialize(pair, 2);
+    assert_condition(table.locate(0., pair) == 0);
+    assert_condition(table.locate(2., pair) == 0);
+    assert_condition(table.locate(4., pair) == 0);
+  }
+
+  /// bulk sampling gives the same result as sampling one value at a time
+  {
+    const uint_fast32_t length = 100;
+    std::vector< double > cumulative_distribution(length);
+    std::vector< double > values(length);
+    cumulative_distribution[0] = 0.;
+    values[0] = 1.;
+    for (uint_fast32_t i = 1; i < length; ++i) {
+      cumulative_distribution[i] = cumulative_distribution[i - 1] +
+                                   random_generator.get_uniform_random_double();
+      values[i] = values[i - 1] + random_generator.get_uniform_random_double();
+    }
+    for (uint_fast32_t i = 0; i < length; ++i) {
+      cumulative_distribution[i] /= cumulative_distribution[length - 1];
+    }
+    GuideTable table;
+    table.initialize(cumulative_distribution.data(), length);
+
+    // use a number of values that is not a multiple of the block size
+    const uint_fast32_t number_of_values = 3 * GUIDETABLE_BLOCK_SIZE + 5;
+    std::vector< double > x(number_of_values);
+    std::vector< double > bulk(number_of_values);
+    for (uint_fast32_t i = 0; i < number_of_values; ++i) {
+      x[i] = random_generator.get_uniform_random_double();
+      bulk[i] = x[i];
+    }
+    table.sample_linear(number_of_values, bulk.data(),
+                        cumulative_distribution.data(), values.data());
+    for (uint_fast32_t i = 0; i < number_of_values; ++i) {
+      const double single = table.sample_linear(
+          x[i], cumulative_distribution.data(), values.data());
+      assert_condition(bulk[i] == single);
+      const uint_fast32_t index =
+          Utilities::locate(x[i], cumulative_distribution.data(), length);
+      assert_condition(single >= values[index]);
+      assert_condition(single <= values[index + 1]);
+    }
+
+    // filling with random values is the same as sampling uniform random
+    // values drawn from an identical generator
+    RandomGenerator fill_generator(42);
+    RandomGenerator reference_generator(42);
+    table.fill_linear(fill_generator, number_of_values, bulk.data(),
+                      cumulative_distribution.data(), values.data());
+    for (uint_fast32_t i = 0; i < number_of_values; ++i) {
+      assert_condition(
+          bulk[i] ==
+          table.sample_linear(reference_generator.get_uniform_random_double(),
+                              cumulative_distribution.data(), values.data()));
+    }
+  }
+
+  return 0;
+}
@@ -181,5 +181,144 @@ int main(int argc, char **argv) {
           << hydrovars.get_primitives_pressure() << "\n";
   }
 
+  /// check that the pencil flux sweep gives exactly the same result as the
+  /// face by face flux sweep
+  {
+    const CoordinateVector< int_fast32_t > ncell_pencil(5, 6, 7);
+    HydroDensitySubGrid pencil_grid(box1, ncell_pencil);
+    for (auto cellit = pencil_grid.hydro_begin();
+         cellit != pencil_grid.hydro_end(); ++cellit) {
+      HydroVariables &hydrovars = cellit.get_hydro_variables();
+      hydrovars.set_primitives_density(0.1 + Utilities::random_double());
+      hydrovars.set_primitives_velocity(
+          2. * Utilities::random_position() - CoordinateVector<>(1.));
+      hydrovars.set_primitives_pressure(0.1 + Utilities::random_double());
+      for (uint_fast8_t j = 0; j < 5; ++j) {
+        hydrovars.primitive_gradients(j) =
+            2. * Utilities::random_position() - CoordinateVector<>(1.);
+      }
+    }
+    pencil_grid.initialize_hydrodynamic_variables(hydro, false);
+    HydroDensitySubGrid face_grid(pencil_grid);
+
+    pencil_grid.inner_flux_sweep(hydro, dt);
+    face_grid.inner_face_flux_sweep(hydro, dt);
+
+    auto it = pencil_grid.hydro_begin();
+    auto it2 = face_grid.hydro_begin();
+    while (it != pencil_grid.hydro_end() && it2 != face_grid.hydro_end()) {
+      for (uint_fast8_t j = 0; j < 5; ++j) {
+        assert_condition(it.get_hydro_variables().delta_conserved(j) ==
+                         it2.get_hydro_variables().delta_conserved(j));
+      }
+      ++it;
+      ++it2;
+    }
+  }
+
+  /// check that the fused sweeps give the same result as the separate sweeps
+  {
+    HydroDensitySubGrid separate_grid1(test_grid1);
+    HydroDensitySubGrid separate_grid2(test_grid2);
+    HydroDensitySubGrid fused_grid1(test_grid1);
+    HydroDensitySubGrid fused_grid2(test_grid2);
+    fused_grid1.enable_fused_hydro();
+    fused_grid2.enable_fused_hydro();
+
+    ParameterFile params;
+    params.add_value("HydroBoundaryManager:boundary x high", "reflective");
+    const HydroBoundaryManager boundary_manager(params);
+    HydroDensitySubGrid *neighbours1[6] = {&fused_grid2, nullptr, nullptr,
+                                           nullptr,      nullptr, nullptr};
+    HydroDensitySubGrid *neighbours2[6] = {nullptr, &fused_grid1, nullptr,
+                                           nullptr, nullptr,      nullptr};
+
+    separate_grid1.inner_gradient_sweep(hydro);
+    separate_grid2.inner_gradient_sweep(hydro);
+    separate_grid1.outer_gradient_sweep(TRAVELDIRECTION_FACE_X_P, hydro,
+                                        separate_grid2);
+    separate_grid1.outer_ghost_gradient_sweep(TRAVELDIRECTION_FACE_X_N, hydro,
+                                              inflow_boundary);
+    separate_grid2.outer_ghost_gradient_sweep(TRAVELDIRECTION_FACE_X_P, hydro,
+                                              reflective_boundary);
+    for (int_fast32_t direction = TRAVELDIRECTION_FACE_Y_P;
+         direction <= TRAVELDIRECTION_FACE_Z_N; ++direction) {
+      separate_grid1.outer_ghost_gradient_sweep(direction, hydro,
+                                                inflow_boundary);
+      separate_grid2.outer_ghost_gradient_sweep(direction, hydro,
+                                                inflow_boundary);
+    }
+    separate_grid1.apply_slope_limiter(hydro);
+    separate_grid2.apply_slope_limiter(hydro);
+
+    fused_grid1.fused_gradient_sweep(hydro, neighbours1, boundary_manager);
+    fused_grid2.fused_gradient_sweep(hydro, neighbours2, boundary_manager);
+
+    // the gradients should be exactly the same
+    HydroDensitySubGrid *separate_grids[2] = {&separate_grid1,
+                                              &separate_grid2};
+    HydroDensitySubGrid *fused_grids[2] = {&fused_grid1, &fused_grid2};
+    for (uint_fast8_t igrid = 0; igrid < 2; ++igrid) {
+      auto it = separate_grids[igrid]->hydro_begin();
+      auto it2 = fused_grids[igrid]->hydro_begin();
+      while (it != separate_grids[igrid]->hydro_end()) {
+        for (uint_fast8_t j = 0; j < 5; ++j) {
+          for (uint_fast8_t i = 0; i < 3; ++i) {
+            assert_condition(
+                it.get_hydro_variables().primitive_gradients(j)[i] ==
+                it2.get_hydro_variables().primitive_gradients(j)[i]);
+          }
+        }
+        ++it;
+        ++it2;
+      }
+    }
+
+    separate_grid1.predict_primitive_variables(hydro, 0.5 * dt);
+    separate_grid2.predict_primitive_variables(hydro, 0.5 * dt);
+    separate_grid1.inner_flux_sweep(hydro, dt);
+    separate_grid2.inner_flux_sweep(hydro, dt);
+    separate_grid1.outer_flux_sweep(TRAVELDIRECTION_FACE_X_P, hydro,
+                                    separate_grid2, dt);
+    separate_grid1.outer_ghost_flux_sweep(TRAVELDIRECTION_FACE_X_N, hydro,
+                                          inflow_boundary, dt);
+    separate_grid2.outer_ghost_flux_sweep(TRAVELDIRECTION_FACE_X_P, hydro,
+                                          reflective_boundary, dt);
+    for (int_fast32_t direction = TRAVELDIRECTION_FACE_Y_P;
+         direction <= TRAVELDIRECTION_FACE_Z_N; ++direction) {
+      separate_grid1.outer_ghost_flux_sweep(direction, hydro, inflow_boundary,
+                                            dt);
+      separate_grid2.outer_ghost_flux_sweep(direction, hydro, inflow_boundary,
+                                            dt);
+    }
+    separate_grid1.update_conserved_variables(dt);
+    separate_grid2.update_conserved_variables(dt);
+    separate_grid1.update_primitive_variables(hydro);
+    separate_grid2.update_primitive_variables(hydro);
+
+    fused_grid1.fused_flux_sweep(hydro, neighbours1, boundary_manager, dt);
+    fused_grid2.fused_flux_sweep(hydro, neighbours2, boundary_manager, dt);
+    fused_grid1.fused_update(hydro, dt);
+    fused_grid2.fused_update(hydro, dt);
+
+    // the fluxes are added in a different order, so we allow for round off
+    for (uint_fast8_t igrid = 0; igrid < 2; ++igrid) {
+      auto it = separate_grids[igrid]->hydro_begin();
+      auto it2 = fused_grids[igrid]->hydro_begin();
+      while (it != separate_grids[igrid]->hydro_end()) {
+        for (uint_fast8_t j = 0; j < 5; ++j) {
+          assert_values_equal_tol(it.get_hydro_variables().conserved(j),
+                                  it2.get_hydro_variables().conserved(j),
+                                  1.e-12);
+          assert_values_equal_tol(it.get_hydro_variables().primitives(j),
+                                  it2.get_hydro_variables().primitives(j),
+                                  1.e-12);
+        }
+        ++it;
+        ++it2;
+      }
+    }
+  }
+
   return 0;
 }
@@ -31,6 +31,7 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 /**
  * @brief Read test line cooling data from a file outputted by Kenny's Fortran
@@ -124,6 +125,49 @@ int main(int argc, char **argv) {
     }
   }
 
+  // test the batched version of simq: every system in the batch should give
+  // exactly the same result as the single system version, and singular
+  // systems should be flagged
+  for (uint_fast32_t loop = 0; loop < 1000; ++loop) {
+    double A[5][5][LINECOOLINGDATA_BATCH_WIDTH];
+    double B[5][LINECOOLINGDATA_BATCH_WIDTH];
+    double As[LINECOOLINGDATA_BATCH_WIDTH][5][5];
+    double Bs[LINECOOLINGDATA_BATCH_WIDTH][5];
+    for (uint_fast32_t l = 0; l < LINECOOLINGDATA_BATCH_WIDTH; ++l) {
+      for (uint_fast8_t i = 0; i < 5; ++i) {
+        for (uint_fast8_t j = 0; j < 5; ++j) {
+          const double a = Utilities::random_double();
+          A[i][j][l] = a;
+          As[l][i][j] = a;
+        }
+        const double b = Utilities::random_double();
+        B[i][l] = b;
+        Bs[l][i] = b;
+      }
+    }
+    // make the last system singular every other loop
+    const uint_fast32_t lsingular = LINECOOLINGDATA_BATCH_WIDTH - 1;
+    if (loop % 2 == 0) {
+      for (uint_fast8_t i = 0; i < 5; ++i) {
+        A[i][0][lsingular] = 0.;
+        As[lsingular][i][0] = 0.;
+      }
+    }
+
+    const int status = LineCoolingData::solve_systems_of_linear_equations(A, B);
+    assert_condition((status != 0) == (loop % 2 == 0));
+    for (uint_fast32_t l = 0; l < LINECOOLINGDATA_BATCH_WIDTH; ++l) {
+      const int status_single =
+          LineCoolingData::solve_system_of_linear_equations(As[l], Bs[l]);
+      assert_condition(((status >> l) & 1) == (status_single != 0));
+      if (status_single == 0) {
+        for (uint_fast8_t i = 0; i < 5; ++i) {
+          assert_condition(B[i][l] == Bs[l][i]);
+        }
+      }
+    }
+  }
+
   // linecool
   {
     std::ifstream file("linecool_testdata.txt");
@@ -148,6 +192,68 @@ int main(int argc, char **argv) {
     }
   }
 
+  // batched and tabulated linecool
+  // the batched version should give exactly the same result as the single
+  // point version, the tabulated version should be close
+  {
+    LineCoolingData tabulated_data(true);
+    assert_condition(!data.is_tabulated());
+    assert_condition(tabulated_data.is_tabulated());
+
+    std::vector< double > T, ne, cooling;
+    std::vector< std::vector< double > > abundances;
+    std::ifstream file("linecool_testdata.txt");
+    std::string line;
+    while (getline(file, line)) {
+      std::istringstream lstream(line);
+
+      double Tval, neval, coolf;
+      std::vector< double > abundance(LINECOOLINGDATA_NUMELEMENTS);
+      lstream >> Tval >> neval;
+      for (uint_fast8_t i = 0; i < 13; ++i) {
+        lstream >> abundance[i];
+      }
+      lstream >> coolf;
+
+      T.push_back(Tval);
+      ne.push_back(
+          UnitConverter::to_SI< QUANTITY_NUMBER_DENSITY >(neval, "cm^-3"));
+      abundances.push_back(abundance);
+    }
+    // add a point without free electrons
+    T.push_back(8000.);
+    ne.push_back(0.);
+    abundances.push_back(abundances[0]);
+
+    const uint_fast32_t number_of_points = T.size();
+    std::vector< double > abundance_array(number_of_points *
+                                          LINECOOLINGDATA_NUMELEMENTS);
+    for (uint_fast32_t i = 0; i < number_of_points; ++i) {
+      for (uint_fast32_t j = 0; j < LINECOOLINGDATA_NUMELEMENTS; ++j) {
+        abundance_array[i * LINECOOLINGDATA_NUMELEMENTS + j] =
+            abundances[i][j];
+      }
+    }
+    const double(*abundance_pointer)[LINECOOLINGDATA_NUMELEMENTS] =
+        reinterpret_cast< const double(*)[LINECOOLINGDATA_NUMELEMENTS] >(
+            &abundance_array[0]);
+
+    cooling.resize(number_of_points);
+    data.get_cooling(number_of_points, &T[0], &ne[0], abundance_pointer,
+                     &cooling[0]);
+    std::vector< double > tabulated_cooling(number_of_points);
+    tabulated_data.get_cooling(number_of_points, &T[0], &ne[0],
+                               abundance_pointer, &tabulated_cooling[0]);
+    for (uint_fast32_t i = 0; i < number_of_points; ++i) {
+      const double cool = data.get_cooling(T[i], ne[i], &abundances[i][0]);
+      assert_condition(cooling[i] == cool);
+      const double tabulated_cool =
+          tabulated_data.get_cooling(T[i], ne[i], &abundances[i][0]);
+      assert_condition(tabulated_cooling[i] == tabulated_cool);
+      assert_values_equal_rel(tabulated_cool, cool, 1.e-4);
+    }
+  }
+
   // linestr
   {
     std::ifstream file("linestr_testdata.txt");
@@ -89,6 +89,131 @@ public:
   }
 };
 
+/**
+ * @brief Functor used to test MPICommunicator::gather_chunked().
+ */
+class TestGatherFunction {
+private:
+  /*! @brief Elements to gather (3 values per element). */
+  std::vector< double > &_elements;
+
+  /*! @brief Block of elements held by the local process. */
+  const std::pair< size_t, size_t > _block;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param elements Elements to gather (3 values per element).
+   * @param block Block of elements held by the local process.
+   */
+  TestGatherFunction(std::vector< double > &elements,
+                     const std::pair< size_t, size_t > block)
+      : _elements(elements), _block(block) {}
+
+  /**
+   * @brief Copy the values of the given local chunk into the given buffer.
+   *
+   * @param chunk_begin Index of the first element of the chunk.
+   * @param chunk_end Index of the first element not part of the chunk.
+   * @param buffer Chunk buffer.
+   */
+  void pack(const size_t chunk_begin, const size_t chunk_end, double *buffer) {
+    assert_condition(chunk_begin >= _block.first);
+    assert_condition(chunk_end <= _block.second);
+    for (size_t i = 3 * chunk_begin; i < 3 * chunk_end; ++i) {
+      buffer[i - 3 * chunk_begin] = _elements[i];
+    }
+  }
+
+  /**
+   * @brief Store the values in the given buffer for the given chunk, which
+   * should not be local.
+   *
+   * @param chunk_begin Index of the first element of the chunk.
+   * @param chunk_end Index of the first element not part of the chunk.
+   * @param buffer Gathered chunk buffer.
+   */
+  void unpack(const size_t chunk_begin, const size_t chunk_end,
+              const double *buffer) {
+    assert_condition(chunk_end <= _block.first ||
+                     chunk_begin >= _block.second);
+    for (size_t i = 3 * chunk_begin; i < 3 * chunk_end; ++i) {
+      _elements[i] = buffer[i - 3 * chunk_begin];
+    }
+  }
+};
+
+/**
+ * @brief Functor used to test MPICommunicator::reduce_pipelined().
+ */
+class TestChunkFunction {
+private:
+  /*! @brief Number of MPI processes. */
+  const double _number_of_processes;
+
+  /*! @brief Index of the first element of the next chunk to pack. */
+  size_t _next_pack;
+
+  /*! @brief Index of the first element of the next chunk. */
+  size_t _next_chunk;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param number_of_processes Number of MPI processes.
+   */
+  TestChunkFunction(const double number_of_processes)
+      : _number_of_processes(number_of_processes), _next_pack(0),
+        _next_chunk(0) {}
+
+  /**
+   * @brief Fill the given chunk buffer and check that chunks are packed in
+   * order.
+   *
+   * @param chunk_begin Index of the first element of the chunk.
+   * @param chunk_end Index of the first element not part of the chunk.
+   * @param buffer Chunk buffer.
+   */
+  void pack(const size_t chunk_begin, const size_t chunk_end, double *buffer) {
+    assert_condition(chunk_begin == _next_pack);
+    for (size_t i = chunk_begin; i < chunk_end; ++i) {
+      buffer[i - chunk_begin] = i;
+    }
+    _next_pack = chunk_end;
+  }
+
+  /**
+   * @brief Check that the given chunk was fully reduced and that chunks are
+   * processed in order.
+   *
+   * @param chunk_begin Index of the first element of the chunk.
+   * @param chunk_end Index of the first element not part of the chunk.
+   * @param buffer Reduced chunk buffer.
+   * @param progress Functor that progresses the outstanding reductions.
+   */
+  void update(const size_t chunk_begin, const size_t chunk_end,
+              const double *buffer,
+              const MPICommunicator::PipelineProgress &progress) {
+    assert_condition(chunk_begin == _next_chunk);
+    assert_condition(chunk_end > chunk_begin);
+    assert_condition(_next_pack >= chunk_end);
+    for (size_t i = chunk_begin; i < chunk_end; ++i) {
+      assert_condition(buffer[i - chunk_begin] == i * _number_of_processes);
+      progress();
+    }
+    _next_chunk = chunk_end;
+  }
+
+  /**
+   * @brief Get the index of the first element that was not processed.
+   *
+   * @return Index of the first element that was not processed.
+   */
+  size_t get_next_chunk() const { return _next_chunk; }
+};
+
 /**
  * @brief Unit test for MPICommunicator.
  *
@@ -141,6 +266,32 @@ int main(int argc, char **argv) {
     assert_condition(numbers[i] == 42.);
   }
 
+  // chunked gather with multiple values per element, with a chunk size that
+  // does not divide the block sizes
+  std::vector< double > elements(19 * 3, 0.);
+  for (size_t i = block.first; i < block.second; ++i) {
+    for (size_t j = 0; j < 3; ++j) {
+      elements[3 * i + j] = i + 0.1 * j;
+    }
+  }
+  TestGatherFunction gather_function(elements, block);
+  comm.gather_chunked< double >(19, 3, 2, gather_function);
+  for (size_t i = 0; i < 19; ++i) {
+    for (size_t j = 0; j < 3; ++j) {
+      assert_condition(elements[3 * i + j] == i + 0.1 * j);
+    }
+  }
+
+  // pipelined reduction with a chunk size that does not divide the vector size
+  // we test both the minimal ring and a ring with more buffers than chunks
+  for (uint_fast32_t number_of_buffers = 2; number_of_buffers < 20;
+       number_of_buffers += 15) {
+    TestChunkFunction chunk_function(comm.get_size());
+    comm.reduce_pipelined< MPI_SUM_OF_ALL_PROCESSES, double >(
+        100, 9, number_of_buffers, chunk_function);
+    assert_condition(chunk_function.get_next_chunk() == 100);
+  }
+
   std::vector< double > vector(100, 1.);
   comm.reduce< MPI_SUM_OF_ALL_PROCESSES >(vector);
   for (size_t i = 0; i < vector.size(); ++i) {
@@ -0,0 +1,115 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testNUMATopology.cpp
+ *
+ * @brief Unit test for the NUMATopology class and the NUMA aware steal policy
+ * of the Scheduler.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "Assert.hpp"
+#include "NUMATopology.hpp"
+#include "Scheduler.hpp"
+
+/**
+ * @brief Unit test for the NUMATopology class and the NUMA aware steal policy
+ * of the Scheduler.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  /// explicit topology
+  {
+    // 5 threads on 2 nodes: 0, 1, 2 on node 0 and 3, 4 on node 1
+    NUMATopology topology(5, 2);
+    assert_condition(topology.get_number_of_threads() == 5);
+    assert_condition(topology.get_number_of_nodes() == 2);
+    assert_condition(topology.get_node(0) == 0);
+    assert_condition(topology.get_node(2) == 0);
+    assert_condition(topology.get_node(3) == 1);
+    assert_condition(topology.get_node(4) == 1);
+    assert_condition(topology.get_threads(0).size() == 3);
+    assert_condition(topology.get_threads(1).size() == 2);
+    assert_condition(topology.same_node(0, 1));
+    assert_condition(!topology.same_node(2, 3));
+
+    // blocks are contiguous and the thread index never decreases
+    int_fast32_t last_thread = 0;
+    for (size_t i = 0; i < 100; ++i) {
+      const int_fast32_t thread = topology.get_block_thread(i, 100);
+      assert_condition(thread == last_thread || thread == last_thread + 1);
+      last_thread = thread;
+    }
+    assert_condition(last_thread == 4);
+    assert_condition(topology.get_block_thread(0, 100) == 0);
+    assert_condition(topology.get_block_thread(59, 100) == 2);
+    assert_condition(topology.get_block_thread(60, 100) == 3);
+
+    // we cannot have more nodes than threads
+    NUMATopology small_topology(2, 4);
+    assert_condition(small_topology.get_number_of_nodes() == 2);
+  }
+
+  /// detected topology: at least one node, and every thread is on a node
+  {
+    NUMATopology topology(1);
+    assert_condition(topology.get_number_of_nodes() == 1);
+    assert_condition(topology.get_node(0) == 0);
+  }
+
+  /// NUMA aware work stealing
+  {
+    ThreadSafeVector< Task > tasks(10, "Tasks");
+    std::vector< TaskQueue * > queues(4);
+    for (uint_fast32_t i = 0; i < 4; ++i) {
+      queues[i] = new TaskQueue(10, "Queue");
+    }
+    TaskQueue shared_queue(10, "Shared queue");
+    NUMATopology topology(4, 2);
+    Scheduler scheduler(tasks, queues, shared_queue, SCHEDULER_STEAL_NUMA,
+                        &topology);
+
+    // one task on the other node, one on the same node
+    const size_t remote_task = tasks.get_free_element();
+    queues[3]->add_task(remote_task);
+    const size_t local_task = tasks.get_free_element();
+    queues[1]->add_task(local_task);
+
+    int_fast32_t queue_index;
+    assert_condition(scheduler.get_task(0, queue_index) == local_task);
+    assert_condition(queue_index == 1);
+    assert_condition(scheduler.get_number_of_remote_steals() == 0);
+    assert_condition(scheduler.get_task(0, queue_index) == remote_task);
+    assert_condition(queue_index == 3);
+    assert_condition(scheduler.get_number_of_remote_steals() == 1);
+    assert_condition(scheduler.get_number_of_successful_steals() == 2);
+    assert_condition(scheduler.get_task(0, queue_index) == NO_TASK);
+    assert_condition(queue_index == -1);
+
+    for (uint_fast32_t i = 0; i < 4; ++i) {
+      delete queues[i];
+    }
+  }
+
+  return 0;
+}
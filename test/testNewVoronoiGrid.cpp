@@ -29,6 +29,7 @@
 #include "Timer.hpp"
 #include "Utilities.hpp"
 
+#include <algorithm>
 #include <fstream>
 
 /**
@@ -1270,6 +1271,69 @@ int main(int argc, char **argv) {
                 timer.value(), time_per_cell);
   }
 
+  /// test incremental NewVoronoiGrid update
+  {
+    const uint_fast32_t ncell = 1000;
+    std::vector< CoordinateVector<> > positions(ncell);
+    for (uint_fast32_t i = 0; i < ncell; ++i) {
+      positions[i] = Utilities::random_position();
+    }
+
+    Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+    NewVoronoiGrid grid(positions, box);
+    grid.compute_grid();
+
+    // first step: only the generators in a sphere around the centre move
+    // second step: all generators move, which triggers a full reconstruction
+    const CoordinateVector<> centre(0.5);
+    const double dx = 0.1 * std::cbrt(1. / ncell);
+    for (uint_fast32_t step = 0; step < 2; ++step) {
+      const double radius = (step == 0) ? 0.25 : 1.;
+      for (uint_fast32_t i = 0; i < ncell; ++i) {
+        const CoordinateVector<> d = positions[i] - centre;
+        if (d.norm() < radius) {
+          const CoordinateVector<> new_position =
+              positions[i] + dx * d / radius;
+          if (box.inside(new_position)) {
+            positions[i] = new_position;
+          }
+        }
+      }
+
+      assert_condition(grid.update_grid());
+
+      std::vector< CoordinateVector<> > reference_positions(positions);
+      NewVoronoiGrid reference_grid(reference_positions, box);
+      reference_grid.compute_grid();
+
+      for (uint_fast32_t i = 0; i < ncell; ++i) {
+        assert_values_equal_rel(grid.get_volume(i),
+                                reference_grid.get_volume(i), 1.e-10);
+        const CoordinateVector<> centroid = grid.get_centroid(i);
+        const CoordinateVector<> reference_centroid =
+            reference_grid.get_centroid(i);
+        assert_values_equal_rel(centroid.x(), reference_centroid.x(), 1.e-10);
+        assert_values_equal_rel(centroid.y(), reference_centroid.y(), 1.e-10);
+        assert_values_equal_rel(centroid.z(), reference_centroid.z(), 1.e-10);
+
+        const std::vector< VoronoiFace > faces = grid.get_faces(i);
+        const std::vector< VoronoiFace > reference_faces =
+            reference_grid.get_faces(i);
+        assert_condition(faces.size() == reference_faces.size());
+        std::vector< uint_fast32_t > ngbs, reference_ngbs;
+        for (uint_fast32_t j = 0; j < faces.size(); ++j) {
+          ngbs.push_back(faces[j].get_neighbour());
+          reference_ngbs.push_back(reference_faces[j].get_neighbour());
+        }
+        std::sort(ngbs.begin(), ngbs.end());
+        std::sort(reference_ngbs.begin(), reference_ngbs.end());
+        assert_condition(ngbs == reference_ngbs);
+      }
+    }
+
+    cmac_status("Incremental grid update works!");
+  }
+
   /// test NewVoronoiGrid construction: regular generators
   {
     const uint_fast32_t ncell_1D = 5;
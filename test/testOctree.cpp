@@ -19,7 +19,7 @@
 /**
  * @file testOctree.cpp
  *
- * @brief Unit test for the Octree class.
+ * @brief Unit test for the Octree and FlatOctree classes.
  *
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
@@ -27,6 +27,7 @@
 #include "Box.hpp"
 #include "CoordinateVector.hpp"
 #include "Error.hpp"
+#include "FlatOctree.hpp"
 #include "Octree.hpp"
 #include "Utilities.hpp"
 #include <fstream>
@@ -169,5 +170,96 @@ int main(int argc, char **argv) {
     }
   }
 
+  // flat octree: compare with the Octree and with a brute force search, using
+  // enough positions to have multiple levels of leaves
+  {
+    const uint_fast32_t numpos_flat = 10000;
+    std::vector< CoordinateVector<> > flat_positions(numpos_flat);
+    std::vector< double > flat_hs(numpos_flat);
+    for (uint_fast32_t i = 0; i < numpos_flat; ++i) {
+      flat_positions[i] = Utilities::random_position();
+      flat_hs[i] = 0.05 * Utilities::random_double();
+    }
+
+    for (uint_fast8_t periodic = 0; periodic < 2; ++periodic) {
+      Octree tree(flat_positions, box, periodic);
+      tree.set_auxiliaries(flat_hs, Octree::max< double >);
+      FlatOctree flat_tree(flat_positions, box, periodic);
+      flat_tree.set_auxiliaries(flat_hs, FlatOctree::max< double >);
+      assert_condition(flat_tree.get_number_of_nodes() < numpos_flat);
+
+      for (uint_fast32_t itest = 0; itest < 100; ++itest) {
+        const CoordinateVector<> centre = Utilities::random_position();
+        const double radius = 0.02 * Utilities::random_double();
+
+        std::vector< uint_fast32_t > ngbs_brute_force;
+        for (uint_fast32_t i = 0; i < numpos_flat; ++i) {
+          double r;
+          if (periodic) {
+            r = box.periodic_distance(flat_positions[i], centre).norm();
+          } else {
+            r = (flat_positions[i] - centre).norm();
+          }
+          if (r <= flat_hs[i] + radius) {
+            ngbs_brute_force.push_back(i);
+          }
+        }
+
+        std::vector< uint_fast32_t > ngbs_tree =
+            tree.get_ngbs_sphere(centre, radius);
+        std::vector< uint_fast32_t > ngbs_flat =
+            flat_tree.get_ngbs_sphere(centre, radius);
+
+        assert_condition(ngbs_brute_force.size() == ngbs_tree.size());
+        assert_condition(ngbs_brute_force.size() == ngbs_flat.size());
+        std::sort(ngbs_tree.begin(), ngbs_tree.end());
+        std::sort(ngbs_flat.begin(), ngbs_flat.end());
+        for (size_t i = 0; i < ngbs_flat.size(); ++i) {
+          assert_condition(ngbs_brute_force[i] == ngbs_tree[i]);
+          assert_condition(ngbs_brute_force[i] == ngbs_flat[i]);
+        }
+
+        std::vector< uint_fast32_t > ngbs_tree_point = tree.get_ngbs(centre);
+        std::vector< uint_fast32_t > ngbs_flat_point =
+            flat_tree.get_ngbs(centre);
+        assert_condition(ngbs_tree_point.size() == ngbs_flat_point.size());
+        std::sort(ngbs_tree_point.begin(), ngbs_tree_point.end());
+        std::sort(ngbs_flat_point.begin(), ngbs_flat_point.end());
+        for (size_t i = 0; i < ngbs_flat_point.size(); ++i) {
+          assert_condition(ngbs_tree_point[i] == ngbs_flat_point[i]);
+        }
+
+        const uint_fast32_t closest_tree = tree.get_closest_ngb(centre);
+        const uint_fast32_t closest_flat = flat_tree.get_closest_ngb(centre);
+        double r_tree, r_flat;
+        if (periodic) {
+          r_tree = box.periodic_distance(flat_positions[closest_tree], centre)
+                       .norm();
+          r_flat = box.periodic_distance(flat_positions[closest_flat], centre)
+                       .norm();
+        } else {
+          r_tree = (flat_positions[closest_tree] - centre).norm();
+          r_flat = (flat_positions[closest_flat] - centre).norm();
+        }
+        assert_condition(r_tree == r_flat);
+      }
+    }
+  }
+
+  // flat octree with duplicate positions: these end up in a single leaf on
+  // the deepest level
+  {
+    std::vector< CoordinateVector<> > duplicate_positions(
+        100, CoordinateVector<>(0.3, 0.6, 0.2));
+    std::vector< double > duplicate_hs(100, 0.1);
+    FlatOctree flat_tree(duplicate_positions, box, false);
+    flat_tree.set_auxiliaries(duplicate_hs, FlatOctree::max< double >);
+    std::vector< uint_fast32_t > ngbs =
+        flat_tree.get_ngbs(CoordinateVector<>(0.3, 0.6, 0.25));
+    assert_condition(ngbs.size() == 100);
+    ngbs = flat_tree.get_ngbs(CoordinateVector<>(0.3, 0.6, 0.35));
+    assert_condition(ngbs.size() == 0);
+  }
+
   return 0;
 }
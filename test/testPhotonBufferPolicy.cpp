@@ -0,0 +1,121 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testPhotonBufferPolicy.cpp
+ *
+ * @brief Unit test for variable capacity photon buffers and the
+ * PhotonBufferPolicy class.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "Assert.hpp"
+#include "MemorySpace.hpp"
+#include "PhotonBufferPolicy.hpp"
+
+/**
+ * @brief Unit test for variable capacity photon buffers and the
+ * PhotonBufferPolicy class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  /// variable capacity buffers
+  {
+    MemorySpace space(10);
+    const size_t index = space.get_free_buffer(5);
+    assert_condition(space[index].get_capacity() == 5);
+    space[index].set_subgrid_index(3);
+    space[index].set_direction(2);
+
+    PhotonBuffer input;
+    for (uint_fast32_t i = 0; i < 7; ++i) {
+      input.get_next_free_photon();
+    }
+    assert_condition(!input.is_full());
+
+    // the overflow buffer inherits the capacity, subgrid and direction
+    const size_t overflow_index = space.add_photons(index, input);
+    assert_condition(overflow_index != index);
+    assert_condition(space[index].is_full());
+    assert_condition(space[index].size() == 5);
+    assert_condition(space[overflow_index].size() == 2);
+    assert_condition(space[overflow_index].get_capacity() == 5);
+    assert_condition(space[overflow_index].get_subgrid_index() == 3);
+    assert_condition(space[overflow_index].get_direction() == 2);
+
+    // buffers taken from the memory space get the requested capacity, even if
+    // they were used before with another capacity
+    space.free_buffer(index);
+    space.free_buffer(overflow_index);
+    for (uint_fast32_t i = 0; i < 10; ++i) {
+      assert_condition(space[space.get_free_buffer()].get_capacity() ==
+                       PHOTONBUFFER_SIZE);
+    }
+  }
+
+  /// adaptive policy
+  {
+    // minimum capacity 10, target task duration 1000 cycles, flush at half
+    // the capacity, no smoothing
+    PhotonBufferPolicy policy(10, 1000., 0.5, 4, 1.);
+    policy.set_number_of_subgrids(3);
+    assert_condition(policy.get_flush_patience() == 4);
+    for (uint_fast32_t igrid = 0; igrid < 3; ++igrid) {
+      assert_condition(policy.get_capacity(igrid) == PHOTONBUFFER_SIZE);
+      assert_condition(policy.get_flush_threshold(igrid) ==
+                       PHOTONBUFFER_SIZE / 2);
+    }
+
+    // subgrid 0: full buffers, but very expensive photons: the capacity is
+    // limited by the target task duration (and the minimum capacity)
+    policy.record_task(0, 200, 200 * 100);
+    policy.record_task(0, 200, 200 * 100);
+    // subgrid 1: cheap photons, but only a trickle: the capacity is limited by
+    // the average buffer occupancy
+    policy.record_task(1, 10, 10);
+    policy.record_task(1, 12, 12);
+    policy.record_task(1, 8, 8);
+    // subgrid 2: no tasks, keeps its old values
+    policy.update();
+
+    assert_condition(policy.get_last_number_of_tasks() == 5);
+    assert_condition(policy.get_last_number_of_photons() == 430);
+    assert_condition(policy.get_capacity(0) == 10);
+    assert_condition(policy.get_flush_threshold(0) == 5);
+    assert_condition(policy.get_capacity(1) == 20);
+    assert_condition(policy.get_flush_threshold(1) == 10);
+    assert_condition(policy.get_capacity(2) == PHOTONBUFFER_SIZE);
+    assert_values_equal(policy.get_average_capacity(),
+                        (10. + 20. + PHOTONBUFFER_SIZE) / 3.);
+
+    // the statistics are reset after every update
+    policy.update();
+    assert_condition(policy.get_last_number_of_tasks() == 0);
+    assert_condition(policy.get_capacity(1) == 20);
+
+    // changing the number of subgrids discards all information
+    policy.set_number_of_subgrids(4);
+    assert_condition(policy.get_capacity(0) == PHOTONBUFFER_SIZE);
+  }
+
+  return 0;
+}
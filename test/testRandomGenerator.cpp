@@ -24,6 +24,7 @@
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
 #include "Assert.hpp"
+#include "PhiloxRandomGenerator.hpp"
 #include "RandomGenerator.hpp"
 
 /**
@@ -83,5 +84,107 @@ int main(int argc, char **argv) {
     }
   }
 
+  /// bulk test: the bulk interface produces the same values as consecutive
+  /// calls
+  {
+    RandomGenerator generator_A(42);
+    RandomGenerator generator_B(42);
+
+    double values[1000];
+    generator_A.get_uniform_random_doubles(values, 1000);
+    for (uint_fast32_t i = 0; i < 1000; ++i) {
+      assert_condition(values[i] == generator_B.get_uniform_random_double());
+    }
+  }
+
+  /// Philox test: known answer test from Salmon et al. (2011)
+  {
+    const uint32_t counter[4] = {0, 0, 0, 0};
+    const uint32_t key[2] = {0, 0};
+    uint32_t output[4];
+    PhiloxRandomGenerator::get_raw_block(counter, key, output);
+    assert_condition(output[0] == 0x6627e8d5);
+    assert_condition(output[1] == 0xe169c58d);
+    assert_condition(output[2] == 0xbc57ac4c);
+    assert_condition(output[3] == 0x9b00dbd8);
+
+    const uint32_t counter_max[4] = {0xffffffff, 0xffffffff, 0xffffffff,
+                                     0xffffffff};
+    const uint32_t key_max[2] = {0xffffffff, 0xffffffff};
+    PhiloxRandomGenerator::get_raw_block(counter_max, key_max, output);
+    assert_condition(output[0] == 0x408f276d);
+    assert_condition(output[1] == 0x41c83b0e);
+    assert_condition(output[2] == 0xa20bc7c6);
+    assert_condition(output[3] == 0x6d5451fd);
+  }
+
+  /// Philox test: statistics, bulk generation, substreams and restart
+  {
+    PhiloxRandomGenerator generator_A(42);
+
+    double mean_random = 0.;
+    uint_fast32_t num = 1000000;
+    double weight = 1. / num;
+    for (uint_fast32_t i = 0; i < num; ++i) {
+      const double value = generator_A.get_uniform_random_double();
+      assert_condition(value > 0. && value < 1.);
+      mean_random += weight * value;
+    }
+    assert_values_equal_tol(mean_random, 0.5, 1.e-3);
+
+    // the bulk interface picks up where a partially used block left off
+    PhiloxRandomGenerator generator_B(42);
+    PhiloxRandomGenerator generator_C(42);
+    generator_B.get_random_integer();
+    generator_C.get_random_integer();
+    double values[1001];
+    generator_B.get_uniform_random_doubles(values, 1001);
+    for (uint_fast32_t i = 0; i < 1001; ++i) {
+      assert_condition(values[i] == generator_C.get_uniform_random_double());
+    }
+    assert_condition(generator_B.get_random_integer() ==
+                     generator_C.get_random_integer());
+
+    // different substreams produce different values, the same substream
+    // reproduces the same values
+    generator_B.set_substream(1);
+    generator_C.set_substream(2);
+    const double value_B = generator_B.get_uniform_random_double();
+    assert_condition(value_B != generator_C.get_uniform_random_double());
+    generator_C.set_substream(1);
+    assert_condition(value_B == generator_C.get_uniform_random_double());
+
+#ifdef USE_PHILOX_RANDOM_GENERATOR
+    // job substreams are unique for every iteration and job
+    RandomGenerator generator_E(42);
+    RandomGenerator generator_F(42);
+    generator_E.set_job_substream(1, 2);
+    generator_F.set_job_substream(2, 1);
+    const double value_E = generator_E.get_uniform_random_double();
+    assert_condition(value_E != generator_F.get_uniform_random_double());
+    generator_F.get_uniform_random_double();
+    generator_F.set_job_substream(1, 2);
+    assert_condition(value_E == generator_F.get_uniform_random_double());
+#endif
+
+    generator_B.get_random_integer();
+    {
+      RestartWriter restart_writer("philoxrandomgenerator.dump");
+      generator_B.write_restart_file(restart_writer);
+    }
+
+    {
+      RestartReader restart_reader("philoxrandomgenerator.dump");
+      PhiloxRandomGenerator generator_D(restart_reader);
+
+      for (uint_fast32_t i = 0; i < 1e3; ++i) {
+        assert_condition(generator_B.get_random_integer() ==
+                         generator_D.get_random_integer());
+        assert_condition(generator_B.get_uniform_random_double() ==
+                         generator_D.get_uniform_random_double());
+      }
+    }
+  }
+
   return 0;
 }
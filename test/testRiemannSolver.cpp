@@ -31,6 +31,7 @@
 
 #include <fstream>
 #include <string>
+#include <vector>
 
 /**
  * @brief Run a Rieman solver test.
@@ -98,6 +99,72 @@ void plot_solution(ExactRiemannSolver &solver, double rhoL, double uL,
   }
 }
 
+/**
+ * @brief Check that the batched flux calculation of the given Riemann solver
+ * gives exactly the same result as the flux calculation for single
+ * interfaces.
+ *
+ * @param solver Riemann solver to test.
+ */
+template < typename _solver_ > void check_batch(const _solver_ &solver) {
+
+  // not a multiple of the batch size, so that we also test the remainder
+  const uint_fast32_t number_of_interfaces = 100;
+  std::vector< double > W[10], fluxes[5];
+  for (uint_fast8_t j = 0; j < 10; ++j) {
+    W[j].resize(number_of_interfaces);
+  }
+  for (uint_fast8_t j = 0; j < 5; ++j) {
+    fluxes[j].resize(number_of_interfaces);
+  }
+  RandomGenerator random_generator(42);
+  for (uint_fast32_t k = 0; k < number_of_interfaces; ++k) {
+    for (uint_fast8_t side = 0; side < 2; ++side) {
+      W[5 * side][k] = 0.1 + random_generator.get_uniform_random_double();
+      for (uint_fast8_t j = 1; j < 4; ++j) {
+        W[5 * side + j][k] =
+            2. * random_generator.get_uniform_random_double() - 1.;
+      }
+      W[5 * side + 4][k] = 0.1 + random_generator.get_uniform_random_double();
+    }
+  }
+  // add some vacuum states
+  W[0][3] = 0.;
+  W[9][17] = 0.;
+  W[0][50] = 0.;
+  W[5][50] = 0.;
+  // and a state that generates vacuum
+  W[1][70] = -100.;
+  W[6][70] = 100.;
+
+  const double *WL[5], *WR[5];
+  double *F[5];
+  for (uint_fast8_t j = 0; j < 5; ++j) {
+    WL[j] = &W[j][0];
+    WR[j] = &W[5 + j][0];
+    F[j] = &fluxes[j][0];
+  }
+  for (uint_fast8_t i = 0; i < 3; ++i) {
+    solver.solve_for_flux_batch(number_of_interfaces, i, WL, WR, F);
+
+    CoordinateVector<> normal;
+    normal[i] = 1.;
+    for (uint_fast32_t k = 0; k < number_of_interfaces; ++k) {
+      double mflux, Eflux;
+      CoordinateVector<> pflux;
+      solver.solve_for_flux(
+          W[0][k], CoordinateVector<>(W[1][k], W[2][k], W[3][k]), W[4][k],
+          W[5][k], CoordinateVector<>(W[6][k], W[7][k], W[8][k]), W[9][k],
+          mflux, pflux, Eflux, normal);
+      assert_condition(fluxes[0][k] == mflux);
+      assert_condition(fluxes[1][k] == pflux.x());
+      assert_condition(fluxes[2][k] == pflux.y());
+      assert_condition(fluxes[3][k] == pflux.z());
+      assert_condition(fluxes[4][k] == Eflux);
+    }
+  }
+}
+
 /**
  * @brief Unit test for the RiemannSolver class.
  *
@@ -246,5 +313,11 @@ int main(int argc, char **argv) {
     }
   }
 
+  /// batched flux calculation test
+  {
+    check_batch(HLLCRiemannSolver(5. / 3.));
+    check_batch(ExactRiemannSolver(5. / 3.));
+  }
+
   return 0;
 }
@@ -201,5 +201,78 @@ int main(int argc, char **argv) {
     //    }
   }
 
+  /// incremental mapping: should give the same result as the full mapping if
+  /// the tolerance is zero
+  {
+    const char *mapping_types[2] = {"centroid", "Petkova"};
+    for (uint_fast8_t itype = 0; itype < 2; ++itype) {
+      Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+      CartesianDensityGrid grid_full(box, 8);
+      CartesianDensityGrid grid_incremental(box, 8);
+      std::pair< cellsize_t, cellsize_t > block =
+          std::make_pair(0, grid_full.get_number_of_cells());
+      SPHArrayInterface interface_full(1., 1., mapping_types[itype]);
+      SPHArrayInterface interface_incremental(1., 1., mapping_types[itype]);
+      interface_incremental.set_incremental_mapping(0.);
+
+      std::vector< double > x(1000, 0.);
+      std::vector< double > y(1000, 0.);
+      std::vector< double > z(1000, 0.);
+      std::vector< double > h(1000, 0.);
+      std::vector< double > m(1000, 0.);
+      for (size_t i = 0; i < 1000; ++i) {
+        x[i] = 0.1 + 0.8 * Utilities::random_double();
+        y[i] = 0.1 + 0.8 * Utilities::random_double();
+        z[i] = 0.1 + 0.8 * Utilities::random_double();
+        h[i] = 0.2;
+        m[i] = 0.001;
+      }
+      // keep the extent of the particle distribution fixed
+      x[0] = 0.;
+      x[1] = 1.;
+
+      for (uint_fast32_t istep = 0; istep < 3; ++istep) {
+        interface_full.reset(x.data(), y.data(), z.data(), h.data(), m.data(),
+                             1000);
+        interface_full.initialize();
+        grid_full.initialize(block, interface_full);
+        interface_incremental.reset(x.data(), y.data(), z.data(), h.data(),
+                                    m.data(), 1000);
+        interface_incremental.initialize();
+        grid_incremental.initialize(block, interface_incremental);
+
+        auto it_full = grid_full.begin();
+        auto it_incremental = grid_incremental.begin();
+        for (; it_full != grid_full.end(); ++it_full, ++it_incremental) {
+          assert_values_equal_rel(
+              it_full.get_ionization_variables().get_number_density(),
+              it_incremental.get_ionization_variables().get_number_density(),
+              1.e-10);
+          const double xH = it_full.get_cell_midpoint().x();
+          it_full.get_ionization_variables().set_ionic_fraction(ION_H_n, xH);
+          it_incremental.get_ionization_variables().set_ionic_fraction(ION_H_n,
+                                                                       xH);
+        }
+
+        interface_full.write(grid_full, istep, params, 0.);
+        interface_incremental.write(grid_incremental, istep, params, 0.);
+        std::vector< double > neutral_fractions_full(1000, -1.);
+        std::vector< double > neutral_fractions_incremental(1000, -1.);
+        interface_full.fill_array(neutral_fractions_full.data());
+        interface_incremental.fill_array(neutral_fractions_incremental.data());
+        for (size_t i = 0; i < 1000; ++i) {
+          assert_values_equal_rel(neutral_fractions_full[i],
+                                  neutral_fractions_incremental[i], 1.e-10);
+        }
+
+        // move some of the particles
+        for (size_t i = 2; i < 1000; i += 10) {
+          x[i] = 0.1 + 0.8 * Utilities::random_double();
+          h[i] = 0.15 + 0.1 * Utilities::random_double();
+        }
+      }
+    }
+  }
+
   return 0;
 }
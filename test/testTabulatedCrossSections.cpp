@@ -0,0 +1,220 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testTabulatedCrossSections.cpp
+ *
+ * @brief Unit test for the TabulatedCrossSections class and the bulk cross
+ * section API of PhotonBuffer.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "Assert.hpp"
+#include "PhotonBuffer.hpp"
+#include "RandomGenerator.hpp"
+#include "TabulatedCrossSections.hpp"
+#include "VernerCrossSections.hpp"
+
+/**
+ * @brief Unit test for the TabulatedCrossSections class and the bulk cross
+ * section API of PhotonBuffer.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  VernerCrossSections verner;
+  TabulatedCrossSections tabulated(new VernerCrossSections());
+
+  /// discontinuities
+  {
+    // all ionization thresholds in the range of the table are detected, but
+    // they only affect a small number of bins
+    const uint_fast32_t number_of_exact_bins =
+        tabulated.get_number_of_exact_bins();
+    assert_condition(number_of_exact_bins > 0);
+    assert_condition(number_of_exact_bins < 4 * NUMBER_OF_IONNAMES);
+
+    // the hydrogen threshold is reproduced exactly
+    const double nu_H = 3.288465385e15;
+    assert_condition(tabulated.get_cross_section(ION_H_n, 0.999 * nu_H) ==
+                     0.);
+    assert_condition(tabulated.get_cross_section(ION_H_n, nu_H) ==
+                     verner.get_cross_section(ION_H_n, nu_H));
+  }
+
+  /// interpolation, inside and outside the range of the table
+  {
+    RandomGenerator random_generator(42);
+    double sigma[NUMBER_OF_IONNAMES];
+    for (uint_fast32_t i = 0; i < 100000; ++i) {
+      const double frequency =
+          3.e15 + 1.2e16 * random_generator.get_uniform_random_double();
+      tabulated.get_cross_sections(frequency, sigma);
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        const double sigma_verner = verner.get_cross_section(ion, frequency);
+        const double sigma_tabulated =
+            tabulated.get_cross_section(ion, frequency);
+        assert_values_equal_rel(sigma_tabulated, sigma_verner, 1.e-4);
+        assert_condition(sigma[ion] == sigma_tabulated);
+      }
+    }
+  }
+
+  /// exact values for discrete frequencies
+  {
+    // frequencies are added in arbitrary order, and the same frequency can be
+    // added more than once
+    const double frequencies[4] = {4.123456789e15, 9.87654321e15, 2.e15,
+                                   4.123456789e15};
+    for (uint_fast8_t i = 0; i < 4; ++i) {
+      tabulated.add_discrete_frequency(frequencies[i]);
+    }
+    for (uint_fast8_t i = 0; i < 4; ++i) {
+      const double frequency = frequencies[i];
+      double sigma[NUMBER_OF_IONNAMES];
+      tabulated.get_cross_sections(frequency, sigma);
+      // discrete frequencies have their own table position
+      uint_least16_t bin;
+      float weight;
+      tabulated.get_table_position(frequency, bin, weight);
+      assert_condition(bin >= TABULATEDCROSSSECTIONS_DEFAULT_SIZE);
+      assert_condition(bin != TABULATEDCROSSSECTIONS_EXACT_BIN);
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        const double sigma_verner = verner.get_cross_section(ion, frequency);
+        assert_condition(tabulated.get_cross_section(ion, frequency) ==
+                         sigma_verner);
+        assert_condition(sigma[ion] == sigma_verner);
+        assert_condition(tabulated.get_cross_section(ion, frequency, bin,
+                                                     weight) == sigma_verner);
+      }
+    }
+  }
+
+  /// table positions, as used by compact photon packets
+  {
+    const TabulatedCrossSections table(new VernerCrossSections(), 1000, 3.e15,
+                                       1.4e16);
+    for (uint_fast32_t i = 0; i < 1000; ++i) {
+      // bin centres: linear interpolation, unless the bin contains a
+      // discontinuity
+      const double frequency = 3.e15 + (i + 0.5) * 1.1e13;
+      uint_least16_t bin;
+      float weight;
+      table.get_table_position(frequency, bin, weight);
+      if (bin != TABULATEDCROSSSECTIONS_EXACT_BIN) {
+        assert_condition(bin == i);
+        assert_values_equal_rel(weight, 0.5, 1.e-6);
+      }
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        assert_values_equal_rel(
+            table.get_cross_section(ion, frequency, bin, weight),
+            table.get_cross_section(ion, frequency), 1.e-6);
+      }
+    }
+
+    // the hydrogen threshold is evaluated exactly
+    const double nu_H = 3.288465385e15;
+    uint_least16_t bin;
+    float weight;
+    table.get_table_position(nu_H, bin, weight);
+    assert_condition(bin == TABULATEDCROSSSECTIONS_EXACT_BIN);
+    assert_condition(table.get_cross_section(ION_H_n, nu_H, bin, weight) ==
+                     verner.get_cross_section(ION_H_n, nu_H));
+
+    // frequencies outside the range of the table are not clamped, but are
+    // evaluated exactly
+    const double frequencies[2] = {2.e15, 2.e16};
+    for (uint_fast8_t i = 0; i < 2; ++i) {
+      table.get_table_position(frequencies[i], bin, weight);
+      assert_condition(bin == TABULATEDCROSSSECTIONS_EXACT_BIN);
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        assert_condition(
+            table.get_cross_section(ion, frequencies[i], bin, weight) ==
+            verner.get_cross_section(ion, frequencies[i]));
+      }
+    }
+  }
+
+#ifdef USE_COMPACT_PHOTON_PACKET
+  /// compact photon packets
+  {
+    const Abundances abundances(0.1, 2.2e-4, 4.e-5, 3.3e-4, 5.e-5, 9.e-6);
+    PhotonPacket::set_cross_section_table(&tabulated, abundances);
+    RandomGenerator random_generator(42);
+    for (uint_fast32_t i = 0; i < 1000; ++i) {
+      const double frequency =
+          3.2e15 + 1.e16 * random_generator.get_uniform_random_double();
+      PhotonPacket photon;
+      photon.set_energy(frequency);
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        double sigma = tabulated.get_cross_section(ion, frequency);
+#ifndef VARIABLE_ABUNDANCES
+        if (ion != ION_H_n) {
+          sigma *= abundances.get_abundance(get_element(ion));
+        }
+#endif
+        assert_values_equal_rel(photon.get_photoionization_cross_section(ion),
+                                sigma, 1.e-6);
+      }
+    }
+  }
+#endif
+
+  /// bulk API for a PhotonBuffer
+#ifndef USE_COMPACT_PHOTON_PACKET
+  {
+    const Abundances abundances(0.1, 2.2e-4, 4.e-5, 3.3e-4, 5.e-5, 9.e-6);
+    RandomGenerator random_generator(42);
+    PhotonBuffer buffer;
+    for (uint_fast32_t i = 0; i < PHOTONBUFFER_SIZE; ++i) {
+      const uint_fast32_t index = buffer.get_next_free_photon();
+      buffer[index].set_energy(
+          3.2e15 + 1.e16 * random_generator.get_uniform_random_double());
+    }
+    buffer.set_photoionization_cross_sections(tabulated, abundances);
+    for (uint_fast32_t i = 0; i < buffer.size(); ++i) {
+      const double frequency = buffer[i].get_energy();
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        double sigma = tabulated.get_cross_section(ion, frequency);
+#ifndef VARIABLE_ABUNDANCES
+        if (ion != ION_H_n) {
+          sigma *= abundances.get_abundance(get_element(ion));
+        }
+#endif
+        assert_condition(buffer[i].get_photoionization_cross_section(ion) ==
+                         sigma);
+      }
+    }
+
+    // only photons from the given index onwards are updated
+    const double old_sigma = buffer[0].get_photoionization_cross_section(0);
+    buffer[0].set_energy(1.e16);
+    buffer[1].set_energy(1.e16);
+    buffer.set_photoionization_cross_sections(tabulated, abundances, 1);
+    assert_condition(buffer[0].get_photoionization_cross_section(0) ==
+                     old_sigma);
+    assert_condition(buffer[1].get_photoionization_cross_section(ION_H_n) ==
+                     tabulated.get_cross_section(ION_H_n, 1.e16));
+  }
+#endif
+
+  return 0;
+}
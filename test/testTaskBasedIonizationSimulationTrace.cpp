@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testTaskBasedIonizationSimulationTrace.cpp
+ *
+ * @brief Unit test for the task trace output of the
+ * TaskBasedIonizationSimulation library.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+
+#include "Assert.hpp"
+#include "TaskBasedIonizationSimulation.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+/**
+ * @brief Unit test for the task trace output of the
+ * TaskBasedIonizationSimulation library.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  // make sure we do not check trace files left behind by an earlier run
+  std::remove("task_trace_00.json");
+  std::remove("task_trace_01.json");
+
+  TaskBasedIonizationSimulation simulation(
+      1, "test_taskbasedionizationsimulation_trace.param");
+  simulation.initialize(nullptr);
+  simulation.run(nullptr);
+
+  // a Chrome trace is written for every iteration, and contains events
+  for (uint_fast32_t iloop = 0; iloop < 2; ++iloop) {
+    std::stringstream filename;
+    filename << "task_trace_0" << iloop << ".json";
+    std::ifstream ifile(filename.str());
+    assert_condition(ifile.good());
+    std::string line;
+    uint_fast32_t number_of_events = 0;
+    while (std::getline(ifile, line)) {
+      if (line.find("\"photon traversal\"") != std::string::npos) {
+        ++number_of_events;
+      }
+    }
+    assert_condition(number_of_events > 0);
+  }
+
+  return 0;
+}
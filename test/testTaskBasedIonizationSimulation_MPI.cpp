@@ -0,0 +1,105 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testTaskBasedIonizationSimulation_MPI.cpp
+ *
+ * @brief Unit test for the distributed memory version of the
+ * TaskBasedIonizationSimulation.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "Assert.hpp"
+#include "MPICommunicator.hpp"
+#include "TaskBasedIonizationSimulation.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+/**
+ * @brief Unit test for the distributed memory version of the
+ * TaskBasedIonizationSimulation.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  MPICommunicator comm(argc, argv);
+
+  // make sure we have at least 2 processes
+  assert_condition(comm.get_size() > 1);
+
+  {
+    TaskBasedIonizationSimulation simulation(
+        2, "test_taskbasedionizationsimulation_mpi.param", false, false,
+        &comm);
+    simulation.initialize(nullptr);
+    simulation.run(nullptr);
+  }
+
+  // every process wrote its own part of the grid
+  std::stringstream filename;
+  filename << "test_taskbasedionizationsimulation_mpi_rank";
+  filename.fill('0');
+  filename.width(3);
+  filename << comm.get_rank();
+  filename << "_010.txt";
+  std::ifstream file(filename.str());
+  assert_condition(file.good());
+
+  std::string line;
+  std::getline(file, line);
+  uint_fast32_t number_of_cells = 0;
+  double total_volume = 0.;
+  double ionized_volume = 0.;
+  while (std::getline(file, line)) {
+    std::istringstream linestream(line);
+    double x, y, z, n, volume, xH;
+    linestream >> x >> y >> z >> n >> volume >> xH;
+    ++number_of_cells;
+    total_volume += volume;
+    if (xH < 0.5) {
+      ionized_volume += volume;
+    }
+  }
+  comm.reduce< MPI_SUM_OF_ALL_PROCESSES >(number_of_cells);
+  comm.reduce< MPI_SUM_OF_ALL_PROCESSES >(total_volume);
+  comm.reduce< MPI_SUM_OF_ALL_PROCESSES >(ionized_volume);
+
+  // all cells are present exactly once
+  assert_condition(number_of_cells == 16 * 16 * 16);
+
+  // the ionized region matches the Stromgren sphere for a source with
+  // luminosity Q = 4.26e49 s^-1 in a medium with density n = 100 cm^-3 and
+  // recombination rate alpha = 4.e-13 cm^3 s^-1 (the tolerance accounts for
+  // the coarse resolution of the grid, which overestimates the volume)
+  const double Q = 4.26e49;
+  const double n = 1.e8;
+  const double alpha = 4.e-19;
+  const double stromgren_volume = Q / (n * n * alpha);
+  const double ionized_fraction = ionized_volume / total_volume;
+  const double stromgren_fraction = stromgren_volume / total_volume;
+  cmac_status("Ionized volume fraction: %g (Stromgren: %g)", ionized_fraction,
+              stromgren_fraction);
+  assert_values_equal_rel(ionized_fraction, stromgren_fraction, 0.15);
+
+  return 0;
+}
@@ -0,0 +1,136 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testTaskTrace.cpp
+ *
+ * @brief Unit test for the TaskTrace class.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "Assert.hpp"
+#include "TaskTrace.hpp"
+
+#include <fstream>
+
+/**
+ * @brief Unit test for the TaskTrace class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  // a buffer size of 3 is rounded up to 4, and only every second task is
+  // sampled
+  TaskTrace trace(2, 3, 0.5);
+
+  uint_fast32_t number_sampled = 0;
+  for (uint_fast32_t i = 0; i < 20; ++i) {
+    Task task;
+    task.set_type(TASKTYPE_PHOTON_TRAVERSAL);
+    task.set_subgrid(i);
+    task.start(0);
+    task.stop();
+    if (trace.sample(0)) {
+      ++number_sampled;
+      // alternate between the own queue, another thread's queue and the
+      // shared queue
+      trace.record(0, task, (i % 3 == 0) ? 0 : ((i % 3 == 1) ? 1 : -1), i);
+    }
+  }
+  assert_condition(number_sampled == 10);
+  assert_condition(trace.get_number_of_records(0) == 4);
+  assert_condition(trace.get_number_of_records(1) == 0);
+
+  // the ring buffer only contains the 4 most recent sampled tasks, from
+  // oldest to newest
+  for (uint_fast32_t i = 0; i < 4; ++i) {
+    const TaskTraceRecord &record = trace.get_record(0, i);
+    const uint_fast32_t index = 12 + 2 * i;
+    assert_condition(record._subgrid == index);
+    assert_condition(record._number_of_photons == index);
+    assert_condition(record._type == TASKTYPE_PHOTON_TRAVERSAL);
+    assert_condition(record._end >= record._start);
+    if (index % 3 == 1) {
+      assert_condition(record._queue == 1);
+      assert_condition(record._flags & TASKTRACE_FLAG_STOLEN);
+    } else {
+      assert_condition(!(record._flags & TASKTRACE_FLAG_STOLEN));
+    }
+  }
+
+  trace.write_binary("test_tasktrace.dat", 0);
+  {
+    std::ifstream ifile("test_tasktrace.dat", std::ios::binary);
+    uint32_t version, number_of_threads;
+    int32_t rank;
+    uint64_t reset_cycle, number_of_records;
+    double cycles_per_microsecond;
+    ifile.read(reinterpret_cast< char * >(&version), sizeof(version));
+    ifile.read(reinterpret_cast< char * >(&rank), sizeof(rank));
+    ifile.read(reinterpret_cast< char * >(&number_of_threads),
+               sizeof(number_of_threads));
+    ifile.read(reinterpret_cast< char * >(&reset_cycle), sizeof(reset_cycle));
+    ifile.read(reinterpret_cast< char * >(&cycles_per_microsecond),
+               sizeof(cycles_per_microsecond));
+    ifile.read(reinterpret_cast< char * >(&number_of_records),
+               sizeof(number_of_records));
+    assert_condition(version == TASKTRACE_FILE_VERSION);
+    assert_condition(rank == 0);
+    assert_condition(number_of_threads == 2);
+    assert_condition(number_of_records == 4);
+    TaskTraceRecord record;
+    ifile.read(reinterpret_cast< char * >(&record), sizeof(record));
+    assert_condition(record._subgrid == 12);
+  }
+
+  trace.write_chrome_trace("test_tasktrace.json", 0);
+  {
+    std::ifstream ifile("test_tasktrace.json");
+    std::string line;
+    uint_fast32_t number_of_events = 0;
+    while (std::getline(ifile, line)) {
+      if (line.find("\"photon traversal\"") != std::string::npos) {
+        ++number_of_events;
+      }
+    }
+    assert_condition(number_of_events == 4);
+  }
+
+  // queues with an index of 128 or more (on nodes with many cores) are stored
+  // without overflow
+  {
+    Task task;
+    task.set_type(TASKTYPE_PHOTON_TRAVERSAL);
+    task.set_subgrid(0);
+    task.start(1);
+    task.stop();
+    assert_condition(trace.sample(1));
+    trace.record(1, task, 200, 0);
+    const TaskTraceRecord &record = trace.get_record(1, 0);
+    assert_condition(record._queue == 200);
+    assert_condition(record._flags & TASKTRACE_FLAG_STOLEN);
+  }
+
+  trace.reset();
+  assert_condition(trace.get_number_of_records(0) == 0);
+
+  return 0;
+}
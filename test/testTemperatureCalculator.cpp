@@ -80,7 +80,12 @@ int main(int argc, char **argv) {
     ChargeTransferRates ctr;
     Abundances abundances(0.1, 2.2e-4, 4.e-5, 3.3e-4, 5.e-5, 9.e-6);
     TemperatureCalculator calculator(true, 3, 1., abundances, 1.e-3, 100, 1.,
-                                     0., 1., 0., 4000., data, rates, ctr);
+                                     0., 1., 0., 4000., false, data, rates,
+                                     ctr);
+    // calculator that uses tabulated rates
+    TemperatureCalculator tabulated_calculator(true, 3, 1., abundances, 1.e-3,
+                                               100, 1., 0., 1., 0., 4000.,
+                                               true, data, rates, ctr);
 
     HomogeneousDensityFunction function(1.);
     function.initialize();
@@ -130,6 +135,35 @@ int main(int argc, char **argv) {
             UnitConverter::to_SI< QUANTITY_NUMBER_DENSITY >(n, "cm^-3"));
         ionization_variables.set_temperature(T);
 
+        // the batched version should give exactly the same result as the
+        // single temperature version, and leave the ionization variables in
+        // the state that corresponds to the last temperature
+        const double Tbatch[3] = {1.1 * T, 0.9 * T, T};
+        double h0batch[3], he0batch[3], gainbatch[3], lossbatch[3];
+        TemperatureCalculator::compute_cooling_and_heating_balance(
+            3, Tbatch, h0batch, he0batch, gainbatch, lossbatch,
+            ionization_variables, cell.get_cell_midpoint(), j, abundances, h,
+            1., 0., 0.75, data, rates, ctr);
+        const double Cp1batch =
+            ionization_variables.get_ionic_fraction(ION_C_p1);
+        const double Sp3batch =
+            ionization_variables.get_ionic_fraction(ION_S_p3);
+        for (uint_fast8_t i = 0; i < 3; ++i) {
+          double gaini, lossi, h0i, he0i;
+          TemperatureCalculator::compute_cooling_and_heating_balance(
+              h0i, he0i, gaini, lossi, Tbatch[i], ionization_variables,
+              cell.get_cell_midpoint(), j, abundances, h, 1., 0., 0.75, data,
+              rates, ctr);
+          assert_condition(h0i == h0batch[i]);
+          assert_condition(he0i == he0batch[i]);
+          assert_condition(gaini == gainbatch[i]);
+          assert_condition(lossi == lossbatch[i]);
+        }
+        assert_condition(ionization_variables.get_ionic_fraction(ION_C_p1) ==
+                         Cp1batch);
+        assert_condition(ionization_variables.get_ionic_fraction(ION_S_p3) ==
+                         Sp3batch);
+
         double gain, loss, h0, he0;
         TemperatureCalculator::compute_cooling_and_heating_balance(
             h0, he0, gain, loss, T, ionization_variables,
@@ -262,9 +296,23 @@ int main(int argc, char **argv) {
             UnitConverter::to_SI< QUANTITY_NUMBER_DENSITY >(ntot, "cm^-3"));
         ionization_variables.set_temperature(T);
 
-        // calculate the ionization state of the cell
+        // calculate the ionization state of the cell, using both the exact and
+        // the tabulated rates
+        IonizationVariables tabulated_ionization_variables(
+            ionization_variables);
         calculator.calculate_temperature(ionization_variables, 1., 1.,
                                          cell.get_cell_midpoint());
+        tabulated_calculator.calculate_temperature(
+            tabulated_ionization_variables, 1., 1., cell.get_cell_midpoint());
+        assert_values_equal_rel(
+            tabulated_ionization_variables.get_temperature(),
+            ionization_variables.get_temperature(), 1.e-3);
+        assert_values_equal_rel(
+            tabulated_ionization_variables.get_ionic_fraction(ION_H_n),
+            ionization_variables.get_ionic_fraction(ION_H_n), 1.e-3);
+        assert_values_equal_rel(
+            tabulated_ionization_variables.get_ionic_fraction(ION_O_p1),
+            ionization_variables.get_ionic_fraction(ION_O_p1), 1.e-3);
 
         h0 = ionization_variables.get_ionic_fraction(ION_H_n);
 
@@ -330,8 +378,8 @@ int main(int argc, char **argv) {
     ChargeTransferRates ctr;
     Abundances abundances(0.1, 2.2e-4, 4.e-5, 3.3e-4, 5.e-5, 9.e-6);
     TemperatureCalculator calculator(true, 3, 1., abundances, 1.e-3, 100, 1.,
-                                     1., 0.75, 4.11e19, 4000., data, rates,
-                                     ctr);
+                                     1., 0.75, 4.11e19, 4000., false, data,
+                                     rates, ctr);
 
     DiscDensityFunction function;
     function.initialize();
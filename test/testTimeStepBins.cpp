@@ -0,0 +1,135 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testTimeStepBins.cpp
+ *
+ * @brief Unit test for the TimeStepBins class.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "Assert.hpp"
+#include "TimeLine.hpp"
+#include "TimeStepBins.hpp"
+
+/**
+ * @brief Unit test for the TimeStepBins class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  /// no local time stepping
+  {
+    TimeStepBins bins(3, 0);
+    std::vector< double > requested_timesteps(3);
+    requested_timesteps[0] = 0.1;
+    requested_timesteps[1] = 0.01;
+    requested_timesteps[2] = 0.5;
+    assert_condition(bins.get_system_timestep_request(requested_timesteps) ==
+                     0.01);
+    bins.set_levels(requested_timesteps, 0.0078125);
+    assert_condition(bins.get_number_of_substeps() == 1);
+    for (uint_fast32_t i = 0; i < 3; ++i) {
+      assert_condition(bins.get_level(i) == 0);
+      assert_condition(bins.get_timestep(i, 0.0078125) == 0.0078125);
+      assert_condition(bins.is_starting(i, 0));
+      assert_condition(bins.is_ending(i, 0));
+    }
+  }
+
+  /// local time stepping
+  {
+    TimeStepBins bins(4, 3);
+    std::vector< double > requested_timesteps(4);
+    requested_timesteps[0] = 0.1;
+    requested_timesteps[1] = 0.02;
+    requested_timesteps[2] = 0.5;
+    requested_timesteps[3] = 0.05;
+
+    // the system time step is set by the largest requested time step, but
+    // cannot be more than 2^3 times the smallest requested time step
+    assert_condition(bins.get_system_timestep_request(requested_timesteps) ==
+                     0.16);
+
+    TimeLine timeline(0., 1., 0.001, 0.2);
+    double actual_timestep, current_time;
+    timeline.advance(bins.get_system_timestep_request(requested_timesteps),
+                     actual_timestep, current_time);
+    assert_condition(actual_timestep == 0.125);
+
+    bins.set_levels(requested_timesteps, actual_timestep);
+    assert_condition(bins.get_level(0) == 1);
+    assert_condition(bins.get_level(1) == 3);
+    assert_condition(bins.get_level(2) == 0);
+    assert_condition(bins.get_level(3) == 2);
+    assert_condition(bins.get_number_of_substeps() == 8);
+    for (uint_fast32_t i = 0; i < 4; ++i) {
+      assert_condition(bins.get_timestep(i, actual_timestep) <=
+                       requested_timesteps[i]);
+    }
+
+    // every element covers the system time step exactly once, and the time
+    // steps of elements on different levels are nested
+    for (uint_fast32_t i = 0; i < 4; ++i) {
+      uint_fast32_t number_of_starts = 0;
+      uint_fast32_t number_of_ends = 0;
+      bool in_step = false;
+      for (uint_fast32_t substep = 0; substep < 8; ++substep) {
+        if (bins.is_starting(i, substep)) {
+          assert_condition(!in_step);
+          in_step = true;
+          ++number_of_starts;
+          // all elements on a higher level start at the same time
+          for (uint_fast32_t j = 0; j < 4; ++j) {
+            if (bins.get_level(j) > bins.get_level(i)) {
+              assert_condition(bins.is_starting(j, substep));
+            }
+          }
+        }
+        assert_condition(in_step);
+        if (bins.is_ending(i, substep)) {
+          in_step = false;
+          ++number_of_ends;
+        }
+      }
+      assert_condition(!in_step);
+      assert_condition(number_of_starts ==
+                       (static_cast< uint_fast32_t >(1) << bins.get_level(i)));
+      assert_condition(number_of_ends == number_of_starts);
+    }
+  }
+
+  /// the smallest time step is limited by the maximum level
+  {
+    TimeStepBins bins(2, 2);
+    std::vector< double > requested_timesteps(2);
+    requested_timesteps[0] = 1.;
+    requested_timesteps[1] = 0.01;
+    assert_condition(bins.get_system_timestep_request(requested_timesteps) ==
+                     0.04);
+    bins.set_levels(requested_timesteps, 0.03125);
+    assert_condition(bins.get_level(0) == 0);
+    assert_condition(bins.get_level(1) == 2);
+    assert_condition(bins.get_timestep(1, 0.03125) <= 0.01);
+  }
+
+  return 0;
+}
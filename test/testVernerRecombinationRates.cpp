@@ -24,6 +24,7 @@
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
 #include "Assert.hpp"
+#include "TabulatedRecombinationRates.hpp"
 #include "UnitConverter.hpp"
 #include "VernerRecombinationRates.hpp"
 #include <fstream>
@@ -40,6 +41,8 @@
 int main(int argc, char **argv) {
 
   VernerRecombinationRates recombination_rates;
+  TabulatedRecombinationRates tabulated_recombination_rates(
+      recombination_rates);
 
   std::ifstream file("verner_rec_testdata.txt");
   std::string line;
@@ -57,6 +60,13 @@ int main(int argc, char **argv) {
 
       double tolerance = 1.e-15;
 
+      // the tabulated rates should be close to the exact rates
+      for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+        assert_values_equal_rel(
+            tabulated_recombination_rates.get_recombination_rate(ion, T),
+            recombination_rates.get_recombination_rate(ion, T), 1.e-5);
+      }
+
       assert_values_equal_rel(
           UnitConverter::to_unit< QUANTITY_REACTION_RATE >(
               recombination_rates.get_recombination_rate(ION_H_n, T),
@@ -73,5 +73,43 @@ int main(int argc, char **argv) {
     assert_values_equal(2000., grid.get_average_temperature());
   }
 
+  /// photon traversal
+  {
+    HomogeneousDensityFunction density_function(1., 2000., 1.);
+    density_function.initialize();
+    Box<> box(CoordinateVector<>(0.), CoordinateVector<>(1.));
+    UniformRandomVoronoiGeneratorDistribution *test_positions =
+        new UniformRandomVoronoiGeneratorDistribution(box, 1000, 42);
+    VoronoiDensityGrid grid(test_positions, box, "Old", 0, false, false, false,
+                            nullptr);
+    std::pair< cellsize_t, cellsize_t > block =
+        std::make_pair(0, grid.get_number_of_cells());
+    grid.initialize(block, density_function);
+
+    const CoordinateVector<> photon_origin(0.5, 0.4, 0.3);
+    const CoordinateVector<> photon_direction(1., 0., 0.);
+    Photon photon(photon_origin, photon_direction, 1.);
+    photon.set_cross_section(ION_H_n, 1.);
+#ifdef HAS_HELIUM
+    photon.set_cross_section(ION_He_n, 0.);
+#endif
+
+    // the optical depth up to the wall is simply the distance to the wall
+    assert_values_equal_rel(grid.integrate_optical_depth(photon), 0.5, 1.e-10);
+
+    // a photon with a smaller optical depth stops inside the grid, in the cell
+    // that contains its new position
+    DensityGrid::iterator inside = grid.interact(photon, 0.25);
+    assert_condition(inside != grid.end());
+    assert_values_equal_rel(photon.get_position().x(), 0.75, 1.e-10);
+    assert_condition(inside.get_index() ==
+                     grid.get_cell_index(photon.get_position()));
+
+    // a photon with a larger optical depth leaves the grid
+    DensityGrid::iterator outside = grid.interact(photon, 1.);
+    assert_condition(outside == grid.end());
+    assert_values_equal_rel(photon.get_position().x(), 1., 1.e-10);
+  }
+
   return 0;
 }
@@ -0,0 +1,128 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file testWorkStealingDeque.cpp
+ *
+ * @brief Unit test for the WorkStealingDeque class.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+
+/*! @brief Number of elements used during the test. */
+#define TESTWORKSTEALINGDEQUE_NELEMENT 100000
+
+#include "Assert.hpp"
+#include "WorkStealingDeque.hpp"
+
+#include <omp.h>
+#include <vector>
+
+/**
+ * @brief Unit test for the WorkStealingDeque class.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  /// serial test: owner operations are LIFO, steals are FIFO
+  {
+    WorkStealingDeque deque(10);
+    size_t element;
+    assert_condition(!deque.pop(element));
+    assert_condition(!deque.steal(element));
+    for (size_t i = 0; i < 10; ++i) {
+      deque.push(i);
+    }
+    assert_condition(deque.size() == 10);
+    assert_condition(deque.pop(element));
+    assert_condition(element == 9);
+    assert_condition(deque.steal(element));
+    assert_condition(element == 0);
+    assert_condition(deque.size() == 8);
+    // the deque wraps around
+    deque.push(10);
+    deque.push(11);
+    assert_condition(deque.size() == 10);
+    for (size_t i = 0; i < 5; ++i) {
+      assert_condition(deque.steal(element));
+      assert_condition(element == i + 1);
+    }
+    const size_t remaining[5] = {11, 10, 8, 7, 6};
+    for (size_t i = 0; i < 5; ++i) {
+      assert_condition(deque.pop(element));
+      assert_condition(element == remaining[i]);
+    }
+    assert_condition(!deque.pop(element));
+    assert_condition(deque.size() == 0);
+  }
+
+  /// parallel test: thread 0 owns the deque and pushes and pops elements,
+  /// while all other threads steal elements. Every element should be taken
+  /// exactly once.
+  omp_set_num_threads(8);
+  for (uint_fast32_t iloop = 0; iloop < 10; ++iloop) {
+
+    WorkStealingDeque deque(TESTWORKSTEALINGDEQUE_NELEMENT);
+    std::vector< uint_fast32_t > counts(TESTWORKSTEALINGDEQUE_NELEMENT, 0);
+    size_t number_done = 0;
+
+#pragma omp parallel default(shared)
+    {
+      size_t element;
+      if (omp_get_thread_num() == 0) {
+        for (size_t i = 0; i < TESTWORKSTEALINGDEQUE_NELEMENT; ++i) {
+          deque.push(i);
+          // pop every third element ourselves
+          if (i % 3 == 0 && deque.pop(element)) {
+#pragma omp atomic
+            ++counts[element];
+#pragma omp atomic
+            ++number_done;
+          }
+        }
+        while (deque.pop(element)) {
+#pragma omp atomic
+          ++counts[element];
+#pragma omp atomic
+          ++number_done;
+        }
+      } else {
+        size_t this_number_done;
+        do {
+          if (deque.steal(element)) {
+#pragma omp atomic
+            ++counts[element];
+#pragma omp atomic
+            ++number_done;
+          }
+#pragma omp atomic read
+          this_number_done = number_done;
+        } while (this_number_done < TESTWORKSTEALINGDEQUE_NELEMENT);
+      }
+    }
+
+    for (size_t i = 0; i < TESTWORKSTEALINGDEQUE_NELEMENT; ++i) {
+      assert_condition(counts[i] == 1);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,159 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file TimingBenchmark.hpp
+ *
+ * @brief Shared benchmark code for the timing tests: a result sink that keeps
+ * the compiler from optimising timed code away, and a task execution loop for
+ * Scheduler based benchmarks.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#ifndef TIMINGBENCHMARK_HPP
+#define TIMINGBENCHMARK_HPP
+
+#include "OpenMP.hpp"
+#include "Scheduler.hpp"
+#include "TimingTools.hpp"
+
+#include <vector>
+
+/*! @brief Sink for values that depend on the result of timed code. The value
+ *  is printed at the end of the timing test, so that the compiler cannot
+ *  optimise the timed code away. */
+static double timingbenchmark_sink = 0.;
+
+/**
+ * @brief Add a value that depends on the result of timed code to the sink.
+ *
+ * @param value Value to add.
+ */
+inline void timingbenchmark_consume(const double value) {
+  timingbenchmark_sink += value;
+}
+
+/**
+ * @brief Print the value of the sink. Should be called at the end of the
+ * timing test.
+ */
+#define timingbenchmark_print_sink()                                           \
+  timingtools_print("(dummy result: %g)", timingbenchmark_sink)
+
+/**
+ * @brief Tasks and task queues for a Scheduler based benchmark, and the loop
+ * that executes all tasks.
+ */
+class TaskBenchmark {
+private:
+  /*! @brief Tasks. */
+  ThreadSafeVector< Task > _tasks;
+
+  /*! @brief Per thread task queues. */
+  std::vector< TaskQueue * > _queues;
+
+  /*! @brief Shared task queue. */
+  TaskQueue _shared_queue;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param number_of_threads Number of threads to use.
+   * @param number_of_tasks Maximum number of tasks that exist at the same
+   * time.
+   */
+  inline TaskBenchmark(const int_fast32_t number_of_threads,
+                       const size_t number_of_tasks)
+      : _tasks(number_of_tasks, "Tasks"), _queues(number_of_threads),
+        _shared_queue(number_of_tasks, "Shared queue") {
+    for (int_fast32_t ithread = 0; ithread < number_of_threads; ++ithread) {
+      _queues[ithread] = new TaskQueue(number_of_tasks, "Queue", ithread);
+    }
+  }
+
+  /**
+   * @brief Destructor.
+   */
+  inline ~TaskBenchmark() {
+    for (size_t ithread = 0; ithread < _queues.size(); ++ithread) {
+      delete _queues[ithread];
+    }
+  }
+
+  /**
+   * @brief Access the tasks.
+   *
+   * @return Tasks.
+   */
+  inline ThreadSafeVector< Task > &get_tasks() { return _tasks; }
+
+  /**
+   * @brief Access the per thread task queues.
+   *
+   * @return Per thread task queues.
+   */
+  inline std::vector< TaskQueue * > &get_queues() { return _queues; }
+
+  /**
+   * @brief Access the shared task queue.
+   *
+   * @return Shared task queue.
+   */
+  inline TaskQueue &get_shared_queue() { return _shared_queue; }
+
+  /**
+   * @brief Execute tasks with the given Scheduler until the given number of
+   * tasks is done.
+   *
+   * The execute function is called as execute(thread_id, task) and returns a
+   * value that depends on the result of the task, which is added to the sink.
+   * It can create new tasks. After it returns, the task dependency is
+   * unlocked and the task is freed.
+   *
+   * @param scheduler Scheduler that hands out the tasks.
+   * @param number_of_tasks Total number of tasks to execute.
+   * @param execute Function that executes a single task.
+   */
+  template < typename _function_ >
+  inline void run(Scheduler &scheduler, const size_t number_of_tasks,
+                  _function_ execute) {
+
+    AtomicValue< size_t > number_done(0);
+    double result = 0.;
+#ifdef HAVE_OPENMP
+#pragma omp parallel default(shared) reduction(+ : result)
+#endif
+    {
+      const int_fast8_t thread_id = get_thread_index();
+      while (number_done.value() < number_of_tasks) {
+        const uint_fast32_t current_index = scheduler.get_task(thread_id);
+        if (current_index != NO_TASK) {
+          Task &task = _tasks[current_index];
+          result += execute(thread_id, task);
+          task.unlock_dependency();
+          _tasks.free_element(current_index);
+          number_done.pre_increment();
+        }
+      }
+    }
+    timingbenchmark_consume(result);
+  }
+};
+
+#endif // TIMINGBENCHMARK_HPP
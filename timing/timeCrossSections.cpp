@@ -0,0 +1,121 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file timeCrossSections.cpp
+ *
+ * @brief Timing test for the computation of the photoionization cross sections
+ * of newly emitted photon packets.
+ *
+ * We fill the cross sections of a full PhotonBuffer with photons with random
+ * frequencies, using the Verner cross sections directly and using a
+ * TabulatedCrossSections table. Results are given as photons per second.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "PhotonBuffer.hpp"
+#include "RandomGenerator.hpp"
+#include "TabulatedCrossSections.hpp"
+#include "TimingBenchmark.hpp"
+#include "VernerCrossSections.hpp"
+
+/*! @brief Number of times a full buffer is filled. */
+#define TIMECROSSSECTIONS_NBUFFER 10000u
+
+/**
+ * @brief Fill the cross sections of the given buffer a number of times.
+ *
+ * @param buffer PhotonBuffer.
+ * @param cross_sections CrossSections to use.
+ * @param abundances Abundances.
+ * @param timer Timer used to time the cross section computation.
+ */
+void fill_buffer(PhotonBuffer &buffer, const CrossSections &cross_sections,
+                 const Abundances &abundances, Timer &timer) {
+
+  double result = 0.;
+  timer.start();
+  for (uint_fast32_t i = 0; i < TIMECROSSSECTIONS_NBUFFER; ++i) {
+    buffer.set_photoionization_cross_sections(cross_sections, abundances);
+    result += buffer[i % buffer.size()].get_photoionization_cross_section(
+        i % NUMBER_OF_IONNAMES);
+  }
+  timer.stop();
+  timingbenchmark_consume(result);
+}
+
+/**
+ * @brief Timing test for the computation of the photoionization cross sections
+ * of newly emitted photon packets.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeCrossSections", argc, argv);
+
+  const Abundances abundances(0.1, 2.2e-4, 4.e-5, 3.3e-4, 5.e-5, 9.e-6);
+  VernerCrossSections verner;
+  Timer tabulation_timer;
+  tabulation_timer.start();
+  TabulatedCrossSections tabulated(new VernerCrossSections());
+  tabulation_timer.stop();
+  timingtools_print("Tabulation took %g s, %" PRIuFAST32
+                    " bins are evaluated exactly.",
+                    tabulation_timer.value(),
+                    tabulated.get_number_of_exact_bins());
+
+  RandomGenerator random_generator(42);
+  PhotonBuffer buffer;
+  for (uint_fast32_t i = 0; i < PHOTONBUFFER_SIZE; ++i) {
+    const uint_fast32_t index = buffer.get_next_free_photon();
+    buffer[index].set_energy(
+        3.288465385e15 *
+        (1. + 3. * random_generator.get_uniform_random_double()));
+  }
+
+  const double number_of_photons =
+      static_cast< double >(TIMECROSSSECTIONS_NBUFFER) * PHOTONBUFFER_SIZE;
+
+  Timer verner_timer;
+  timingtools_start_timing_block("Verner") {
+    timingtools_start_timing();
+    fill_buffer(buffer, verner, abundances, verner_timer);
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block("Verner");
+
+  Timer tabulated_timer;
+  timingtools_start_timing_block("tabulated") {
+    timingtools_start_timing();
+    fill_buffer(buffer, tabulated, abundances, tabulated_timer);
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block("tabulated");
+
+  timingtools_print("Verner: %g photons/s, tabulated: %g photons/s",
+                    timingtools_num_sample * number_of_photons /
+                        verner_timer.value(),
+                    timingtools_num_sample * number_of_photons /
+                        tabulated_timer.value());
+  timingbenchmark_print_sink();
+
+  return 0;
+}
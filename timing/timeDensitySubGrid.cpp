@@ -0,0 +1,293 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2019 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file timeDensitySubGrid.cpp
+ *
+ * @brief Timing test for photon traversal through a DensitySubGrid.
+ *
+ * This file is compiled twice: once with the default cell layout
+ * (timeDensitySubGridAoS) and once with the structure-of-arrays layout
+ * (timeDensitySubGridSoA), so that the photon throughput of both layouts can
+ * be compared. For both layouts, we compare the scalar traversal
+ * (DensitySubGrid::interact()) with the batched traversal
+ * (DensitySubGrid::interact_batch()). Configure with ACTIVATE_ARCH_NATIVE to
+ * get the lane width that matches the vector registers of the machine.
+ *
+ * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
+ */
+#include "DensitySubGrid.hpp"
+#include "PhotonBuffer.hpp"
+#include "RandomGenerator.hpp"
+#include "TimingBenchmark.hpp"
+
+#include <string>
+#include <vector>
+
+#ifdef SUBGRID_SOA
+/*! @brief Name of the cell layout that is timed. */
+#define TIMEDENSITYSUBGRID_LAYOUT "SoA"
+#else
+/*! @brief Name of the cell layout that is timed. */
+#define TIMEDENSITYSUBGRID_LAYOUT "AoS"
+#endif
+
+#ifdef USE_COMPACT_PHOTON_PACKET
+/**
+ * @brief Cross sections that only have a constant hydrogen and helium cross
+ * section.
+ *
+ * Used to give compact photon packets the same cross sections as in the
+ * default photon packet case.
+ */
+class BenchmarkCrossSections : public CrossSections {
+private:
+  /*! @brief Hydrogen photoionization cross section (in m^2). */
+  const double _sigma_H;
+
+  /*! @brief Helium photoionization cross section (in m^2). */
+  const double _sigma_He;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param sigma_H Hydrogen photoionization cross section (in m^2).
+   * @param sigma_He Helium photoionization cross section (in m^2).
+   */
+  inline BenchmarkCrossSections(const double sigma_H, const double sigma_He)
+      : _sigma_H(sigma_H), _sigma_He(sigma_He) {}
+
+  /**
+   * @brief Get the photoionization cross section for the given ion.
+   *
+   * @param ion IonName for a valid ion.
+   * @param energy Photon frequency (in Hz).
+   * @return Photoionization cross section (in m^2).
+   */
+  virtual double get_cross_section(const int_fast32_t ion,
+                                   const double energy) const {
+    if (ion == ION_H_n) {
+      return _sigma_H;
+    }
+#ifdef HAS_HELIUM
+    if (ion == ION_He_n) {
+      return _sigma_He;
+    }
+#endif
+    return 0.;
+  }
+};
+#endif
+
+/**
+ * @brief Set up a 64^3 subgrid that approximates the converged state of one of
+ * the benchmark problems, and generate photon packets that start from the
+ * central source.
+ *
+ * The grid has a homogeneous density, an (optional) central cavity, and is
+ * highly ionized within the Stromgren radius of the source.
+ *
+ * @param side Side length of the box (in m).
+ * @param number_density Number density (in m^-3).
+ * @param cavity_radius Radius of the central empty cavity (in m).
+ * @param luminosity Ionizing luminosity of the source (in s^-1).
+ * @param sigma_H Hydrogen photoionization cross section (in m^2).
+ * @param sigma_He Helium photoionization cross section (in m^2).
+ * @param number_of_photons Number of photon packets to generate.
+ * @param photons Output photon packets.
+ * @return Pointer to a newly created DensitySubGrid (memory management is
+ * transferred to the caller).
+ */
+DensitySubGrid *setup_benchmark(const double side, const double number_density,
+                                const double cavity_radius,
+                                const double luminosity, const double sigma_H,
+                                const double sigma_He,
+                                const uint_fast32_t number_of_photons,
+                                std::vector< PhotonPacket > &photons) {
+
+  const double box[6] = {-0.5 * side, -0.5 * side, -0.5 * side,
+                         side,        side,        side};
+  const CoordinateVector< int_fast32_t > ncell(64, 64, 64);
+  DensitySubGrid *grid = new DensitySubGrid(box, ncell);
+
+  // case B recombination rate for hydrogen at 10^4 K (in m^3 s^-1)
+  const double alpha_H = 2.7e-19;
+  const double stromgren_radius =
+      std::cbrt(3. * luminosity /
+                (4. * M_PI * number_density * number_density * alpha_H));
+  for (auto cellit = grid->begin(); cellit != grid->end(); ++cellit) {
+    const double r = cellit.get_cell_midpoint().norm();
+    IonizationVariables &vars = cellit.get_ionization_variables();
+    if (r < cavity_radius) {
+      vars.set_number_density(0.);
+    } else {
+      vars.set_number_density(number_density);
+    }
+    if (r < stromgren_radius) {
+      vars.set_ionic_fraction(ION_H_n, 1.e-3);
+#ifdef HAS_HELIUM
+      vars.set_ionic_fraction(ION_He_n, 1.e-2);
+#endif
+    } else {
+      vars.set_ionic_fraction(ION_H_n, 1.);
+#ifdef HAS_HELIUM
+      vars.set_ionic_fraction(ION_He_n, 1.);
+#endif
+    }
+  }
+  grid->reset_intensities();
+
+  RandomGenerator random_generator(42);
+  photons.resize(number_of_photons);
+  for (uint_fast32_t i = 0; i < number_of_photons; ++i) {
+    PhotonPacket &photon = photons[i];
+    photon.set_energy(3.288e15);
+#ifndef USE_COMPACT_PHOTON_PACKET
+    for (int_fast32_t ion = 0; ion < NUMBER_OF_IONNAMES; ++ion) {
+      photon.set_photoionization_cross_section(ion, 0.);
+    }
+    photon.set_photoionization_cross_section(ION_H_n, sigma_H);
+#ifdef HAS_HELIUM
+    photon.set_photoionization_cross_section(ION_He_n, sigma_He);
+#endif
+#endif
+
+    const double cost = 2. * random_generator.get_uniform_random_double() - 1.;
+    const double phi = 2. * M_PI * random_generator.get_uniform_random_double();
+    const double sint = std::sqrt(std::max(1. - cost * cost, 0.));
+    const CoordinateVector<> direction(sint * std::cos(phi),
+                                       sint * std::sin(phi), cost);
+
+    photon.set_position(CoordinateVector<>(0.));
+    photon.set_direction(direction);
+    photon.set_weight(1.);
+    photon.set_target_optical_depth(
+        -std::log(random_generator.get_uniform_random_double()));
+  }
+
+  return grid;
+}
+
+/**
+ * @brief Traverse all photon packets through the given subgrid.
+ *
+ * @param grid DensitySubGrid.
+ * @param photons Photon packets (changed by the traversal).
+ * @param batched Use the batched traversal?
+ */
+void traverse_photons(DensitySubGrid &grid,
+                      std::vector< PhotonPacket > &photons,
+                      const bool batched) {
+
+  int_fast32_t result = 0;
+  if (batched) {
+    // traverse the photons in chunks with the size of a photon buffer
+    int_fast32_t output_directions[PHOTONBUFFER_SIZE];
+    for (size_t i = 0; i < photons.size(); i += PHOTONBUFFER_SIZE) {
+      const uint_fast32_t size =
+          std::min< size_t >(photons.size() - i, PHOTONBUFFER_SIZE);
+      grid.interact_batch< DENSITYSUBGRID_BATCH_WIDTH >(
+          &photons[i], size, TRAVELDIRECTION_INSIDE, output_directions);
+      for (uint_fast32_t j = 0; j < size; ++j) {
+        result += output_directions[j];
+      }
+    }
+  } else {
+    for (size_t i = 0; i < photons.size(); ++i) {
+      result += grid.interact(photons[i], TRAVELDIRECTION_INSIDE);
+    }
+  }
+  grid.flush_traversal_counters();
+  timingbenchmark_consume(
+      result +
+      grid.begin().get_ionization_variables().get_mean_intensity(ION_H_n));
+}
+
+/**
+ * @brief Timing test for photon traversal through a DensitySubGrid.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeDensitySubGrid", argc, argv);
+
+  const uint_fast32_t number_of_photons = 200000;
+  const double pc = 3.086e16;
+
+  timingtools_print_header("Cell layout: %s, lane width: %i",
+                           TIMEDENSITYSUBGRID_LAYOUT,
+                           DENSITYSUBGRID_BATCH_WIDTH);
+
+  // starbench: 2.512 pc box, n = 3113 cm^-3, Q = 10^49 s^-1, monochromatic
+  // 13.6 eV source
+  // lexingtonHII40: 10 pc box, n = 100 cm^-3 with a 0.97 pc central cavity,
+  // Q = 4.26x10^49 s^-1, representative cross sections for a 40,000 K
+  // blackbody
+  const char *names[2] = {"starbench", "lexingtonHII40"};
+  const double sides[2] = {2.512 * pc, 10. * pc};
+  const double number_densities[2] = {3.113e9, 1.e8};
+  const double cavity_radii[2] = {0., 3.e16};
+  const double luminosities[2] = {1.e49, 4.26e49};
+  const double sigmas_H[2] = {6.3e-22, 3.e-22};
+  const double sigmas_He[2] = {0., 4.5e-22};
+  const char *mode_names[2] = {"scalar", "batched"};
+
+  for (uint_fast8_t ibench = 0; ibench < 2; ++ibench) {
+#ifdef USE_COMPACT_PHOTON_PACKET
+    // compact photon packets look up their cross sections in a shared table
+    // (an abundance of 1 makes sure the helium cross section is not rescaled)
+    const TabulatedCrossSections cross_section_table(
+        new BenchmarkCrossSections(sigmas_H[ibench], sigmas_He[ibench]));
+    PhotonPacket::set_cross_section_table(&cross_section_table,
+                                          Abundances(1., 0., 0., 0., 0., 0.));
+#endif
+    std::vector< PhotonPacket > photons;
+    DensitySubGrid *grid = setup_benchmark(
+        sides[ibench], number_densities[ibench], cavity_radii[ibench],
+        luminosities[ibench], sigmas_H[ibench], sigmas_He[ibench],
+        number_of_photons, photons);
+    for (uint_fast8_t imode = 0; imode < 2; ++imode) {
+      const std::string label =
+          std::string(names[ibench]) + " (" + mode_names[imode] + ")";
+      Timer total_timer;
+      timingtools_start_timing_block(label.c_str()) {
+        // traversal changes the photon packets, so we work on a copy
+        std::vector< PhotonPacket > batch(photons);
+        total_timer.start();
+        timingtools_start_timing();
+        traverse_photons(*grid, batch, imode == 1);
+        timingtools_stop_timing();
+        total_timer.stop();
+      }
+      timingtools_end_timing_block(label.c_str());
+      timingtools_print("%s (%s): %g photons/s", label.c_str(),
+                        TIMEDENSITYSUBGRID_LAYOUT,
+                        timingtools_num_sample * number_of_photons /
+                            total_timer.value());
+    }
+    delete grid;
+  }
+
+  timingbenchmark_print_sink();
+
+  return 0;
+}
@@ -0,0 +1,230 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file timeNUMAAffinity.cpp
+ *
+ * @brief Timing test for NUMA aware subgrid placement and work stealing.
+ *
+ * We compare the default subgrid placement (subgrids are allocated by
+ * whichever thread grabs them first, random victim work stealing) with NUMA
+ * aware placement (Morton ordered subgrid blocks per NUMA node, same node
+ * victims first). Every round, a memory bound task is created for every
+ * subgrid and put in the queue of the thread that allocated the subgrid. We
+ * count how many tasks are executed by a thread on the NUMA node that holds
+ * the subgrid memory (local) or on another node (remote).
+ *
+ * The NUMA node of every thread is detected at runtime, which requires the
+ * threads to be pinned. Pinning is controlled by the OpenMP runtime and cannot
+ * be changed once the program is running; timeNUMAAffinity_pinning.py runs
+ * this test for a number of different pinning setups.
+ *
+ * Run with e.g. `--number_of_threads 128` to get the scaling for 1 to 128
+ * threads.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "DensitySubGridCreator.hpp"
+#include "HomogeneousDensityFunction.hpp"
+#include "NUMATopology.hpp"
+#include "TimingBenchmark.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+/*! @brief Number of cells in each coordinate direction. */
+#define TIMENUMAAFFINITY_NCELL 128
+
+/*! @brief Number of subgrids in each coordinate direction. */
+#define TIMENUMAAFFINITY_NSUBGRID 16
+
+/*! @brief Number of task rounds. */
+#define TIMENUMAAFFINITY_NROUND 20
+
+/**
+ * @brief Execution statistics for a single run.
+ */
+struct TimeNUMAAffinityStatistics {
+  /*! @brief Number of detected NUMA nodes. */
+  int_fast32_t _number_of_nodes;
+
+  /*! @brief Number of tasks executed on the NUMA node of their subgrid. */
+  uint_fast64_t _local_tasks;
+
+  /*! @brief Number of tasks executed on another NUMA node. */
+  uint_fast64_t _remote_tasks;
+
+  /*! @brief Number of tasks stolen from a thread on another NUMA node. */
+  uint_fast64_t _remote_steals;
+};
+
+/**
+ * @brief Run all tasks using the given number of threads and placement.
+ *
+ * @param number_of_threads Number of threads to use.
+ * @param numa_affinity Use NUMA aware placement and work stealing?
+ * @param statistics Execution statistics (output variable).
+ * @param timer Timer used to time the task execution.
+ */
+void run_tasks(const int_fast32_t number_of_threads, const bool numa_affinity,
+               TimeNUMAAffinityStatistics &statistics, Timer &timer) {
+
+  const NUMATopology topology(number_of_threads);
+
+  DensitySubGridCreator< DensitySubGrid > grid_creator(
+      Box<>(CoordinateVector<>(0.), CoordinateVector<>(1.)),
+      CoordinateVector< int_fast32_t >(TIMENUMAAFFINITY_NCELL),
+      CoordinateVector< int_fast32_t >(TIMENUMAAFFINITY_NSUBGRID),
+      CoordinateVector< bool >(false));
+  HomogeneousDensityFunction density_function;
+  if (numa_affinity) {
+    grid_creator.initialize(density_function, topology);
+  } else {
+    grid_creator.initialize(density_function);
+  }
+
+  // the thread that allocated every subgrid (and hence determines the NUMA
+  // node that holds its memory)
+  const size_t number_of_subgrids = grid_creator.number_of_original_subgrids();
+  std::vector< int_fast32_t > home_threads(number_of_subgrids);
+  for (size_t igrid = 0; igrid < number_of_subgrids; ++igrid) {
+    const DensitySubGrid &subgrid = *grid_creator.get_subgrid(igrid);
+    home_threads[igrid] = subgrid.get_owning_thread();
+  }
+
+  TaskBenchmark benchmark(number_of_threads, number_of_subgrids);
+  ThreadSafeVector< Task > &tasks = benchmark.get_tasks();
+  std::vector< TaskQueue * > &queues = benchmark.get_queues();
+  Scheduler scheduler(tasks, queues, benchmark.get_shared_queue(),
+                      numa_affinity ? SCHEDULER_STEAL_NUMA
+                                    : SCHEDULER_STEAL_RANDOM,
+                      &topology);
+
+  // the thread that executed every task in every round (only counted after
+  // the timed part)
+  std::vector< int_fast32_t > executing_threads(TIMENUMAAFFINITY_NROUND *
+                                                number_of_subgrids);
+  timer.start();
+  for (uint_fast32_t iround = 0; iround < TIMENUMAAFFINITY_NROUND; ++iround) {
+
+    for (size_t igrid = 0; igrid < number_of_subgrids; ++igrid) {
+      const size_t itask = tasks.get_free_element();
+      Task &task = tasks[itask];
+      DensitySubGrid &subgrid = *grid_creator.get_subgrid(igrid);
+      task.set_subgrid(igrid);
+      task.set_dependency(subgrid.get_dependency());
+      queues[home_threads[igrid]]->add_task(itask);
+    }
+
+    int_fast32_t *round_threads =
+        &executing_threads[iround * number_of_subgrids];
+    benchmark.run(scheduler, number_of_subgrids,
+                  [&](const int_fast8_t thread_id, Task &task) {
+                    const size_t igrid = task.get_subgrid();
+                    round_threads[igrid] = thread_id;
+
+                    // memory bound work: read and update every cell in the
+                    // subgrid
+                    double result = 0.;
+                    DensitySubGrid &subgrid = *grid_creator.get_subgrid(igrid);
+                    for (auto it = subgrid.begin(); it != subgrid.end();
+                         ++it) {
+                      IonizationVariables &variables =
+                          it.get_ionization_variables();
+                      const double intensity =
+                          variables.get_mean_intensity(ION_H_n) +
+                          variables.get_number_density() *
+                              variables.get_ionic_fraction(ION_H_n);
+                      variables.set_mean_intensity(ION_H_n, intensity);
+                      result += intensity;
+                    }
+                    return result;
+                  });
+  }
+  timer.stop();
+
+  uint_fast64_t local_tasks = 0;
+  uint_fast64_t remote_tasks = 0;
+  for (size_t i = 0; i < executing_threads.size(); ++i) {
+    if (topology.same_node(executing_threads[i],
+                           home_threads[i % number_of_subgrids])) {
+      ++local_tasks;
+    } else {
+      ++remote_tasks;
+    }
+  }
+
+  statistics._number_of_nodes = topology.get_number_of_nodes();
+  statistics._local_tasks = local_tasks;
+  statistics._remote_tasks = remote_tasks;
+  statistics._remote_steals = scheduler.get_number_of_remote_steals();
+}
+
+/**
+ * @brief Timing test for NUMA aware subgrid placement and work stealing.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeNUMAAffinity", argc, argv);
+
+  const char *proc_bind = std::getenv("OMP_PROC_BIND");
+  const char *places = std::getenv("OMP_PLACES");
+  timingtools_print("Thread pinning: OMP_PROC_BIND=%s, OMP_PLACES=%s",
+                    (proc_bind != nullptr) ? proc_bind : "(not set)",
+                    (places != nullptr) ? places : "(not set)");
+
+  const uint_fast32_t number_of_tasks =
+      TIMENUMAAFFINITY_NROUND * TIMENUMAAFFINITY_NSUBGRID *
+      TIMENUMAAFFINITY_NSUBGRID * TIMENUMAAFFINITY_NSUBGRID;
+  const char *placement_names[2] = {"default placement", "NUMA affinity"};
+  const char *file_names[2] = {"timeNUMAAffinity_scaling_default.txt",
+                               "timeNUMAAffinity_scaling_numa.txt"};
+  for (uint_fast8_t iplacement = 0; iplacement < 2; ++iplacement) {
+
+    timingtools_print_header("Subgrid tasks (%s), %" PRIuFAST32 " tasks.",
+                             placement_names[iplacement], number_of_tasks);
+
+    timingtools_start_scaling_block(placement_names[iplacement]) {
+      TimeNUMAAffinityStatistics statistics;
+      Timer rate_timer;
+      timingtools_start_timing();
+      run_tasks(timingtools_current_num_threads + 1, iplacement == 1,
+                statistics, rate_timer);
+      timingtools_stop_timing();
+      if (timingtools_index == timingtools_num_sample - 1) {
+        timingtools_print(
+            "%u threads on %" PRIiFAST32 " NUMA node(s): %g tasks/s, local "
+            "tasks: %" PRIuFAST64 ", remote tasks: %" PRIuFAST64
+            ", remote steals: %" PRIuFAST64,
+            timingtools_current_num_threads + 1, statistics._number_of_nodes,
+            number_of_tasks / rate_timer.value(), statistics._local_tasks,
+            statistics._remote_tasks, statistics._remote_steals);
+      }
+    }
+    timingtools_end_scaling_block(placement_names[iplacement],
+                                  file_names[iplacement]);
+  }
+
+  timingbenchmark_print_sink();
+
+  return 0;
+}
@@ -0,0 +1,60 @@
+################################################################################
+# This file is part of CMacIonize
+# Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+#
+# CMacIonize is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# CMacIonize is distributed in the hope that it will be useful,
+# but WITOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+################################################################################
+
+##
+# @file timeNUMAAffinity_pinning.py
+#
+# @brief Script that runs timeNUMAAffinity for different thread pinning setups.
+#
+# Thread pinning is set by the OpenMP runtime at program start, so every setup
+# requires a separate run. The scaling files of every run are renamed to
+# include the name of the pinning setup.
+#
+# Usage: python3 timeNUMAAffinity_pinning.py NUMBER_OF_THREADS
+#
+# @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+##
+
+import os
+import subprocess
+import sys
+
+number_of_threads = sys.argv[1] if len(sys.argv) > 1 else "1"
+
+setups = {
+    "unpinned": {"OMP_PROC_BIND": "false"},
+    "close": {"OMP_PROC_BIND": "close", "OMP_PLACES": "cores"},
+    "spread": {"OMP_PROC_BIND": "spread", "OMP_PLACES": "cores"},
+}
+
+for name, variables in setups.items():
+    print("Running pinning setup {0}...".format(name))
+    environment = dict(os.environ)
+    for key in ["OMP_PROC_BIND", "OMP_PLACES"]:
+        environment.pop(key, None)
+    environment.update(variables)
+    subprocess.run(
+        ["./timeNUMAAffinity", "--number_of_threads", number_of_threads],
+        env=environment,
+        check=True,
+    )
+    for placement in ["default", "numa"]:
+        os.rename(
+            "timeNUMAAffinity_scaling_{0}.txt".format(placement),
+            "timeNUMAAffinity_scaling_{0}_{1}.txt".format(placement, name),
+        )
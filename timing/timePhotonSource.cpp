@@ -0,0 +1,245 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file timePhotonSource.cpp
+ *
+ * @brief Timing test for the generation of photons by a PhotonSource with a
+ * large number of discrete sources.
+ *
+ * For 1 to 10^6 sources with random weights, we time the generation of photons
+ * with PhotonSource::get_random_photon(), which selects a source using an
+ * AliasTable. For comparison, we also time the source selection on its own,
+ * both with the alias table and with a linear walk through the cumulative
+ * probabilities (the method used before the alias table was introduced).
+ * Results are given as photons (or selections) per second.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "Abundances.hpp"
+#include "AliasTable.hpp"
+#include "CrossSections.hpp"
+#include "MonochromaticPhotonSourceSpectrum.hpp"
+#include "PhotonSource.hpp"
+#include "PhotonSourceDistribution.hpp"
+#include "RandomGenerator.hpp"
+#include "TimingTools.hpp"
+
+#include <algorithm>
+#include <vector>
+
+/*! @brief Number of photons generated for every source number. */
+#define TIMEPHOTONSOURCE_NPHOTON 1000000u
+
+/*! @brief Maximum number of linear source selections for every source number.
+ *  The linear selection cost scales with the number of sources, so we limit
+ *  the total amount of work. */
+#define TIMEPHOTONSOURCE_NLINEAR_WORK 2000000000u
+
+/**
+ * @brief PhotonSourceDistribution with a given number of sources with random
+ * positions and random weights.
+ */
+class TimingPhotonSourceDistribution : public PhotonSourceDistribution {
+private:
+  /*! @brief Positions of the sources. */
+  std::vector< CoordinateVector<> > _positions;
+
+  /*! @brief Weights of the sources. */
+  std::vector< double > _weights;
+
+public:
+  /**
+   * @brief Constructor.
+   *
+   * @param number_of_sources Number of sources.
+   * @param random_generator RandomGenerator used to generate positions and
+   * weights.
+   */
+  TimingPhotonSourceDistribution(const photonsourcenumber_t number_of_sources,
+                                 RandomGenerator &random_generator)
+      : _positions(number_of_sources), _weights(number_of_sources) {
+    double total_weight = 0.;
+    for (photonsourcenumber_t i = 0; i < number_of_sources; ++i) {
+      _positions[i][0] = random_generator.get_uniform_random_double();
+      _positions[i][1] = random_generator.get_uniform_random_double();
+      _positions[i][2] = random_generator.get_uniform_random_double();
+      _weights[i] = random_generator.get_uniform_random_double();
+      total_weight += _weights[i];
+    }
+    for (photonsourcenumber_t i = 0; i < number_of_sources; ++i) {
+      _weights[i] /= total_weight;
+    }
+  }
+
+  virtual ~TimingPhotonSourceDistribution() {}
+
+  /**
+   * @brief Get the number of sources.
+   *
+   * @return Number of sources.
+   */
+  virtual photonsourcenumber_t get_number_of_sources() const {
+    return _positions.size();
+  }
+
+  /**
+   * @brief Get the position of the source with the given index.
+   *
+   * @param index Index of a source.
+   * @return Position of that source.
+   */
+  virtual CoordinateVector<> get_position(photonsourcenumber_t index) {
+    return _positions[index];
+  }
+
+  /**
+   * @brief Get the weight of the source with the given index.
+   *
+   * @param index Index of a source.
+   * @return Weight of that source.
+   */
+  virtual double get_weight(photonsourcenumber_t index) const {
+    return _weights[index];
+  }
+
+  /**
+   * @brief Get the total luminosity of all sources.
+   *
+   * @return Total luminosity (in s^-1).
+   */
+  virtual double get_total_luminosity() const { return 1.e49; }
+};
+
+/**
+ * @brief CrossSections implementation with constant cross sections.
+ */
+class TimingCrossSections : public CrossSections {
+public:
+  /**
+   * @brief Get the photoionization cross section for the given ion at the
+   * given photon energy.
+   *
+   * @param ion IonName for an ion.
+   * @param energy Photon energy.
+   * @return Photoionization cross section.
+   */
+  virtual double get_cross_section(int_fast32_t ion, double energy) const {
+    return 6.3e-22;
+  }
+};
+
+/**
+ * @brief Timing test for the generation of photons by a PhotonSource with a
+ * large number of discrete sources.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timePhotonSource", argc, argv);
+
+  MonochromaticPhotonSourceSpectrum spectrum(3.28847e15);
+  TimingCrossSections cross_sections;
+  Abundances abundances(0., 0., 0., 0., 0., 0.);
+  RandomGenerator random_generator(42);
+  double dummy = 0.;
+
+  for (photonsourcenumber_t number_of_sources = 1;
+       number_of_sources <= 1000000; number_of_sources *= 10) {
+
+    timingtools_print_header("%" PRIuFAST32 " sources", number_of_sources);
+
+    TimingPhotonSourceDistribution distribution(number_of_sources,
+                                                random_generator);
+    PhotonSource source(&distribution, &spectrum, nullptr, nullptr,
+                        abundances, cross_sections);
+
+    std::vector< double > weights(number_of_sources);
+    std::vector< double > cumulative(number_of_sources);
+    for (photonsourcenumber_t i = 0; i < number_of_sources; ++i) {
+      weights[i] = distribution.get_weight(i);
+      cumulative[i] = (i > 0) ? cumulative[i - 1] + weights[i] : weights[i];
+    }
+    cumulative.back() = 1.;
+    AliasTable table;
+    table.initialize(weights);
+
+    Timer photon_timer;
+    timingtools_start_timing_block("PhotonSource::get_random_photon") {
+      timingtools_start_timing();
+      photon_timer.start();
+      for (uint_fast32_t i = 0; i < TIMEPHOTONSOURCE_NPHOTON; ++i) {
+        const Photon photon = source.get_random_photon(random_generator);
+        dummy += photon.get_position().x();
+      }
+      photon_timer.stop();
+      timingtools_stop_timing();
+    }
+    timingtools_end_timing_block("PhotonSource::get_random_photon");
+
+    Timer alias_timer;
+    timingtools_start_timing_block("alias table selection") {
+      timingtools_start_timing();
+      alias_timer.start();
+      for (uint_fast32_t i = 0; i < TIMEPHOTONSOURCE_NPHOTON; ++i) {
+        dummy +=
+            table.get_index(random_generator.get_uniform_random_double());
+      }
+      alias_timer.stop();
+      timingtools_stop_timing();
+    }
+    timingtools_end_timing_block("alias table selection");
+
+    const uint_fast32_t number_of_linear_samples =
+        std::min< uint_fast32_t >(TIMEPHOTONSOURCE_NPHOTON,
+                                  TIMEPHOTONSOURCE_NLINEAR_WORK /
+                                      number_of_sources);
+    Timer linear_timer;
+    timingtools_start_timing_block("linear selection") {
+      timingtools_start_timing();
+      linear_timer.start();
+      for (uint_fast32_t i = 0; i < number_of_linear_samples; ++i) {
+        const double x = random_generator.get_uniform_random_double();
+        photonsourcenumber_t index = 0;
+        while (x > cumulative[index]) {
+          ++index;
+        }
+        dummy += index;
+      }
+      linear_timer.stop();
+      timingtools_stop_timing();
+    }
+    timingtools_end_timing_block("linear selection");
+
+    const double number_of_samples = timingtools_num_sample;
+    timingtools_print(
+        "%" PRIuFAST32 " sources: %g photons/s, alias table: %g "
+        "selections/s, linear: %g selections/s",
+        number_of_sources,
+        number_of_samples * TIMEPHOTONSOURCE_NPHOTON / photon_timer.value(),
+        number_of_samples * TIMEPHOTONSOURCE_NPHOTON / alias_timer.value(),
+        number_of_samples * number_of_linear_samples / linear_timer.value());
+  }
+
+  timingtools_print("(dummy result: %g)", dummy);
+
+  return 0;
+}
@@ -21,11 +21,18 @@
  *
  * @brief Timing test for the Riemann solver.
  *
+ * Also times the flux sweep of a HydroDensitySubGrid set up with the Bondi
+ * profile of the bondi benchmark. Results are given as cell updates per
+ * second, for both the face by face and the pencil flux sweep.
+ *
  * @author Bert Vandenbroucke (bv7@st-andrews.ac.uk)
  */
+#include "BondiProfile.hpp"
 #include "ExactRiemannSolver.hpp"
 #include "HLLCRiemannSolver.hpp"
+#include "HydroDensitySubGrid.hpp"
 #include "TimingTools.hpp"
+#include "UnitConverter.hpp"
 #include <vector>
 
 /**
@@ -93,4 +100,62 @@ int main(int argc, char **argv) {
     timingtools_stop_timing();
   }
   timingtools_end_timing_block("HLLCRiemannSolver");
+
+  // set up a 64^3 subgrid with the Bondi profile of the bondi benchmark
+  const double au = UnitConverter::to_SI< QUANTITY_LENGTH >(1., "au");
+  const double box[6] = {-50. * au, -50. * au, -50. * au,
+                         100. * au, 100. * au, 100. * au};
+  const CoordinateVector< int_fast32_t > ncell(64);
+  HydroDensitySubGrid subgrid(box, ncell);
+  const BondiProfile bondi_profile(
+      UnitConverter::to_SI< QUANTITY_MASS >(18., "Msol"),
+      UnitConverter::to_SI< QUANTITY_DENSITY >(1.e-19, "g cm^-3"),
+      UnitConverter::to_SI< QUANTITY_VELOCITY >(2.031, "km s^-1"));
+  for (auto cellit = subgrid.hydro_begin(); cellit != subgrid.hydro_end();
+       ++cellit) {
+    double density, pressure, neutral_fraction;
+    CoordinateVector<> velocity;
+    bondi_profile.get_hydrodynamic_variables(
+        cellit.get_cell_midpoint(), density, velocity, pressure,
+        neutral_fraction);
+    HydroVariables &hydro_variables = cellit.get_hydro_variables();
+    hydro_variables.set_primitives_density(density);
+    hydro_variables.set_primitives_velocity(velocity);
+    hydro_variables.set_primitives_pressure(pressure);
+  }
+  const Hydro hydro(1., 500., 1.e4, 1.e99, false);
+  const double dt = subgrid.initialize_hydrodynamic_variables(hydro, false);
+  subgrid.inner_gradient_sweep(hydro);
+  subgrid.apply_slope_limiter(hydro);
+
+  const uint_fast32_t num_sweep = 10;
+  const double num_update =
+      double(num_sweep) * subgrid.get_number_of_cells();
+  Timer face_timer;
+  timingtools_start_timing_block("face by face flux sweep") {
+    face_timer.start();
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < num_sweep; ++i) {
+      subgrid.inner_face_flux_sweep(hydro, dt);
+    }
+    timingtools_stop_timing();
+    face_timer.stop();
+  }
+  timingtools_end_timing_block("face by face flux sweep");
+  timingtools_print("%g cell updates/s",
+                    timingtools_num_sample * num_update / face_timer.value());
+
+  Timer pencil_timer;
+  timingtools_start_timing_block("pencil flux sweep") {
+    pencil_timer.start();
+    timingtools_start_timing();
+    for (uint_fast32_t i = 0; i < num_sweep; ++i) {
+      subgrid.inner_flux_sweep(hydro, dt);
+    }
+    timingtools_stop_timing();
+    pencil_timer.stop();
+  }
+  timingtools_end_timing_block("pencil flux sweep");
+  timingtools_print("%g cell updates/s",
+                    timingtools_num_sample * num_update / pencil_timer.value());
 }
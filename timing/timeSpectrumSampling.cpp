@@ -0,0 +1,182 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file timeSpectrumSampling.cpp
+ *
+ * @brief Timing test for the sampling of frequencies from a tabulated
+ * spectrum.
+ *
+ * We sample frequencies from a tabulated cumulative distribution with the same
+ * size as the one used by most tabulated spectra (1000 bins), using a binary
+ * search (Utilities::locate()), a GuideTable, and the bulk sampling function
+ * of GuideTable. The uniform random numbers are generated in advance, so that
+ * only the cost of the inversion is measured. Results are given as samples per
+ * second.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "GuideTable.hpp"
+#include "RandomGenerator.hpp"
+#include "TimingTools.hpp"
+#include "Utilities.hpp"
+
+#include <cmath>
+#include <vector>
+
+/*! @brief Number of bins in the cumulative distribution. */
+#define TIMESPECTRUMSAMPLING_NFREQ 1000
+
+/*! @brief Number of pregenerated uniform random numbers. */
+#define TIMESPECTRUMSAMPLING_NRANDOM 1000000u
+
+/*! @brief Number of times every random number is used in every timing
+ *  block. */
+#define TIMESPECTRUMSAMPLING_NREPEAT 10u
+
+/*! @brief Number of samples drawn at once by the bulk sampling function. */
+#define TIMESPECTRUMSAMPLING_NBULK 200u
+
+/**
+ * @brief Timing test for the sampling of frequencies from a tabulated
+ * spectrum.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeSpectrumSampling", argc, argv);
+
+  // power law spectrum with a sharp drop, which is similar to the ionizing
+  // part of a stellar spectrum
+  std::vector< double > frequencies(TIMESPECTRUMSAMPLING_NFREQ);
+  std::vector< double > cumulative_distribution(TIMESPECTRUMSAMPLING_NFREQ);
+  for (uint_fast32_t i = 0; i < TIMESPECTRUMSAMPLING_NFREQ; ++i) {
+    frequencies[i] =
+        3.289e15 * (1. + 3. * i / (TIMESPECTRUMSAMPLING_NFREQ - 1.));
+  }
+  cumulative_distribution[0] = 0.;
+  for (uint_fast32_t i = 1; i < TIMESPECTRUMSAMPLING_NFREQ; ++i) {
+    const double nu = frequencies[i] / 3.289e15;
+    const double spectrum = (nu < 1.8) ? std::pow(nu, -3.) : 1.e-3 * nu;
+    cumulative_distribution[i] =
+        cumulative_distribution[i - 1] +
+        spectrum * (frequencies[i] - frequencies[i - 1]);
+  }
+  for (uint_fast32_t i = 0; i < TIMESPECTRUMSAMPLING_NFREQ; ++i) {
+    cumulative_distribution[i] /=
+        cumulative_distribution[TIMESPECTRUMSAMPLING_NFREQ - 1];
+  }
+
+  GuideTable guide_table;
+  guide_table.initialize(cumulative_distribution.data(),
+                         TIMESPECTRUMSAMPLING_NFREQ);
+
+  RandomGenerator random_generator(42);
+  std::vector< double > random_numbers(TIMESPECTRUMSAMPLING_NRANDOM);
+  for (uint_fast32_t i = 0; i < TIMESPECTRUMSAMPLING_NRANDOM; ++i) {
+    random_numbers[i] = random_generator.get_uniform_random_double();
+  }
+  double dummy = 0.;
+
+  Timer locate_timer;
+  timingtools_start_timing_block("binary search") {
+    timingtools_start_timing();
+    locate_timer.start();
+    for (uint_fast32_t irep = 0; irep < TIMESPECTRUMSAMPLING_NREPEAT;
+         ++irep) {
+      for (uint_fast32_t i = 0; i < TIMESPECTRUMSAMPLING_NRANDOM; ++i) {
+        const double x = random_numbers[i];
+        const uint_fast32_t inu =
+            Utilities::locate(x, cumulative_distribution.data(),
+                              TIMESPECTRUMSAMPLING_NFREQ);
+        dummy += frequencies[inu] +
+                 (frequencies[inu + 1] - frequencies[inu]) *
+                     (x - cumulative_distribution[inu]) /
+                     (cumulative_distribution[inu + 1] -
+                      cumulative_distribution[inu]);
+      }
+    }
+    locate_timer.stop();
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block("binary search");
+
+  Timer guide_timer;
+  timingtools_start_timing_block("guide table") {
+    timingtools_start_timing();
+    guide_timer.start();
+    double samples[TIMESPECTRUMSAMPLING_NBULK];
+    for (uint_fast32_t irep = 0; irep < TIMESPECTRUMSAMPLING_NREPEAT;
+         ++irep) {
+      for (uint_fast32_t i = 0; i < TIMESPECTRUMSAMPLING_NRANDOM;
+           i += TIMESPECTRUMSAMPLING_NBULK) {
+        for (uint_fast32_t j = 0; j < TIMESPECTRUMSAMPLING_NBULK; ++j) {
+          samples[j] = guide_table.sample_linear(random_numbers[i + j],
+                                                 cumulative_distribution.data(),
+                                                 frequencies.data());
+        }
+        for (uint_fast32_t j = 0; j < TIMESPECTRUMSAMPLING_NBULK; ++j) {
+          dummy += samples[j];
+        }
+      }
+    }
+    guide_timer.stop();
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block("guide table");
+
+  Timer bulk_timer;
+  timingtools_start_timing_block("guide table (bulk)") {
+    timingtools_start_timing();
+    bulk_timer.start();
+    double samples[TIMESPECTRUMSAMPLING_NBULK];
+    for (uint_fast32_t irep = 0; irep < TIMESPECTRUMSAMPLING_NREPEAT;
+         ++irep) {
+      for (uint_fast32_t i = 0; i < TIMESPECTRUMSAMPLING_NRANDOM;
+           i += TIMESPECTRUMSAMPLING_NBULK) {
+        for (uint_fast32_t j = 0; j < TIMESPECTRUMSAMPLING_NBULK; ++j) {
+          samples[j] = random_numbers[i + j];
+        }
+        guide_table.sample_linear(TIMESPECTRUMSAMPLING_NBULK, samples,
+                                  cumulative_distribution.data(),
+                                  frequencies.data());
+        for (uint_fast32_t j = 0; j < TIMESPECTRUMSAMPLING_NBULK; ++j) {
+          dummy += samples[j];
+        }
+      }
+    }
+    bulk_timer.stop();
+    timingtools_stop_timing();
+  }
+  timingtools_end_timing_block("guide table (bulk)");
+
+  const double number_of_samples =
+      static_cast< double >(timingtools_num_sample) *
+      TIMESPECTRUMSAMPLING_NRANDOM * TIMESPECTRUMSAMPLING_NREPEAT;
+  timingtools_print("binary search: %g samples/s, guide table: %g samples/s, "
+                    "guide table (bulk): %g samples/s",
+                    number_of_samples / locate_timer.value(),
+                    number_of_samples / guide_timer.value(),
+                    number_of_samples / bulk_timer.value());
+  timingtools_print("(dummy result: %g)", dummy);
+
+  return 0;
+}
@@ -0,0 +1,157 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file timeTaskQueue.cpp
+ *
+ * @brief Timing test for the task queues and the Scheduler.
+ *
+ * All initial tasks are put in the queue of the first thread (as happens for a
+ * single bright source), so that all other threads need to steal work. Every
+ * task creates a child task in the queue of the executing thread until a given
+ * depth is reached, and tasks share a limited number of dependencies (like
+ * photon traversal tasks share subgrids).
+ *
+ * Run with e.g. `--number_of_threads 64` to get the scaling for 1 to 64
+ * threads.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "TimingBenchmark.hpp"
+
+#include <cmath>
+#include <vector>
+
+/*! @brief Number of initial tasks. */
+#define TIMETASKQUEUE_NTASK 20000
+
+/*! @brief Number of child tasks created for every initial task. */
+#define TIMETASKQUEUE_DEPTH 4
+
+/*! @brief Number of different task dependencies. */
+#define TIMETASKQUEUE_NDEPENDENCY 64
+
+/**
+ * @brief Run all tasks using the given number of threads and steal policy.
+ *
+ * @param number_of_threads Number of threads to use.
+ * @param steal_policy Steal policy used by the Scheduler.
+ * @param steal_attempts Number of steal attempts (output variable).
+ * @param steal_successes Number of successful steals (output variable).
+ * @param timer Timer used to time the task execution.
+ */
+void run_tasks(const int_fast32_t number_of_threads,
+               const SchedulerStealPolicy steal_policy,
+               uint_fast64_t &steal_attempts, uint_fast64_t &steal_successes,
+               Timer &timer) {
+
+  const uint_fast32_t number_of_tasks =
+      TIMETASKQUEUE_NTASK * (TIMETASKQUEUE_DEPTH + 1);
+
+  TaskBenchmark benchmark(number_of_threads, number_of_tasks);
+  ThreadSafeVector< Task > &tasks = benchmark.get_tasks();
+  std::vector< TaskQueue * > &queues = benchmark.get_queues();
+  ThreadLock dependencies[TIMETASKQUEUE_NDEPENDENCY];
+
+  for (uint_fast32_t i = 0; i < TIMETASKQUEUE_NTASK; ++i) {
+    const size_t itask = tasks.get_free_element();
+    Task &task = tasks[itask];
+    task.set_subgrid(i % TIMETASKQUEUE_NDEPENDENCY);
+    task.set_buffer(TIMETASKQUEUE_DEPTH);
+    task.set_dependency(&dependencies[i % TIMETASKQUEUE_NDEPENDENCY]);
+    queues[0]->add_task(itask);
+  }
+
+  Scheduler scheduler(tasks, queues, benchmark.get_shared_queue(),
+                      steal_policy);
+  timer.start();
+  benchmark.run(scheduler, number_of_tasks,
+                [&](const int_fast8_t thread_id, Task &task) {
+                  // do some work
+                  double result = 0.;
+                  for (uint_fast32_t i = 0; i < 100; ++i) {
+                    result += std::cos(0.01 * M_PI * i);
+                  }
+
+                  const uint_fast32_t depth = task.get_buffer();
+                  if (depth > 0) {
+                    const uint_fast32_t new_subgrid =
+                        (task.get_subgrid() + 1) % TIMETASKQUEUE_NDEPENDENCY;
+                    const size_t itask = tasks.get_free_element();
+                    Task &new_task = tasks[itask];
+                    new_task.set_subgrid(new_subgrid);
+                    new_task.set_buffer(depth - 1);
+                    new_task.set_dependency(&dependencies[new_subgrid]);
+                    queues[thread_id]->add_task(itask);
+                  }
+                  return result;
+                });
+  timer.stop();
+
+  steal_attempts = scheduler.get_number_of_steal_attempts();
+  steal_successes = scheduler.get_number_of_successful_steals();
+}
+
+/**
+ * @brief Timing test for the task queues and the Scheduler.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeTaskQueue", argc, argv);
+
+  const uint_fast32_t number_of_tasks =
+      TIMETASKQUEUE_NTASK * (TIMETASKQUEUE_DEPTH + 1);
+  const char *policy_names[2] = {"random victim", "nearest neighbour"};
+  const SchedulerStealPolicy policies[2] = {SCHEDULER_STEAL_RANDOM,
+                                            SCHEDULER_STEAL_NEIGHBOUR};
+  const char *file_names[2] = {"timeTaskQueue_scaling_random.txt",
+                               "timeTaskQueue_scaling_neighbour.txt"};
+  for (uint_fast8_t ipolicy = 0; ipolicy < 2; ++ipolicy) {
+
+    timingtools_print_header("Work stealing (%s), %" PRIuFAST32 " tasks.",
+                             policy_names[ipolicy], number_of_tasks);
+
+    timingtools_start_scaling_block(policy_names[ipolicy]) {
+      uint_fast64_t steal_attempts, steal_successes;
+      Timer rate_timer;
+      timingtools_start_timing();
+      run_tasks(timingtools_current_num_threads + 1, policies[ipolicy],
+                steal_attempts, steal_successes, rate_timer);
+      timingtools_stop_timing();
+      if (timingtools_index == timingtools_num_sample - 1) {
+        timingtools_print(
+            "%u threads: %g tasks/s, steal success rate: %g (%" PRIuFAST64
+            " attempts)",
+            timingtools_current_num_threads + 1,
+            number_of_tasks / rate_timer.value(),
+            (steal_attempts > 0) ? steal_successes / double(steal_attempts)
+                                 : 0.,
+            steal_attempts);
+      }
+    }
+    timingtools_end_scaling_block(policy_names[ipolicy], file_names[ipolicy]);
+  }
+
+  timingbenchmark_print_sink();
+
+  return 0;
+}
@@ -0,0 +1,116 @@
+/*******************************************************************************
+ * This file is part of CMacIonize
+ * Copyright (C) 2020 Bert Vandenbroucke (bert.vandenbroucke@gmail.com)
+ *
+ * CMacIonize is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * CMacIonize is distributed in the hope that it will be useful,
+ * but WITOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with CMacIonize. If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/**
+ * @file timeVoronoiDensityGrid.cpp
+ *
+ * @brief Timing test for photon propagation through a VoronoiDensityGrid.
+ *
+ * Uses the grid setup of the starbench_voronoi benchmark: 10,000 uniform
+ * random generators with 10 Lloyd iterations in a 2.512 pc box, a homogeneous
+ * density of 3113 cm^-3 and a monochromatic 13.6 eV source at the centre.
+ *
+ * @author Bert Vandenbroucke (bert.vandenbroucke@ugent.be)
+ */
+#include "HomogeneousDensityFunction.hpp"
+#include "RandomGenerator.hpp"
+#include "TimingBenchmark.hpp"
+#include "UniformRandomVoronoiGeneratorDistribution.hpp"
+#include "VoronoiDensityGrid.hpp"
+
+#include <vector>
+
+/**
+ * @brief Propagate the given number of photons from the centre of the grid.
+ *
+ * @param grid VoronoiDensityGrid.
+ * @param number_of_photons Number of photons to propagate.
+ * @param random_generator RandomGenerator used to generate directions and
+ * optical depths.
+ */
+void propagate_photons(VoronoiDensityGrid &grid,
+                       const uint_fast32_t number_of_photons,
+                       RandomGenerator &random_generator) {
+
+  double result = 0.;
+  for (uint_fast32_t i = 0; i < number_of_photons; ++i) {
+    const double cost = 2. * random_generator.get_uniform_random_double() - 1.;
+    const double phi = 2. * M_PI * random_generator.get_uniform_random_double();
+    const double sint = std::sqrt(std::max(1. - cost * cost, 0.));
+    const CoordinateVector<> direction(sint * std::cos(phi),
+                                       sint * std::sin(phi), cost);
+    Photon photon(CoordinateVector<>(0.), direction, 3.288e15);
+    photon.set_cross_section(ION_H_n, 6.3e-22);
+    const double tau = -std::log(random_generator.get_uniform_random_double());
+    DensityGrid::iterator it = grid.interact(photon, tau);
+    result += photon.get_position().x();
+    if (it != grid.end()) {
+      result += it.get_index();
+    }
+  }
+  timingbenchmark_consume(result);
+}
+
+/**
+ * @brief Timing test for photon propagation through a VoronoiDensityGrid.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Command line arguments.
+ * @return Exit code: 0 on success.
+ */
+int main(int argc, char **argv) {
+
+  timingtools_init("timeVoronoiDensityGrid", argc, argv);
+
+  const double pc = 3.086e16;
+  const Box<> box(CoordinateVector<>(-1.256 * pc),
+                  CoordinateVector<>(2.512 * pc));
+  UniformRandomVoronoiGeneratorDistribution *generators =
+      new UniformRandomVoronoiGeneratorDistribution(box, 10000, 42);
+  VoronoiDensityGrid grid(generators, box, "Old", 10);
+  // use a very low neutral fraction, so that most photons cross the entire
+  // grid (like in the ionized region of the benchmark)
+  HomogeneousDensityFunction density_function(3.113e9, 8000., 1.e-6);
+  density_function.initialize();
+  std::pair< cellsize_t, cellsize_t > block =
+      std::make_pair(0, grid.get_number_of_cells());
+  grid.initialize(block, density_function);
+
+  const uint_fast32_t number_of_photons = 100000;
+  RandomGenerator random_generator(42);
+
+  timingtools_print_header("starbench_voronoi grid, %" PRIuFAST32 " photons.",
+                           number_of_photons);
+
+  Timer rate_timer;
+  timingtools_start_timing_block("photon propagation") {
+    rate_timer.start();
+    timingtools_start_timing();
+    propagate_photons(grid, number_of_photons, random_generator);
+    timingtools_stop_timing();
+    rate_timer.stop();
+  }
+  timingtools_end_timing_block("photon propagation");
+
+  timingtools_print("%g photons/s",
+                    timingtools_num_sample * number_of_photons /
+                        rate_timer.value());
+  timingbenchmark_print_sink();
+
+  return 0;
+}
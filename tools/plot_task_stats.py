@@ -64,6 +64,9 @@ task_names = [
     "update conserved",
     "update primitives",
     "flush continuous buffers",
+    "gradsweep fused",
+    "fluxsweep fused",
+    "update fused",
 ]
 
 # load the task data
@@ -72,6 +72,9 @@ task_names = [
     "update conserved",
     "update primitives",
     "flush continuous buffers",
+    "gradsweep fused",
+    "fluxsweep fused",
+    "update fused",
 ]
 task_colors = pl.cm.ScalarMappable(cmap="tab20").to_rgba(
     np.linspace(0.0, 1.0, len(task_names))